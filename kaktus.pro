@@ -12,6 +12,11 @@ CONFIG(debug, debug|release) {
     CONFIG += sanitizer sanitize_address
 }
 
+# DB query instrumentation, disable with: qmake CONFIG+=no_db_stats
+!no_db_stats {
+    DEFINES += KAKTUS_DB_STATS
+}
+
 INCLUDEPATH += src
 
 include(qhttpserver/qhttpserver.pri)
@@ -41,7 +46,16 @@ SOURCES += \
     src/ttrssfetcher.cpp \
     src/networkaccessmanagerfactory.cpp \
     src/customnetworkaccessmanager.cpp \
-    src/iconprovider.cpp
+    src/iconprovider.cpp \
+    src/querystats.cpp \
+    src/jsonentrydecoder.cpp \
+    src/htmlscanner.cpp \
+    src/ingestpipeline.cpp \
+    src/syncscheduler.cpp \
+    src/syncstats.cpp \
+    src/networkmanager.cpp \
+    src/batchtuner.cpp \
+    src/hotentries.cpp
 
 HEADERS += \
     src/info.h \
@@ -65,7 +79,36 @@ HEADERS += \
     src/ttrssfetcher.h \
     src/networkaccessmanagerfactory.h \
     src/customnetworkaccessmanager.h \
-    src/key.h
+    src/key.h \
+    src/querystats.h \
+    src/jsonentrydecoder.h \
+    src/htmlscanner.h \
+    src/ingestpipeline.h \
+    src/syncscheduler.h \
+    src/syncstats.h \
+    src/networkmanager.h \
+    src/batchtuner.h \
+    src/hotentries.h
+
+# Local replay server and headless sync benchmark are not shipped, enable
+# with: qmake CONFIG+=benchmark
+benchmark {
+    DEFINES += KAKTUS_BENCHMARK
+
+    SOURCES += \
+        src/replayserver.cpp \
+        src/syncbenchmark.cpp
+
+    HEADERS += \
+        src/replayserver.h \
+        src/syncbenchmark.h
+
+    # Full and incremental sync of all aggregators against local replay
+    # server: make benchmark
+    benchmark.commands = QT_QPA_PLATFORM=offscreen $$OUT_PWD/$$TARGET --benchmark-sync all
+    benchmark.depends = $(TARGET)
+    QMAKE_EXTRA_TARGETS += benchmark
+}
 
 SAILFISHAPP_ICONS = 86x86 108x108 128x128 150x150 172x172 256x256
 CONFIG += sailfishapp_i18n_include_obsolete
@@ -62,6 +62,9 @@ CoverBackground {
         case 4:
             label = qsTr("Signing in")
             break;
+        case 5:
+            label = qsTr("Refreshing")
+            break;
         case 11:
         case 21:
         case 31:
@@ -59,6 +59,99 @@ Page {
                     debug.test();
                 }
             }
+
+            TextSwitch {
+                text: "DB query statistics"
+                description: dbstats.available ? "Per-method timing and slow query log" :
+                                                 "Not available in this build"
+                enabled: dbstats.available
+                onCheckedChanged: {
+                    dbstats.enabled = checked;
+                }
+                Component.onCompleted: {
+                    checked = dbstats.enabled;
+                }
+            }
+
+            Row {
+                spacing: Theme.paddingMedium
+                Button {
+                    text: "Refresh"
+                    onClicked: statsLabel.text = dbstats.report()
+                }
+                Button {
+                    text: "Dump to file"
+                    onClicked: {
+                        var path = dbstats.dump();
+                        if (path.length > 0)
+                            notification.show(path);
+                    }
+                }
+                Button {
+                    text: "Reset"
+                    onClicked: {
+                        dbstats.reset();
+                        statsLabel.text = "";
+                    }
+                }
+            }
+
+            Label {
+                id: statsLabel
+                width: parent.width
+                wrapMode: Text.WrapAnywhere
+                font.family: "Monospace"
+                font.pixelSize: Theme.fontSizeTiny
+                color: Theme.secondaryColor
+            }
+
+            SectionHeader {
+                text: "Sync statistics"
+            }
+
+            Row {
+                spacing: Theme.paddingMedium
+                Button {
+                    text: "Clear"
+                    onClicked: syncstats.clear()
+                }
+            }
+
+            Label {
+                id: syncLabel
+                width: parent.width
+                wrapMode: Text.WrapAnywhere
+                font.family: "Monospace"
+                font.pixelSize: Theme.fontSizeTiny
+                color: Theme.secondaryColor
+                text: syncstats.report()
+
+                Connections {
+                    target: syncstats
+                    onUpdated: syncLabel.text = syncstats.report()
+                }
+            }
+
+            Row {
+                spacing: Theme.paddingMedium
+                Button {
+                    text: "Compact DB"
+                    enabled: !fetcher.busy
+                    onClicked: {
+                        if (fetcher.compactDB())
+                            freePagesLabel.update();
+                    }
+                }
+                Label {
+                    id: freePagesLabel
+                    anchors.verticalCenter: parent.verticalCenter
+                    color: Theme.secondaryColor
+                    function update() {
+                        text = "Free pages: " + (db.freePageRatio() * 100).toFixed(1) + "%";
+                    }
+                    Component.onCompleted: update()
+                }
+            }
         }
     }
 }
@@ -22,8 +22,6 @@ ListItem {
     property int read: 0
     property int readlater: 0
     property string content
-    property string contentall
-    property string contentraw
     property string image
     property bool friendStream
     property string feedIcon
@@ -40,7 +40,7 @@ Page {
 
     function setContentPane(delegate) {
         contentPanel.index = delegate.index
-        contentPanel.content = delegate.contentall;
+        contentPanel.content = entryModel.readContentText(delegate.uid);
         contentPanel.image = delegate.image;
         contentPanel.expanded = false;
         delegate.expanded = true;
@@ -191,8 +191,6 @@ Page {
             uid: model.uid
             title: model.title
             content: model.content
-            contentall: model.contentall
-            contentraw: model.contentraw
             date: model.date
             read: model.read
             friendStream: model.feedId.substring(0,4) === "user"
@@ -276,7 +274,7 @@ Page {
                 app.hideBar()
                 pageStack.push(Qt.resolvedUrl("FeedWebContentPage.qml"),
                                {"entryId": model.uid,
-                                   "content": model.contentraw,
+                                   "content": entryModel.readContent(model.uid),
                                    "onlineUrl": delegate.onlineurl,
                                    "offlineUrl": delegate.offlineurl,
                                    "title": model.title,
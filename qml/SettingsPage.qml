@@ -241,6 +241,18 @@ Page {
                             }
                         }
 
+                        TextSwitch {
+                            text: qsTr("Background refresh")
+                            description: qsTr("Feeds are refreshed in the background when they are due. " +
+                                              "Feeds that post often are checked more frequently than quiet ones.")
+                            onCheckedChanged: {
+                                settings.backgroundSync = checked;
+                            }
+                            Component.onCompleted: {
+                                checked = settings.backgroundSync;
+                            }
+                        }
+
                         Spacer {}
                     }
                 }
@@ -533,6 +545,17 @@ Page {
                             }
                         }
 
+                        TextSwitch {
+                            text: qsTr("Collapse duplicates")
+                            description: qsTr("Article delivered by many feeds is listed only once in the view of all articles.")
+                            onCheckedChanged: {
+                                settings.collapseDuplicates = checked;
+                            }
+                            Component.onCompleted: {
+                                checked = settings.collapseDuplicates;
+                            }
+                        }
+
                         ComboBox {
                             width: root.width
                             label: qsTr("Clicking on article behaviour")
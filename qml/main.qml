@@ -220,6 +220,7 @@ ApplicationWindow {
         if (typeof fetcher === 'undefined')
             return;
         fetcher.ready.connect(fetcherReady);
+        fetcher.refreshed.connect(fetcherRefreshed);
         fetcher.newAuthUrl.connect(fetcherNewAuthUrl);
         fetcher.errorGettingAuthUrl.connect(fetcherErrorGettingAuthUrl);
         fetcher.networkNotAccessible.connect(fetcherNetworkNotAccessible);
@@ -238,6 +239,7 @@ ApplicationWindow {
         if (typeof fetcher === 'undefined')
             return;
         fetcher.ready.disconnect(fetcherReady);
+        fetcher.refreshed.disconnect(fetcherRefreshed);
         fetcher.newAuthUrl.disconnect(fetcherNewAuthUrl);
         fetcher.errorGettingAuthUrl.disconnect(fetcherErrorGettingAuthUrl);
         fetcher.networkNotAccessible.disconnect(fetcherNetworkNotAccessible);
@@ -255,7 +257,11 @@ ApplicationWindow {
     property bool fetcherBusyStatus: false
 
     function fetcherReady() {
-        resetView();
+        // Models are reloaded in place when only entries have changed
+        if (fetcher.structureChanged)
+            resetView();
+        else
+            utils.updateModels();
 
         switch (settings.cachingMode) {
         case 0:
@@ -271,6 +277,11 @@ ApplicationWindow {
         }
     }
 
+    function fetcherRefreshed(count) {
+        if (count > 0)
+            notification.show(qsTr("%n new article(s)", "", count));
+    }
+
     function fetcherNewAuthUrl(url, type) {
         pageStack.push(Qt.resolvedUrl("AuthWebViewPage.qml"),{"url":url,"type":type,"code": 400});
     }
@@ -286,6 +297,10 @@ ApplicationWindow {
     function fetcherError(code) {
         console.log("Fetcher error: code=" + code);
 
+        // Failed background refresh is retried later
+        if (fetcher.busyType === 5 && code >= 500 && code !== 700)
+            return;
+
         if (code < 400)
             return;
         if (code === 700 || (code >= 400 && code < 500)) {
@@ -368,6 +383,10 @@ ApplicationWindow {
             bar.progressText = qsTr("Signing in...");
             bar.progress = 0;
             break;
+        case 5:
+            bar.progressText = qsTr("Refreshing...");
+            bar.progress = 0;
+            break;
         case 11:
             bar.progressText = qsTr("Waiting for network...");
             bar.progress = 0;
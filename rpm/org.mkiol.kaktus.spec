@@ -16,6 +16,7 @@ URL:        https://github.com/mkiol/kaktus
 Source0:    %{name}-%{version}.tar.bz2
 Requires:   sailfishsilica-qt5 >= 0.10.9
 Requires:   mlite-qt5
+Requires:   sqlite >= 3.24.0
 BuildRequires:  pkgconfig(sailfishapp) >= 1.0.2
 BuildRequires:  pkgconfig(Qt5Core)
 BuildRequires:  pkgconfig(Qt5Qml)
@@ -0,0 +1,43 @@
+/* Copyright (C) 2022 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "batchtuner.h"
+
+#include <QDebug>
+
+BatchTuner::BatchTuner(const Limits &limits) : m_limits{limits} {
+    reset(m_limits.minSize);
+}
+
+void BatchTuner::reset(int size, int concurrency) {
+    m_size = qBound(m_limits.minSize, size, m_limits.maxSize);
+    m_concurrency = qBound(1, concurrency, m_limits.maxConcurrency);
+}
+
+void BatchTuner::succeeded(int size, qint64 ms, qint64 bytes) {
+    if (ms > m_limits.slowMs || bytes > m_limits.maxBytes) {
+        m_size = qMax(m_limits.minSize, m_size / 2);
+        qDebug() << "Batch reply slow or large:" << ms << "ms" << bytes
+                 << "bytes, batch size" << m_size;
+        return;
+    }
+
+    // Replies of smaller batches sent before the last growth don't tell
+    // anything about current size
+    if (size < m_size || ms > m_limits.fastMs || bytes > m_limits.maxBytes / 2)
+        return;
+
+    m_size = qMin(m_limits.maxSize, m_size + qMax(1, m_size / 2));
+    m_concurrency = qMin(m_limits.maxConcurrency, m_concurrency + 1);
+}
+
+void BatchTuner::failed() {
+    m_size = qMax(m_limits.minSize, m_size / 2);
+    m_concurrency = qMax(1, m_concurrency / 2);
+    qDebug() << "Batch request failed, batch size" << m_size << "concurrency"
+             << m_concurrency;
+}
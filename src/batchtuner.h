@@ -0,0 +1,47 @@
+/* Copyright (C) 2022 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef BATCHTUNER_H
+#define BATCHTUNER_H
+
+#include <QtGlobal>
+
+// Number of items packed into one request and number of requests in
+// flight, adapted to server replies. Batch grows by half while replies are
+// fast and small, concurrency grows with it. Slow or large reply halves
+// batch, error or timeout halves both.
+class BatchTuner {
+   public:
+    struct Limits {
+        int minSize = 1;
+        int maxSize = 50;
+        int maxConcurrency = 4;
+        // Replies faster than fastMs allow growth, slower than slowMs
+        // shrink batch
+        qint64 fastMs = 2000;
+        qint64 slowMs = 8000;
+        qint64 maxBytes = 2 * 1024 * 1024;
+    };
+
+    explicit BatchTuner(const Limits &limits = {});
+
+    void reset(int size, int concurrency = 1);
+    inline int size() const { return m_size; }
+    inline int concurrency() const { return m_concurrency; }
+    inline const Limits &limits() const { return m_limits; }
+
+    // Size is the number of items in request that has finished
+    void succeeded(int size, qint64 ms, qint64 bytes);
+    void failed();
+
+   private:
+    Limits m_limits;
+    int m_size = 1;
+    int m_concurrency = 1;
+};
+
+#endif  // BATCHTUNER_H
@@ -2,6 +2,8 @@
 #include <QNetworkReply>
 #include <QDebug>
 
+#include "networkmanager.h"
+
 CustomNetworkAccessManager::CustomNetworkAccessManager(const QString &userAgent, QObject *parent) :
     QNetworkAccessManager(parent), userAgent(userAgent)
 {
@@ -14,7 +16,9 @@ QNetworkReply *CustomNetworkAccessManager::createRequest(Operation operation, co
 
     QNetworkRequest newRequest(reqest);
     newRequest.setRawHeader("User-Agent", userAgent.toLatin1());
+    NetworkManager::configure(newRequest);
 
     QNetworkReply *reply = QNetworkAccessManager::createRequest(operation, newRequest, outgoingData);
+    connect(reply, &QNetworkReply::finished, [reply] { NetworkManager::keepSession(reply); });
     return reply;
 }
@@ -5,6 +5,8 @@
 #include <QNetworkRequest>
 #include <QIODevice>
 
+// QML engine creates manager per thread, so main thread NetworkManager can't
+// be shared. HTTP/2 and TLS sessions are still common with it.
 class CustomNetworkAccessManager: public QNetworkAccessManager
 {
 
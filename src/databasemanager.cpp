@@ -5,17 +5,25 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  */
 
+#include <QCryptographicHash>
 #include <QDebug>
 #include <QDateTime>
+#include <QPair>
+#include <QSet>
+#include <QSqlRecord>
+#include <QStringList>
+#include <QTimer>
 
 #include "databasemanager.h"
+#include "hotentries.h"
+#include "querystats.h"
 
 DatabaseManager::DatabaseManager(QObject *parent) : QObject{parent} {}
 
 bool DatabaseManager::isSynced()
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec("SELECT count(*) FROM actions");
 
@@ -95,18 +103,187 @@ bool DatabaseManager::openDB()
     db.setDatabaseName(dbFilePath);
     //db.setConnectOptions("QSQLITE_ENABLE_SHARED_CACHE");
 
-    return db.open();
+    if (!db.open())
+        return false;
+
+    // UPSERT used for entries, streams and modules is supported since SQLite 3.24
+    if (!sqliteVersionAtLeast(3, 24)) {
+        qWarning() << "SQLite 3.24 or newer is required";
+        db.close();
+        return false;
+    }
+
+    if (!attachArchive())
+        qWarning() << "Archive DB can not be attached";
+
+    return true;
 }
 
-bool DatabaseManager::makeBackup()
+bool DatabaseManager::attachArchive()
+{
+    archiveAttached = false;
+
+    if (archiveFilePath.isEmpty()) {
+        archiveFilePath = Settings::instance()->getSettingsDir();
+        archiveFilePath.append(QDir::separator()).append("archive.db");
+        archiveFilePath = QDir::toNativeSeparators(archiveFilePath);
+    }
+
+    TimedQuery query(db, __func__);
+
+    bool ret = query.exec(QString("ATTACH DATABASE '%1' AS archive;").arg(archiveFilePath));
+    if (!ret) {
+       qWarning() << "SQL Error:" << query.lastQuery();
+       checkError(query.lastError());
+       return false;
+    }
+
+    query.exec("PRAGMA archive.auto_vacuum = INCREMENTAL");
+    query.exec("PRAGMA archive.journal_mode = MEMORY");
+    query.exec("PRAGMA archive.synchronous = OFF");
+
+    // Columns must be in the same order as in createEntriesStructure
+    query.exec("CREATE TABLE IF NOT EXISTS archive.entries ("
+                     "id VARCHAR(50) PRIMARY KEY, "
+                     "stream_id VARCHAR(50), "
+                     "title TEXT, "
+                     "author TEXT, "
+                     "content TEXT, "
+                     "link TEXT, "
+                     "image TEXT, "
+                     "annotations TEXT, "
+                     "fresh INTEGER DEFAULT 0, "
+                     "fresh_or INTEGER DEFAULT 0, "
+                     "read INTEGER DEFAULT 0, "
+                     "saved INTEGER DEFAULT 0, "
+                     "liked INTEGER DEFAULT 0, "
+                     "cached INTEGER DEFAULT 0, "
+                     "broadcast INTEGER DEFAULT 0, "
+                     "flag INTEGER DEFAULT 0, "
+                     "created_at TIMESTAMP, "
+                     "published_at TIMESTAMP, "
+                     "cached_at TIMESTAMP, "
+                     "timestamp TIMESTAMP, "
+                     "crawl_time TIMESTAMP,"
+                     "last_update TIMESTAMP "
+                     ");");
+    ret = query.exec("CREATE INDEX IF NOT EXISTS archive.entries_published_at "
+                     "ON entries(published_at DESC);");
+    if (!ret) {
+       qWarning() << "SQL Error:" << query.lastQuery();
+       checkError(query.lastError());
+       return false;
+    }
+
+    archiveAttached = true;
+    return true;
+}
+
+QString DatabaseManager::entriesSource(const QString &filter) const
+{
+    if (!archiveAttached)
+        return "entries";
+
+    // Archived entries are visible only if not present in the hot table,
+    // filter is applied to both sides so the union stays small
+    return "(SELECT * FROM main.entries WHERE " + filter + " "
+           "UNION ALL "
+           "SELECT * FROM archive.entries WHERE " + filter + " "
+           "AND id NOT IN (SELECT id FROM main.entries))";
+}
+
+// Copy is hidden only if its original is still in the hot table
+QString DatabaseManager::duplicatesFilter() const
+{
+    if (!Settings::instance()->getCollapseDuplicates())
+        return "";
+
+    return "AND NOT EXISTS (SELECT 1 FROM duplicates AS d, entries AS o "
+           "WHERE d.entry_id=e.id AND d.original_id!=e.id AND o.id=d.original_id) ";
+}
+
+void DatabaseManager::archiveEntries()
 {
     Settings *s = Settings::instance();
 
+    if (s->getArchiveDays() < 1 || !archiveAttached)
+        return;
+
+    if (db.isOpen()) {
+        TimedQuery query(db, __func__);
+
+        int date = QDateTime::currentDateTimeUtc().addDays(0-s->getArchiveDays()).toTime_t();
+
+        // Only read saved or liked entries past the hot window are archived,
+        // others are removed by retention
+        bool ret = query.exec(QString("SELECT id FROM entries "
+                                      "WHERE (saved=1 OR liked=1) AND read=1 AND fresh=0 AND published_at<%1 "
+                                      "LIMIT %2;")
+                              .arg(date).arg(archiveBatch));
+        if (!ret) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+           return;
+        }
+
+        QStringList ids;
+        while(query.next()) {
+            ids.append(QString("'%1'").arg(query.value(0).toString()));
+        }
+
+        if (ids.isEmpty()) {
+            // Removing entries that are no longer saved or liked
+            ret = query.exec("DELETE FROM archive.entries WHERE saved!=1 AND liked!=1;");
+            if (!ret) {
+               qWarning() << "SQL Error:" << query.lastQuery();
+               checkError(query.lastError());
+            }
+            return;
+        }
+
+        QString idList = ids.join(",");
+
+        db.transaction();
+
+        ret = query.exec(QString("INSERT OR REPLACE INTO archive.entries "
+                                 "SELECT * FROM main.entries WHERE id IN (%1);")
+                         .arg(idList));
+        if (ret)
+            ret = query.exec(QString("DELETE FROM main.entries WHERE id IN (%1);")
+                             .arg(idList));
+
+        if (!ret) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+           db.rollback();
+           return;
+        }
+
+        db.commit();
+        HotEntries::instance()->invalidate();
+
+        qDebug() << "Entries archived:" << ids.size();
+
+        // Next batch is moved after pending events are processed
+        if (ids.size() == archiveBatch)
+            QTimer::singleShot(0, this, &DatabaseManager::archiveEntries);
+    } else {
+        qWarning() << "DB is not open";
+    }
+}
+
+void DatabaseManager::initBackupFilePath()
+{
     if (backupFilePath.isEmpty()) {
-        backupFilePath = s->getSettingsDir();
+        backupFilePath = Settings::instance()->getSettingsDir();
         backupFilePath.append(QDir::separator()).append("settings_backup.db");
         backupFilePath = QDir::toNativeSeparators(backupFilePath);
     }
+}
+
+bool DatabaseManager::makeBackup()
+{
+    initBackupFilePath();
 
     if (QFile::exists(backupFilePath)) {
         //qDebug() << "DB backup file exists and will be overwrite";
@@ -116,14 +293,195 @@ bool DatabaseManager::makeBackup()
     return QFile::copy(dbFilePath, backupFilePath);
 }
 
+bool DatabaseManager::compact()
+{
+    if (!db.isOpen()) {
+        qWarning() << "DB is not open";
+        return false;
+    }
+
+    bool vacuumInto = sqliteVersionAtLeast(3, 27);
+
+    {
+        TimedQuery query(db, __func__);
+
+        // New auto vacuum mode of existing DB takes effect on full vacuum
+        query.exec("PRAGMA main.auto_vacuum = INCREMENTAL");
+
+        if (archiveAttached) {
+            query.exec("PRAGMA archive.auto_vacuum = INCREMENTAL");
+            if (!query.exec("VACUUM archive;")) {
+               qWarning() << "SQL Error:" << query.lastQuery();
+               checkError(query.lastError());
+            }
+        }
+
+        // VACUUM INTO is supported since SQLite 3.27
+        if (!vacuumInto) {
+            bool ret = query.exec("VACUUM main;");
+            if (!ret) {
+               qWarning() << "SQL Error:" << query.lastQuery();
+               checkError(query.lastError());
+            }
+            return ret;
+        }
+
+        initBackupFilePath();
+
+        if (QFile::exists(backupFilePath))
+            QFile::remove(backupFilePath);
+
+        // Compacted copy is written to backup file and then swapped with current DB
+        bool ret = query.exec(QString("VACUUM main INTO '%1';").arg(backupFilePath));
+        if (!ret) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+           return false;
+        }
+    }
+
+    return restoreBackup();
+}
+
+// Must be called only when sync is not running. Returns true when more
+// free pages may be released by next call.
+bool DatabaseManager::incrementalVacuum()
+{
+    if (db.isOpen()) {
+        // Full vacuum of converted DB leaves no free pages
+        if (!checkAutoVacuum())
+            return false;
+
+        TimedQuery query(db, __func__);
+
+        double ratio = freePageRatio();
+        if (ratio <= 0)
+            return false;
+
+        // Each result row is one freed page
+        bool ret = query.exec(QString("PRAGMA main.incremental_vacuum(%1);").arg(vacuumPages));
+        if (!ret) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+           return false;
+        }
+        while(query.next()) {}
+
+        if (archiveAttached) {
+            ret = query.exec(QString("PRAGMA archive.incremental_vacuum(%1);").arg(vacuumPages));
+            if (!ret) {
+               qWarning() << "SQL Error:" << query.lastQuery();
+               checkError(query.lastError());
+            }
+            while(query.next()) {}
+        }
+
+        double newRatio = freePageRatio();
+        qDebug() << "Incremental vacuum, free pages ratio:" << ratio << "->" << newRatio;
+
+        return newRatio > 0 && newRatio < ratio;
+    } else {
+        qWarning() << "DB is not open";
+    }
+
+    return false;
+}
+
+double DatabaseManager::freePageRatio()
+{
+    if (db.isOpen()) {
+        TimedQuery query(db, __func__);
+
+        int pages = 0;
+        int freePages = 0;
+
+        QStringList schemas{"main"};
+        if (archiveAttached)
+            schemas.append("archive");
+
+        for (const auto &schema : schemas) {
+            bool ret = query.exec(QString("PRAGMA %1.page_count;").arg(schema));
+            if (ret && query.next())
+                pages += query.value(0).toInt();
+
+            if (ret)
+                ret = query.exec(QString("PRAGMA %1.freelist_count;").arg(schema));
+            if (ret && query.next())
+                freePages += query.value(0).toInt();
+
+            if (!ret) {
+               qWarning() << "SQL Error:" << query.lastQuery();
+               checkError(query.lastError());
+            }
+        }
+
+        return pages > 0 ? static_cast<double>(freePages) / pages : 0;
+    } else {
+        qWarning() << "DB is not open";
+    }
+
+    return 0;
+}
+
+// Returns true if DB is already in incremental auto vacuum mode, otherwise
+// converts it
+bool DatabaseManager::checkAutoVacuum()
+{
+    TimedQuery query(db, __func__);
+
+    QStringList schemas{"main"};
+    if (archiveAttached)
+        schemas.append("archive");
+
+    bool incremental = true;
+
+    for (const auto &schema : schemas) {
+        bool ret = query.exec(QString("PRAGMA %1.auto_vacuum;").arg(schema));
+        if (ret && query.next() && query.value(0).toInt() == 2)
+            continue;
+
+        // Enabling incremental mode on existing DB requires full vacuum
+        qDebug() << "Converting DB to incremental auto vacuum:" << schema;
+        incremental = false;
+
+        query.exec(QString("PRAGMA %1.auto_vacuum = INCREMENTAL").arg(schema));
+        if (!query.exec(QString("VACUUM %1;").arg(schema))) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+        }
+    }
+
+    return incremental;
+}
+
+bool DatabaseManager::sqliteVersionAtLeast(int major, int minor)
+{
+    TimedQuery query(db, __func__);
+
+    if (!query.exec("SELECT sqlite_version();") || !query.next()) {
+       qWarning() << "SQL Error:" << query.lastQuery();
+       checkError(query.lastError());
+       return false;
+    }
+
+    auto version = query.value(0).toString().split('.');
+    int curMajor = version.value(0).toInt();
+    int curMinor = version.value(1).toInt();
+
+    return curMajor > major || (curMajor == major && curMinor >= minor);
+}
+
 bool DatabaseManager::restoreBackup()
 {
+    HotEntries::instance()->invalidate();
+
     if (!QFile::exists(backupFilePath)) {
         qWarning() << "DB backup file doesn't exist";
         return false;
     }
 
-    if (!deleteDB()) {
+    // Archive is not part of the backup and stays attached to restored DB
+    if (!deleteDB(false)) {
         qWarning() << "Current DB file can not be deleted";
         return false;
     }
@@ -136,9 +494,10 @@ bool DatabaseManager::restoreBackup()
     return openDB();
 }
 
-bool DatabaseManager::deleteDB()
+bool DatabaseManager::deleteDB(bool withArchive)
 {
     db.close();
+    archiveAttached = false;
     QSqlDatabase::removeDatabase("qt_sql_kaktus_connection");
 
     if (dbFilePath=="") {
@@ -148,13 +507,26 @@ bool DatabaseManager::deleteDB()
         dbFilePath = QDir::toNativeSeparators(dbFilePath);
     }
 
+    if (!withArchive)
+        return QFile::remove(dbFilePath);
+
+    // Archive of previous account must not be attached to new DB
+    if (archiveFilePath.isEmpty()) {
+        archiveFilePath = Settings::instance()->getSettingsDir();
+        archiveFilePath.append(QDir::separator()).append("archive.db");
+        archiveFilePath = QDir::toNativeSeparators(archiveFilePath);
+    }
+
+    if (QFile::exists(archiveFilePath) && !QFile::remove(archiveFilePath))
+        qWarning() << "Unable to remove archive DB";
+
     return QFile::remove(dbFilePath);
 }
 
 bool DatabaseManager::isTableExists(const QString &name)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
         if (query.exec(QString("SELECT COUNT(*) FROM sqlite_master "
                                "WHERE type='table' AND name='%1';")
                        .arg(name))) {
@@ -175,7 +547,7 @@ bool DatabaseManager::isTableExists(const QString &name)
 {
     bool ret = true;
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         query.exec("PRAGMA journal_mode = MEMORY");
         query.exec("PRAGMA synchronous = OFF");
@@ -207,7 +579,7 @@ bool DatabaseManager::checkParameters()
     bool createDB = false;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         query.exec("PRAGMA journal_mode = MEMORY");
         query.exec("PRAGMA synchronous = OFF");
@@ -236,6 +608,10 @@ bool DatabaseManager::checkParameters()
                     createDB = true;
 
                 } else {
+                    createDuplicatesStructure();
+                    createScheduleStructure();
+                    createCheckpointsStructure();
+
                     // Check is Dashboard exists
                     if (!isDashboardExists()) {
                         emit empty();
@@ -271,6 +647,8 @@ bool DatabaseManager::checkParameters()
 
 bool DatabaseManager::createDB()
 {
+    HotEntries::instance()->invalidate();
+
     if (!deleteDB()) {
         qWarning() << "DB can not be deleted";
     }
@@ -294,8 +672,10 @@ bool DatabaseManager::createStructure()
 {
     bool ret = true;
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
+        // Must be set before first table is created
+        query.exec("PRAGMA auto_vacuum = INCREMENTAL");
         query.exec("PRAGMA journal_mode = MEMORY");
         query.exec("PRAGMA synchronous = OFF");
 
@@ -330,7 +710,7 @@ bool DatabaseManager::createActionsStructure()
 {
     bool ret = true;
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         query.exec("PRAGMA journal_mode = MEMORY");
         query.exec("PRAGMA synchronous = OFF");
@@ -363,7 +743,7 @@ bool DatabaseManager::createTabsStructure()
 {
     bool ret = true;
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         query.exec("PRAGMA journal_mode = MEMORY");
         query.exec("PRAGMA synchronous = OFF");
@@ -391,7 +771,7 @@ bool DatabaseManager::createCacheStructure()
 {
     bool ret = true;
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         query.exec("PRAGMA journal_mode = MEMORY");
         query.exec("PRAGMA synchronous = OFF");
@@ -429,7 +809,7 @@ bool DatabaseManager::createDashboardsStructure()
 {
     bool ret = true;
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         query.exec("PRAGMA journal_mode = MEMORY");
         query.exec("PRAGMA synchronous = OFF");
@@ -457,7 +837,7 @@ bool DatabaseManager::createStreamsStructure()
 {
     bool ret = true;
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         query.exec("PRAGMA journal_mode = MEMORY");
         query.exec("PRAGMA synchronous = OFF");
@@ -487,6 +867,10 @@ bool DatabaseManager::createStreamsStructure()
            qWarning() << "SQL Error:" << query.lastQuery();
            checkError(query.lastError());
         }
+
+        // Schedule outlives streams rebuilt on every sync, rows of removed
+        // streams are deleted when schedule is written
+        ret = createScheduleStructure() && ret;
     } else {
         qWarning() << "DB is not opened";
         return false;
@@ -500,7 +884,7 @@ bool DatabaseManager::createModulesStructure()
 {
     bool ret = true;
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         query.exec("PRAGMA journal_mode = MEMORY");
         query.exec("PRAGMA synchronous = OFF");
@@ -552,7 +936,7 @@ bool DatabaseManager::createEntriesStructure()
 {
     bool ret = true;
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         query.exec("PRAGMA journal_mode = MEMORY");
         query.exec("PRAGMA synchronous = OFF");
@@ -599,6 +983,72 @@ bool DatabaseManager::createEntriesStructure()
            qWarning() << "SQL Error:" << query.lastQuery();
            checkError(query.lastError());
         }
+
+        query.exec("DROP TABLE IF EXISTS duplicates;");
+        ret = createDuplicatesStructure() && ret;
+
+        // Checkpoints describe stored entries
+        query.exec("DROP TABLE IF EXISTS checkpoints;");
+        ret = createCheckpointsStructure() && ret;
+    } else {
+        qWarning() << "DB is not opened";
+        return false;
+    }
+
+    return ret;
+}
+
+// Fingerprints of entries, original_id is id of the first entry with the
+// same normalized link or title/content hash (equal to entry_id if none)
+bool DatabaseManager::createDuplicatesStructure()
+{
+    bool ret = true;
+    if (db.isOpen()) {
+        TimedQuery query(db, __func__);
+
+        query.exec("CREATE TABLE IF NOT EXISTS duplicates ("
+                         "entry_id VARCHAR(50) PRIMARY KEY, "
+                         "link_hash CHAR(32), "
+                         "content_hash CHAR(32), "
+                         "original_id VARCHAR(50) "
+                         ");");
+        query.exec("CREATE INDEX IF NOT EXISTS duplicates_link_hash "
+                         "ON duplicates(link_hash);");
+        query.exec("CREATE INDEX IF NOT EXISTS duplicates_content_hash "
+                         "ON duplicates(content_hash);");
+        ret = query.exec("CREATE INDEX IF NOT EXISTS duplicates_original_id "
+                         "ON duplicates(original_id);");
+        if (!ret) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+        }
+    } else {
+        qWarning() << "DB is not opened";
+        return false;
+    }
+
+    return ret;
+}
+
+
+// Next poll of streams refreshed in background
+bool DatabaseManager::createScheduleStructure()
+{
+    bool ret = true;
+    if (db.isOpen()) {
+        TimedQuery query(db, __func__);
+
+        ret = query.exec("CREATE TABLE IF NOT EXISTS schedule ("
+                         "stream_id VARCHAR(50) PRIMARY KEY, "
+                         "last_published_at TIMESTAMP DEFAULT 0, "
+                         "next_poll TIMESTAMP DEFAULT 0, "
+                         "idle INTEGER DEFAULT 0, "
+                         "errors INTEGER DEFAULT 0 "
+                         ");");
+        if (!ret) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+        }
     } else {
         qWarning() << "DB is not opened";
         return false;
@@ -607,11 +1057,38 @@ bool DatabaseManager::createEntriesStructure()
     return ret;
 }
 
+// Paging position of interrupted sync, rows are removed when sync ends
+bool DatabaseManager::createCheckpointsStructure()
+{
+    bool ret = true;
+    if (db.isOpen()) {
+        TimedQuery query(db, __func__);
+
+        ret = query.exec("CREATE TABLE IF NOT EXISTS checkpoints ("
+                         "job VARCHAR(50) PRIMARY KEY, "
+                         "continuation TEXT, "
+                         "page_offset INTEGER DEFAULT 0, "
+                         "pages INTEGER DEFAULT 0, "
+                         "last_date INTEGER DEFAULT 0, "
+                         "done INTEGER DEFAULT 0, "
+                         "updated_at TIMESTAMP "
+                         ");");
+        if (!ret) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+        }
+    } else {
+        qWarning() << "DB is not opened";
+        return false;
+    }
+
+    return ret;
+}
 
 void DatabaseManager::writeDashboard(const Dashboard &item)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         query.prepare("INSERT INTO dashboards (id, name, title, description) "
                       "VALUES(?,?,?,?)");
@@ -633,7 +1110,7 @@ void DatabaseManager::writeDashboard(const Dashboard &item)
 void DatabaseManager::writeCache(const CacheItem &item)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         query.prepare("INSERT OR REPLACE INTO cache (id, orig_url, final_url, base_url, type, content_type, "
                       "entry_id, stream_id, flag, date) VALUES(?,?,?,?,?,?,?,?,?,?)");
@@ -661,7 +1138,7 @@ void DatabaseManager::writeCache(const CacheItem &item)
 void DatabaseManager::writeTab(const Tab &item)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         query.prepare("INSERT INTO tabs (id, dashboard_id, title, icon) "
                       "VALUES(?,?,?,?)");
@@ -685,7 +1162,7 @@ void DatabaseManager::writeAction(const Action &item)
     if (db.isOpen()) {
         bool synced = isSynced();
 
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         query.prepare("INSERT INTO actions (type, id1, id2, id3, text, date1, date2, date3) "
                       "VALUES(?,?,?,?,?,?,?,?)");
@@ -716,7 +1193,7 @@ void DatabaseManager::updateActionByIdAndType(const QString &oldId1, ActionsType
                                               const QString &newId2, const QString &newId3, ActionsTypes newType)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         query.prepare("UPDATE actions SET type = ?, id1 = ?, id2 = ?, id3 = ? WHERE type = ? AND id1 = ?");
 
@@ -739,11 +1216,19 @@ void DatabaseManager::updateActionByIdAndType(const QString &oldId1, ActionsType
 void DatabaseManager::writeStream(const Stream &item)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         query.prepare("INSERT INTO streams (id, title, content, link, query, icon, "
                       "type, unread, read, saved, slow, newest_item_added_at, update_at, last_update) "
-                      "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+                      "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?) "
+                      "ON CONFLICT(id) DO UPDATE SET "
+                      "title = excluded.title, newest_item_added_at = excluded.newest_item_added_at, "
+                      "update_at = excluded.update_at, last_update = excluded.last_update, "
+                      "unread = excluded.unread, read = excluded.read, saved = excluded.saved, slow = excluded.slow "
+                      "WHERE title IS NOT excluded.title OR newest_item_added_at IS NOT excluded.newest_item_added_at OR "
+                      "update_at IS NOT excluded.update_at OR "
+                      "unread IS NOT excluded.unread OR read IS NOT excluded.read OR "
+                      "saved IS NOT excluded.saved OR slow IS NOT excluded.slow");
 
         query.addBindValue(item.id);
         query.addBindValue(item.title);
@@ -760,25 +1245,11 @@ void DatabaseManager::writeStream(const Stream &item)
         query.addBindValue(item.updateAt);
         query.addBindValue(item.lastUpdate);
 
-        if(!query.exec()) {
-            QSqlQuery query(db);
-            query.prepare("UPDATE streams SET title = ?, newest_item_added_at = ?, update_at = ?, last_update = ?, "
-                          "unread = ?, read = ?, saved = ?, slow = ? WHERE id = ?");
-
-            query.addBindValue(item.title);
-            query.addBindValue(item.newestItemAddedAt);
-            query.addBindValue(item.updateAt);
-            query.addBindValue(item.lastUpdate);
-            query.addBindValue(item.unread);
-            query.addBindValue(item.read);
-            query.addBindValue(item.saved);
-            query.addBindValue(item.slow);
-            query.addBindValue(item.id);
-
-            if (!query.exec()) {
-               qWarning() << "SQL Error:" << query.lastQuery();
-               checkError(query.lastError());
-            }
+        if (!query.exec()) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+        } else if (query.numRowsAffected() > 0) {
+            HotEntries::instance()->updateStream(item.id, item.title, item.icon);
         }
     } else {
         qWarning() << "DB is not opened";
@@ -788,9 +1259,17 @@ void DatabaseManager::writeStream(const Stream &item)
 void DatabaseManager::writeModule(const Module &item)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        // Hot set is rebuilt only when tab or streams of module have changed
+        bool changed = false;
+
+        TimedQuery query(db, __func__);
         query.prepare("INSERT INTO modules (id, tab_id, widget_id, page_id, name, title, status, icon) "
-                      "VALUES (:id, :tab_id, :widget_id, :page_id, :name, :title, :status, :icon)");
+                      "VALUES (:id, :tab_id, :widget_id, :page_id, :name, :title, :status, :icon) "
+                      "ON CONFLICT(id) DO UPDATE SET "
+                      "status = excluded.status, title = excluded.title, tab_id = excluded.tab_id, "
+                      "icon = excluded.icon, name = excluded.name "
+                      "WHERE status IS NOT excluded.status OR title IS NOT excluded.title OR "
+                      "tab_id IS NOT excluded.tab_id OR icon IS NOT excluded.icon OR name IS NOT excluded.name");
         query.bindValue(":id", item.id);
 
         query.bindValue(":tab_id", item.tabId);
@@ -801,20 +1280,11 @@ void DatabaseManager::writeModule(const Module &item)
         query.bindValue(":status", item.status);
         query.bindValue(":icon", item.icon);
 
-        if(!query.exec()) {
-            query.prepare("UPDATE modules SET status = :status, title = :title, tab_id = :tab_id, icon = :icon, name = :name "
-                          "WHERE id = :id");
-
-            query.bindValue(":status", item.status);
-            query.bindValue(":title", item.title);
-            query.bindValue(":tab_id", item.tabId);
-            query.bindValue(":icon", item.icon);
-            query.bindValue(":name", item.name);
-            query.bindValue(":id", item.id);
-
-            if (!query.exec()) {
-               qWarning() << "SQL Error! " << query.executedQuery(); checkError(query.lastError());
-            }
+        if (!query.exec()) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+        } else if (query.numRowsAffected() > 0) {
+            changed = true;
         }
 
         QList<QString>::const_iterator i = item.streamList.begin();
@@ -825,10 +1295,15 @@ void DatabaseManager::writeModule(const Module &item)
             if (!ret) {
                qWarning() << "SQL Error:" << query.lastQuery();
                checkError(query.lastError());
+            } else if (query.numRowsAffected() > 0) {
+                changed = true;
             }
 
             ++i;
         }
+
+        if (changed)
+            HotEntries::instance()->invalidate();
     } else {
         qWarning() << "DB is not opened";
     }
@@ -837,7 +1312,7 @@ void DatabaseManager::writeModule(const Module &item)
 void DatabaseManager::writeStreamModuleTab(const StreamModuleTab &item)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("INSERT OR IGNORE INTO module_stream (module_id, stream_id) VALUES('%1','%2');")
                          .arg(item.moduleId, item.streamId));
@@ -845,49 +1320,435 @@ void DatabaseManager::writeStreamModuleTab(const StreamModuleTab &item)
         if (!ret) {
            qWarning() << "SQL Error:" << query.lastQuery();
            checkError(query.lastError());
+        } else if (query.numRowsAffected() > 0) {
+            HotEntries::instance()->invalidate();
         }
     } else {
         qWarning() << "DB is not opened";
     }
 }
 
-void DatabaseManager::writeEntry(const Entry &item)
+// Hash of structural columns, stored row and fetched item are compared by it
+static QByteArray rowHash(const QStringList &columns)
 {
-    if (db.isOpen()) {
-        QSqlQuery query(db);
+    return QCryptographicHash::hash(columns.join(QChar(0x1f)).toUtf8(), QCryptographicHash::Md5);
+}
 
-        query.prepare("INSERT OR REPLACE INTO entries (id, stream_id, title, author, content, link, image, annotations, "
-                      "fresh_or, read, saved, liked, broadcast, created_at, published_at, crawl_time, timestamp, "
-                      "last_update, fresh, cached) "
-                      "VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?, "
-                      "coalesce((SELECT fresh FROM entries WHERE id = ?),1), "
-                      "coalesce((SELECT cached FROM entries WHERE id = ?),0))");
+// First column of sql result is row key, remaining columns are hashed
+QHash<QString, QByteArray> DatabaseManager::readRowHashes(const QString &sql)
+{
+    QHash<QString, QByteArray> hashes;
 
+    TimedQuery query(db, __func__);
+
+    if (!query.exec(sql)) {
+        qWarning() << "SQL Error:" << query.lastQuery();
+        checkError(query.lastError());
+        return hashes;
+    }
+
+    int count = query.record().count();
+    while (query.next()) {
+        QStringList columns;
+        for (int i = 1; i < count; ++i)
+            columns.append(query.value(i).toString());
+        hashes.insert(query.value(0).toString(), rowHash(columns));
+    }
+
+    return hashes;
+}
+
+DatabaseManager::StructureDiff DatabaseManager::writeStructure(const Structure &structure)
+{
+    StructureDiff diff;
+
+    if (!db.isOpen()) {
+        qWarning() << "DB is not opened";
+        return diff;
+    }
+
+    auto storedDashboards = readRowHashes("SELECT id, name, title, description FROM dashboards;");
+    auto storedTabs = readRowHashes("SELECT id, dashboard_id, title, icon FROM tabs;");
+    auto storedModules = readRowHashes("SELECT id, tab_id, widget_id, page_id, name, title, status, icon "
+                                       "FROM modules;");
+    auto storedPairs = readRowHashes("SELECT module_id || '/' || stream_id, module_id, stream_id "
+                                     "FROM module_stream;");
+    auto storedStreams = readRowHashes("SELECT id, title, content, link, query, icon, type FROM streams;");
+
+    // Streams referenced by stored pairs, so unreferenced ones can be removed
+    QSet<QString> storedStreamIds;
+    {
+        TimedQuery query(db, __func__);
+        if (query.exec("SELECT DISTINCT stream_id FROM module_stream;")) {
+            while (query.next())
+                storedStreamIds.insert(query.value(0).toString());
+        } else {
+            qWarning() << "SQL Error:" << query.lastQuery();
+            checkError(query.lastError());
+        }
+    }
+
+    TimedQuery query(db, __func__);
+
+    auto exec = [this, &query] {
+        if (!query.exec()) {
+            qWarning() << "SQL Error:" << query.lastQuery();
+            checkError(query.lastError());
+        }
+    };
+
+    // Stored row which hash differs is replaced, equal one is left intact
+    auto changed = [&diff](QHash<QString, QByteArray> &stored, const QString &id, const QByteArray &hash) {
+        auto it = stored.find(id);
+        if (it == stored.end()) {
+            ++diff.inserted;
+            return true;
+        }
+        bool ret = it.value() != hash;
+        if (ret)
+            ++diff.updated;
+        else
+            ++diff.unchanged;
+        stored.erase(it);
+        return ret;
+    };
+
+    // Rows left in stored hashes were not fetched
+    auto remove = [&diff, &query, &exec](const QHash<QString, QByteArray> &stored, const QString &sql) {
+        query.prepare(sql);
+        for (auto it = stored.constBegin(); it != stored.constEnd(); ++it) {
+            query.addBindValue(it.key());
+            exec();
+            ++diff.removed;
+        }
+    };
+
+    db.transaction();
+
+    query.prepare("INSERT OR REPLACE INTO dashboards (id, name, title, description) VALUES(?,?,?,?)");
+    for (const auto &item : structure.dashboards) {
+        if (!changed(storedDashboards, item.id,
+                     rowHash({item.name, item.title, item.description})))
+            continue;
+        query.addBindValue(item.id);
+        query.addBindValue(item.name);
+        query.addBindValue(item.title);
+        query.addBindValue(item.description);
+        exec();
+    }
+
+    query.prepare("INSERT OR REPLACE INTO tabs (id, dashboard_id, title, icon) VALUES(?,?,?,?)");
+    for (const auto &item : structure.tabs) {
+        if (!changed(storedTabs, item.id,
+                     rowHash({item.dashboardId, item.title, item.icon})))
+            continue;
         query.addBindValue(item.id);
-        query.addBindValue(item.streamId);
-        query.addBindValue(item.title);
-        query.addBindValue(item.author);
-        query.addBindValue(item.content);
-        query.addBindValue(item.link);
-        query.addBindValue(item.image);
-        query.addBindValue(item.annotations);
-        query.addBindValue(item.freshOR);
-        query.addBindValue(item.read);
-        query.addBindValue(item.saved);
-        query.addBindValue(item.liked);
-        query.addBindValue(item.broadcast);
-        query.addBindValue(item.createdAt);
-        query.addBindValue(item.publishedAt);
-        query.addBindValue(item.crawlTime);
-        query.addBindValue(item.timestamp);
-        query.addBindValue(QDateTime::currentDateTimeUtc().toTime_t());
-        query.addBindValue(item.id);
+        query.addBindValue(item.dashboardId);
+        query.addBindValue(item.title);
+        query.addBindValue(item.icon);
+        exec();
+    }
+
+    QSet<QString> streamIds;
+    QList<QPair<QString, QString>> newPairs;
+
+    query.prepare("INSERT OR REPLACE INTO modules (id, tab_id, widget_id, page_id, name, title, status, icon) "
+                  "VALUES(?,?,?,?,?,?,?,?)");
+    for (const auto &item : structure.modules) {
+        for (const auto &streamId : item.streamList) {
+            streamIds.insert(streamId);
+            QString key = item.id + '/' + streamId;
+            // Pairs are keyed by both ids, so equal key means equal pair
+            if (storedPairs.remove(key) == 0)
+                newPairs.append(qMakePair(item.id, streamId));
+        }
+
+        if (!changed(storedModules, item.id,
+                     rowHash({item.tabId, item.widgetId, item.pageId, item.name,
+                              item.title, item.status, item.icon})))
+            continue;
         query.addBindValue(item.id);
+        query.addBindValue(item.tabId);
+        query.addBindValue(item.widgetId);
+        query.addBindValue(item.pageId);
+        query.addBindValue(item.name);
+        query.addBindValue(item.title);
+        query.addBindValue(item.status);
+        query.addBindValue(item.icon);
+        exec();
+    }
 
-        if (!query.exec()) {
-           qWarning() << "SQL Error:" << query.lastQuery();
-           checkError(query.lastError());
+    query.prepare("INSERT OR IGNORE INTO module_stream (module_id, stream_id) VALUES(?,?)");
+    for (const auto &pair : newPairs) {
+        query.addBindValue(pair.first);
+        query.addBindValue(pair.second);
+        exec();
+        ++diff.inserted;
+    }
+
+    if (!structure.streams.isEmpty()) {
+        // Counters are written only when they differ, but only change of
+        // structural columns is counted
+        query.prepare("INSERT INTO streams (id, title, content, link, query, icon, "
+                      "type, unread, read, saved, slow, newest_item_added_at, update_at, last_update) "
+                      "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?) "
+                      "ON CONFLICT(id) DO UPDATE SET "
+                      "title = excluded.title, content = excluded.content, link = excluded.link, "
+                      "query = excluded.query, icon = excluded.icon, type = excluded.type, "
+                      "unread = excluded.unread, read = excluded.read, saved = excluded.saved, slow = excluded.slow, "
+                      "newest_item_added_at = excluded.newest_item_added_at, "
+                      "update_at = excluded.update_at, last_update = excluded.last_update "
+                      "WHERE title IS NOT excluded.title OR content IS NOT excluded.content OR "
+                      "link IS NOT excluded.link OR query IS NOT excluded.query OR "
+                      "icon IS NOT excluded.icon OR type IS NOT excluded.type OR "
+                      "unread IS NOT excluded.unread OR read IS NOT excluded.read OR "
+                      "saved IS NOT excluded.saved OR slow IS NOT excluded.slow OR "
+                      "newest_item_added_at IS NOT excluded.newest_item_added_at OR "
+                      "update_at IS NOT excluded.update_at");
+        for (const auto &item : structure.streams) {
+            streamIds.insert(item.id);
+            changed(storedStreams, item.id,
+                    rowHash({item.title, item.content, item.link, item.query, item.icon, item.type}));
+            query.addBindValue(item.id);
+            query.addBindValue(item.title);
+            query.addBindValue(item.content);
+            query.addBindValue(item.link);
+            query.addBindValue(item.query);
+            query.addBindValue(item.icon);
+            query.addBindValue(item.type);
+            query.addBindValue(item.unread);
+            query.addBindValue(item.read);
+            query.addBindValue(item.saved);
+            query.addBindValue(item.slow);
+            query.addBindValue(item.newestItemAddedAt);
+            query.addBindValue(item.updateAt);
+            query.addBindValue(item.lastUpdate);
+            exec();
+        }
+    }
+
+    remove(storedDashboards, "DELETE FROM dashboards WHERE id = ?");
+    remove(storedTabs, "DELETE FROM tabs WHERE id = ?");
+    remove(storedModules, "DELETE FROM modules WHERE id = ?");
+    remove(storedPairs, "DELETE FROM module_stream WHERE module_id || '/' || stream_id = ?");
+
+    for (const auto &id : storedStreamIds) {
+        if (!streamIds.contains(id))
+            diff.removedStreams.append(id);
+    }
+
+    query.prepare("DELETE FROM entries WHERE stream_id = ?");
+    for (const auto &id : diff.removedStreams) {
+        query.addBindValue(id);
+        exec();
+    }
+
+    query.prepare("DELETE FROM streams WHERE id = ?");
+    for (const auto &id : diff.removedStreams) {
+        query.addBindValue(id);
+        exec();
+    }
+
+    db.commit();
+
+    diff.removed += diff.removedStreams.size();
+
+    if (!diff.isEmpty())
+        HotEntries::instance()->invalidate();
+
+    qDebug() << "Structure diff: inserted" << diff.inserted << "updated" << diff.updated
+             << "removed" << diff.removed << "unchanged" << diff.unchanged;
+
+    return diff;
+}
+
+void DatabaseManager::writeEntry(const Entry &item)
+{
+    writeEntries(QList<Entry>() << item);
+}
+
+// All entries are written in one transaction with statements prepared once,
+// checkpoint (if any) is written in the same transaction
+void DatabaseManager::writeEntries(const QList<Entry> &items, const Checkpoint &checkpoint)
+{
+    if (items.isEmpty() && checkpoint.job.isEmpty())
+        return;
+
+    // Only inserted or changed rows are merged into hot set
+    QList<Entry> changed;
+
+    if (db.isOpen()) {
+        TimedQuery archiveQuery(db, __func__);
+        TimedQuery query(db, __func__);
+
+        // Archived entry is not moved back to hot table, only state is
+        // updated. Archive is looked up once per chunk of ids, so entries
+        // that are not archived are written once.
+        QSet<QString> archived;
+        if (archiveAttached) {
+            for (int i = 0; i < items.size(); i += archiveBatch) {
+                int count = items.size() - i;
+                if (count > archiveBatch)
+                    count = archiveBatch;
+                QStringList marks;
+                for (int j = 0; j < count; ++j)
+                    marks.append("?");
+
+                archiveQuery.prepare(QString("SELECT id FROM archive.entries WHERE id IN (%1)")
+                                     .arg(marks.join(",")));
+                for (int j = 0; j < count; ++j)
+                    archiveQuery.addBindValue(items.at(i + j).id);
+
+                if (!archiveQuery.exec()) {
+                   qWarning() << "SQL Error:" << archiveQuery.lastQuery();
+                   checkError(archiveQuery.lastError());
+                }
+
+                while (archiveQuery.next())
+                    archived.insert(archiveQuery.value(0).toString());
+            }
+        }
+
+        if (!archived.isEmpty())
+            archiveQuery.prepare("UPDATE archive.entries SET annotations = ?, fresh_or = ?, "
+                                 "read = ?, saved = ?, liked = ?, broadcast = ? WHERE id = ?");
+
+        // Existing rows are updated in place only when synced columns have
+        // changed, so local state (fresh, cached, cached_at) is kept and
+        // unchanged entries are not rewritten. Flag is always cleared to
+        // mark the entry as refreshed (see removeEntriesByFlag).
+        query.prepare("INSERT INTO entries (id, stream_id, title, author, content, link, image, annotations, "
+                      "fresh_or, read, saved, liked, broadcast, created_at, published_at, crawl_time, timestamp, "
+                      "last_update, fresh, cached) "
+                      "VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,1,0) "
+                      "ON CONFLICT(id) DO UPDATE SET "
+                      "stream_id=excluded.stream_id, title=excluded.title, author=excluded.author, "
+                      "content=excluded.content, link=excluded.link, image=excluded.image, "
+                      "annotations=excluded.annotations, fresh_or=excluded.fresh_or, read=excluded.read, "
+                      "saved=excluded.saved, liked=excluded.liked, broadcast=excluded.broadcast, "
+                      "created_at=excluded.created_at, published_at=excluded.published_at, "
+                      "crawl_time=excluded.crawl_time, timestamp=excluded.timestamp, "
+                      "last_update=excluded.last_update, flag=0 "
+                      "WHERE flag!=0 OR stream_id IS NOT excluded.stream_id OR title IS NOT excluded.title OR "
+                      "author IS NOT excluded.author OR content IS NOT excluded.content OR "
+                      "link IS NOT excluded.link OR image IS NOT excluded.image OR "
+                      "annotations IS NOT excluded.annotations OR fresh_or IS NOT excluded.fresh_or OR "
+                      "read IS NOT excluded.read OR saved IS NOT excluded.saved OR "
+                      "liked IS NOT excluded.liked OR broadcast IS NOT excluded.broadcast OR "
+                      "created_at IS NOT excluded.created_at OR published_at IS NOT excluded.published_at OR "
+                      "crawl_time IS NOT excluded.crawl_time OR timestamp IS NOT excluded.timestamp");
+
+        int lastUpdate = QDateTime::currentDateTimeUtc().toTime_t();
+
+        db.transaction();
+
+        for (const auto &item : items) {
+            if (archived.contains(item.id)) {
+                archiveQuery.addBindValue(item.annotations);
+                archiveQuery.addBindValue(item.freshOR);
+                archiveQuery.addBindValue(item.read);
+                archiveQuery.addBindValue(item.saved);
+                archiveQuery.addBindValue(item.liked);
+                archiveQuery.addBindValue(item.broadcast);
+                archiveQuery.addBindValue(item.id);
+
+                if (!archiveQuery.exec()) {
+                   qWarning() << "SQL Error:" << archiveQuery.lastQuery();
+                   checkError(archiveQuery.lastError());
+                }
+                continue;
+            }
+
+            query.addBindValue(item.id);
+            query.addBindValue(item.streamId);
+            query.addBindValue(item.title);
+            query.addBindValue(item.author);
+            query.addBindValue(item.content);
+            query.addBindValue(item.link);
+            query.addBindValue(item.image);
+            query.addBindValue(item.annotations);
+            query.addBindValue(item.freshOR);
+            query.addBindValue(item.read);
+            query.addBindValue(item.saved);
+            query.addBindValue(item.liked);
+            query.addBindValue(item.broadcast);
+            query.addBindValue(item.createdAt);
+            query.addBindValue(item.publishedAt);
+            query.addBindValue(item.crawlTime);
+            query.addBindValue(item.timestamp);
+            query.addBindValue(lastUpdate);
+
+            if (!query.exec()) {
+               qWarning() << "SQL Error:" << query.lastQuery();
+               checkError(query.lastError());
+            } else if (query.numRowsAffected() > 0) {
+                changed.append(item);
+            }
         }
+
+        if (!checkpoint.job.isEmpty()) {
+            TimedQuery checkpointQuery(db, __func__);
+            checkpointQuery.prepare("INSERT OR REPLACE INTO checkpoints "
+                                    "(job, continuation, page_offset, pages, last_date, done, updated_at) "
+                                    "VALUES(?,?,?,?,?,?,?)");
+            checkpointQuery.addBindValue(checkpoint.job);
+            checkpointQuery.addBindValue(checkpoint.continuation);
+            checkpointQuery.addBindValue(checkpoint.offset);
+            checkpointQuery.addBindValue(checkpoint.pages);
+            checkpointQuery.addBindValue(checkpoint.lastDate);
+            checkpointQuery.addBindValue(checkpoint.done ? 1 : 0);
+            checkpointQuery.addBindValue(lastUpdate);
+
+            if (!checkpointQuery.exec()) {
+               qWarning() << "SQL Error:" << checkpointQuery.lastQuery();
+               checkError(checkpointQuery.lastError());
+            }
+        }
+
+        db.commit();
+    } else {
+        qWarning() << "DB is not opened";
+    }
+
+    HotEntries::instance()->merge(changed);
+}
+
+void DatabaseManager::writeFingerprints(const QList<Fingerprint> &items)
+{
+    if (items.isEmpty())
+        return;
+
+    if (db.isOpen()) {
+        TimedQuery query(db, __func__);
+
+        // Original of matching entry is taken, so all copies point to the same
+        // one. Original that is no longer stored is not taken.
+        query.prepare("INSERT OR REPLACE INTO duplicates (entry_id, link_hash, content_hash, original_id) "
+                      "VALUES (?,?,?,COALESCE((SELECT original_id FROM duplicates "
+                      "WHERE entry_id!=? AND (link_hash=? OR content_hash=?) "
+                      "AND original_id IN (SELECT id FROM main.entries) LIMIT 1),?))");
+
+        db.transaction();
+
+        for (const auto &item : items) {
+            // Missing hash is stored as NULL, so it matches nothing
+            QVariant linkHash = item.linkHash.isEmpty() ? QVariant(QVariant::String) : QVariant(item.linkHash);
+            QVariant contentHash = item.contentHash.isEmpty() ? QVariant(QVariant::String) : QVariant(item.contentHash);
+            query.addBindValue(item.entryId);
+            query.addBindValue(linkHash);
+            query.addBindValue(contentHash);
+            query.addBindValue(item.entryId);
+            query.addBindValue(linkHash);
+            query.addBindValue(contentHash);
+            query.addBindValue(item.entryId);
+
+            if (!query.exec()) {
+               qWarning() << "SQL Error:" << query.lastQuery();
+               checkError(query.lastError());
+            }
+        }
+
+        db.commit();
     } else {
         qWarning() << "DB is not opened";
     }
@@ -895,8 +1756,10 @@ void DatabaseManager::writeEntry(const Entry &item)
 
 void DatabaseManager::updateEntriesFreshFlag(int flag)
 {
+    HotEntries::instance()->updateFreshAll(flag);
+
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("UPDATE entries SET fresh=%1;").arg(flag));
 
@@ -912,7 +1775,7 @@ void DatabaseManager::updateEntriesFreshFlag(int flag)
 void DatabaseManager::updateEntriesFlag(int flag)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("UPDATE entries SET flag=%1;").arg(flag));
 
@@ -927,8 +1790,10 @@ void DatabaseManager::updateEntriesFlag(int flag)
 
 void DatabaseManager::updateEntriesCachedFlagByEntry(const QString &id, int cacheDate, int flag)
 {
+    HotEntries::instance()->updateCached(id, flag == 1);
+
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
         bool ret = query.exec(QString("UPDATE entries SET cached=%1, cached_at=%2 WHERE id='%3';")
                          .arg(flag)
                          .arg(cacheDate)
@@ -944,8 +1809,10 @@ void DatabaseManager::updateEntriesCachedFlagByEntry(const QString &id, int cach
 
 void DatabaseManager::updateEntriesBroadcastFlagByEntry(const QString &id, int flag, const QString &annotations)
 {
+    HotEntries::instance()->updateBroadcast(id, flag, QString(annotations.toUtf8().toBase64()));
+
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
         bool ret = query.exec(QString("UPDATE entries SET broadcast=%1, annotations='%2' WHERE id='%3';")
                          .arg(flag)
                          .arg(QString(annotations.toUtf8().toBase64()), id));
@@ -960,14 +1827,25 @@ void DatabaseManager::updateEntriesBroadcastFlagByEntry(const QString &id, int f
 
 void DatabaseManager::updateEntriesLikedFlagByEntry(const QString &id, int flag)
 {
+    HotEntries::instance()->updateLiked(id, flag);
+
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
         bool ret = query.exec(QString("UPDATE entries SET liked=%1 WHERE id='%2';")
                          .arg(flag).arg(id));
         if (!ret) {
            qWarning() << "SQL Error:" << query.lastQuery();
            checkError(query.lastError());
         }
+
+        if (archiveAttached) {
+            ret = query.exec(QString("UPDATE archive.entries SET liked=%1 WHERE id='%2';")
+                             .arg(flag).arg(id));
+            if (!ret) {
+               qWarning() << "SQL Error:" << query.lastQuery();
+               checkError(query.lastError());
+            }
+        }
     } else {
         qWarning() << "DB is not opened";
     }
@@ -975,8 +1853,10 @@ void DatabaseManager::updateEntriesLikedFlagByEntry(const QString &id, int flag)
 
 void DatabaseManager::updateEntriesReadFlagByEntry(const QString &id, int flag)
 {
+    HotEntries::instance()->updateRead(id, flag);
+
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
         bool ret = query.exec(QString("UPDATE entries SET read=%1 WHERE id='%2';")
                          .arg(flag)
                          .arg(id));
@@ -984,6 +1864,15 @@ void DatabaseManager::updateEntriesReadFlagByEntry(const QString &id, int flag)
            qWarning() << "SQL Error:" << query.lastQuery();
            checkError(query.lastError());
         }
+
+        if (archiveAttached) {
+            ret = query.exec(QString("UPDATE archive.entries SET read=%1 WHERE id='%2';")
+                             .arg(flag).arg(id));
+            if (!ret) {
+               qWarning() << "SQL Error:" << query.lastQuery();
+               checkError(query.lastError());
+            }
+        }
     } else {
         qWarning() << "DB is not opened";
     }
@@ -991,8 +1880,10 @@ void DatabaseManager::updateEntriesReadFlagByEntry(const QString &id, int flag)
 
 void DatabaseManager::updateEntriesReadFlagByTab(const QString &id, int flag)
 {
+    HotEntries::instance()->updateReadByTab(id, flag);
+
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
         bool ret = query.exec(QString("UPDATE entries SET read=%1 "
                                       "WHERE stream_id IN "
                                       "(SELECT ms.stream_id FROM module_stream as ms, modules as m "
@@ -1011,8 +1902,10 @@ void DatabaseManager::updateEntriesReadFlagByTab(const QString &id, int flag)
 
 void DatabaseManager::updateEntriesSavedFlagByEntry(const QString &id, int flag)
 {
+    HotEntries::instance()->updateSaved(id, flag);
+
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
         bool ret = query.exec(QString("UPDATE entries SET saved=%1 WHERE id='%2';")
                          .arg(flag)
                          .arg(id));
@@ -1020,6 +1913,15 @@ void DatabaseManager::updateEntriesSavedFlagByEntry(const QString &id, int flag)
            qWarning() << "SQL Error:" << query.lastQuery();
            checkError(query.lastError());
         }
+
+        if (archiveAttached) {
+            ret = query.exec(QString("UPDATE archive.entries SET saved=%1 WHERE id='%2';")
+                             .arg(flag).arg(id));
+            if (!ret) {
+               qWarning() << "SQL Error:" << query.lastQuery();
+               checkError(query.lastError());
+            }
+        }
     } else {
         qWarning() << "DB is not opened";
     }
@@ -1027,8 +1929,10 @@ void DatabaseManager::updateEntriesSavedFlagByEntry(const QString &id, int flag)
 
 void DatabaseManager::updateEntriesReadFlagByStream(const QString &id, int flag)
 {
+    HotEntries::instance()->updateReadByStream(id, flag);
+
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
         bool ret = query.exec(QString("UPDATE entries SET read=%1 WHERE stream_id='%2';")
                          .arg(flag)
                          .arg(id));
@@ -1044,8 +1948,10 @@ void DatabaseManager::updateEntriesReadFlagByStream(const QString &id, int flag)
 
 void DatabaseManager::updateEntriesReadFlagByDashboard(const QString &id, int flag)
 {
+    HotEntries::instance()->updateReadByDashboard(id, flag);
+
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
         bool ret = query.exec(QString("UPDATE entries SET read=%1 "
                                       "WHERE stream_id IN "
                                       "(SELECT s.id FROM streams as s, module_stream as ms, modules as m, tabs as t "
@@ -1065,8 +1971,10 @@ void DatabaseManager::updateEntriesReadFlagByDashboard(const QString &id, int fl
 
 void DatabaseManager::updateEntriesSavedFlagByFlagAndDashboard(const QString &id, int flagOld, int flagNew)
 {
+    HotEntries::instance()->invalidate();
+
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
         bool ret = query.exec(QString("UPDATE entries SET saved=%1 "
                                       "WHERE saved=%2 AND stream_id IN "
                                       "(SELECT s.id FROM streams as s, module_stream as ms, modules as m, tabs as t "
@@ -1085,10 +1993,201 @@ void DatabaseManager::updateEntriesSavedFlagByFlagAndDashboard(const QString &id
     }
 }
 
+// Long id lists are not pasted into statement, they are inserted into temp
+// table with bound values and joined
+bool DatabaseManager::writeTempIds(const QList<QString> &ids)
+{
+    TimedQuery query(db, __func__);
+
+    if (!query.exec("CREATE TEMP TABLE IF NOT EXISTS temp_ids (id TEXT PRIMARY KEY);") ||
+        !query.exec("DELETE FROM temp.temp_ids;")) {
+        qWarning() << "SQL Error:" << query.lastQuery();
+        checkError(query.lastError());
+        return false;
+    }
+
+    query.prepare("INSERT OR IGNORE INTO temp.temp_ids (id) VALUES (?)");
+
+    db.transaction();
+
+    bool ret = true;
+    for (const auto &id : ids) {
+        query.addBindValue(id);
+        if (!query.exec()) {
+            qWarning() << "SQL Error:" << query.lastQuery();
+            checkError(query.lastError());
+            ret = false;
+            break;
+        }
+    }
+
+    db.commit();
+
+    return ret;
+}
+
+// Entries of stream are marked as read unless listed in unreadIds
+void DatabaseManager::updateEntriesReadFlagByStreamAndIds(const QString &id, const QList<QString> &unreadIds)
+{
+    HotEntries::instance()->invalidate();
+
+    if (db.isOpen()) {
+        if (!writeTempIds(unreadIds))
+            return;
+
+        TimedQuery query(db, __func__);
+
+        bool ret = query.exec(QString("UPDATE entries SET read=0 "
+                                      "WHERE stream_id='%1' AND read!=0 AND id IN (SELECT id FROM temp.temp_ids);")
+                              .arg(id));
+        if (ret)
+            ret = query.exec(QString("UPDATE entries SET read=1 "
+                                     "WHERE stream_id='%1' AND read=0 AND id NOT IN (SELECT id FROM temp.temp_ids);")
+                             .arg(id));
+
+        if (!ret) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+        }
+    } else {
+        qWarning() << "DB is not opened";
+    }
+}
+
+// All entries are marked as read unless listed in unreadIds
+void DatabaseManager::updateEntriesReadFlagByIds(const QList<QString> &unreadIds)
+{
+    HotEntries::instance()->invalidate();
+
+    if (db.isOpen()) {
+        if (!writeTempIds(unreadIds))
+            return;
+
+        TimedQuery query(db, __func__);
+
+        bool ret = query.exec("UPDATE entries SET read=0 WHERE read!=0 AND "
+                              "id IN (SELECT id FROM temp.temp_ids);");
+        if (ret)
+            ret = query.exec("UPDATE entries SET read=1 WHERE read=0 AND "
+                             "id NOT IN (SELECT id FROM temp.temp_ids);");
+
+        if (!ret) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+        }
+    } else {
+        qWarning() << "DB is not opened";
+    }
+}
+
+// Only listed entries are marked as read, others are not touched
+void DatabaseManager::markEntriesReadByIds(const QList<QString> &readIds)
+{
+    HotEntries::instance()->invalidate();
+
+    if (db.isOpen()) {
+        if (!writeTempIds(readIds))
+            return;
+
+        TimedQuery query(db, __func__);
+
+        if (!query.exec("UPDATE entries SET read=1 WHERE read=0 AND "
+                        "id IN (SELECT id FROM temp.temp_ids);")) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+        }
+    } else {
+        qWarning() << "DB is not opened";
+    }
+}
+
+// Flag is set for entries listed in ids and cleared for all others
+void DatabaseManager::updateEntriesSavedFlagByIds(const QList<QString> &ids)
+{
+    updateEntriesFlagByIds("saved", ids);
+}
+
+void DatabaseManager::updateEntriesBroadcastFlagByIds(const QList<QString> &ids)
+{
+    updateEntriesFlagByIds("broadcast", ids);
+}
+
+void DatabaseManager::updateEntriesLikedFlagByIds(const QList<QString> &ids)
+{
+    updateEntriesFlagByIds("liked", ids);
+}
+
+void DatabaseManager::updateEntriesFlagByIds(const QString &column, const QList<QString> &ids)
+{
+    HotEntries::instance()->invalidate();
+
+    if (db.isOpen()) {
+        if (!writeTempIds(ids))
+            return;
+
+        TimedQuery query(db, __func__);
+
+        QStringList tables("main.entries");
+        if (archiveAttached)
+            tables.append("archive.entries");
+
+        for (const auto &table : tables) {
+            bool ret = query.exec(QString("UPDATE %1 SET %2=1 WHERE %2!=1 AND "
+                                          "id IN (SELECT id FROM temp.temp_ids);")
+                                  .arg(table, column));
+            if (ret)
+                ret = query.exec(QString("UPDATE %1 SET %2=0 WHERE %2=1 AND "
+                                         "id NOT IN (SELECT id FROM temp.temp_ids);")
+                                 .arg(table, column));
+
+            if (!ret) {
+               qWarning() << "SQL Error:" << query.lastQuery();
+               checkError(query.lastError());
+            }
+        }
+    } else {
+        qWarning() << "DB is not opened";
+    }
+}
+
+void DatabaseManager::updateStreamUnreadById(const QString &id, int unread)
+{
+    if (db.isOpen()) {
+        TimedQuery query(db, __func__);
+        bool ret = query.exec(QString("UPDATE streams SET unread=%1 WHERE id='%2';")
+                         .arg(unread)
+                         .arg(id));
+
+        if (!ret) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+        }
+    } else {
+        qWarning() << "DB is not opened";
+    }
+}
+
+void DatabaseManager::updateStreamUpdateAtById(const QString &id, int updateAt)
+{
+    if (db.isOpen()) {
+        TimedQuery query(db, __func__);
+        bool ret = query.exec(QString("UPDATE streams SET update_at=%1 WHERE id='%2';")
+                         .arg(updateAt)
+                         .arg(id));
+
+        if (!ret) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+        }
+    } else {
+        qWarning() << "DB is not opened";
+    }
+}
+
 void DatabaseManager::updateStreamSlowFlagById(const QString &id, int flag)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
         bool ret = query.exec(QString("UPDATE streams SET slow=%1 WHERE id='%2';")
                          .arg(flag)
                          .arg(id));
@@ -1104,8 +2203,10 @@ void DatabaseManager::updateStreamSlowFlagById(const QString &id, int flag)
 
 void DatabaseManager::updateEntriesSlowReadFlagByDashboard(const QString &id, int flag)
 {
+    HotEntries::instance()->invalidate();
+
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
         bool ret = query.exec(QString("UPDATE entries SET read=%1 "
                                       "WHERE stream_id IN "
                                       "(SELECT s.id FROM streams as s, module_stream as ms, modules as m, tabs as t "
@@ -1128,7 +2229,7 @@ DatabaseManager::Dashboard DatabaseManager::readDashboard(const QString &id)
     Dashboard item;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
         bool ret = query.exec(QString("SELECT id, name, title, description FROM dashboards WHERE id='%1';")
                         .arg(id));
 
@@ -1155,7 +2256,7 @@ QList<DatabaseManager::Dashboard> DatabaseManager::readDashboards()
     QList<DatabaseManager::Dashboard> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
         bool ret = query.exec(QString("SELECT id, name, title, description FROM dashboards LIMIT %1;")
                         .arg(dashboardsLimit));
 
@@ -1184,7 +2285,7 @@ QList<DatabaseManager::Tab> DatabaseManager::readTabsByDashboard(const QString &
     QList<DatabaseManager::Tab> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
         bool ret = query.exec(QString("SELECT id, title, icon FROM tabs WHERE dashboard_id='%1' LIMIT %2;")
                         .arg(id)
                         .arg(tabsLimit));
@@ -1213,7 +2314,7 @@ QList<DatabaseManager::Stream> DatabaseManager::readStreamsByTab(const QString &
     QList<DatabaseManager::Stream> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT s.id, ms.module_id, m.title, s.title, m.name, s.content, s.link, s.query, s.icon, "
                                       "s.type, s.unread, s.read, s.saved, s.slow, s.newest_item_added_at, s.update_at, s.last_update "
@@ -1266,7 +2367,7 @@ QList<QString> DatabaseManager::readStreamIdsByTab(const QString &id)
     QList<QString> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
         bool ret = query.exec(QString("SELECT s.id FROM streams as s, module_stream as ms, modules as m "
                                       "WHERE ms.stream_id=s.id AND ms.module_id=m.id AND m.tab_id='%1' "
                                       "LIMIT %2;")
@@ -1288,12 +2389,165 @@ QList<QString> DatabaseManager::readStreamIdsByTab(const QString &id)
     return list;
 }
 
+// Streams without schedule are returned with zero next poll
+QList<DatabaseManager::Schedule> DatabaseManager::readSchedules(int since)
+{
+    QList<DatabaseManager::Schedule> list;
+
+    if (db.isOpen()) {
+        TimedQuery query(db, __func__);
+        bool ret = query.exec(QString("SELECT s.id, s.slow, "
+                                      "(SELECT COUNT(*) FROM entries WHERE stream_id=s.id AND published_at>%1), "
+                                      "(SELECT MAX(published_at) FROM entries WHERE stream_id=s.id), "
+                                      "sc.last_published_at, sc.next_poll, sc.idle, sc.errors "
+                                      "FROM streams as s LEFT JOIN schedule as sc ON sc.stream_id=s.id;")
+                              .arg(since));
+
+        if (!ret) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+        }
+
+        while(query.next()) {
+            Schedule item;
+            item.streamId = query.value(0).toString();
+            item.slow = query.value(1).toInt();
+            item.posts = query.value(2).toInt();
+            item.newestPublishedAt = query.value(3).toInt();
+            item.lastPublishedAt = query.value(4).toInt();
+            item.nextPoll = query.value(5).toInt();
+            item.idle = query.value(6).toInt();
+            item.errors = query.value(7).toInt();
+            list.append(item);
+        }
+    } else {
+        qWarning() << "DB is not open";
+    }
+
+    return list;
+}
+
+QMap<QString,DatabaseManager::Watermark> DatabaseManager::readStreamWatermarks()
+{
+    QMap<QString,Watermark> map;
+
+    if (db.isOpen()) {
+        TimedQuery query(db, __func__);
+        bool ret = query.exec("SELECT s.id, s.newest_item_added_at, e.unread, e.newest "
+                              "FROM streams as s LEFT JOIN "
+                              "(SELECT stream_id, SUM(read=0) as unread, MAX(timestamp) as newest "
+                              "FROM entries GROUP BY stream_id) as e ON e.stream_id=s.id;");
+
+        if (!ret) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+        }
+
+        while(query.next()) {
+            Watermark item;
+            item.newestItemAddedAt = query.value(1).toInt();
+            item.unread = query.value(2).toInt();
+            item.newestTimestamp = query.value(3).toInt();
+            map.insert(query.value(0).toString(), item);
+        }
+    } else {
+        qWarning() << "DB is not open";
+    }
+
+    return map;
+}
+
+void DatabaseManager::writeSchedules(const QList<Schedule> &items)
+{
+    if (db.isOpen()) {
+        TimedQuery query(db, __func__);
+
+        db.transaction();
+
+        // Removed streams
+        if (!query.exec("DELETE FROM schedule WHERE stream_id NOT IN (SELECT id FROM streams);")) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+        }
+
+        query.prepare("INSERT OR REPLACE INTO schedule "
+                      "(stream_id, last_published_at, next_poll, idle, errors) "
+                      "VALUES(?,?,?,?,?)");
+
+        for (const auto &item : items) {
+            query.addBindValue(item.streamId);
+            query.addBindValue(item.lastPublishedAt);
+            query.addBindValue(item.nextPoll);
+            query.addBindValue(item.idle);
+            query.addBindValue(item.errors);
+
+            if (!query.exec()) {
+               qWarning() << "SQL Error:" << query.lastQuery();
+               checkError(query.lastError());
+            }
+        }
+
+        db.commit();
+    } else {
+        qWarning() << "DB is not open";
+    }
+}
+
+QList<DatabaseManager::Checkpoint> DatabaseManager::readCheckpoints(const QString &prefix)
+{
+    QList<DatabaseManager::Checkpoint> list;
+
+    if (db.isOpen()) {
+        TimedQuery query(db, __func__);
+        bool ret = query.exec(QString("SELECT job, continuation, page_offset, pages, last_date, done, updated_at "
+                                      "FROM checkpoints WHERE job LIKE '%1%';")
+                              .arg(prefix));
+
+        if (!ret) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+        }
+
+        while(query.next()) {
+            Checkpoint item;
+            item.job = query.value(0).toString();
+            item.continuation = query.value(1).toString();
+            item.offset = query.value(2).toInt();
+            item.pages = query.value(3).toInt();
+            item.lastDate = query.value(4).toInt();
+            item.done = query.value(5).toInt() == 1;
+            item.updatedAt = query.value(6).toInt();
+            list.append(item);
+        }
+    } else {
+        qWarning() << "DB is not open";
+    }
+
+    return list;
+}
+
+void DatabaseManager::removeCheckpoints(const QString &prefix)
+{
+    if (db.isOpen()) {
+        TimedQuery query(db, __func__);
+        bool ret = query.exec(QString("DELETE FROM checkpoints WHERE job LIKE '%1%';")
+                              .arg(prefix));
+
+        if (!ret) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+        }
+    } else {
+        qWarning() << "DB is not open";
+    }
+}
+
 QList<DatabaseManager::Stream> DatabaseManager::readStreamsByDashboard(const QString &id)
 {
     QList<DatabaseManager::Stream> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
         bool ret = query.exec(QString("SELECT s.id, ms.module_id, m.title, s.title, m.name, s.content, s.link, s.query, s.icon, "
                                       "s.type, s.unread, s.read, s.saved, s.slow, s.newest_item_added_at, s.update_at, s.last_update "
                                       "FROM streams as s, module_stream as ms, modules as m, tabs as t "
@@ -1320,18 +2574,50 @@ QList<DatabaseManager::Stream> DatabaseManager::readStreamsByDashboard(const QSt
                 item.title = query.value(3).toString();
             }
 
-            item.content = query.value(5).toString();
-            item.link = query.value(6).toString();
-            item.query = query.value(7).toString();
-            item.icon = query.value(8).toString();
-            item.type = query.value(9).toString();
-            item.unread = query.value(10).toInt();
-            item.read = query.value(11).toInt();
-            item.saved = query.value(12).toInt();
-            item.slow = query.value(13).toInt();
-            item.newestItemAddedAt = query.value(14).toInt();
-            item.updateAt = query.value(15).toInt();
-            item.lastUpdate = query.value(16).toInt();
+            item.content = query.value(5).toString();
+            item.link = query.value(6).toString();
+            item.query = query.value(7).toString();
+            item.icon = query.value(8).toString();
+            item.type = query.value(9).toString();
+            item.unread = query.value(10).toInt();
+            item.read = query.value(11).toInt();
+            item.saved = query.value(12).toInt();
+            item.slow = query.value(13).toInt();
+            item.newestItemAddedAt = query.value(14).toInt();
+            item.updateAt = query.value(15).toInt();
+            item.lastUpdate = query.value(16).toInt();
+            list.append(item);
+        }
+    } else {
+        qWarning() << "DB is not open";
+    }
+
+    return list;
+}
+
+// Only id, title and icon, as joined to entries in list views
+QList<DatabaseManager::Stream> DatabaseManager::readStreamTitlesByDashboard(const QString &id)
+{
+    QList<DatabaseManager::Stream> list;
+
+    if (db.isOpen()) {
+        TimedQuery query(db, __func__);
+        bool ret = query.exec(QString("SELECT DISTINCT s.id, s.title, s.icon "
+                                      "FROM streams as s, module_stream as ms, modules as m, tabs as t "
+                                      "WHERE ms.stream_id=s.id AND ms.module_id=m.id AND m.tab_id=t.id "
+                                      "AND t.dashboard_id='%1';")
+                        .arg(id));
+
+        if (!ret) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+        }
+
+        while(query.next()) {
+            Stream item;
+            item.id = query.value(0).toString();
+            item.title = query.value(1).toString();
+            item.icon = query.value(2).toString();
             list.append(item);
         }
     } else {
@@ -1346,7 +2632,7 @@ QList<DatabaseManager::StreamModuleTab> DatabaseManager::readStreamModuleTabList
     QList<DatabaseManager::StreamModuleTab> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT ms.stream_id, m.id, m.tab_id "
                               "FROM module_stream as ms, modules as m "
@@ -1378,7 +2664,7 @@ QList<DatabaseManager::StreamModuleTab> DatabaseManager::readStreamModuleTabList
     QList<DatabaseManager::StreamModuleTab> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT ms.stream_id, m.id, m.tab_id "
                               "FROM module_stream as ms, modules as m, tabs as t "
@@ -1411,7 +2697,7 @@ QList<DatabaseManager::StreamModuleTab> DatabaseManager::readSlowStreamModuleTab
     QList<DatabaseManager::StreamModuleTab> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT ms.stream_id, m.id, m.tab_id "
                               "FROM streams as s, module_stream as ms, modules as m, tabs as t "
@@ -1444,7 +2730,7 @@ QList<QString> DatabaseManager::readStreamIds()
     QList<QString> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
         bool ret = query.exec("SELECT id FROM streams;");
 
         if (!ret) {
@@ -1462,10 +2748,79 @@ QList<QString> DatabaseManager::readStreamIds()
     return list;
 }
 
+// Highest numeric entry id of every stream
+QMap<QString,int> DatabaseManager::readMaxEntryIdsByStream()
+{
+    QMap<QString,int> map;
+
+    if (db.isOpen()) {
+        TimedQuery query(db, __func__);
+        bool ret = query.exec("SELECT stream_id, MAX(CAST(id AS INTEGER)) FROM entries "
+                              "GROUP BY stream_id;");
+
+        if (!ret) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+        }
+
+        while(query.next()) {
+            map.insert(query.value(0).toString(), query.value(1).toInt());
+        }
+    } else {
+        qWarning() << "DB is not open";
+    }
+
+    return map;
+}
+
+// Ids that are neither in hot nor in archived entries
+QList<QString> DatabaseManager::readMissingEntryIds(const QList<QString> &ids)
+{
+    QList<QString> list;
+
+    if (ids.isEmpty())
+        return list;
+
+    if (db.isOpen()) {
+        TimedQuery query(db, __func__);
+
+        QStringList quoted;
+        for (const auto &id : ids)
+            quoted.append(QString("'%1'").arg(id));
+        QString idList = quoted.join(",");
+
+        QString sql = QString("SELECT id FROM main.entries WHERE id IN (%1)").arg(idList);
+        if (archiveAttached)
+            sql += QString(" UNION SELECT id FROM archive.entries WHERE id IN (%1)").arg(idList);
+
+        bool ret = query.exec(sql + ";");
+
+        if (!ret) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+           return list;
+        }
+
+        QSet<QString> found;
+        while(query.next()) {
+            found.insert(query.value(0).toString());
+        }
+
+        for (const auto &id : ids) {
+            if (!found.contains(id))
+                list.append(id);
+        }
+    } else {
+        qWarning() << "DB is not open";
+    }
+
+    return list;
+}
+
 QString DatabaseManager::readStreamIdByEntry(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT stream_id FROM entries WHERE id='%1';")
                               .arg(id));
@@ -1489,7 +2844,7 @@ QList<QString> DatabaseManager::readTabIdsByDashboard(const QString &id)
     QList<QString> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT id FROM tabs WHERE dashboard_id='%1';")
                               .arg(id));
@@ -1511,10 +2866,10 @@ QList<QString> DatabaseManager::readTabIdsByDashboard(const QString &id)
 QString DatabaseManager::readEntryImageById(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
-        bool ret = query.exec(QString("SELECT image FROM entries WHERE id='%1';")
-                              .arg(id));
+        bool ret = query.exec(QString("SELECT image FROM %2 WHERE id='%1';")
+                              .arg(id, entriesSource(QString("id='%1'").arg(id))));
         if (!ret) {
            qWarning() << "SQL Error:" << query.lastQuery();
            checkError(query.lastError());
@@ -1533,10 +2888,10 @@ QString DatabaseManager::readEntryImageById(const QString &id)
 QString DatabaseManager::readEntryContentById(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
-        bool ret = query.exec(QString("SELECT content FROM entries WHERE id='%1';")
-                              .arg(id));
+        bool ret = query.exec(QString("SELECT content FROM %2 WHERE id='%1';")
+                              .arg(id, entriesSource(QString("id='%1'").arg(id))));
         if (!ret) {
            qWarning() << "SQL Error:" << query.lastQuery();
            checkError(query.lastError());
@@ -1557,7 +2912,7 @@ QList<QString> DatabaseManager::readModuleIdByStream(const QString &id)
     QList<QString> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT module_id FROM module_stream WHERE module_id='%1';")
                               .arg(id));
@@ -1581,7 +2936,7 @@ QList<QString> DatabaseManager::readCacheIdsOlderThan(int cacheDate, int limit)
     QList<QString> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT id FROM cache WHERE entry_id IN "
                                       "(SELECT id FROM entries WHERE cached_at<%1 AND stream_id IN "
@@ -1607,7 +2962,7 @@ QList<QString> DatabaseManager::readCacheFinalUrlsByStream(const QString &id, in
     QList<QString> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT c.final_url FROM cache as c, entries as e "
             "WHERE c.entry_id=e.id AND e.stream_id='%1' AND e.saved!=1 AND e.broadcast!=1 AND e.liked!=1 AND e.id NOT IN ("
@@ -1634,7 +2989,7 @@ DatabaseManager::CacheItem DatabaseManager::readCacheByOrigUrl(const QString &id
     CacheItem item;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT id, orig_url, final_url, base_url, type, content_type, entry_id, stream_id, flag, date "
                                       "FROM cache WHERE orig_url='%1' AND flag=1;").arg(id));
@@ -1669,10 +3024,11 @@ DatabaseManager::CacheItem DatabaseManager::readCacheByEntry(const QString &id)
     CacheItem item;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT id, orig_url, final_url, base_url, type, content_type, entry_id, stream_id, flag, date "
-                                      "FROM cache WHERE entry_id='%1' AND flag=1;").arg(id));
+                                      "FROM cache WHERE entry_id IN ('%1', (SELECT original_id FROM duplicates WHERE entry_id='%1')) "
+                                      "AND flag=1;").arg(id));
         if (!ret) {
            qWarning() << "SQL Error:" << query.lastQuery();
            checkError(query.lastError());
@@ -1702,7 +3058,7 @@ DatabaseManager::CacheItem DatabaseManager::readCacheByCache(const QString &id)
     CacheItem item;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT id, orig_url, final_url, type, content_type, entry_id, stream_id, flag, date "
                                       "FROM cache WHERE id='%1';").arg(id));
@@ -1735,7 +3091,7 @@ DatabaseManager::CacheItem DatabaseManager::readCacheByFinalUrl(const QString &i
     CacheItem item;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT id, orig_url, final_url, base_url, type, content_type, entry_id, stream_id, flag, date "
                                       "FROM cache WHERE final_url='%1';").arg(id));
@@ -1766,7 +3122,7 @@ DatabaseManager::CacheItem DatabaseManager::readCacheByFinalUrl(const QString &i
 bool DatabaseManager::isCacheExists(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT COUNT(*) FROM cache WHERE id='%1';").arg(id));
 
@@ -1790,9 +3146,10 @@ bool DatabaseManager::isCacheExists(const QString &id)
 bool DatabaseManager::isCacheExistsByEntryId(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
-        bool ret = query.exec(QString("SELECT count(*) FROM cache WHERE entry_id='%1' AND flag=1;")
+        bool ret = query.exec(QString("SELECT count(*) FROM cache WHERE entry_id IN "
+                                      "('%1', (SELECT original_id FROM duplicates WHERE entry_id='%1')) AND flag=1;")
                         .arg(id));
         if (!ret) {
            qWarning() << "SQL Error:" << query.lastQuery();
@@ -1811,10 +3168,49 @@ bool DatabaseManager::isCacheExistsByEntryId(const QString &id)
     return false;
 }
 
+// Same as isCacheExistsByEntryId but for many entries in one query
+QSet<QString> DatabaseManager::readCachedEntryIds(const QList<QString> &ids)
+{
+    QSet<QString> cached;
+
+    if (ids.isEmpty())
+        return cached;
+
+    if (db.isOpen()) {
+        TimedQuery query(db, __func__);
+
+        QStringList marks;
+        for (int i = 0; i < ids.size(); ++i)
+            marks.append("?");
+
+        query.prepare(QString("SELECT entry_id FROM cache WHERE flag=1 AND entry_id IN (%1) "
+                              "UNION SELECT d.entry_id FROM duplicates AS d, cache AS c "
+                              "WHERE d.entry_id IN (%1) AND c.entry_id=d.original_id AND c.flag=1;")
+                      .arg(marks.join(",")));
+        for (int i = 0; i < 2; ++i) {
+            for (const auto &id : ids)
+                query.addBindValue(id);
+        }
+
+        if (!query.exec()) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+        }
+
+        while(query.next()) {
+            cached.insert(query.value(0).toString());
+        }
+    } else {
+        qWarning() << "DB is not open";
+    }
+
+    return cached;
+}
+
 bool DatabaseManager::isCacheExistsByFinalUrl(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT count(*) FROM cache WHERE final_url='%1';")
                         .arg(id));
@@ -1835,10 +3231,42 @@ bool DatabaseManager::isCacheExistsByFinalUrl(const QString &id)
     return false;
 }
 
+// Returns ids (final URL hashes) that are already in cache
+QSet<QString> DatabaseManager::readCacheFinalUrls(const QStringList &ids)
+{
+    QSet<QString> list;
+
+    if (ids.isEmpty())
+        return list;
+
+    if (db.isOpen()) {
+        TimedQuery query(db, __func__);
+
+        QStringList idList;
+        for (const auto &id : ids)
+            idList.append(QString("'%1'").arg(id));
+
+        bool ret = query.exec(QString("SELECT DISTINCT final_url FROM cache WHERE final_url IN (%1);")
+                        .arg(idList.join(",")));
+        if (!ret) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+        }
+
+        while(query.next()) {
+            list.insert(query.value(0).toString());
+        }
+    } else {
+        qWarning() << "DB is not open";
+    }
+
+    return list;
+}
+
 bool DatabaseManager::isDashboardExists()
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec("SELECT count(*) FROM dashboards;");
 
@@ -1864,7 +3292,7 @@ QMap<QString,QString> DatabaseManager::readStreamIdsTabIds()
     QMap<QString,QString> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec("SELECT ms.stream_id, m.tab_id FROM module_stream as ms, modules as m "
                               "WHERE ms.module_id=m.id;");
@@ -1888,7 +3316,7 @@ QList<DatabaseManager::StreamModuleTab> DatabaseManager::readStreamModuleTabList
     QList<DatabaseManager::StreamModuleTab> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec("SELECT ms.stream_id, ms.module_id, m.tab_id "
                               "FROM module_stream as ms, modules as m "
@@ -1921,7 +3349,7 @@ QList<DatabaseManager::StreamModuleTab> DatabaseManager::readStreamModuleTabList
     QList<DatabaseManager::StreamModuleTab> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec("SELECT e.stream_id, m.id, m.tab_id, min(e.published_at) "
                               "FROM entries as e, module_stream as ms, modules as m "
@@ -1952,7 +3380,7 @@ QList<DatabaseManager::StreamModuleTab> DatabaseManager::readStreamModuleTabList
 int DatabaseManager::readLastUpdateByStream(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT last_update FROM streams "
                                       "WHERE id='%1';").arg(id));
@@ -1975,7 +3403,7 @@ int DatabaseManager::readLastUpdateByStream(const QString &id)
 int DatabaseManager::readLastUpdateByTab(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT max(s.last_update) FROM streams as s, module_stream as ms, modules as m "
                                       "WHERE ms.stream_id=s.id AND ms.module_id=m.id AND m.tab_id='%1';").arg(id));
@@ -1998,7 +3426,7 @@ int DatabaseManager::readLastUpdateByTab(const QString &id)
 int DatabaseManager::readLastPublishedAtByTab(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT max(e.published_at) "
                                       "FROM entries as e, module_stream as ms, modules as m "
@@ -2023,7 +3451,7 @@ int DatabaseManager::readLastPublishedAtByTab(const QString &id)
 int DatabaseManager::readLastTimestampByTab(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT max(e.timestamp) "
                                       "FROM entries as e, module_stream as ms, modules as m "
@@ -2048,7 +3476,7 @@ int DatabaseManager::readLastTimestampByTab(const QString &id)
 int DatabaseManager::readLastCrawlTimeByTab(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT max(e.crawl_time) "
                                       "FROM entries as e, module_stream as ms, modules as m "
@@ -2072,7 +3500,7 @@ int DatabaseManager::readLastCrawlTimeByTab(const QString &id)
 int DatabaseManager::readLastLastUpdateByTab(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT max(e.last_update) "
                                       "FROM entries as e, module_stream as ms, modules as m "
@@ -2096,7 +3524,7 @@ int DatabaseManager::readLastLastUpdateByTab(const QString &id)
 int DatabaseManager::readLastPublishedAtByDashboard(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT max(e.published_at) "
                                       "FROM entries as e, module_stream as ms, modules as m, tabs as t "
@@ -2121,7 +3549,7 @@ int DatabaseManager::readLastPublishedAtByDashboard(const QString &id)
 int DatabaseManager::readLastTimestampByDashboard(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT max(e.timestamp) "
                                       "FROM entries as e, module_stream as ms, modules as m, tabs as t "
@@ -2146,7 +3574,7 @@ int DatabaseManager::readLastTimestampByDashboard(const QString &id)
 int DatabaseManager::readLastCrawlTimeByDashboard(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT max(e.crawl_time) "
                                       "FROM entries as e, module_stream as ms, modules as m, tabs as t "
@@ -2171,7 +3599,7 @@ int DatabaseManager::readLastCrawlTimeByDashboard(const QString &id)
 int DatabaseManager::readLastLastUpdateByDashboard(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT max(e.last_update) "
                                       "FROM entries as e, module_stream as ms, modules as m, tabs as t "
@@ -2196,7 +3624,7 @@ int DatabaseManager::readLastLastUpdateByDashboard(const QString &id)
 int DatabaseManager::readLastPublishedAtSlowByDashboard(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT max(e.published_at) "
                                       "FROM entries as e, streams as s, module_stream as ms, modules as m, tabs as t "
@@ -2221,7 +3649,7 @@ int DatabaseManager::readLastPublishedAtSlowByDashboard(const QString &id)
 int DatabaseManager::readLastTimestampSlowByDashboard(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT max(e.timestamp) "
                                       "FROM entries as e, streams as s, module_stream as ms, modules as m, tabs as t "
@@ -2246,7 +3674,7 @@ int DatabaseManager::readLastTimestampSlowByDashboard(const QString &id)
 int DatabaseManager::readLastCrawlTimeSlowByDashboard(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT max(e.crawl_time) "
                                       "FROM entries as e, streams as s, module_stream as ms, modules as m, tabs as t "
@@ -2271,7 +3699,7 @@ int DatabaseManager::readLastCrawlTimeSlowByDashboard(const QString &id)
 int DatabaseManager::readLastLastUpdateSlowByDashboard(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT max(e.last_update) "
                                       "FROM entries as e, streams as s, module_stream as ms, modules as m, tabs as t "
@@ -2296,7 +3724,7 @@ int DatabaseManager::readLastLastUpdateSlowByDashboard(const QString &id)
 int DatabaseManager::readLastPublishedAtByStream(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT max(e.published_at) "
                                       "FROM entries as e, module_stream as ms "
@@ -2321,7 +3749,7 @@ int DatabaseManager::readLastPublishedAtByStream(const QString &id)
 int DatabaseManager::readLastTimestampByStream(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT max(e.timestamp) "
                                       "FROM entries as e, module_stream as ms "
@@ -2346,7 +3774,7 @@ int DatabaseManager::readLastTimestampByStream(const QString &id)
 int DatabaseManager::readLastCrawlTimeByStream(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT max(e.crawl_time) "
                                       "FROM entries as e, module_stream as ms "
@@ -2371,7 +3799,7 @@ int DatabaseManager::readLastCrawlTimeByStream(const QString &id)
 int DatabaseManager::readLastLastUpdateByStream(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT max(e.last_update) "
                                       "FROM entries as e, module_stream as ms "
@@ -2396,7 +3824,7 @@ int DatabaseManager::readLastLastUpdateByStream(const QString &id)
 int DatabaseManager::readLastUpdateByDashboard(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT max(s.last_update) FROM streams as s, modules as m, module_stream as ms, tabs as t "
                                       "WHERE ms.stream_id=s.id AND ms.module_id=m.id AND m.tab_id=t.id "
@@ -2421,7 +3849,7 @@ QList<DatabaseManager::Entry> DatabaseManager::readEntriesByStream(const QString
     QList<DatabaseManager::Entry> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT e.id, e.stream_id, e.title, e.author, e.content, e.link, e.image, s.icon, s.title, e.annotations, s.id, "
                                       "e.fresh, e.fresh_or, e.read, e.saved, e.liked, e.cached, e.broadcast, e.created_at, e.published_at, e.timestamp, e.crawl_time, e.last_update "
@@ -2470,7 +3898,7 @@ QList<DatabaseManager::Entry> DatabaseManager::readEntriesByStream(const QString
 QString DatabaseManager::readLatestEntryIdByStream(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT id FROM entries WHERE stream_id='%1' "
                                       "ORDER BY published_at DESC LIMIT 1;")
@@ -2493,7 +3921,7 @@ QString DatabaseManager::readLatestEntryIdByStream(const QString &id)
 QString DatabaseManager::readLatestEntryIdByTab(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT e.id FROM entries as e, streams as s, module_stream as ms, modules as m "
                                       "WHERE e.stream_id=ms.stream_id AND e.stream_id=s.id AND ms.module_id=m.id AND m.tab_id='%1' "
@@ -2518,7 +3946,7 @@ QString DatabaseManager::readLatestEntryIdByTab(const QString &id)
 QString DatabaseManager::readLatestEntryIdByDashboard(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT e.id FROM entries as e, streams as s, module_stream as ms, modules as m, tabs as t "
                                       "WHERE e.stream_id=ms.stream_id AND e.stream_id=s.id AND ms.module_id=m.id AND m.tab_id=t.id AND t.dashboard_id='%1' "
@@ -2545,15 +3973,15 @@ QList<DatabaseManager::Entry> DatabaseManager::readEntriesByDashboard(const QStr
     QList<DatabaseManager::Entry> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT e.id, e.stream_id, e.title, e.author, e.content, e.link, e.image, s.icon, s.title, e.annotations, s.id, "
                                       "e.fresh, e.fresh_or, e.read, e.saved, e.liked, e.cached, e.broadcast, e.created_at, e.published_at, e.timestamp, e.crawl_time, e.last_update "
                                       "FROM entries as e, streams as s, module_stream as ms, modules as m, tabs as t "
                                       "WHERE e.stream_id=ms.stream_id AND e.stream_id=s.id AND ms.module_id=m.id AND m.tab_id=t.id "
-                                      "AND t.dashboard_id='%1' "
+                                      "AND t.dashboard_id='%1' %5"
                                       "ORDER BY e.published_at %4 LIMIT %2 OFFSET %3;")
-                        .arg(id).arg(limit).arg(offset).arg(ascOrder ? "ASC" : "DESC"));
+                        .arg(id).arg(limit).arg(offset).arg(ascOrder ? "ASC" : "DESC").arg(duplicatesFilter()));
 
         if (!ret) {
            qWarning() << "SQL Error:" << query.lastQuery();
@@ -2598,15 +4026,15 @@ QList<DatabaseManager::Entry> DatabaseManager::readEntriesUnreadByDashboard(cons
     QList<DatabaseManager::Entry> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT e.id, e.stream_id, e.title, e.author, e.content, e.link, e.image, s.icon, s.title, e.annotations, s.id, "
                                       "e.fresh, e.fresh_or, e.read, e.saved, e.liked, e.cached, e.broadcast, e.created_at, e.published_at, e.timestamp, e.crawl_time, e.last_update "
                                       "FROM entries as e, streams as s, module_stream as ms, modules as m, tabs as t "
                                       "WHERE e.stream_id=ms.stream_id AND e.stream_id=s.id AND ms.module_id=m.id AND m.tab_id=t.id "
-                                      "AND t.dashboard_id='%1' "
+                                      "AND t.dashboard_id='%1' %5"
                                       "AND e.read=0 ORDER BY e.published_at %4 LIMIT %2 OFFSET %3;")
-                        .arg(id).arg(limit).arg(offset).arg(ascOrder ? "ASC" : "DESC"));
+                        .arg(id).arg(limit).arg(offset).arg(ascOrder ? "ASC" : "DESC").arg(duplicatesFilter()));
 
         if (!ret) {
            qWarning() << "SQL Error:" << query.lastQuery();
@@ -2651,15 +4079,15 @@ QList<DatabaseManager::Entry> DatabaseManager::readEntriesUnreadAndSavedByDashbo
     QList<DatabaseManager::Entry> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT e.id, e.stream_id, e.title, e.author, e.content, e.link, e.image, s.icon, s.title, e.annotations, s.id, "
                                       "e.fresh, e.fresh_or, e.read, e.saved, e.liked, e.cached, e.broadcast, e.created_at, e.published_at, e.timestamp, e.crawl_time, e.last_update "
                                       "FROM entries as e, streams as s, module_stream as ms, modules as m, tabs as t "
                                       "WHERE e.stream_id=ms.stream_id AND e.stream_id=s.id AND ms.module_id=m.id AND m.tab_id=t.id "
-                                      "AND t.dashboard_id='%1' "
+                                      "AND t.dashboard_id='%1' %5"
                                       "AND (e.read=0 OR e.saved=1) ORDER BY e.published_at %4 LIMIT %2 OFFSET %3;")
-                        .arg(id).arg(limit).arg(offset).arg(ascOrder ? "ASC" : "DESC"));
+                        .arg(id).arg(limit).arg(offset).arg(ascOrder ? "ASC" : "DESC").arg(duplicatesFilter()));
         if (!ret) {
            qWarning() << "SQL Error:" << query.lastQuery();
            checkError(query.lastError());
@@ -2703,7 +4131,7 @@ QList<DatabaseManager::Entry> DatabaseManager::readEntriesSlowUnreadByDashboard(
     QList<DatabaseManager::Entry> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT e.id, e.stream_id, e.title, e.author, e.content, e.link, e.image, s.icon, s.title, e.annotations, s.id, "
                                       "e.fresh, e.fresh_or, e.read, e.saved, e.liked, e.cached, e.broadcast, e.created_at, e.published_at, e.timestamp, e.crawl_time, e.last_update "
@@ -2756,7 +4184,7 @@ QList<DatabaseManager::Entry> DatabaseManager::readEntriesSlowUnreadAndSavedByDa
     QList<DatabaseManager::Entry> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT e.id, e.stream_id, e.title, e.author, e.content, e.link, e.image, s.icon, s.title, e.annotations, s.id, "
                                       "e.fresh, e.fresh_or, e.read, e.saved, e.liked, e.cached, e.broadcast, e.created_at, e.published_at, e.timestamp, e.crawl_time, e.last_update "
@@ -2809,7 +4237,7 @@ QList<DatabaseManager::Entry> DatabaseManager::readEntriesByTab(const QString &i
     QList<DatabaseManager::Entry> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT e.id, e.stream_id, e.title, e.author, e.content, e.link, e.image, s.icon, s.title, e.annotations, s.id, "
                                       "e.fresh, e.fresh_or, e.read, e.saved, e.liked, e.cached, e.broadcast, e.created_at, e.published_at, e.timestamp, e.crawl_time, e.last_update "
@@ -2862,7 +4290,7 @@ QList<DatabaseManager::Entry> DatabaseManager::readEntriesUnreadByTab(const QStr
     QList<DatabaseManager::Entry> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT e.id, e.stream_id, e.title, e.author, e.content, e.link, e.image, s.icon, s.title, e.annotations, s.id, "
                                       "e.fresh, e.fresh_or, e.read, e.saved, e.liked, e.cached, e.broadcast, e.created_at, e.published_at, e.timestamp, e.crawl_time, e.last_update "
@@ -2916,7 +4344,7 @@ QList<DatabaseManager::Entry> DatabaseManager::readEntriesUnreadAndSavedByTab(co
     QList<DatabaseManager::Entry> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT e.id, e.stream_id, e.title, e.author, e.content, e.link, e.image, s.icon, s.title, e.annotations, s.id, "
                                       "e.fresh, e.fresh_or, e.read, e.saved, e.liked, e.cached, e.broadcast, e.created_at, e.published_at, e.timestamp, e.crawl_time, e.last_update "
@@ -2970,15 +4398,16 @@ QList<DatabaseManager::Entry> DatabaseManager::readEntriesSavedByDashboard(const
     QList<DatabaseManager::Entry> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT e.id, e.stream_id, e.title, e.author, e.content, e.link, e.image, s.icon, s.title, e.annotations, s.id, "
                                       "e.fresh, e.fresh_or, e.read, e.saved, e.liked, e.cached, e.broadcast, e.created_at, e.published_at, e.timestamp, e.crawl_time, e.last_update "
-                                      "FROM entries as e, streams as s, module_stream as ms, modules as m, tabs as t "
+                                      "FROM %5 as e, streams as s, module_stream as ms, modules as m, tabs as t "
                                       "WHERE e.stream_id=ms.stream_id AND e.stream_id=s.id AND ms.module_id=m.id AND m.tab_id=t.id "
                                       "AND t.dashboard_id='%1' "
                                       "AND e.saved=1 ORDER BY e.published_at %4 LIMIT %2 OFFSET %3;")
-                        .arg(id).arg(limit).arg(offset).arg(ascOrder ? "ASC" : "DESC"));
+                        .arg(id).arg(limit).arg(offset).arg(ascOrder ? "ASC" : "DESC")
+                        .arg(entriesSource("saved=1")));
 
         if (!ret) {
            qWarning() << "SQL Error:" << query.lastQuery();
@@ -3023,7 +4452,7 @@ QList<DatabaseManager::Entry> DatabaseManager::readEntriesSlowByDashboard(const
     QList<DatabaseManager::Entry> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT e.id, e.stream_id, e.title, e.author, e.content, e.link, e.image, s.icon, s.title, e.annotations, s.id, "
                                       "e.fresh, e.fresh_or, e.read, e.saved, e.liked, e.cached, e.broadcast, e.created_at, e.published_at, e.timestamp, e.crawl_time, e.last_update "
@@ -3076,15 +4505,16 @@ QList<DatabaseManager::Entry> DatabaseManager::readEntriesLikedByDashboard(const
     QList<DatabaseManager::Entry> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT e.id, e.stream_id, e.title, e.author, e.content, e.link, e.image, s.icon, s.title, e.annotations, s.id, "
                                       "e.fresh, e.fresh_or, e.read, e.saved, e.liked, e.cached, e.broadcast, e.created_at, e.published_at, e.timestamp, e.crawl_time, e.last_update "
-                                      "FROM entries as e, streams as s, module_stream as ms, modules as m, tabs as t "
+                                      "FROM %5 as e, streams as s, module_stream as ms, modules as m, tabs as t "
                                       "WHERE e.stream_id=ms.stream_id AND e.stream_id=s.id AND ms.module_id=m.id AND m.tab_id=t.id "
                                       "AND t.dashboard_id='%1' "
                                       "AND e.liked=1 ORDER BY e.published_at %4 LIMIT %2 OFFSET %3;")
-                        .arg(id).arg(limit).arg(offset).arg(ascOrder ? "ASC" : "DESC"));
+                        .arg(id).arg(limit).arg(offset).arg(ascOrder ? "ASC" : "DESC")
+                        .arg(entriesSource("liked=1")));
 
         if (!ret) {
            qWarning() << "SQL Error:" << query.lastQuery();
@@ -3129,7 +4559,7 @@ QList<DatabaseManager::Entry> DatabaseManager::readEntriesBroadcastByDashboard(c
     QList<DatabaseManager::Entry> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT e.id, e.stream_id, e.title, e.author, e.content, e.link, e.image, s.icon, s.title, e.annotations, s.id, "
                                       "e.fresh, e.fresh_or, e.read, e.saved, e.liked, e.cached, e.broadcast, e.created_at, e.published_at, e.timestamp, e.crawl_time, e.last_update "
@@ -3182,7 +4612,7 @@ QList<DatabaseManager::Entry> DatabaseManager::readEntriesUnreadByStream(const Q
     QList<DatabaseManager::Entry> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT e.id, e.stream_id, e.title, e.author, e.content, e.link, e.image, s.icon, s.title, e.annotations, s.id, "
                                       "e.fresh, e.fresh_or, e.read, e.saved, e.liked, e.cached, e.broadcast, e.created_at, e.published_at, e.timestamp, e.crawl_time, e.last_update "
@@ -3234,7 +4664,7 @@ QList<DatabaseManager::Entry> DatabaseManager::readEntriesUnreadAndSavedByStream
     QList<DatabaseManager::Entry> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT e.id, e.stream_id, e.title, e.author, e.content, e.link, e.image, s.icon, s.title, e.annotations, s.id, "
                                       "e.fresh, e.fresh_or, e.read, e.saved, e.liked, e.cached, e.broadcast, e.created_at, e.published_at, e.timestamp, e.crawl_time, e.last_update "
@@ -3286,7 +4716,7 @@ QList<DatabaseManager::Action> DatabaseManager::readActions()
     QList<DatabaseManager::Action> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec("SELECT type, id1, id2, id3, text, date1, date2, date3 FROM actions ORDER BY date2;");
 
@@ -3320,7 +4750,7 @@ QList<DatabaseManager::Entry> DatabaseManager::readEntriesCachedOlderThan(int ca
     QList<DatabaseManager::Entry> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT id, stream_id, title, author, content, link, image, "
                                       "fresh, fresh_or, read, saved, liked, cached, created_at, published_at, timestamp, crawl_time, last_update "
@@ -3367,7 +4797,7 @@ QList<QString> DatabaseManager::readCacheFinalUrlOlderThan(int cacheDate, int li
     QList<QString> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT final_url FROM cache "
                                       "WHERE entry_id IN "
@@ -3392,8 +4822,10 @@ QList<QString> DatabaseManager::readCacheFinalUrlOlderThan(int cacheDate, int li
 
 void DatabaseManager::removeCacheItems()
 {
+    HotEntries::instance()->updateCachedAll(false);
+
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec("DELETE FROM cache;");
 
@@ -3416,8 +4848,10 @@ void DatabaseManager::removeCacheItems()
 
 void DatabaseManager::removeStreamsByStream(const QString &id)
 {
+    HotEntries::instance()->invalidate();
+
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("DELETE FROM entries WHERE stream_id='%1';")
                          .arg(id));
@@ -3463,8 +4897,10 @@ void DatabaseManager::removeStreamsByStream(const QString &id)
 
 void DatabaseManager::removeTabById(const QString &id)
 {
+    HotEntries::instance()->invalidate();
+
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("DELETE FROM tabs WHERE id='%1';")
                          .arg(id));
@@ -3479,10 +4915,65 @@ void DatabaseManager::removeTabById(const QString &id)
     }
 }
 
+// Fingerprints of removed and archived entries are not needed
+void DatabaseManager::removeOrphanedFingerprints()
+{
+    if (db.isOpen()) {
+        TimedQuery query(db, __func__);
+
+        bool ret = query.exec("DELETE FROM duplicates WHERE entry_id NOT IN (SELECT id FROM main.entries);");
+
+        if (!ret) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+           return;
+        }
+
+        // Copies of removed original point to the oldest remaining copy
+        ret = query.exec("SELECT d.original_id, d.entry_id FROM duplicates AS d, main.entries AS e "
+                         "WHERE e.id=d.entry_id AND d.original_id NOT IN (SELECT entry_id FROM duplicates) "
+                         "ORDER BY e.published_at DESC;");
+
+        if (!ret) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+           return;
+        }
+
+        QHash<QString, QString> originals;
+        while(query.next()) {
+            originals.insert(query.value(0).toString(), query.value(1).toString());
+        }
+
+        if (originals.isEmpty())
+            return;
+
+        query.prepare("UPDATE duplicates SET original_id=? WHERE original_id=?;");
+
+        db.transaction();
+
+        for (auto it = originals.constBegin(); it != originals.constEnd(); ++it) {
+            query.addBindValue(it.value());
+            query.addBindValue(it.key());
+
+            if (!query.exec()) {
+               qWarning() << "SQL Error:" << query.lastQuery();
+               checkError(query.lastError());
+            }
+        }
+
+        db.commit();
+    } else {
+        qWarning() << "DB is not open";
+    }
+}
+
 void DatabaseManager::removeEntriesByFlag(int value)
 {
+    HotEntries::instance()->invalidate();
+
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("DELETE FROM cache WHERE entry_id IN "
                                       "(SELECT id FROM entries WHERE flag=%1);")
@@ -3505,10 +4996,72 @@ void DatabaseManager::removeEntriesByFlag(int value)
     }
 }
 
+// Saved and broadcast entries are kept
+void DatabaseManager::removeEntriesOlderThanByTimestamp(int date)
+{
+    HotEntries::instance()->invalidate();
+
+    if (db.isOpen()) {
+        TimedQuery query(db, __func__);
+
+        bool ret = query.exec(QString("DELETE FROM cache WHERE entry_id IN "
+                                      "(SELECT id FROM entries WHERE saved!=1 AND broadcast!=1 AND timestamp<%1);")
+                              .arg(date));
+
+        if (!ret) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+        }
+
+        ret = query.exec(QString("DELETE FROM entries WHERE saved!=1 AND broadcast!=1 AND timestamp<%1;")
+                         .arg(date));
+
+        if (!ret) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+        }
+    } else {
+        qWarning() << "DB is not open";
+    }
+}
+
+// Same as marking all entries and removing by flag, but
+// without rewriting entries that are kept
+void DatabaseManager::removeEntriesNotInIds(const QList<QString> &ids)
+{
+    HotEntries::instance()->invalidate();
+
+    if (db.isOpen()) {
+        if (!writeTempIds(ids))
+            return;
+
+        TimedQuery query(db, __func__);
+
+        bool ret = query.exec("DELETE FROM cache WHERE entry_id IN "
+                              "(SELECT id FROM entries WHERE id NOT IN (SELECT id FROM temp.temp_ids));");
+
+        if (!ret) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+        }
+
+        ret = query.exec("DELETE FROM entries WHERE id NOT IN (SELECT id FROM temp.temp_ids);");
+
+        if (!ret) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+        }
+    } else {
+        qWarning() << "DB is not open";
+    }
+}
+
 void DatabaseManager::removeEntriesByStream(const QString &id, int limit)
 {
+    HotEntries::instance()->invalidate();
+
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("DELETE FROM cache WHERE entry_id IN ("
                                       "SELECT id FROM entries WHERE stream_id='%1' AND saved!=1 AND id NOT IN ("
@@ -3539,7 +5092,7 @@ void DatabaseManager::removeEntriesByStream(const QString &id, int limit)
 void DatabaseManager::removeActionsById(const QString &id)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("DELETE FROM actions WHERE id1='%1';")
                          .arg(id));
@@ -3559,7 +5112,7 @@ void DatabaseManager::removeActionsById(const QString &id)
 void DatabaseManager::removeActionsByIdAndType(const QString &id, ActionsTypes type)
 {
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("DELETE FROM actions WHERE id1='%1' AND type=%2;")
                          .arg(id).arg(static_cast<int>(type)));
@@ -3577,14 +5130,47 @@ void DatabaseManager::removeActionsByIdAndType(const QString &id, ActionsTypes t
 }
 
 
+// Uploaded actions are removed in one transaction
+void DatabaseManager::removeActions(const QList<Action> &items)
+{
+    if (items.isEmpty())
+        return;
+
+    if (db.isOpen()) {
+        TimedQuery query(db, __func__);
+
+        query.prepare("DELETE FROM actions WHERE id1=? AND type=?");
+
+        db.transaction();
+
+        for (const auto &item : items) {
+            query.addBindValue(item.id1);
+            query.addBindValue(static_cast<int>(item.type));
+
+            if (!query.exec()) {
+               qWarning() << "SQL Error:" << query.lastQuery();
+               checkError(query.lastError());
+            }
+        }
+
+        db.commit();
+        emit syncedChanged();
+    } else {
+        qWarning() << "DB is not open";
+    }
+}
+
 QMap<QString,QString> DatabaseManager::readNotCachedEntries()
 {
     QMap<QString,QString> list;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
-        bool ret = query.exec("SELECT id, link FROM entries WHERE cached=0;");
+        // Copy is downloaded with its original
+        bool ret = query.exec("SELECT id, link FROM entries AS e WHERE cached=0 "
+                              "AND NOT EXISTS (SELECT 1 FROM duplicates AS d, entries AS o "
+                              "WHERE d.entry_id=e.id AND d.original_id!=e.id AND o.id=d.original_id);");
 
         if (!ret) {
            qWarning() << "SQL Error:" << query.lastQuery();
@@ -3607,9 +5193,11 @@ int DatabaseManager::countEntriesNotCached()
     int count = 0;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
-        bool ret = query.exec("SELECT count(*) FROM entries WHERE cached=0;");
+        bool ret = query.exec("SELECT count(*) FROM entries AS e WHERE cached=0 "
+                              "AND NOT EXISTS (SELECT 1 FROM duplicates AS d, entries AS o "
+                              "WHERE d.entry_id=e.id AND d.original_id!=e.id AND o.id=d.original_id);");
 
         if (!ret) {
            qWarning() << "SQL Error:" << query.lastQuery();
@@ -3629,31 +5217,54 @@ int DatabaseManager::countEntriesNotCached()
 
 void DatabaseManager::cleanDashboards()
 {
+    HotEntries::instance()->invalidate();
+
     createDashboardsStructure();
 }
 
 void DatabaseManager::cleanTabs()
 {
+    HotEntries::instance()->invalidate();
+
     createTabsStructure();
 }
 
 void DatabaseManager::cleanModules()
 {
+    HotEntries::instance()->invalidate();
+
     createModulesStructure();
 }
 
 void DatabaseManager::cleanStreams()
 {
+    HotEntries::instance()->invalidate();
+
     createStreamsStructure();
 }
 
 void DatabaseManager::cleanEntries()
 {
+    HotEntries::instance()->invalidate();
+
     createEntriesStructure();
+
+    if (archiveAttached) {
+        TimedQuery query(db, __func__);
+
+        bool ret = query.exec("DELETE FROM archive.entries;");
+
+        if (!ret) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+        }
+    }
 }
 
 void DatabaseManager::cleanCache()
 {
+    HotEntries::instance()->invalidate();
+
     createCacheStructure();
 }
 
@@ -3662,7 +5273,7 @@ int DatabaseManager::countEntries()
     int count = 0;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec("SELECT COUNT(*) FROM entries;");
 
@@ -3687,7 +5298,7 @@ int DatabaseManager::countStreams()
     int count = 0;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec("SELECT COUNT(*) FROM streams;");
 
@@ -3712,7 +5323,7 @@ int DatabaseManager::countTabs()
     int count = 0;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec("SELECT COUNT(*) FROM tabs;");
 
@@ -3732,12 +5343,53 @@ int DatabaseManager::countTabs()
     return count;
 }
 
+// Only ids are read and rows are not cached by query, so all entries of
+// a dashboard can be listed without loading their content
+// Ids are ordered, next page starts after the last id of previous one
+QStringList DatabaseManager::readEntryIdsByStreams(const QStringList &streamIds, bool read,
+                                                   const QString &after, int limit)
+{
+    QStringList list;
+
+    if (streamIds.isEmpty())
+        return list;
+
+    if (db.isOpen()) {
+        QStringList ids;
+        for (const auto &id : streamIds)
+            ids.append(QString("'%1'").arg(id));
+
+        TimedQuery query(db, __func__);
+        query.setForwardOnly(true);
+
+        query.prepare(QString("SELECT id FROM entries WHERE stream_id IN (%1) AND read=%2 "
+                              "AND id > ? ORDER BY id LIMIT %3;")
+                      .arg(ids.join(",")).arg(read ? 1 : 0).arg(limit));
+        query.addBindValue(after);
+
+        bool ret = query.exec();
+
+        if (!ret) {
+           qWarning() << "SQL Error:" << query.lastQuery();
+           checkError(query.lastError());
+        }
+
+        while(query.next()) {
+            list.append(query.value(0).toString());
+        }
+    } else {
+        qWarning() << "DB is not open";
+    }
+
+    return list;
+}
+
 int DatabaseManager::countEntriesByStream(const QString &id)
 {
     int count = 0;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT COUNT(*) FROM entries WHERE stream_id='%1';")
                               .arg(id));
@@ -3763,7 +5415,7 @@ int DatabaseManager::countEntriesNewerThanByStream(const QString &id, const QDat
     int count = 0;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT COUNT(*) FROM entries WHERE stream_id='%1' AND published_at>=%2;")
                               .arg(id)
@@ -3790,7 +5442,7 @@ int DatabaseManager::countEntriesUnreadByStream(const QString &id)
     int count = 0;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT COUNT(*) FROM entries WHERE stream_id='%1' AND read=0;")
                               .arg(id));
@@ -3814,13 +5466,13 @@ int DatabaseManager::countEntriesReadByDashboard(const QString &id)
     int count = 0;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT COUNT(*) FROM entries as e, streams as s, module_stream as ms, modules as m, tabs as t "
                                       "WHERE e.stream_id=s.id AND ms.stream_id=s.id AND ms.module_id=m.id AND m.tab_id=t.id "
-                                      "AND t.dashboard_id='%1' "
+                                      "AND t.dashboard_id='%1' %2"
                                       "AND e.read>0;")
-                              .arg(id));
+                              .arg(id, duplicatesFilter()));
 
         if (!ret) {
            qWarning() << "SQL Error:" << query.lastQuery();
@@ -3842,7 +5494,7 @@ int DatabaseManager::countEntriesSlowReadByDashboard(const QString &id)
     int count = 0;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT COUNT(*) FROM entries as e, streams as s, module_stream as ms, modules as m, tabs as t "
                                       "WHERE e.stream_id=s.id AND ms.stream_id=s.id AND ms.module_id=m.id AND m.tab_id=t.id "
@@ -3870,13 +5522,13 @@ int DatabaseManager::countEntriesUnreadByDashboard(const QString &id)
     int count = 0;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT COUNT(*) FROM entries as e, module_stream as ms, modules as m, tabs as t "
                                       "WHERE e.stream_id=ms.stream_id AND ms.module_id=m.id AND m.tab_id=t.id "
-                                      "AND t.dashboard_id='%1' "
+                                      "AND t.dashboard_id='%1' %2"
                                       "AND e.read=0;")
-                              .arg(id));
+                              .arg(id, duplicatesFilter()));
 
         if (!ret) {
            qWarning() << "SQL Error:" << query.lastQuery();
@@ -3898,7 +5550,7 @@ int DatabaseManager::countEntriesSlowUnreadByDashboard(const QString &id)
     int count = 0;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT count(*) FROM entries as e, streams as s, module_stream as ms, modules as m, tabs as t "
                                       "WHERE e.stream_id=ms.stream_id AND s.id=e.stream_id AND ms.module_id=m.id AND m.tab_id=t.id "
@@ -3926,7 +5578,7 @@ int DatabaseManager::countEntriesUnreadByTab(const QString &id)
     int count = 0;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT COUNT(*) FROM entries as e, module_stream as ms, modules as m "
                                       "WHERE e.stream_id=ms.stream_id AND ms.module_id=m.id "
@@ -3952,7 +5604,7 @@ int DatabaseManager::countEntriesReadByStream(const QString &id)
     int count = 0;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT COUNT(*) FROM entries WHERE stream_id='%1' AND read>0;")
                               .arg(id));
@@ -3977,7 +5629,7 @@ int DatabaseManager::countEntriesReadByTab(const QString &id)
     int count = 0;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT COUNT(*) FROM entries as e, module_stream as ms, modules as m "
                                       "WHERE e.stream_id=ms.stream_id AND ms.module_id=m.id "
@@ -4004,7 +5656,7 @@ int DatabaseManager::countEntriesFreshByStream(const QString &id)
     int count = 0;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT COUNT(*) FROM entries WHERE stream_id='%1' AND fresh=1;")
                               .arg(id));
@@ -4029,7 +5681,7 @@ int DatabaseManager::countEntriesFreshByTab(const QString &id)
     int count = 0;
 
     if (db.isOpen()) {
-        QSqlQuery query(db);
+        TimedQuery query(db, __func__);
 
         bool ret = query.exec(QString("SELECT COUNT(*) FROM entries as e, module_stream as ms, modules as m "
                                       "WHERE e.stream_id=ms.stream_id AND ms.module_id=m.id "
@@ -12,12 +12,15 @@
 #include <QDateTime>
 #include <QDir>
 #include <QFile>
+#include <QHash>
 #include <QList>
 #include <QMap>
 #include <QObject>
+#include <QSet>
 #include <QSqlDatabase>
 #include <QSqlError>
 #include <QSqlQuery>
+#include <QStringList>
 #include <QVariant>
 
 #include "settings.h"
@@ -33,6 +36,9 @@ public:
     static const int tabsLimit = 100;
     static const int streamLimit = 100;
     static const int entriesLimit = 100;
+    static const int archiveBatch = 500;
+    static const int vacuumPages = 256;
+    static const int vacuumDelay = 5000;
 
     struct StreamModuleTab {
         QString streamId;
@@ -41,6 +47,40 @@ public:
         int date = 0;
     };
 
+    // Polling state of a stream used by background refresh
+    struct Schedule {
+        QString streamId;
+        int slow = 0;
+        // Number of entries published in history window
+        int posts = 0;
+        int newestPublishedAt = 0;
+        // Stored state
+        int lastPublishedAt = 0;
+        int nextPoll = 0;
+        int idle = 0;
+        int errors = 0;
+    };
+
+    // Local state of a stream compared with aggregator before sync
+    struct Watermark {
+        int newestItemAddedAt = 0;
+        int unread = 0;
+        int newestTimestamp = 0;
+    };
+
+    // Position of paged download stored with the page it follows, so
+    // interrupted sync continues after the last stored page
+    struct Checkpoint {
+        QString job;
+        QString continuation;
+        int offset = 0;
+        int pages = 0;
+        int lastDate = 0;
+        // All pages of the job are stored
+        bool done = false;
+        int updatedAt = 0;
+    };
+
     struct Dashboard {
         QString id;
         QString name;
@@ -84,6 +124,27 @@ public:
         int lastUpdate = 0;
     };
 
+    // Subscription tree fetched from aggregator
+    struct Structure {
+        QList<Dashboard> dashboards;
+        QList<Tab> tabs;
+        QList<Module> modules;
+        // Empty if aggregator doesn't list streams with structure, their
+        // rows are written later with fetched items then
+        QList<Stream> streams;
+    };
+
+    // Number of rows written by writeStructure
+    struct StructureDiff {
+        int inserted = 0;
+        int updated = 0;
+        int removed = 0;
+        int unchanged = 0;
+        // Streams which are not in any module anymore
+        QStringList removedStreams;
+        inline bool isEmpty() const { return inserted == 0 && updated == 0 && removed == 0; }
+    };
+
     struct Entry {
         QString id;
         QString streamId;
@@ -123,6 +184,13 @@ public:
         int flag = 0;
     };
 
+    // Hashes identifying the same article delivered by different feeds
+    struct Fingerprint {
+        QString entryId;
+        QString linkHash;
+        QString contentHash;
+    };
+
     enum ActionsTypes {
         SetRead = 11,
         UnSetRead = 10,
@@ -164,6 +232,10 @@ public:
 
     bool makeBackup();
     bool restoreBackup();
+    bool compact();
+
+    bool incrementalVacuum();
+    Q_INVOKABLE double freePageRatio();
 
     bool isSynced();
 
@@ -174,12 +246,17 @@ public:
     void cleanEntries();
     void cleanCache();
 
+    void archiveEntries();
+
     void writeDashboard(const Dashboard &item);
     void writeTab(const Tab &item);
     void writeModule(const Module &item);
     void writeStreamModuleTab(const StreamModuleTab &item);
     void writeStream(const Stream &item);
+    StructureDiff writeStructure(const Structure &structure);
     void writeEntry(const Entry &item);
+    void writeEntries(const QList<Entry> &items, const Checkpoint &checkpoint = Checkpoint());
+    void writeFingerprints(const QList<Fingerprint> &items);
     void writeCache(const CacheItem &item);
     void writeAction(const Action &item);
     void updateActionByIdAndType(const QString &oldId1, ActionsTypes oldType, const QString &newId1, const QString &newId2, const QString &newId3, ActionsTypes newType);
@@ -196,13 +273,23 @@ public:
     void updateEntriesFreshFlag(int flag);
     void updateEntriesFlag(int flag);
     void updateEntriesSavedFlagByFlagAndDashboard(const QString &id, int flagOld, int flagNew);
+    void updateEntriesReadFlagByStreamAndIds(const QString &id, const QList<QString> &unreadIds);
+    void updateEntriesReadFlagByIds(const QList<QString> &unreadIds);
+    void markEntriesReadByIds(const QList<QString> &readIds);
+    void updateEntriesSavedFlagByIds(const QList<QString> &ids);
+    void updateEntriesBroadcastFlagByIds(const QList<QString> &ids);
+    void updateEntriesLikedFlagByIds(const QList<QString> &ids);
 
     void updateStreamSlowFlagById(const QString &id, int flag);
+    void updateStreamUnreadById(const QString &id, int unread);
+    void updateStreamUpdateAtById(const QString &id, int updateAt);
 
     bool isDashboardExists();
     bool isCacheExists(const QString &id);
     bool isCacheExistsByFinalUrl(const QString &id);
+    QSet<QString> readCacheFinalUrls(const QStringList &ids);
     bool isCacheExistsByEntryId(const QString &id);
+    QSet<QString> readCachedEntryIds(const QList<QString> &ids);
 
     Dashboard readDashboard(const QString &id);
     QList<Action> readActions();
@@ -210,9 +297,17 @@ public:
     QList<Tab> readTabsByDashboard(const QString &id);
     QList<Stream> readStreamsByTab(const QString &id);
     QList<QString> readStreamIdsByTab(const QString &id);
+    QList<Schedule> readSchedules(int since);
+    QMap<QString,Watermark> readStreamWatermarks();
+    void writeSchedules(const QList<Schedule> &items);
+    QList<Checkpoint> readCheckpoints(const QString &prefix);
+    void removeCheckpoints(const QString &prefix);
     QList<Stream> readStreamsByDashboard(const QString &id);
+    QList<Stream> readStreamTitlesByDashboard(const QString &id);
     QList<QString> readTabIdsByDashboard(const QString &id);
     QList<QString> readStreamIds();
+    QMap<QString,int> readMaxEntryIdsByStream();
+    QList<QString> readMissingEntryIds(const QList<QString> &ids);
     QString readStreamIdByEntry(const QString &id);
     QList<QString> readModuleIdByStream(const QString &id);
     QMap<QString,QString> readStreamIdsTabIds();
@@ -240,6 +335,8 @@ public:
     QList<Entry> readEntriesLikedByDashboard(const QString &id, int offset, int limit, bool ascOrder = false);
     QList<Entry> readEntriesBroadcastByDashboard(const QString &id, int offset, int limit, bool ascOrder = false);
     QList<Entry> readEntriesByStream(const QString &id, int offset, int limit, bool ascOrder = false);
+    QStringList readEntryIdsByStreams(const QStringList &streamIds, bool read,
+                                      const QString &after, int limit);
     QList<Entry> readEntriesUnreadByStream(const QString &id, int offset, int limit, bool ascOrder = false);
     QList<Entry> readEntriesUnreadAndSavedByStream(const QString &id, int offset, int limit, bool ascOrder = false);
     QList<Entry> readEntriesByTab(const QString &id, int offset, int limit, bool ascOrder = false);
@@ -284,10 +381,14 @@ public:
     void removeStreamsByStream(const QString &id);
     //void removeEntriesOlderThan(int cacheDate, int limit);
     //void removeEntriesOlderThanByCrawlTime(int cacheDate);
+    void removeEntriesOlderThanByTimestamp(int date);
+    void removeEntriesNotInIds(const QList<QString> &ids);
     void removeEntriesByStream(const QString &id, int limit);
     void removeEntriesByFlag(int value);
+    void removeOrphanedFingerprints();
     void removeActionsById(const QString &id);
     void removeActionsByIdAndType(const QString &id, ActionsTypes type);
+    void removeActions(const QList<Action> &items);
     //void removeEntriesBySavedFlag(int flag);
     void removeCacheItems();
 
@@ -326,15 +427,26 @@ private:
     QSqlDatabase db;
     QString dbFilePath;
     QString backupFilePath;
+    QString archiveFilePath;
+    bool archiveAttached = false;
 
     void checkError(const QSqlError &error);
 
     bool openDB();
+    bool attachArchive();
+    void initBackupFilePath();
+    bool checkAutoVacuum();
+    bool sqliteVersionAtLeast(int major, int minor);
+    QString entriesSource(const QString &filter) const;
+    QString duplicatesFilter() const;
+    void updateEntriesFlagByIds(const QString &column, const QList<QString> &ids);
+    QHash<QString, QByteArray> readRowHashes(const QString &sql);
+    bool writeTempIds(const QList<QString> &ids);
     bool createDB();
     //bool alterDB_19to22();
     //bool alterDB_20to22();
     //bool alterDB_21to22();
-    bool deleteDB();
+    bool deleteDB(bool withArchive = true);
 
     bool createStructure();
     bool createDashboardsStructure();
@@ -342,6 +454,9 @@ private:
     bool createModulesStructure();
     bool createStreamsStructure();
     bool createEntriesStructure();
+    bool createDuplicatesStructure();
+    bool createScheduleStructure();
+    bool createCheckpointsStructure();
     bool createCacheStructure();
     bool createActionsStructure();
     bool checkParameters();
@@ -47,9 +47,7 @@ DownloadManager::DownloadManager(QObject *parent) : QObject{parent} {
             &DownloadManager::cacheRemoverProgressChanged);
     connect(&m_ncm, &QNetworkConfigurationManager::onlineStateChanged, this,
             &DownloadManager::onlineStateChanged);
-    connect(&m_manager, &QNetworkAccessManager::finished, this,
-            &DownloadManager::downloadFinished);
-    connect(&m_manager, &QNetworkAccessManager::networkAccessibleChanged, this,
+    connect(m_manager, &QNetworkAccessManager::networkAccessibleChanged, this,
             &DownloadManager::networkAccessibleChanged);
 }
 
@@ -147,10 +145,15 @@ void DownloadManager::doDownload(DatabaseManager::CacheItem &&item) {
     request.setHeader(QNetworkRequest::UserAgentHeader,
                       Settings::instance()->getDmUserAgent());
     request.setRawHeader("Accept", "*/*");
-    auto *reply = m_manager.get(request);
+    // Pages and images may depend on cookies set by previous downloads
+    NetworkManager::useCookieJar(request);
+    auto *reply = m_manager->get(request);
     m_replyToCheckerMap.insert(reply, new Checker{reply});
     m_replyToCachedItemMap.insert(reply, item);
 
+    // Manager also finishes fetcher replies, so only own reply is handled
+    connect(reply, &QNetworkReply::finished, this,
+            [this, reply] { downloadFinished(reply); });
     connect(reply, &QNetworkReply::sslErrors, this,
             &DownloadManager::sslErrors);
     connect(reply,
@@ -20,6 +20,7 @@
 #include <QUrl>
 
 #include "databasemanager.h"
+#include "networkmanager.h"
 #include "settings.h"
 
 class QSslError;
@@ -166,7 +167,8 @@ class DownloadManager : public QObject {
     static const int maxCacheRetency = 604800;  // 1 week
     static const int minImageSize = 2000;
 
-    QNetworkAccessManager m_manager;
+    // Shared with fetchers
+    NetworkManager *m_manager = NetworkManager::instance();
     QList<DatabaseManager::CacheItem> m_queue;
     QList<QNetworkReply *> m_downloads;
     QMap<QNetworkReply *, DatabaseManager::CacheItem> m_replyToCachedItemMap;
@@ -12,11 +12,9 @@
 #include <QDebug>
 #include <QList>
 #include <QModelIndex>
-#include <QRegExp>
-#include <QUrl>
-#include <QtGui/QTextDocument>
 
 #include "databasemanager.h"
+#include "hotentries.h"
 #include "utils.h"
 
 EntryModelIniter::EntryModelIniter(QObject *parent) : QThread{parent} {}
@@ -48,6 +46,11 @@ EntryModel::EntryModel(QObject *parent)
     connect(&m_initer, SIGNAL(finished()), this, SLOT(initFinished()));
     connect(Settings::instance(), SIGNAL(showOldestFirstChanged()), this,
             SLOT(init()));
+    connect(Settings::instance(), &Settings::collapseDuplicatesChanged, this,
+            [this] {
+                HotEntries::instance()->invalidate();
+                initInThread();
+            });
 }
 
 void EntryModel::init(const QString &feedId) {
@@ -87,31 +90,13 @@ int EntryModel::getDateRowId(int date) {
     return 10;
 }
 
-int EntryModel::createItems(int offset, int limit) {
+QList<DatabaseManager::Entry> EntryModel::readEntries(int offset, int limit,
+                                                      bool ascOrder) const {
     auto *s = Settings::instance();
     auto *db = DatabaseManager::instance();
 
     QList<DatabaseManager::Entry> list;
 
-    bool ascOrder = s->getShowOldestFirst();
-
-    // Counting 'last' & 'daterow' rows
-    if (offset > 0) {
-        int dummyRowsCount = 0;
-        int l = this->rowCount();
-        // qDebug() << "this->rowCount():" << l;
-        for (int i = 0; i < l; ++i) {
-            EntryItem *item = dynamic_cast<EntryItem *>(readRow(i));
-            // qDebug() << item->id();
-            if (item->id() == "last" || item->id() == "daterow") {
-                ++dummyRowsCount;
-            }
-        }
-        // qDebug() << "dummyRowsCount:" << dummyRowsCount << "orig offset:" <<
-        // offset;
-        if (offset > dummyRowsCount) offset = offset - dummyRowsCount;
-    }
-
     auto mode = s->getViewMode();
     switch (mode) {
         case Settings::ViewMode::TabsFeedsEntries:
@@ -182,8 +167,72 @@ int EntryModel::createItems(int offset, int limit) {
             break;
     }
 
+    return list;
+}
+
+int EntryModel::createItems(int offset, int limit) {
+    auto *s = Settings::instance();
+    auto *db = DatabaseManager::instance();
+
+    QList<HotEntries::Item> items;
+
+    bool ascOrder = s->getShowOldestFirst();
+
+    // Counting 'last' & 'daterow' rows
+    if (offset > 0) {
+        int dummyRowsCount = 0;
+        int l = this->rowCount();
+        // qDebug() << "this->rowCount():" << l;
+        for (int i = 0; i < l; ++i) {
+            EntryItem *item = dynamic_cast<EntryItem *>(readRow(i));
+            // qDebug() << item->id();
+            if (item->id() == "last" || item->id() == "daterow") {
+                ++dummyRowsCount;
+            }
+        }
+        // qDebug() << "dummyRowsCount:" << dummyRowsCount << "orig offset:" <<
+        // offset;
+        if (offset > dummyRowsCount) offset = offset - dummyRowsCount;
+    }
+
+    auto mode = s->getViewMode();
+
+    // First pages of dashboard, tab and feed views are served from memory
+    bool hot = false;
+    if (mode == Settings::ViewMode::TabsFeedsEntries ||
+        mode == Settings::ViewMode::TabsEntries ||
+        mode == Settings::ViewMode::FeedsEntries ||
+        mode == Settings::ViewMode::AllEntries) {
+        auto *hotEntries = HotEntries::instance();
+        auto scope = mode == Settings::ViewMode::AllEntries
+                         ? HotEntries::Scope::Dashboard
+                         : mode == Settings::ViewMode::TabsEntries
+                               ? HotEntries::Scope::Tab
+                               : HotEntries::Scope::Stream;
+        hot = hotEntries->read(s->getDashboardInUse(), scope, m_feedId,
+                               s->getFilter(), offset, limit, ascOrder,
+                               &items);
+        if (!hot && offset == 0 && !ascOrder) {
+            hotEntries->rebuild(s->getDashboardInUse());
+            hot = hotEntries->read(s->getDashboardInUse(), scope, m_feedId,
+                                   s->getFilter(), offset, limit, ascOrder,
+                                   &items);
+        }
+    }
+
+    if (!hot) {
+        auto list = readEntries(offset, limit, ascOrder);
+
+        QList<QString> ids;
+        for (const auto &entry : list) ids.append(entry.id);
+        auto cached = db->readCachedEntryIds(ids);
+
+        for (const auto &entry : list)
+            items.append(HotEntries::makeItem(entry, cached.contains(entry.id)));
+    }
+
     // Remove dummy row
-    if (list.count() > 0) {
+    if (items.count() > 0) {
         int l = rowCount();
         if (l > 0) {
             EntryItem *item = qobject_cast<EntryItem *>(readRow(l - 1));
@@ -191,8 +240,6 @@ int EntryModel::createItems(int offset, int limit) {
         }
     }
 
-    QList<DatabaseManager::Entry>::iterator i = list.begin();
-
     int prevDateRow = 0;
     if (rowCount() > 0) {
         EntryItem *item = dynamic_cast<EntryItem *>(readRow(rowCount() - 1));
@@ -200,106 +247,63 @@ int EntryModel::createItems(int offset, int limit) {
         // qDebug() << "prevDateRow UID:" << item->uid();
     }
 
-    QRegExp re("<[^>]*>");
-    while (i != list.end()) {
-        // Removing html tags!
-        QTextDocument doc;
-        doc.setHtml((*i).content);
-
-        QString content0 =
-            doc.toPlainText()
-                .replace(QChar::ObjectReplacementCharacter, QChar::Space)
-                .trimmed();
-        QString content = content0.simplified();
-        if (content.length() > 1000) {
-            content = content.left(997) + "...";
-        } else if (content.length() < 15) {
-            content.clear();
-        }
-
-        doc.setHtml((*i).title);
-        QString title =
-            doc.toPlainText()
-                .replace(QChar::ObjectReplacementCharacter, QChar::Space)
-                .simplified();
-        if (title.length() > 200) title = title.left(197) + QString("...");
-
-        // qDebug() << title;
-
-        /*QRegExp rx("(\\S*)\\s*\((\\S*)\)", Qt::CaseInsensitive);
-        if (rx.indexIn((*i).author)!=-1) {
-            qDebug() << "(*i).author:" << (*i).author << "cap:" <<
-        rx.cap(1).toUtf8();
-            //(*i).author = rx.cap(1).toUtf8();
-        }*/
-
-        // Detecting invalid images
-        bool imageOk = true;
-        QUrl imageUrl((*i).image);
-        // qDebug() << imageUrl.path();
-        if (imageUrl.path() == "/assets/images/transparent.png")
-            imageOk = false;
-        if (imageUrl.host() == "rc.feedsportal.com") imageOk = false;
-
+    for (auto i = items.cbegin(); i != items.cend(); ++i) {
         // Adding date row
-        int dateRow = getDateRowId((*i).publishedAt);
+        int dateRow = getDateRowId(i->date);
         if ((!ascOrder && dateRow > prevDateRow) ||
             (ascOrder && dateRow < prevDateRow) || prevDateRow == 0) {
             switch (dateRow) {
                 case 1:
                     appendRow(new EntryItem("daterow", tr("Today"), "", "", "",
-                                            "", "", "", "", "", "", "", false,
-                                            false, false, 0, 0, 0, 0));
+                                            "", "", "", "", "", false, false,
+                                            false, 0, 0, 0, 0));
                     break;
                 case 2:
                     appendRow(new EntryItem("daterow", tr("Yesterday"), "", "",
-                                            "", "", "", "", "", "", "", "",
-                                            false, false, false, 0, 0, 0, 0));
+                                            "", "", "", "", "", "", false,
+                                            false, false, 0, 0, 0, 0));
                     break;
                 case 3:
                     appendRow(new EntryItem("daterow", tr("Current week"), "",
-                                            "", "", "", "", "", "", "", "", "",
-                                            false, false, false, 0, 0, 0, 0));
+                                            "", "", "", "", "", "", "", false,
+                                            false, false, 0, 0, 0, 0));
                     break;
                 case 4:
                     appendRow(new EntryItem("daterow", tr("Current month"), "",
-                                            "", "", "", "", "", "", "", "", "",
-                                            false, false, false, 0, 0, 0, 0));
+                                            "", "", "", "", "", "", "", false,
+                                            false, false, 0, 0, 0, 0));
                     break;
                 case 5:
                     appendRow(new EntryItem("daterow", tr("Previous month"), "",
-                                            "", "", "", "", "", "", "", "", "",
-                                            false, false, false, 0, 0, 0, 0));
+                                            "", "", "", "", "", "", "", false,
+                                            false, false, 0, 0, 0, 0));
                     break;
                 case 6:
                     appendRow(new EntryItem("daterow", tr("Current year"), "",
-                                            "", "", "", "", "", "", "", "", "",
-                                            false, false, false, 0, 0, 0, 0));
+                                            "", "", "", "", "", "", "", false,
+                                            false, false, 0, 0, 0, 0));
                     break;
                 default:
                     appendRow(new EntryItem("daterow",
                                             tr("Previous year & older"), "", "",
-                                            "", "", "", "", "", "", "", "",
-                                            false, false, false, 0, 0, 0, 0));
+                                            "", "", "", "", "", "", false,
+                                            false, false, 0, 0, 0, 0));
                     break;
             }
         }
         prevDateRow = dateRow;
         appendRow(new EntryItem{
-            i->id, title.remove(re), i->author, content, content0, i->content,
-            i->link, imageOk ? i->image : "", i->feedId, i->feedIcon,
-            i->feedTitle.remove(re), i->annotations,
-            db->isCacheExistsByEntryId(i->id), i->broadcast == 1, i->liked == 1,
-            i->fresh == 1, i->read, i->saved, i->publishedAt});
-        ++i;
+            i->id, i->title, i->author, i->content, i->link, i->image,
+            i->streamId, i->feedIcon, i->feedTitle, i->annotations, i->cached,
+            i->broadcast, i->liked, i->fresh, i->read, i->saved, i->date});
     }
 
     // Dummy row as workaround!
-    if (!list.isEmpty())
-        appendRow(new EntryItem("last", "", "", "", "", "", "", "", "", "", "",
-                                "", false, false, false, 0, 0, 0, 0));
+    if (!items.isEmpty())
+        appendRow(new EntryItem("last", "", "", "", "", "", "", "", "", "",
+                                false, false, false, 0, 0, 0, 0));
 
-    return list.count();
+    return items.count();
 }
 
 void EntryModel::setAllAsUnread() {
@@ -523,6 +527,14 @@ int EntryModel::countUnread() {
 
 int EntryModel::count() const { return this->rowCount(); }
 
+QString EntryModel::readContent(const QString &id) const {
+    return DatabaseManager::instance()->readEntryContentById(id);
+}
+
+QString EntryModel::readContentText(const QString &id) const {
+    return HotEntries::plainText(readContent(id));
+}
+
 void EntryModel::setData(int row, const QString &fieldName,
                          const QVariant &newValue, const QVariant &newValue2) {
     auto db = DatabaseManager::instance();
@@ -611,7 +623,6 @@ void EntryModel::setData(int row, const QString &fieldName,
 
 EntryItem::EntryItem(const QString &uid, const QString &title,
                      const QString &author, const QString &content,
-                     const QString &contentall, const QString &contentraw,
                      const QString &link, const QString &image,
                      const QString &feedId, const QString &feedIcon,
                      const QString &feedTitle, const QString &annotations,
@@ -622,8 +633,6 @@ EntryItem::EntryItem(const QString &uid, const QString &title,
       m_title(title),
       m_author(author),
       m_content(content),
-      m_contentall(contentall),
-      m_contentraw(contentraw),
       m_link(link),
       m_image(image),
       m_feedId(feedId),
@@ -644,8 +653,6 @@ QHash<int, QByteArray> EntryItem::roleNames() const {
     names[TitleRole] = "title";
     names[AuthorRole] = "author";
     names[ContentRole] = "content";
-    names[ContentAllRole] = "contentall";
-    names[ContentRawRole] = "contentraw";
     names[LinkRole] = "link";
     names[ImageRole] = "image";
     names[FeedIdRole] = "feedId";
@@ -672,10 +679,6 @@ QVariant EntryItem::data(int role) const {
             return author();
         case ContentRole:
             return content();
-        case ContentAllRole:
-            return contentall();
-        case ContentRawRole:
-            return contentraw();
         case LinkRole:
             return link();
         case ImageRole:
@@ -15,6 +15,7 @@
 #include <QThread>
 #include <QVariant>
 
+#include "databasemanager.h"
 #include "feedmodel.h"
 #include "listmodel.h"
 
@@ -43,8 +44,6 @@ class EntryItem : public ListItem {
         TitleRole = Qt::DisplayRole,
         AuthorRole,
         ContentRole,
-        ContentAllRole,
-        ContentRawRole,
         LinkRole,
         ImageRole,
         FeedIdRole,
@@ -64,7 +63,6 @@ class EntryItem : public ListItem {
     EntryItem(QObject *parent = nullptr) : ListItem(parent) {}
     explicit EntryItem(const QString &uid, const QString &title,
                        const QString &author, const QString &content,
-                       const QString &contentall, const QString &contentraw,
                        const QString &link, const QString &image,
                        const QString &feedId, const QString &feedIcon,
                        const QString &feedTitle, const QString &annotations,
@@ -78,8 +76,6 @@ class EntryItem : public ListItem {
     inline QString title() const { return m_title; }
     inline QString author() const { return m_author; }
     inline QString content() const { return m_content; }
-    inline QString contentall() const { return m_contentall; }
-    inline QString contentraw() const { return m_contentraw; }
     inline QString link() const { return m_link; }
     inline QString image() const { return m_image; }
     inline QString feedId() const { return m_feedId; }
@@ -105,8 +101,6 @@ class EntryItem : public ListItem {
     QString m_title;
     QString m_author;
     QString m_content;
-    QString m_contentall;
-    QString m_contentraw;
     QString m_link;
     QString m_image;
     QString m_feedId;
@@ -146,6 +140,9 @@ class EntryModel : public ListModel {
 
     Q_INVOKABLE int createItems(int offset, int limit);
     Q_INVOKABLE int count() const;
+    // Body is not held in items, it is read when entry is opened
+    Q_INVOKABLE QString readContent(const QString &id) const;
+    Q_INVOKABLE QString readContentText(const QString &id) const;
     // Q_INVOKABLE int fixIndex(const QString &id);
 
    public slots:
@@ -163,6 +160,8 @@ class EntryModel : public ListModel {
     EntryModelIniter m_initer;
 
     static int getDateRowId(int date);
+    QList<DatabaseManager::Entry> readEntries(int offset, int limit,
+                                              bool ascOrder) const;
 };
 
 #endif  // ENTRYMODEL_H
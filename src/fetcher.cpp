@@ -20,6 +20,8 @@
 #include <QNetworkRequest>
 #include <QDateTime>
 #include <QByteArray>
+#include <QMutexLocker>
+#include <QMetaEnum>
 #if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
 #include <QJsonDocument>
 #include <QJsonValue>
@@ -42,31 +44,58 @@
 #include "cacheserver.h"
 #include "utils.h"
 
-FetcherCookieJar::FetcherCookieJar(QObject *parent) :
-    QNetworkCookieJar(parent)
-{}
-
-bool FetcherCookieJar::setCookiesFromUrl(const QList<QNetworkCookie> & cookieList, const QUrl & url)
-{
-    Q_UNUSED(cookieList)
-    Q_UNUSED(url)
-    return false;
-}
-
 Fetcher::Fetcher(QObject *parent) :
     QThread(parent),
+    nam(*NetworkManager::instance()),
     currentReply(NULL),
     busyType(Fetcher::UnknownBusyType),
     busy(false)
 {
     auto dm = DownloadManager::instance();
 
-    nam.setCookieJar(new FetcherCookieJar(this));
+    // Accept-Encoding is not set manually, so QNAM negotiates supported
+    // encodings (gzip, deflate and brotli if available) and inflates
+    // replies while they are downloaded
     connect(&nam, SIGNAL(networkAccessibleChanged(QNetworkAccessManager::NetworkAccessibility)),
             this, SLOT(networkAccessibleChanged(QNetworkAccessManager::NetworkAccessibility)));
     connect(this, SIGNAL(addDownload(DatabaseManager::CacheItem)),
             dm, SLOT(addDownload(DatabaseManager::CacheItem)));
     connect(this, SIGNAL(busyChanged()), dm, SLOT(startDownload()));
+
+    ingest.setDownloadHandler([this](const DatabaseManager::CacheItem &item) {
+        emit addDownload(item);
+    });
+
+    auto s = Settings::instance();
+    connect(&scheduler, &SyncScheduler::due, this, &Fetcher::refresh);
+    connect(s, &Settings::backgroundSyncChanged, this, [this, s] {
+        scheduler.setEnabled(s->getBackgroundSync());
+    });
+    scheduler.setEnabled(s->getBackgroundSync());
+
+    // Aggregator connection is opened at startup and before scheduled sync
+    connect(&scheduler, &SyncScheduler::dueSoon, this, &Fetcher::prewarm);
+    QTimer::singleShot(0, this, &Fetcher::prewarm);
+
+    retryTimer.setSingleShot(true);
+    connect(&retryTimer, &QTimer::timeout, this, [this] {
+        if (busy && retryCall)
+            retryCall();
+    });
+
+    // Store jobs run in worker thread, started() is emitted there
+    connect(this, &QThread::started, this, [this] {
+        jobTimer.start();
+        jobWritten = ingest.counters().written;
+    }, Qt::DirectConnection);
+
+    auto stats = SyncStats::instance();
+    connect(this, &Fetcher::error, stats, [stats](int code) {
+        stats->setResult(QString("error %1").arg(code));
+    });
+    connect(this, &Fetcher::canceled, stats, [stats] {
+        stats->setResult("canceled");
+    });
 }
 
 Fetcher::~Fetcher()
@@ -83,6 +112,11 @@ bool Fetcher::isBusy()
     return busy;
 }
 
+bool Fetcher::isStructureChanged()
+{
+    return structureChanged;
+}
+
 Fetcher::BusyType Fetcher::readBusyType()
 {
     return busyType;
@@ -90,11 +124,38 @@ Fetcher::BusyType Fetcher::readBusyType()
 
 void Fetcher::setBusy(bool busy, Fetcher::BusyType type)
 {
+    if (busy && !this->busy) {
+        ingest.begin(isImageCaching());
+        structureChanged = type != Fetcher::Refreshing;
+        checkpointed = false;
+    }
+
+    // Waiting for network is not part of sync
+    auto stats = SyncStats::instance();
+    bool waiting = type == Fetcher::InitiatingWaiting || type == Fetcher::UpdatingWaiting ||
+            type == Fetcher::CheckingCredentialsWaiting || type == Fetcher::GettingAuthUrlWaiting;
+    if (busy && !waiting && (!this->busy || this->busyType >= Fetcher::InitiatingWaiting))
+        stats->begin(QMetaEnum::fromType<Fetcher::BusyType>().valueToKey(type));
+
+    // Refresh has not reached taskEnd
+    if (!busy && this->busyType == Fetcher::Refreshing && !refreshStreams.isEmpty()) {
+        scheduler.polled(refreshStreams, true);
+        refreshStreams.clear();
+    }
+
     this->busyType = type;
     this->busy = busy;
 
-    if (!busy)
+    if (!busy) {
+        retryTimer.stop();
+        retries = 0;
+        stats->setIngest(ingest.report());
+        stats->end();
         this->busyType = Fetcher::UnknownBusyType;
+        pendingValidators.clear();
+        QMutexLocker locker(&pagesMutex);
+        queuedPages.clear();
+    }
 
     emit busyChanged();
 }
@@ -157,6 +218,64 @@ bool Fetcher::update()
     return true;
 }
 
+// Only due streams are fetched, structure and other streams are kept
+bool Fetcher::refresh()
+{
+    auto s = Settings::instance();
+
+    if (busy || !s->getSignedIn() || s->getOfflineMode()) {
+        scheduler.retry();
+        return false;
+    }
+
+#ifdef ONLINE_CHECK
+    if (!ncm.isOnline()) {
+        scheduler.retry();
+        return false;
+    }
+#endif
+
+    refreshStreams = scheduler.dueStreams();
+    if (refreshStreams.isEmpty()) {
+        scheduler.arm();
+        return false;
+    }
+
+    qDebug() << "Refreshing streams:" << refreshStreams.size();
+
+    setBusy(true, Fetcher::Refreshing);
+    emit progress(0,100);
+    signIn();
+    return true;
+}
+
+void Fetcher::prewarm()
+{
+    auto s = Settings::instance();
+    if (busy || !s->getSignedIn() || s->getOfflineMode())
+        return;
+
+    nam.prewarm(serviceUrl());
+}
+
+bool Fetcher::compactDB()
+{
+    if (busy) {
+        qWarning() << "Fetcher is busy, DB will not be compacted";
+        return false;
+    }
+
+    return DatabaseManager::instance()->compact();
+}
+
+void Fetcher::scheduleVacuum()
+{
+    QTimer::singleShot(DatabaseManager::vacuumDelay, this, [this] {
+        if (!busy && DatabaseManager::instance()->incrementalVacuum())
+            scheduleVacuum();
+    });
+}
+
 void Fetcher::cancel()
 {
     if (busyType == Fetcher::UpdatingWaiting ||
@@ -165,19 +284,150 @@ void Fetcher::cancel()
         setBusy(false);
     } else {
 
-        // Restoring backup
+        // Restoring backup, refresh doesn't make it. Stored pages are
+        // kept only when this sync has reached paged download and can be
+        // resumed from its checkpoints.
         auto db = DatabaseManager::instance();
-        if (!db->restoreBackup()) {
+        bool resumable = checkpointed && !resumeCheckpoints(QString()).isEmpty();
+        if (busyType != Fetcher::Refreshing && !resumable && !db->restoreBackup()) {
             qWarning() << "Unable to restore DB backup";
         }
 
-        if (currentReply != NULL)
-            currentReply->close();
-        else
+        if (!abortRequests())
             setBusy(false);
     }
 }
 
+void Fetcher::setConditional(QNetworkRequest &request)
+{
+    // After init DB is empty, so everything has to be downloaded
+    if (busyType == Fetcher::Initiating)
+        return;
+
+    QStringList validators = Settings::instance()->getHttpValidators()
+            .value(request.url().toString()).toStringList();
+    if (validators.size() != 2)
+        return;
+
+    if (!validators.at(0).isEmpty())
+        request.setRawHeader("If-None-Match", validators.at(0).toLatin1());
+    if (!validators.at(1).isEmpty())
+        request.setRawHeader("If-Modified-Since", validators.at(1).toLatin1());
+}
+
+// Returns true on 304, otherwise validators of reply are remembered
+bool Fetcher::isNotModified(QNetworkReply *reply)
+{
+    QString url = reply->request().url().toString();
+    int code = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+    if (code == 304) {
+        qDebug() << "Not modified:" << url;
+        return true;
+    }
+
+    if (code >= 200 && code < 300) {
+        if (reply->rawHeader("Content-Encoding").isEmpty())
+            qDebug() << "Reply is not compressed:" << url;
+
+        QByteArray etag = reply->rawHeader("ETag");
+        QByteArray lastModified = reply->rawHeader("Last-Modified");
+        if (!etag.isEmpty() || !lastModified.isEmpty())
+            pendingValidators.insert(url, QStringList{QString::fromLatin1(etag),
+                                                      QString::fromLatin1(lastModified)});
+    }
+
+    return false;
+}
+
+QList<DatabaseManager::Checkpoint> Fetcher::resumeCheckpoints(const QString &prefix)
+{
+    auto db = DatabaseManager::instance();
+    auto checkpoints = db->readCheckpoints(prefix);
+
+    int minDate = QDateTime::currentDateTimeUtc().toTime_t() - checkpointMaxAge;
+    for (const auto &checkpoint : checkpoints) {
+        if (checkpoint.updatedAt < minDate) {
+            qDebug() << "Checkpoints are too old:" << checkpoint.job;
+            db->removeCheckpoints(prefix);
+            return QList<DatabaseManager::Checkpoint>();
+        }
+    }
+
+    return checkpoints;
+}
+
+bool Fetcher::isTransientError(QNetworkReply *reply)
+{
+    switch (reply->error()) {
+    case QNetworkReply::RemoteHostClosedError:
+    case QNetworkReply::TimeoutError:
+    case QNetworkReply::TemporaryNetworkFailureError:
+    case QNetworkReply::NetworkSessionFailedError:
+    case QNetworkReply::ProxyTimeoutError:
+    case QNetworkReply::UnknownNetworkError:
+        return true;
+    default:
+        break;
+    }
+
+    int code = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    return code == 429 || code == 502 || code == 503 || code == 504;
+}
+
+bool Fetcher::retryTransient(QNetworkReply *reply, std::function<void()> resend)
+{
+    if (!busy || retries >= maxRetries || !isTransientError(reply))
+        return false;
+
+    int delay = retryDelay << retries;
+    ++retries;
+
+    qWarning() << "Transient network error:" << reply->error()
+               << "retry" << retries << "in" << delay << "ms";
+
+    retryCall = resend;
+    retryTimer.start(delay);
+    return true;
+}
+
+bool Fetcher::isImageCaching()
+{
+    auto s = Settings::instance();
+    return s->getCachingMode() == 2 ||
+            (s->getCachingMode() == 1 && DownloadManager::instance()->isWLANConnected());
+}
+
+// Returns false if there was no request to abort
+bool Fetcher::abortRequests()
+{
+    // Waiting for retry, there is no request to abort
+    if (retryTimer.isActive()) {
+        retryTimer.stop();
+        emit canceled();
+        return false;
+    }
+
+    if (!actionReplies.isEmpty()) {
+        auto replies = actionReplies.keys();
+        actionReplies.clear();
+        actionGroups.clear();
+        for (auto reply : replies) {
+            reply->disconnect(this);
+            reply->abort();
+            reply->deleteLater();
+        }
+        emit canceled();
+        return false;
+    }
+
+    if (currentReply == NULL)
+        return false;
+
+    currentReply->close();
+    return true;
+}
+
 bool Fetcher::checkCredentials()
 {
     if (busy) {
@@ -203,7 +453,10 @@ void Fetcher::readyRead()
     int statusCode = currentReply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
     //qDebug() << "readyRead, statusCode=" << statusCode;
     if (statusCode >= 200 && statusCode < 300) {
-        data += currentReply->readAll();
+        if (decoder && decoderReply == currentReply)
+            feedDecoder(decoder.get(), currentReply->readAll());
+        else
+            data += currentReply->readAll();
     }
 }
 
@@ -276,10 +529,89 @@ void Fetcher::networkError(QNetworkReply::NetworkError e)
     }
 }
 
+void Fetcher::startDecoding(const JsonEntryDecoder::Table &table)
+{
+    decodedEntries.clear();
+    decoderReply = currentReply;
+    decoder.reset(new JsonEntryDecoder(table));
+    decoder->setBatchHandler([this](const QList<DatabaseManager::Entry> &batch) {
+        decodedEntries.append(batch);
+    });
+}
+
+void Fetcher::queuePage(const QList<DatabaseManager::Entry> &entries,
+                        const DatabaseManager::Checkpoint &checkpoint)
+{
+    // Page has been downloaded, next error starts backoff from beginning
+    retries = 0;
+
+    if (!checkpoint.job.isEmpty())
+        checkpointed = true;
+
+    QMutexLocker locker(&pagesMutex);
+    queuedPages.append(Page{entries, checkpoint});
+}
+
+bool Fetcher::takePage(QList<DatabaseManager::Entry> *entries, DatabaseManager::Checkpoint *checkpoint)
+{
+    QMutexLocker locker(&pagesMutex);
+    if (queuedPages.isEmpty())
+        return false;
+    Page page = queuedPages.takeFirst();
+    *entries = page.entries;
+    *checkpoint = page.checkpoint;
+    return true;
+}
+
+int Fetcher::queuedPagesCount()
+{
+    QMutexLocker locker(&pagesMutex);
+    return queuedPages.size();
+}
+
+// Request waiting for retry is still being downloaded
+bool Fetcher::isDownloading()
+{
+    return retryTimer.isActive() || (currentReply != NULL && currentReply->isRunning());
+}
+
+bool Fetcher::feedDecoder(JsonEntryDecoder *decoder, const QByteArray &chunk)
+{
+    QElapsedTimer timer;
+    timer.start();
+    bool ok = decoder->feed(chunk);
+    SyncStats::instance()->addParse(chunk.size(), timer.nsecsElapsed());
+    return ok;
+}
+
 bool Fetcher::parse()
 {
-    //qint64 date1 = QDateTime::currentMSecsSinceEpoch();
+    QElapsedTimer timer;
+    timer.start();
+    bool ok = parseData();
+    // Decoded replies were counted chunk by chunk, data is empty then
+    SyncStats::instance()->addParse(data.size(), timer.nsecsElapsed());
+    return ok;
+}
+
+bool Fetcher::parseData()
+{
     //qDebug() << "parse:" << data;
+
+    // Reply was already decoded in chunks, only captured values are left
+    if (decoder && decoderReply == currentReply) {
+        bool ok = decoder->finish();
+        if (ok) {
+#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
+            jsonObj = QJsonObject::fromVariantMap(decoder->captured());
+#else
+            jsonObj = decoder->captured();
+#endif
+        }
+        decoder.reset();
+        return ok;
+    }
+    decoder.reset();
 #if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
     QJsonDocument doc = QJsonDocument::fromJson(data);
 
@@ -311,7 +643,6 @@ bool Fetcher::parse()
         return true;
     }
 #endif
-    //qDebug() << "parse time:" << (QDateTime::currentMSecsSinceEpoch() - date1);
     qWarning() << "Json doc is empty";
     return false;
 }
@@ -401,8 +732,9 @@ void Fetcher::prepareUploadActions()
 
         // Actions optimization
         // 1. Merging series of SetRead into SetListRead
-        mergeActionsIntoList(DatabaseManager::SetRead, DatabaseManager::UnSetRead,
-                             DatabaseManager::SetListRead, DatabaseManager::UnSetListRead);
+        if (actionsAtOnce() == 0)
+            mergeActionsIntoList(DatabaseManager::SetRead, DatabaseManager::UnSetRead,
+                                 DatabaseManager::SetListRead, DatabaseManager::UnSetListRead);
         // 2. Merging series of SetSaved into SetListSaved
         /*mergeActionsIntoList(DatabaseManager::SetSaved, DatabaseManager::UnSetSaved,
                              DatabaseManager::SetListSaved, DatabaseManager::UnSetListSaved);*/
@@ -410,10 +742,226 @@ void Fetcher::prepareUploadActions()
         //qDebug() << actionsList.count() << " actions to upload after opt";
 
         this->uploadProggressTotal = actionsList.size();
+        uploadTimer.start();
+        uploadRequests = 0;
         uploadActions();
     }
 }
 
+int Fetcher::actionsAtOnce() const
+{
+    return 0;
+}
+
+QNetworkReply *Fetcher::sendActions(const ActionGroup &group)
+{
+    Q_UNUSED(group)
+    return NULL;
+}
+
+int Fetcher::checkActionsReply(QNetworkReply *reply, const ActionGroup &group)
+{
+    Q_UNUSED(group)
+    return reply->error() ? 500 : 0;
+}
+
+static QString actionTag(DatabaseManager::ActionsTypes type)
+{
+    switch (type) {
+    case DatabaseManager::SetRead:
+    case DatabaseManager::UnSetRead:
+        return "read";
+    case DatabaseManager::SetSaved:
+    case DatabaseManager::UnSetSaved:
+        return "saved";
+    case DatabaseManager::SetLiked:
+    case DatabaseManager::UnSetLiked:
+        return "liked";
+    case DatabaseManager::SetBroadcast:
+    case DatabaseManager::UnSetBroadcast:
+        return "broadcast";
+    default:
+        return QString();
+    }
+}
+
+// Actions on single items commute unless they change the same tag of the
+// same item, then only the last one matters. Other actions (mark all as
+// read, lists) keep their position.
+void Fetcher::planActions()
+{
+    // Fetchers without batch support report 0, actions are then sent one by one
+    int groupSize = qMax(1, actionsAtOnce());
+
+    actionGroups.clear();
+    uploadedActions.clear();
+    actionsError = 0;
+
+    QList<DatabaseManager::Action> items;
+
+    auto flush = [this, &items, groupSize] {
+        QHash<QString, int> last;
+        for (int i = 0; i < items.size(); ++i)
+            last.insert(actionTag(items.at(i).type) + "|" + items.at(i).id1, i);
+
+        QList<int> types;
+        QHash<int, QList<DatabaseManager::Action>> byType;
+        for (int i = 0; i < items.size(); ++i) {
+            const auto &action = items.at(i);
+
+            if (last.value(actionTag(action.type) + "|" + action.id1) != i) {
+                // Superseded by later action, only removed from DB
+                uploadedActions.append(action);
+                continue;
+            }
+
+            // Annotation is set per item
+            if (action.type == DatabaseManager::SetBroadcast && !action.text.isEmpty()) {
+                ActionGroup group;
+                group.actions.append(action);
+                actionGroups.append(group);
+                continue;
+            }
+
+            int type = static_cast<int>(action.type);
+            if (!byType.contains(type))
+                types.append(type);
+            byType[type].append(action);
+        }
+
+        for (int type : types) {
+            const auto &actions = byType[type];
+            for (int i = 0; i < actions.size(); i += groupSize) {
+                ActionGroup group;
+                group.actions = actions.mid(i, groupSize);
+                actionGroups.append(group);
+            }
+        }
+
+        items.clear();
+    };
+
+    for (const auto &action : actionsList) {
+        if (actionTag(action.type).isEmpty()) {
+            flush();
+            ActionGroup group;
+            group.barrier = true;
+            group.actions.append(action);
+            actionGroups.append(group);
+        } else {
+            items.append(action);
+        }
+    }
+    flush();
+
+    qDebug() << "Actions:" << actionsList.size() << "requests:" << actionGroups.size();
+}
+
+void Fetcher::dispatchActions()
+{
+    auto barrierInFlight = [this] {
+        for (const auto &group : actionReplies) {
+            if (group.barrier)
+                return true;
+        }
+        return false;
+    };
+
+    while (actionsError == 0 && !actionGroups.isEmpty() &&
+           actionReplies.size() < maxActionRequests) {
+        if (!actionReplies.isEmpty() &&
+                (actionGroups.first().barrier || barrierInFlight()))
+            break;
+
+        ActionGroup group = actionGroups.takeFirst();
+
+        QNetworkReply *reply = sendActions(group);
+        if (reply == NULL) {
+            // Unknown or broken action is dropped
+            uploadedActions.append(group.actions);
+            continue;
+        }
+
+        actionReplies.insert(reply, group);
+        uploadRequests++;
+        connect(reply, &QNetworkReply::finished, this, [this, reply] {
+            finishedActions(reply);
+        });
+#ifndef QT_NO_SSL
+        connect(reply, &QNetworkReply::sslErrors, this, &Fetcher::sslErrors);
+#endif
+    }
+
+    emit uploadProgress(uploadedActions.size(), uploadProggressTotal);
+
+    if (!actionReplies.isEmpty())
+        return;
+
+    // All requests have finished, uploaded actions are confirmed at once
+    auto db = DatabaseManager::instance();
+    db->removeActions(uploadedActions);
+    uploadedActions.clear();
+    recordUpload(uploadRequests);
+
+    if (actionsError != 0) {
+        if (actionsError > 0)
+            emit error(actionsError);
+        actionGroups.clear();
+        setBusy(false);
+        return;
+    }
+
+    startFetching();
+}
+
+void Fetcher::finishedActions(QNetworkReply *reply)
+{
+    ActionGroup group = actionReplies.take(reply);
+    reply->deleteLater();
+
+    if (!busy)
+        return;
+
+    int code = checkActionsReply(reply, group);
+    if (code == 0) {
+        uploadedActions.append(group.actions);
+    } else if (code == splitActions) {
+        for (int i = group.actions.size() - 1; i >= 0; --i) {
+            ActionGroup single;
+            single.actions.append(group.actions.at(i));
+            actionGroups.prepend(single);
+        }
+    } else if (actionsError == 0) {
+        actionsError = code;
+    }
+
+    dispatchActions();
+}
+
+void Fetcher::reportProbe(int changed, int total)
+{
+    if (changed < 0)
+        qDebug() << "Probe: changes can't be narrowed, full sync";
+    else if (changed == 0)
+        qDebug() << "Probe: nothing changed, sync skipped";
+    else
+        qDebug() << "Probe:" << changed << "of" << total << "streams changed, sync narrowed";
+
+    SyncStats::instance()->note(changed < 0 ? QString("probe: full sync") :
+                                QString("probe: %1 of %2 streams changed").arg(changed).arg(total));
+}
+
+void Fetcher::recordJob(const char *name)
+{
+    SyncStats::instance()->addJob(name, jobTimer.nsecsElapsed(),
+                                  ingest.counters().written - jobWritten);
+}
+
+void Fetcher::recordUpload(int requests)
+{
+    SyncStats::instance()->addUpload(static_cast<int>(uploadProggressTotal), requests, uploadTimer.nsecsElapsed());
+}
+
 void Fetcher::taskEnd()
 {
     //qDebug() << "taskEnd";
@@ -426,11 +974,43 @@ void Fetcher::taskEnd()
     }
 
     Settings *s = Settings::instance();
-    s->setLastUpdateDate(QDateTime::currentDateTimeUtc().toTime_t());
+    if (busyType != Fetcher::Refreshing)
+        s->setLastUpdateDate(QDateTime::currentDateTimeUtc().toTime_t());
 
     data.clear();
+    decoder.reset();
+    decodedEntries.clear();
+
+    qDebug() << "Ingest:" << ingest.report();
+    DatabaseManager::instance()->removeOrphanedFingerprints();
+
+    // Validators from init replace old ones, DB was rebuilt
+    QVariantMap validators;
+    if (busyType != Fetcher::Initiating)
+        validators = s->getHttpValidators();
+    for (auto it = pendingValidators.constBegin(); it != pendingValidators.constEnd(); ++it)
+        validators.insert(it.key(), it.value());
+    s->setHttpValidators(validators);
+    pendingValidators.clear();
+
+    // Sync is complete, nothing to resume. Refresh doesn't complete
+    // interrupted sync.
+    if (busyType != Fetcher::Refreshing)
+        DatabaseManager::instance()->removeCheckpoints(QString());
+
+    DatabaseManager::instance()->archiveEntries();
+    scheduleVacuum();
+
+    // Full sync has polled all streams
+    if (busyType == Fetcher::Refreshing) {
+        scheduler.polled(refreshStreams, false);
+        refreshStreams.clear();
+        emit refreshed(ingest.counters().written);
+    } else {
+        scheduler.polled(QStringList(), false);
+        emit ready();
+    }
 
-    emit ready();
     setBusy(false);
 }
 
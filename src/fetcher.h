@@ -30,6 +30,14 @@
 #include <QNetworkAccessManager>
 #include <QNetworkConfigurationManager>
 #include <QNetworkCookieJar>
+#include <QPointer>
+#include <QMutex>
+#include <QHash>
+#include <QVariantMap>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <functional>
+#include <memory>
 #if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
 #include <QJsonObject>
 #include <QJsonArray>
@@ -38,21 +46,18 @@
 #endif
 
 #include "databasemanager.h"
-
-class FetcherCookieJar : public QNetworkCookieJar
-{
-    Q_OBJECT
-public:
-    FetcherCookieJar(QObject *parent = 0);
-    virtual bool setCookiesFromUrl(const QList<QNetworkCookie> & cookieList,
-                                   const QUrl & url);
-};
+#include "jsonentrydecoder.h"
+#include "networkmanager.h"
+#include "ingestpipeline.h"
+#include "syncscheduler.h"
+#include "syncstats.h"
 
 class Fetcher : public QThread
 {
     Q_OBJECT
     Q_PROPERTY (bool busy READ isBusy NOTIFY busyChanged)
     Q_PROPERTY (BusyType busyType READ readBusyType NOTIFY busyChanged)
+    Q_PROPERTY (bool structureChanged READ isStructureChanged NOTIFY busyChanged)
 
 public:
 
@@ -62,6 +67,7 @@ public:
         Updating = 2,
         CheckingCredentials = 3,
         GettingAuthUrl = 4,
+        Refreshing = 5,
         InitiatingWaiting = 11,
         UpdatingWaiting = 21,
         CheckingCredentialsWaiting = 31,
@@ -74,15 +80,22 @@ public:
 
     Q_INVOKABLE bool init();
     Q_INVOKABLE bool update();
+    Q_INVOKABLE bool refresh();
     Q_INVOKABLE bool checkCredentials();
     Q_INVOKABLE void cancel();
 
     Q_INVOKABLE virtual void getConnectUrl(int type) = 0;
     Q_INVOKABLE virtual bool setConnectUrl(const QString &url) = 0;
     Q_INVOKABLE void saveImage(const QString &url);
+    // DB file is swapped, so it is compacted only when sync is not running
+    Q_INVOKABLE bool compactDB();
 
     BusyType readBusyType();
     bool isBusy();
+    // Dashboards, tabs or streams were changed by the last sync
+    bool isStructureChanged();
+    // Counters of current or the last sync
+    IngestPipeline::Counters ingestCounters() const { return ingest.counters(); }
 
 signals:
     void quit();
@@ -121,13 +134,15 @@ signals:
     void error(int code);
     void canceled();
     void ready();
+    void refreshed(int count);
     void addDownload(DatabaseManager::CacheItem item);
 
 public slots:
     void sslErrors(const QList<QSslError> &errors);
 
 protected:
-    QNetworkAccessManager nam;
+    // Shared by all fetchers and DownloadManager
+    NetworkManager &nam;
     QNetworkConfigurationManager ncm;
     QNetworkReply* currentReply;
     QByteArray data;
@@ -144,10 +159,98 @@ protected:
     double proggress;
     double proggressTotal;
     double uploadProggressTotal;
+    // Error code set by worker thread (JSON is parsed in run())
+    int jobError = 0;
+    // Entries decoded from reply while it is being downloaded
+    std::unique_ptr<JsonEntryDecoder> decoder;
+    QPointer<QNetworkReply> decoderReply;
+    QList<DatabaseManager::Entry> decodedEntries;
+    // Decoded pages waiting for worker thread, next page is
+    // downloaded while previous one is stored
+    static const int maxQueuedPages = 2;
+    struct Page {
+        QList<DatabaseManager::Entry> entries;
+        DatabaseManager::Checkpoint checkpoint;
+    };
+    QMutex pagesMutex;
+    QList<Page> queuedPages;
+    // Checkpoints older than that are not resumed (sec)
+    static const int checkpointMaxAge = 86400;
+    // Current sync has queued pages with checkpoints, so it can be resumed
+    bool checkpointed = false;
+    // Transient network errors are retried after 1, 2, 4, 8 s
+    static const int maxRetries = 4;
+    static const int retryDelay = 1000;
+    int retries = 0;
+    QTimer retryTimer;
+    std::function<void()> retryCall;
+    // ETag and Last-Modified of replies by URL, saved when sync has
+    // finished, so DB content always matches stored validators
+    QVariantMap pendingValidators;
+    // Stored entries of all aggregators go through it
+    IngestPipeline ingest;
+    // Pending actions planned for upload. Item actions of the same type are
+    // sent together, barrier group (e.g. mark all as read) is sent alone
+    // after all previous requests have finished.
+    struct ActionGroup {
+        bool barrier = false;
+        QList<DatabaseManager::Action> actions;
+    };
+    static const int maxActionRequests = 4;
+    QList<ActionGroup> actionGroups;
+    QHash<QNetworkReply*, ActionGroup> actionReplies;
+    QList<DatabaseManager::Action> uploadedActions;
+    int actionsError = 0;
+    // Background refresh of due streams
+    SyncScheduler scheduler;
+    QStringList refreshStreams;
+    // Timing of current store job and action upload
+    QElapsedTimer jobTimer;
+    int jobWritten = 0;
+    QElapsedTimer uploadTimer;
+    int uploadRequests = 0;
+    // Unless fetcher knows better, every sync may change structure
+    bool structureChanged = true;
 
     void setBusy(bool busy, Fetcher::BusyType type = Fetcher::UnknownBusyType);
     bool parse();
+    // Feeds chunk of reply to decoder, decoding time is counted as parse
+    bool feedDecoder(JsonEntryDecoder *decoder, const QByteArray &chunk);
+    void startDecoding(const JsonEntryDecoder::Table &table);
+    void queuePage(const QList<DatabaseManager::Entry> &entries,
+                   const DatabaseManager::Checkpoint &checkpoint = DatabaseManager::Checkpoint());
+    bool takePage(QList<DatabaseManager::Entry> *entries, DatabaseManager::Checkpoint *checkpoint);
+    int queuedPagesCount();
+    bool isDownloading();
+    virtual bool abortRequests();
+    void setConditional(QNetworkRequest &request);
+    bool isNotModified(QNetworkReply *reply);
+    // Checkpoints of interrupted sync with job name starting with prefix,
+    // empty if there are none or they are too old
+    QList<DatabaseManager::Checkpoint> resumeCheckpoints(const QString &prefix);
+    static bool isTransientError(QNetworkReply *reply);
+    // Returns true if request will be sent again by resend after delay
+    bool retryTransient(QNetworkReply *reply, std::function<void()> resend);
+    bool isImageCaching();
     void prepareUploadActions();
+    // Max number of item actions in one request, 0 if actions are sent
+    // one by one (series of SetRead are merged into SetListRead)
+    virtual int actionsAtOnce() const;
+    void planActions();
+    void dispatchActions();
+    void finishedActions(QNetworkReply *reply);
+    // Returns NULL if there is nothing to send
+    virtual QNetworkReply *sendActions(const ActionGroup &group);
+    // Returns 0 on success, -1 if canceled, splitActions if actions of
+    // the group have to be sent again one by one, otherwise error code
+    static const int splitActions = -2;
+    virtual int checkActionsReply(QNetworkReply *reply, const ActionGroup &group);
+    // Logs decision of change detection done before sync, changed is -1
+    // when full sync is needed
+    void reportProbe(int changed, int total);
+    // Called in main thread when store job has finished
+    void recordJob(const char *name);
+    void recordUpload(int requests);
     void taskEnd();
 
 private slots:
@@ -157,9 +260,15 @@ private slots:
     void readyRead();
 
 private:
+    bool parseData();
     virtual void signIn() = 0;
     virtual void startFetching() = 0;
     virtual void uploadActions() = 0;
+    // Aggregator endpoint, its connection is opened ahead of sync
+    virtual QUrl serviceUrl() const = 0;
+    void prewarm();
+    // Incremental vacuum steps run after sync, only while fetcher is idle
+    void scheduleVacuum();
 
     void mergeActionsIntoList(DatabaseManager::ActionsTypes typeSet,
                               DatabaseManager::ActionsTypes typeUnset,
@@ -0,0 +1,334 @@
+/* Copyright (C) 2022 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "hotentries.h"
+
+#include <QChar>
+#include <QDebug>
+#include <QMutexLocker>
+#include <QRegExp>
+#include <QUrl>
+#include <QtGui/QTextDocument>
+
+#include "settings.h"
+
+QString HotEntries::plainText(const QString &html) {
+    // Removing html tags!
+    QTextDocument doc;
+    doc.setHtml(html);
+
+    return doc.toPlainText()
+        .replace(QChar::ObjectReplacementCharacter, QChar::Space)
+        .trimmed();
+}
+
+HotEntries::Item HotEntries::makeItem(const DatabaseManager::Entry &entry,
+                                      bool cached) {
+    QRegExp re("<[^>]*>");
+
+    Item item;
+
+    item.content = plainText(entry.content).simplified();
+    if (item.content.length() > 1000) {
+        item.content = item.content.left(997) + "...";
+    } else if (item.content.length() < 15) {
+        item.content.clear();
+    }
+
+    item.title = plainText(entry.title).simplified();
+    if (item.title.length() > 200)
+        item.title = item.title.left(197) + QString("...");
+    item.title.remove(re);
+
+    // Detecting invalid images
+    bool imageOk = true;
+    QUrl imageUrl(entry.image);
+    if (imageUrl.path() == "/assets/images/transparent.png") imageOk = false;
+    if (imageUrl.host() == "rc.feedsportal.com") imageOk = false;
+
+    item.id = entry.id;
+    item.streamId = entry.feedId;
+    item.author = entry.author;
+    item.link = entry.link;
+    item.image = imageOk ? entry.image : "";
+    item.feedIcon = entry.feedIcon;
+    item.feedTitle = QString(entry.feedTitle).remove(re);
+    item.annotations = entry.annotations;
+    item.cached = cached;
+    item.broadcast = entry.broadcast == 1;
+    item.liked = entry.liked == 1;
+    item.fresh = entry.fresh == 1;
+    item.read = entry.read;
+    item.saved = entry.saved;
+    item.date = entry.publishedAt;
+
+    return item;
+}
+
+void HotEntries::invalidate() { ++m_generation; }
+
+void HotEntries::rebuild(const QString &dashboardId) {
+    auto *db = DatabaseManager::instance();
+
+    int generation = m_generation;
+
+    Set set;
+
+    for (const auto &smt : db->readStreamModuleTabListByDashboard(dashboardId))
+        set.streamTabs[smt.streamId].insert(smt.tabId);
+    for (const auto &stream : db->readStreamTitlesByDashboard(dashboardId))
+        set.feeds.insert(stream.id, Feed{stream.title, stream.icon});
+
+    auto list = db->readEntriesByDashboard(dashboardId, 0, limit);
+    set.complete = list.size() < limit;
+
+    // Dashboard query returns entry once per module of its stream, set
+    // holds it once
+    QSet<QString> seen;
+    QList<QString> ids;
+    QList<DatabaseManager::Entry> entries;
+    for (const auto &entry : list) {
+        if (seen.contains(entry.id)) continue;
+        seen.insert(entry.id);
+        ids.append(entry.id);
+        entries.append(entry);
+    }
+
+    auto cached = db->readCachedEntryIds(ids);
+
+    set.items.reserve(entries.size());
+    for (const auto &entry : entries)
+        set.items.append(makeItem(entry, cached.contains(entry.id)));
+    set.generation = generation;
+
+    qDebug() << "hot entries rebuilt:" << dashboardId << set.items.size();
+
+    QMutexLocker locker{&m_mutex};
+    m_sets.insert(dashboardId, set);
+}
+
+// Incomplete set holds only entries newer than its oldest one
+bool HotEntries::inWindow(const Set &set, int date) {
+    return set.complete || (!set.items.isEmpty() && date > set.items.last().date);
+}
+
+void HotEntries::mergeItem(Set &set, Item item) {
+    for (int i = 0; i < set.items.size(); ++i) {
+        if (set.items.at(i).id == item.id) {
+            // Local state is not changed by sync
+            item.fresh = set.items.at(i).fresh;
+            item.cached = set.items.at(i).cached;
+            set.items.remove(i);
+            break;
+        }
+    }
+
+    if (!inWindow(set, item.date)) return;
+
+    int pos = 0;
+    while (pos < set.items.size() && set.items.at(pos).date >= item.date) ++pos;
+    set.items.insert(pos, item);
+
+    if (set.items.size() > limit) {
+        set.items.resize(limit);
+        set.complete = false;
+    }
+}
+
+void HotEntries::merge(const QList<DatabaseManager::Entry> &entries) {
+    if (entries.isEmpty()) return;
+
+    // Copies are known only when fingerprints are written, so sets are
+    // rebuilt with duplicates filter
+    if (Settings::instance()->getCollapseDuplicates()) {
+        invalidate();
+        return;
+    }
+
+    // Items are prepared without lock, only entries that belong to some
+    // held set are converted
+    QList<DatabaseManager::Entry> needed;
+    {
+        QMutexLocker locker{&m_mutex};
+        for (auto entry : entries) {
+            for (const auto &set : m_sets) {
+                if (set.generation != m_generation) continue;
+                auto feed = set.feeds.constFind(entry.streamId);
+                if (feed == set.feeds.constEnd()) continue;
+                entry.feedId = entry.streamId;
+                entry.feedTitle = feed->title;
+                entry.feedIcon = feed->icon;
+                needed.append(entry);
+                break;
+            }
+        }
+    }
+
+    if (needed.isEmpty()) return;
+
+    QList<Item> items;
+    items.reserve(needed.size());
+    for (const auto &entry : needed) {
+        // New rows are inserted as fresh and not cached
+        auto item = makeItem(entry, false);
+        item.fresh = true;
+        items.append(item);
+    }
+
+    QMutexLocker locker{&m_mutex};
+    for (auto &set : m_sets) {
+        if (set.generation != m_generation) continue;
+        for (const auto &item : items) {
+            if (set.feeds.contains(item.streamId)) mergeItem(set, item);
+        }
+    }
+}
+
+void HotEntries::updateStream(const QString &id, const QString &title,
+                              const QString &icon) {
+    QRegExp re("<[^>]*>");
+    auto feedTitle = QString(title).remove(re);
+
+    QMutexLocker locker{&m_mutex};
+    for (auto &set : m_sets) {
+        if (!set.streamTabs.contains(id)) continue;
+        set.feeds.insert(id, Feed{title, icon});
+        for (auto &item : set.items) {
+            if (item.streamId != id) continue;
+            item.feedTitle = feedTitle;
+            item.feedIcon = icon;
+        }
+    }
+}
+
+bool HotEntries::match(const Set &set, const Item &item, Scope scope,
+                       const QString &id, int filter) {
+    switch (scope) {
+        case Scope::Tab:
+            if (!set.streamTabs.value(item.streamId).contains(id))
+                return false;
+            break;
+        case Scope::Stream:
+            if (item.streamId != id) return false;
+            break;
+        default:
+            break;
+    }
+
+    if (filter == 2) return item.read == 0;
+    if (filter == 1) return item.read == 0 || item.saved == 1;
+    return true;
+}
+
+bool HotEntries::read(const QString &dashboardId, Scope scope,
+                      const QString &id, int filter, int offset, int limit,
+                      bool ascOrder, QList<Item> *list) {
+    // Set is built without collapsed duplicates, copies have to be
+    // visible in tab and feed views
+    if (scope != Scope::Dashboard &&
+        Settings::instance()->getCollapseDuplicates())
+        return false;
+
+    QMutexLocker locker{&m_mutex};
+
+    auto it = m_sets.constFind(dashboardId);
+    if (it == m_sets.constEnd() || it->generation != m_generation)
+        return false;
+
+    const auto &set = *it;
+
+    // Oldest first order is known only when the whole dashboard is held
+    if (ascOrder && !set.complete) return false;
+
+    int count = set.items.size();
+    for (int i = 0; i < count && list->size() < limit; ++i) {
+        const auto &item = set.items.at(ascOrder ? count - 1 - i : i);
+        if (!match(set, item, scope, id, filter)) continue;
+        if (offset > 0) {
+            --offset;
+            continue;
+        }
+        list->append(item);
+    }
+
+    // Incomplete page can be served only if nothing older exists
+    if (list->size() < limit && !set.complete) {
+        list->clear();
+        return false;
+    }
+
+    return true;
+}
+
+template <typename F>
+void HotEntries::forEachItem(F &&func) {
+    QMutexLocker locker{&m_mutex};
+    for (auto &set : m_sets) {
+        for (auto &item : set.items) func(set, item);
+    }
+}
+
+void HotEntries::updateRead(const QString &id, int flag) {
+    forEachItem([&](Set &, Item &item) {
+        if (item.id == id) item.read = flag;
+    });
+}
+
+void HotEntries::updateReadByStream(const QString &id, int flag) {
+    forEachItem([&](Set &, Item &item) {
+        if (item.streamId == id) item.read = flag;
+    });
+}
+
+void HotEntries::updateReadByTab(const QString &id, int flag) {
+    forEachItem([&](Set &set, Item &item) {
+        if (set.streamTabs.value(item.streamId).contains(id)) item.read = flag;
+    });
+}
+
+void HotEntries::updateReadByDashboard(const QString &id, int flag) {
+    QMutexLocker locker{&m_mutex};
+    auto it = m_sets.find(id);
+    if (it == m_sets.end()) return;
+    for (auto &item : it->items) item.read = flag;
+}
+
+void HotEntries::updateSaved(const QString &id, int flag) {
+    forEachItem([&](Set &, Item &item) {
+        if (item.id == id) item.saved = flag;
+    });
+}
+
+void HotEntries::updateLiked(const QString &id, int flag) {
+    forEachItem([&](Set &, Item &item) {
+        if (item.id == id) item.liked = flag == 1;
+    });
+}
+
+void HotEntries::updateBroadcast(const QString &id, int flag,
+                                 const QString &annotations) {
+    forEachItem([&](Set &, Item &item) {
+        if (item.id == id) {
+            item.broadcast = flag == 1;
+            item.annotations = annotations;
+        }
+    });
+}
+
+void HotEntries::updateCached(const QString &id, bool cached) {
+    forEachItem([&](Set &, Item &item) {
+        if (item.id == id) item.cached = cached;
+    });
+}
+
+void HotEntries::updateCachedAll(bool cached) {
+    forEachItem([&](Set &, Item &item) { item.cached = cached; });
+}
+
+void HotEntries::updateFreshAll(int flag) {
+    forEachItem([&](Set &, Item &item) { item.fresh = flag == 1; });
+}
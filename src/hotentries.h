@@ -0,0 +1,107 @@
+/* Copyright (C) 2022 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef HOTENTRIES_H
+#define HOTENTRIES_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <QVector>
+#include <atomic>
+
+#include "databasemanager.h"
+#include "singleton.h"
+
+// In-memory index of the newest entries of a dashboard. Holds entries
+// already prepared for the list view, so the first pages of
+// AllEntries, TabsEntries and FeedsEntries views are built without
+// running the join query and HTML stripping again. Only snippets are
+// held, full content is read from DB when entry is opened. Entries
+// written by sync are merged into held sets, structure changes
+// invalidate them.
+class HotEntries : public Singleton<HotEntries> {
+   public:
+    enum class Scope { Dashboard, Tab, Stream };
+
+    struct Item {
+        QString id;
+        QString streamId;
+        QString title;
+        QString author;
+        // Snippet of content, body is read when entry is opened
+        QString content;
+        QString link;
+        QString image;
+        QString feedIcon;
+        QString feedTitle;
+        QString annotations;
+        bool cached = false;
+        bool broadcast = false;
+        bool liked = false;
+        bool fresh = false;
+        int read = 0;
+        int saved = 0;
+        int date = 0;
+    };
+
+    static Item makeItem(const DatabaseManager::Entry &entry, bool cached);
+    static QString plainText(const QString &html);
+
+    bool read(const QString &dashboardId, Scope scope, const QString &id,
+              int filter, int offset, int limit, bool ascOrder,
+              QList<Item> *list);
+    void rebuild(const QString &dashboardId);
+    void invalidate();
+    // Inserted or changed entries
+    void merge(const QList<DatabaseManager::Entry> &entries);
+    void updateStream(const QString &id, const QString &title,
+                      const QString &icon);
+
+    void updateRead(const QString &id, int flag);
+    void updateReadByStream(const QString &id, int flag);
+    void updateReadByTab(const QString &id, int flag);
+    void updateReadByDashboard(const QString &id, int flag);
+    void updateSaved(const QString &id, int flag);
+    void updateLiked(const QString &id, int flag);
+    void updateBroadcast(const QString &id, int flag,
+                         const QString &annotations);
+    void updateCached(const QString &id, bool cached);
+    void updateCachedAll(bool cached);
+    void updateFreshAll(int flag);
+
+   private:
+    static const int limit = 300;
+
+    struct Feed {
+        QString title;
+        QString icon;
+    };
+
+    struct Set {
+        QVector<Item> items;
+        QHash<QString, QSet<QString>> streamTabs;
+        QHash<QString, Feed> feeds;
+        bool complete = false;
+        int generation = 0;
+    };
+
+    QMutex m_mutex;
+    QHash<QString, Set> m_sets;
+    std::atomic_int m_generation{0};
+
+    template <typename F>
+    void forEachItem(F &&func);
+    static bool match(const Set &set, const Item &item, Scope scope,
+                      const QString &id, int filter);
+    static bool inWindow(const Set &set, int date);
+    static void mergeItem(Set &set, Item item);
+};
+
+#endif  // HOTENTRIES_H
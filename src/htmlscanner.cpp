@@ -0,0 +1,351 @@
+/* Copyright (C) 2022 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "htmlscanner.h"
+
+#include <cstring>
+
+#ifdef KAKTUS_BENCHMARK
+#include <QElapsedTimer>
+#include <QRegExp>
+#endif
+
+static inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+static inline char toLower(char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+static bool nameIs(const char *begin, const char *end, const char *name) {
+    const auto size = static_cast<ptrdiff_t>(std::strlen(name));
+    if (end - begin != size) return false;
+    for (ptrdiff_t i = 0; i < size; ++i)
+        if (toLower(begin[i]) != name[i]) return false;
+    return true;
+}
+
+static int toInt(const char *begin, const char *end) {
+    int value = 0;
+    bool digits = false;
+    for (; begin < end && *begin >= '0' && *begin <= '9'; ++begin) {
+        value = value * 10 + (*begin - '0');
+        digits = true;
+    }
+    return digits ? value : -1;
+}
+
+HtmlScanner::Result HtmlScanner::scan(const QString &html) {
+    return scan(html.toUtf8());
+}
+
+QString HtmlScanner::firstImage(const QString &html) {
+    Result result;
+    int from = 0;
+
+    while (result.firstImage.isEmpty()) {
+        const auto lt =
+            html.indexOf(QLatin1String{"<img"}, from, Qt::CaseInsensitive);
+        if (lt < 0) break;
+
+        from = tagEnd(html, lt + 4);
+        const auto tag = html.midRef(lt + 1, from - lt - 1).toUtf8();
+        parseTag(tag.constData(), tag.constData() + tag.size(), result);
+    }
+
+    return result.firstImage;
+}
+
+// Index after closing '>', quoted attribute values may contain '>'
+int HtmlScanner::tagEnd(const QString &html, int from) {
+    QChar quote;
+    bool value = false;
+
+    for (int i = from; i < html.size(); ++i) {
+        const auto c = html.at(i);
+
+        if (!quote.isNull()) {
+            if (c == quote) quote = QChar{};
+            continue;
+        }
+
+        if (c == '>') return i + 1;
+        if (c == '=') {
+            value = true;
+            continue;
+        }
+        if (value && (c == '"' || c == '\'')) quote = c;
+        if (!c.isSpace()) value = false;
+    }
+
+    return html.size();
+}
+
+HtmlScanner::Result HtmlScanner::scan(const QByteArray &html) {
+    Result result;
+
+    const char *p = html.constData();
+    const char *end = p + html.size();
+    bool space = false;
+
+    while (p < end) {
+        const auto *lt = static_cast<const char *>(std::memchr(p, '<', end - p));
+        if (!lt) {
+            result.textLength += textLength(p, end, &space);
+            break;
+        }
+        result.textLength += textLength(p, lt, &space);
+        p = parseTag(lt + 1, end, result);
+    }
+
+    return result;
+}
+
+const char *HtmlScanner::parseTag(const char *p, const char *end,
+                                  Result &result) {
+    if (p >= end) return end;
+
+    // Comment
+    if (end - p >= 3 && p[0] == '!' && p[1] == '-' && p[2] == '-') {
+        const char *q = p + 3;
+        while (q < end) {
+            const auto *gt =
+                static_cast<const char *>(std::memchr(q, '>', end - q));
+            if (!gt) return end;
+            if (gt - q >= 2 && gt[-1] == '-' && gt[-2] == '-') return gt + 1;
+            q = gt + 1;
+        }
+        return end;
+    }
+
+    const bool closing = *p == '/';
+    if (closing) ++p;
+
+    const char *name = p;
+    while (p < end && !isSpace(*p) && *p != '>' && *p != '/') ++p;
+    const char *nameEnd = p;
+
+    // Not a tag, e.g. "a < b"
+    if (name == nameEnd && !closing) {
+        ++result.textLength;
+        return name;
+    }
+
+    const bool img = !closing && nameIs(name, nameEnd, "img");
+    Image image;
+
+    while (p < end) {
+        while (p < end && (isSpace(*p) || *p == '/')) ++p;
+        if (p >= end) return end;
+        if (*p == '>') {
+            ++p;
+            break;
+        }
+
+        const char *attr = p;
+        while (p < end && !isSpace(*p) && *p != '=' && *p != '>' && *p != '/')
+            ++p;
+        const char *attrEnd = p;
+        while (p < end && isSpace(*p)) ++p;
+
+        const char *value = nullptr;
+        const char *valueEnd = nullptr;
+        if (p < end && *p == '=') {
+            ++p;
+            while (p < end && isSpace(*p)) ++p;
+            if (p < end && (*p == '"' || *p == '\'')) {
+                const auto *q = static_cast<const char *>(
+                    std::memchr(p + 1, *p, end - p - 1));
+                if (!q) return end;
+                value = p + 1;
+                valueEnd = q;
+                p = q + 1;
+            } else {
+                value = p;
+                while (p < end && !isSpace(*p) && *p != '>') ++p;
+                valueEnd = p;
+            }
+        }
+
+        if (!img || !value) continue;
+
+        if (nameIs(attr, attrEnd, "src")) {
+            image.src = decodeValue(value, valueEnd);
+        } else if (nameIs(attr, attrEnd, "srcset")) {
+            const auto candidates = decodeValue(value, valueEnd).split(',');
+            for (const auto &candidate : candidates) {
+                auto url = candidate.trimmed().section(' ', 0, 0);
+                if (!url.isEmpty()) image.srcset.append(url);
+            }
+        } else if (nameIs(attr, attrEnd, "width")) {
+            image.width = toInt(value, valueEnd);
+        } else if (nameIs(attr, attrEnd, "height")) {
+            image.height = toInt(value, valueEnd);
+        }
+    }
+
+    if (img) addImage(image, result);
+
+    // Content of script and style is not text
+    if (!closing) {
+        if (nameIs(name, nameEnd, "script"))
+            return skipRawText(p, end, "script");
+        if (nameIs(name, nameEnd, "style"))
+            return skipRawText(p, end, "style");
+    }
+
+    return p;
+}
+
+const char *HtmlScanner::skipRawText(const char *p, const char *end,
+                                     const char *name) {
+    const auto size = static_cast<ptrdiff_t>(std::strlen(name));
+
+    while (p < end) {
+        const auto *lt = static_cast<const char *>(std::memchr(p, '<', end - p));
+        if (!lt) return end;
+        if (end - lt > size + 1 && lt[1] == '/' &&
+            nameIs(lt + 2, lt + 2 + size, name)) {
+            const auto *gt = static_cast<const char *>(
+                std::memchr(lt, '>', end - lt));
+            return gt ? gt + 1 : end;
+        }
+        p = lt + 1;
+    }
+
+    return end;
+}
+
+int HtmlScanner::textLength(const char *p, const char *end, bool *space) {
+    int length = 0;
+
+    while (p < end) {
+        const char c = *p;
+
+        if (isSpace(c)) {
+            if (!*space) {
+                ++length;
+                *space = true;
+            }
+            ++p;
+            continue;
+        }
+
+        *space = false;
+
+        // Entity is one character
+        if (c == '&') {
+            const char *q = p + 1;
+            while (q < end && q - p < 12 &&
+                   ((*q >= 'a' && *q <= 'z') || (*q >= 'A' && *q <= 'Z') ||
+                    (*q >= '0' && *q <= '9') || *q == '#'))
+                ++q;
+            if (q < end && *q == ';' && q - p > 1) {
+                ++length;
+                p = q + 1;
+                continue;
+            }
+        }
+
+        // Continuation bytes of UTF-8 sequence are not counted
+        if ((static_cast<unsigned char>(c) & 0xC0) != 0x80) ++length;
+        ++p;
+    }
+
+    return length;
+}
+
+QString HtmlScanner::decodeValue(const char *begin, const char *end) {
+    auto value = QString::fromUtf8(begin, static_cast<int>(end - begin)).trimmed();
+
+    if (value.contains('&')) {
+        value.replace("&amp;", "&", Qt::CaseInsensitive);
+        value.replace("&quot;", "\"", Qt::CaseInsensitive);
+        value.replace("&apos;", "'", Qt::CaseInsensitive);
+        value.replace("&#39;", "'");
+        value.replace("&lt;", "<", Qt::CaseInsensitive);
+        value.replace("&gt;", ">", Qt::CaseInsensitive);
+    }
+
+    return value;
+}
+
+void HtmlScanner::addImage(const Image &image, Result &result) {
+    if (!image.src.isEmpty() && !result.imageUrls.contains(image.src))
+        result.imageUrls.append(image.src);
+    for (const auto &url : image.srcset)
+        if (!result.imageUrls.contains(url)) result.imageUrls.append(url);
+
+    if (!result.firstImage.isEmpty()) return;
+
+    // Tracking pixels are usually 1x1
+    if ((image.width >= 0 && image.width <= 1) ||
+        (image.height >= 0 && image.height <= 1))
+        return;
+
+    auto url = image.src.isEmpty() ? image.srcset.value(0) : image.src;
+    if (!url.isEmpty() && !url.startsWith("data:", Qt::CaseInsensitive))
+        result.firstImage = url;
+}
+
+#ifdef KAKTUS_BENCHMARK
+QString HtmlScanner::benchmark(const QList<QString> &contents, int rounds) {
+    QRegExp rx("<img\\s[^>]*src\\s*=\\s*(\"[^\"]*\"|'[^']*')",
+               Qt::CaseInsensitive);
+
+    int regexImages = 0;
+    int firstImages = 0;
+    int scannerImages = 0;
+    qint64 bytes = 0;
+
+    for (const auto &content : contents) bytes += content.size() * 2;
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < rounds; ++i) {
+        for (const auto &content : contents) {
+            if (rx.indexIn(content) != -1) ++regexImages;
+        }
+    }
+    const auto regexNs = timer.nsecsElapsed();
+
+    timer.restart();
+    for (int i = 0; i < rounds; ++i) {
+        for (const auto &content : contents) {
+            if (!firstImage(content).isEmpty()) ++firstImages;
+        }
+    }
+    const auto firstNs = timer.nsecsElapsed();
+
+    timer.restart();
+    for (int i = 0; i < rounds; ++i) {
+        for (const auto &content : contents) {
+            if (!scan(content).firstImage.isEmpty()) ++scannerImages;
+        }
+    }
+    const auto scannerNs = timer.nsecsElapsed();
+
+    rounds = qMax(1, rounds);
+
+    return QString(
+               "Entries: %1, content: %2 kB, rounds: %3\n"
+               "Regex (first image): %4 ms, images: %5\n"
+               "Scanner (first image): %6 ms, images: %7, speedup: %8x\n"
+               "Scanner (all images, text length): %9 ms, images: %10")
+        .arg(contents.size())
+        .arg(bytes / 1024)
+        .arg(rounds)
+        .arg(regexNs / 1000000.0, 0, 'f', 2)
+        .arg(regexImages / rounds)
+        .arg(firstNs / 1000000.0, 0, 'f', 2)
+        .arg(firstImages / rounds)
+        .arg(firstNs > 0 ? double(regexNs) / firstNs : 0.0, 0, 'f', 1)
+        .arg(scannerNs / 1000000.0, 0, 'f', 2)
+        .arg(scannerImages / rounds);
+}
+#endif
@@ -0,0 +1,60 @@
+/* Copyright (C) 2022 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef HTMLSCANNER_H
+#define HTMLSCANNER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+// Single pass scanner of entry content. Works directly on UTF-8 bytes,
+// tags are found with memchr (vectorized in libc), so text between tags
+// is not inspected byte by byte except for length counting.
+class HtmlScanner {
+   public:
+    struct Result {
+        // First image that is not a tracking pixel nor inline data
+        QString firstImage;
+        // All src and srcset candidates of img elements
+        QStringList imageUrls;
+        // Number of characters outside of tags, whitespace runs and
+        // entities count as one, script and style are skipped
+        int textLength = 0;
+    };
+
+    static Result scan(const QByteArray &html);
+    static Result scan(const QString &html);
+
+    // Only first image, as needed at ingest. Text is not counted and only
+    // img tags are converted to UTF-8, not whole content.
+    static QString firstImage(const QString &html);
+
+#ifdef KAKTUS_BENCHMARK
+    // Compares scanner with regex used before, returns report
+    static QString benchmark(const QList<QString> &contents, int rounds);
+#endif
+
+   private:
+    struct Image {
+        QString src;
+        QStringList srcset;
+        int width = -1;
+        int height = -1;
+    };
+
+    static int tagEnd(const QString &html, int from);
+    static const char *parseTag(const char *p, const char *end, Result &result);
+    static const char *skipRawText(const char *p, const char *end,
+                                   const char *name);
+    static int textLength(const char *p, const char *end, bool *space);
+    static QString decodeValue(const char *begin, const char *end);
+    static void addImage(const Image &image, Result &result);
+};
+
+#endif  // HTMLSCANNER_H
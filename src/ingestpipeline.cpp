@@ -0,0 +1,240 @@
+/* Copyright (C) 2022 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "ingestpipeline.h"
+
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QUrl>
+#include <QUrlQuery>
+
+#include "htmlscanner.h"
+#include "utils.h"
+
+void IngestPipeline::setDownloadHandler(DownloadHandler handler) {
+    m_downloadHandler = std::move(handler);
+}
+
+void IngestPipeline::begin(bool caching) {
+    m_caching = caching;
+    m_ids.clear();
+    m_images.clear();
+
+    QMutexLocker locker{&m_countersMutex};
+    m_counters = Counters{};
+}
+
+IngestPipeline::Counters IngestPipeline::counters() const {
+    QMutexLocker locker{&m_countersMutex};
+    return m_counters;
+}
+
+void IngestPipeline::add(const Counters &counters) {
+    QMutexLocker locker{&m_countersMutex};
+    m_counters.received += counters.received;
+    m_counters.duplicates += counters.duplicates;
+    m_counters.images += counters.images;
+    m_counters.downloads += counters.downloads;
+    m_counters.written += counters.written;
+    m_counters.dedupNs += counters.dedupNs;
+    m_counters.fingerprintNs += counters.fingerprintNs;
+    m_counters.imagesNs += counters.imagesNs;
+    m_counters.cacheNs += counters.cacheNs;
+    m_counters.writeNs += counters.writeNs;
+}
+
+// Counters of batch are added at once, so they can be read from main thread
+int IngestPipeline::push(QList<DatabaseManager::Entry> &entries,
+                         const DatabaseManager::Checkpoint &checkpoint) {
+    Counters counters;
+    counters.received = entries.size();
+
+    QElapsedTimer timer;
+    timer.start();
+    counters.duplicates = dedup(entries, checkpoint.job);
+    counters.dedupNs = timer.nsecsElapsed();
+
+    if (entries.isEmpty()) {
+        if (!checkpoint.job.isEmpty())
+            DatabaseManager::instance()->writeEntries(entries, checkpoint);
+        add(counters);
+        return counters.received;
+    }
+
+    timer.restart();
+    auto fingerprints = fingerprint(entries);
+    counters.fingerprintNs = timer.nsecsElapsed();
+
+    timer.restart();
+    counters.images = extractImages(entries);
+    counters.imagesNs = timer.nsecsElapsed();
+
+    if (m_caching) {
+        timer.restart();
+        counters.downloads = enqueueImages(entries);
+        counters.cacheNs = timer.nsecsElapsed();
+    }
+
+    timer.restart();
+    DatabaseManager::instance()->writeEntries(entries, checkpoint);
+    DatabaseManager::instance()->writeFingerprints(fingerprints);
+    counters.writeNs = timer.nsecsElapsed();
+    counters.written = entries.size();
+
+    add(counters);
+    return counters.received;
+}
+
+// Overlapping pages (e.g. offset paging while new entries arrive) return
+// same entries again. Entries pushed without paging job, or by other job,
+// are always written, because other passes (e.g. saved entries) update
+// flags of entries stored before.
+int IngestPipeline::dedup(QList<DatabaseManager::Entry> &entries,
+                          const QString &job) {
+    if (job.isEmpty()) return 0;
+
+    int duplicates = 0;
+    auto &ids = m_ids[job];
+    auto it = entries.begin();
+    while (it != entries.end()) {
+        if (ids.contains(it->id)) {
+            it = entries.erase(it);
+            ++duplicates;
+        } else {
+            ids.insert(it->id);
+            ++it;
+        }
+    }
+
+    return duplicates;
+}
+
+// Same article from other feed has equal link and title or equal title and
+// content. Link alone is not enough, some feeds use home page as link of
+// every entry.
+QList<DatabaseManager::Fingerprint> IngestPipeline::fingerprint(
+    const QList<DatabaseManager::Entry> &entries) {
+    QList<DatabaseManager::Fingerprint> fingerprints;
+    fingerprints.reserve(entries.size());
+
+    for (const auto &entry : entries) {
+        auto title = entry.title.simplified().toLower();
+
+        DatabaseManager::Fingerprint fp;
+        fp.entryId = entry.id;
+
+        auto link = normalizeLink(entry.link);
+        if (!link.isEmpty())
+            fp.linkHash = QString::fromLatin1(
+                QCryptographicHash::hash((link + '\n' + title).toUtf8(),
+                                         QCryptographicHash::Md5)
+                    .toHex());
+
+        if (!entry.content.isEmpty())
+            fp.contentHash = QString::fromLatin1(
+                QCryptographicHash::hash(
+                    (title + '\n' + entry.content.simplified()).toUtf8(),
+                    QCryptographicHash::Md5)
+                    .toHex());
+
+        fingerprints.append(fp);
+    }
+
+    return fingerprints;
+}
+
+// Scheme, "www." prefix, fragment, trailing slash and tracking parameters
+// are not significant
+QString IngestPipeline::normalizeLink(const QString &link) {
+    QUrl url{link.trimmed()};
+    if (!url.isValid() || url.host().isEmpty()) return {};
+
+    auto host = url.host().toLower();
+    if (host.startsWith("www.")) host = host.mid(4);
+
+    auto path = url.path();
+    while (path.endsWith('/')) path.chop(1);
+
+    QUrlQuery query{url};
+    const auto items = query.queryItems();
+    for (const auto &item : items) {
+        if (item.first.startsWith("utm_") || item.first == "fbclid" ||
+            item.first == "gclid")
+            query.removeAllQueryItems(item.first);
+    }
+
+    auto normalized = host + path;
+    if (!query.isEmpty()) normalized += '?' + query.query(QUrl::FullyEncoded);
+
+    return normalized;
+}
+
+// Image provided by aggregator is preferred over one found in content
+int IngestPipeline::extractImages(QList<DatabaseManager::Entry> &entries) {
+    int images = 0;
+    for (auto &entry : entries) {
+        if (entry.image.isEmpty())
+            entry.image = HtmlScanner::firstImage(entry.content);
+        if (!entry.image.isEmpty()) ++images;
+    }
+    return images;
+}
+
+// Cache is checked with one query per batch, images shared by many
+// entries are checked and queued only once per sync
+int IngestPipeline::enqueueImages(
+    const QList<DatabaseManager::Entry> &entries) {
+    QStringList hashes;
+    QList<QString> urls;
+    for (const auto &entry : entries) {
+        if (entry.image.isEmpty()) continue;
+        auto hash = Utils::hash(entry.image);
+        if (m_images.contains(hash)) continue;
+        m_images.insert(hash);
+        hashes.append(hash);
+        urls.append(entry.image);
+    }
+
+    if (hashes.isEmpty()) return 0;
+
+    int downloads = 0;
+    auto cached = DatabaseManager::instance()->readCacheFinalUrls(hashes);
+
+    for (int i = 0; i < hashes.size(); ++i) {
+        if (cached.contains(hashes.at(i))) continue;
+
+        DatabaseManager::CacheItem item;
+        item.origUrl = urls.at(i);
+        item.finalUrl = urls.at(i);
+        item.type = "entry-image";
+        if (m_downloadHandler) m_downloadHandler(item);
+        ++downloads;
+    }
+
+    return downloads;
+}
+
+QString IngestPipeline::report() const {
+    const auto c = counters();
+
+    return QString(
+               "received: %1, duplicates: %2, images: %3, downloads: %4, "
+               "written: %5, dedup: %6 ms, fingerprint: %7 ms, images: %8 ms, "
+               "cache: %9 ms, write: %10 ms")
+        .arg(c.received)
+        .arg(c.duplicates)
+        .arg(c.images)
+        .arg(c.downloads)
+        .arg(c.written)
+        .arg(c.dedupNs / 1000000)
+        .arg(c.fingerprintNs / 1000000)
+        .arg(c.imagesNs / 1000000)
+        .arg(c.cacheNs / 1000000)
+        .arg(c.writeNs / 1000000);
+}
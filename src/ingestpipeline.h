@@ -0,0 +1,75 @@
+/* Copyright (C) 2022 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef INGESTPIPELINE_H
+#define INGESTPIPELINE_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <functional>
+
+#include "databasemanager.h"
+
+// Common path of decoded entries into DB. Fetchers push normalized
+// batches from worker thread, pipeline drops entries already stored by
+// previous page of the same paging job, fingerprints them for cross-feed
+// duplicate detection, extracts images, decides which images have to be
+// cached and writes whole batch in one transaction.
+class IngestPipeline {
+   public:
+    using DownloadHandler =
+        std::function<void(const DatabaseManager::CacheItem &item)>;
+
+    struct Counters {
+        int received = 0;
+        int duplicates = 0;
+        int images = 0;
+        int downloads = 0;
+        int written = 0;
+        qint64 dedupNs = 0;
+        qint64 fingerprintNs = 0;
+        qint64 imagesNs = 0;
+        qint64 cacheNs = 0;
+        qint64 writeNs = 0;
+    };
+
+    void setDownloadHandler(DownloadHandler handler);
+    void begin(bool caching);
+    // Returns number of received entries, so paging continues also after
+    // page of duplicates. Checkpoint is stored in the same transaction as
+    // entries, its job scopes duplicate detection.
+    int push(QList<DatabaseManager::Entry> &entries,
+             const DatabaseManager::Checkpoint &checkpoint = {});
+    QString report() const;
+
+    // Snapshot, counters are updated by worker thread
+    Counters counters() const;
+
+   private:
+    DownloadHandler m_downloadHandler;
+    bool m_caching = false;
+    // Ids of entries seen by paging job and hashes of images seen during
+    // current sync
+    QHash<QString, QSet<QString>> m_ids;
+    QSet<QString> m_images;
+    mutable QMutex m_countersMutex;
+    Counters m_counters;
+
+    void add(const Counters &counters);
+    // Steps return their count (duplicates, images, downloads)
+    int dedup(QList<DatabaseManager::Entry> &entries, const QString &job);
+    static QList<DatabaseManager::Fingerprint> fingerprint(
+        const QList<DatabaseManager::Entry> &entries);
+    static QString normalizeLink(const QString &link);
+    static int extractImages(QList<DatabaseManager::Entry> &entries);
+    int enqueueImages(const QList<DatabaseManager::Entry> &entries);
+};
+
+#endif  // INGESTPIPELINE_H
@@ -0,0 +1,523 @@
+/* Copyright (C) 2022 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "jsonentrydecoder.h"
+
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+JsonEntryDecoder::JsonEntryDecoder(const Table &table, int batchSize)
+    : m_table{table}, m_batchSize{batchSize}, m_captured{QVariantMap{}} {}
+
+void JsonEntryDecoder::setBatchHandler(BatchHandler handler) {
+    m_handler = std::move(handler);
+}
+
+bool JsonEntryDecoder::feed(const QByteArray &chunk) {
+    if (hasError()) return false;
+
+    // Dropping already consumed data, only unfinished token is kept
+    if (m_pos > 0) {
+        m_buf.remove(0, m_pos);
+        m_consumed += m_pos;
+        m_scan = std::max(0, m_scan - m_pos);
+        m_pos = 0;
+    }
+
+    m_buf.append(chunk);
+    process();
+
+    return !hasError();
+}
+
+bool JsonEntryDecoder::finish() {
+    if (hasError()) return false;
+
+    m_final = true;
+    process();
+
+    if (!hasError() && m_expect != Expect::Done)
+        setError("unexpected end of data");
+
+    m_buf.clear();
+    m_pos = 0;
+
+    if (hasError()) return false;
+
+    flush();
+    return true;
+}
+
+void JsonEntryDecoder::setError(const char *msg) {
+    m_error = QString{"%1 at %2"}.arg(msg).arg(m_consumed + m_pos);
+    qWarning() << "json decoder error:" << m_error;
+}
+
+static inline bool isSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+void JsonEntryDecoder::process() {
+    const int size = m_buf.size();
+    const char *data = m_buf.constData();
+
+    while (m_pos < size && !hasError()) {
+        char c = data[m_pos];
+        if (isSpace(c)) {
+            ++m_pos;
+            continue;
+        }
+
+        switch (m_expect) {
+            case Expect::ValueOrEnd:
+                if (c == ']') {
+                    ++m_pos;
+                    endContainer();
+                    break;
+                }
+                // fall through
+            case Expect::Value:
+                if (c == '{') {
+                    ++m_pos;
+                    beginContainer(false);
+                } else if (c == '[') {
+                    ++m_pos;
+                    beginContainer(true);
+                } else if (c == '"') {
+                    int end = 0;
+                    if (!scanString(&end)) return;
+                    scalar(m_pos + 1, end, {});
+                    m_pos = end + 1;
+                    afterValue();
+                } else if (c == '-' || (c >= '0' && c <= '9')) {
+                    QVariant value;
+                    if (!scanNumber(&value)) return;
+                    scalar(-1, -1, value);
+                    afterValue();
+                } else if (c == 't' || c == 'f' || c == 'n') {
+                    QVariant value;
+                    if (!scanLiteral(&value)) return;
+                    scalar(-1, -1, value);
+                    afterValue();
+                } else {
+                    setError("unexpected character");
+                }
+                break;
+            case Expect::KeyOrEnd:
+                if (c == '}') {
+                    ++m_pos;
+                    endContainer();
+                    break;
+                }
+                // fall through
+            case Expect::Key:
+                if (c == '"') {
+                    int end = 0;
+                    if (!scanString(&end)) return;
+                    m_stack.last().key = decodeString(m_pos + 1, end);
+                    m_pos = end + 1;
+                    m_expect = Expect::Colon;
+                } else {
+                    setError("expected key");
+                }
+                break;
+            case Expect::Colon:
+                if (c == ':') {
+                    ++m_pos;
+                    m_expect = Expect::Value;
+                } else {
+                    setError("expected colon");
+                }
+                break;
+            case Expect::CommaOrEnd:
+                if (c == ',') {
+                    ++m_pos;
+                    auto &frame = m_stack.last();
+                    if (frame.array) {
+                        ++frame.index;
+                        m_expect = Expect::Value;
+                    } else {
+                        m_expect = Expect::Key;
+                    }
+                } else if (c == ']' || c == '}') {
+                    if (m_stack.last().array != (c == ']')) {
+                        setError("mismatched bracket");
+                        break;
+                    }
+                    ++m_pos;
+                    endContainer();
+                } else {
+                    setError("expected comma");
+                }
+                break;
+            case Expect::Done:
+                setError("unexpected data after end");
+                break;
+        }
+    }
+}
+
+bool JsonEntryDecoder::scanString(int *end) {
+    const int size = m_buf.size();
+    const char *data = m_buf.constData();
+
+    // Scan of long string is resumed when next chunk arrives
+    int i = m_scan > m_pos ? m_scan : m_pos + 1;
+    if (i == m_pos + 1) m_scanEscapes = false;
+
+    while (i < size) {
+        const void *p = std::memchr(data + i, '"', size - i);
+        int quote = p ? static_cast<int>(static_cast<const char *>(p) - data)
+                      : size;
+
+        const void *b = std::memchr(data + i, '\\', quote - i);
+        if (!b) {
+            if (quote == size) break;
+            *end = quote;
+            m_scan = 0;
+            return true;
+        }
+
+        m_scanEscapes = true;
+        i = static_cast<int>(static_cast<const char *>(b) - data);
+        // Escaped character can be in next chunk
+        if (i + 1 >= size) break;
+        i += 2;
+    }
+
+    m_scan = std::min(i, size);
+    if (m_final) setError("unterminated string");
+    return false;
+}
+
+static void appendUtf8(QByteArray &out, uint cp) {
+    if (cp < 0x80) {
+        out.append(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.append(static_cast<char>(0xC0 | (cp >> 6)));
+        out.append(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.append(static_cast<char>(0xE0 | (cp >> 12)));
+        out.append(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.append(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        out.append(static_cast<char>(0xF0 | (cp >> 18)));
+        out.append(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        out.append(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.append(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+static int hex4(const char *p, const char *end) {
+    if (end - p < 4) return -1;
+    int v = 0;
+    for (int i = 0; i < 4; ++i) {
+        char c = p[i];
+        v <<= 4;
+        if (c >= '0' && c <= '9')
+            v |= c - '0';
+        else if (c >= 'a' && c <= 'f')
+            v |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            v |= c - 'A' + 10;
+        else
+            return -1;
+    }
+    return v;
+}
+
+QString JsonEntryDecoder::decodeString(int begin, int end) const {
+    const char *p = m_buf.constData() + begin;
+    const char *e = m_buf.constData() + end;
+
+    if (!m_scanEscapes || !std::memchr(p, '\\', e - p))
+        return QString::fromUtf8(p, e - p);
+
+    QByteArray out;
+    out.reserve(e - p);
+
+    while (p < e) {
+        if (*p != '\\') {
+            out.append(*p++);
+            continue;
+        }
+
+        if (++p == e) break;
+        char c = *p++;
+        switch (c) {
+            case 'n': out.append('\n'); break;
+            case 't': out.append('\t'); break;
+            case 'r': out.append('\r'); break;
+            case 'b': out.append('\b'); break;
+            case 'f': out.append('\f'); break;
+            case 'u': {
+                int cp = hex4(p, e);
+                if (cp < 0) {
+                    out.append("\xEF\xBF\xBD");
+                    break;
+                }
+                p += 4;
+                if (cp >= 0xD800 && cp < 0xDC00) {
+                    int low = e - p >= 6 && p[0] == '\\' && p[1] == 'u'
+                                  ? hex4(p + 2, e)
+                                  : -1;
+                    if (low >= 0xDC00 && low < 0xE000) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        p += 6;
+                    } else {
+                        cp = 0xFFFD;
+                    }
+                } else if (cp >= 0xDC00 && cp < 0xE000) {
+                    cp = 0xFFFD;
+                }
+                appendUtf8(out, static_cast<uint>(cp));
+                break;
+            }
+            default:
+                // \" \\ \/
+                out.append(c);
+        }
+    }
+
+    return QString::fromUtf8(out);
+}
+
+bool JsonEntryDecoder::scanNumber(QVariant *value) {
+    const int size = m_buf.size();
+    const char *data = m_buf.constData();
+
+    bool real = false;
+    int i = m_pos;
+    for (; i < size; ++i) {
+        char c = data[i];
+        if (c == '.' || c == 'e' || c == 'E')
+            real = true;
+        else if (c != '-' && c != '+' && (c < '0' || c > '9'))
+            break;
+    }
+
+    // Number can continue in next chunk
+    if (i == size && !m_final) return false;
+
+    auto number = QByteArray::fromRawData(data + m_pos, i - m_pos);
+    bool ok = false;
+    if (!real) {
+        qlonglong v = number.toLongLong(&ok);
+        if (ok) *value = v;
+    }
+    if (!ok) {
+        double v = number.toDouble(&ok);
+        if (!ok) {
+            setError("invalid number");
+            return false;
+        }
+        *value = v;
+    }
+
+    m_pos = i;
+    return true;
+}
+
+bool JsonEntryDecoder::scanLiteral(QVariant *value) {
+    const int size = m_buf.size();
+    const char *data = m_buf.constData() + m_pos;
+
+    const char *literal = data[0] == 't' ? "true" : data[0] == 'f' ? "false"
+                                                                   : "null";
+    int len = static_cast<int>(std::strlen(literal));
+
+    if (size - m_pos < len) {
+        if (m_final) setError("invalid literal");
+        return false;
+    }
+
+    if (std::memcmp(data, literal, len) != 0) {
+        setError("invalid literal");
+        return false;
+    }
+
+    if (data[0] != 'n') *value = data[0] == 't';
+    m_pos += len;
+    return true;
+}
+
+bool JsonEntryDecoder::matches(const QStringList &pattern, int depth) const {
+    if (pattern.size() != depth) return false;
+
+    for (int i = 0; i < pattern.size(); ++i) {
+        const auto &frame = m_stack.at(i);
+        if (pattern.at(i) == "*") {
+            if (!frame.array) return false;
+        } else if (frame.array || frame.key != pattern.at(i)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+QString JsonEntryDecoder::itemPath() const {
+    QString path;
+    for (int i = m_itemDepth; i < m_stack.size(); ++i) {
+        if (!path.isEmpty()) path.append('/');
+        const auto &frame = m_stack.at(i);
+        if (frame.array)
+            path.append('*');
+        else
+            path.append(frame.key);
+    }
+    return path;
+}
+
+void JsonEntryDecoder::assign(const QString &path, const QVariant &value) {
+    auto it = m_table.fields.constFind(path);
+    if (it == m_table.fields.constEnd()) return;
+
+    if (*it)
+        (*it)(m_entry, value);
+    else if (!m_extras.contains(path))
+        m_extras.insert(path, value);
+}
+
+void JsonEntryDecoder::beginContainer(bool array) {
+    if (m_itemDepth >= 0) {
+        assign(itemPath(), {});
+    } else if (m_captureDepth >= 0) {
+        Builder builder;
+        builder.array = array;
+        m_builders.append(builder);
+    } else if (!array && !m_stack.isEmpty() && m_stack.last().array &&
+               matches(m_table.itemsPath, m_stack.size() - 1)) {
+        // New item
+        m_itemDepth = m_stack.size();
+        m_entry = DatabaseManager::Entry{};
+        m_extras.clear();
+        if (m_table.init) m_table.init(m_entry);
+    } else if (!(array && matches(m_table.itemsPath, m_stack.size()))) {
+        for (const auto &pattern : m_table.captures) {
+            if (!matches(pattern, m_stack.size())) continue;
+
+            m_captureDepth = m_stack.size();
+            m_capturePath.clear();
+            for (const auto &frame : m_stack) {
+                if (frame.array)
+                    m_capturePath.append(frame.index);
+                else
+                    m_capturePath.append(frame.key);
+            }
+            Builder builder;
+            builder.array = array;
+            m_builders.append(builder);
+            break;
+        }
+    }
+
+    Frame frame;
+    frame.array = array;
+    m_stack.append(frame);
+
+    m_expect = array ? Expect::ValueOrEnd : Expect::KeyOrEnd;
+}
+
+void JsonEntryDecoder::endContainer() {
+    m_stack.removeLast();
+
+    if (m_itemDepth >= 0 && m_stack.size() == m_itemDepth) {
+        endItem();
+    } else if (m_captureDepth >= 0) {
+        auto builder = m_builders.takeLast();
+        QVariant value = builder.array ? QVariant{builder.list}
+                                       : QVariant{builder.map};
+        if (m_builders.isEmpty()) {
+            insertAt(m_captured, m_capturePath, 0, value);
+            m_captureDepth = -1;
+        } else {
+            addCaptured(value);
+        }
+    }
+
+    afterValue();
+}
+
+void JsonEntryDecoder::scalar(int strBegin, int strEnd, const QVariant &value) {
+    auto decoded = [&] {
+        return strBegin >= 0 ? QVariant{decodeString(strBegin, strEnd)}
+                             : value;
+    };
+
+    if (m_itemDepth >= 0) {
+        auto path = itemPath();
+        // Strings are decoded only when needed
+        if (m_table.fields.contains(path)) assign(path, decoded());
+    } else if (m_captureDepth >= 0) {
+        addCaptured(decoded());
+    } else {
+        for (const auto &pattern : m_table.captures) {
+            if (!matches(pattern, m_stack.size())) continue;
+
+            QVariantList path;
+            for (const auto &frame : m_stack) {
+                if (frame.array)
+                    path.append(frame.index);
+                else
+                    path.append(frame.key);
+            }
+            insertAt(m_captured, path, 0, decoded());
+            break;
+        }
+    }
+}
+
+void JsonEntryDecoder::afterValue() {
+    m_expect = m_stack.isEmpty() ? Expect::Done : Expect::CommaOrEnd;
+}
+
+void JsonEntryDecoder::addCaptured(const QVariant &value) {
+    auto &builder = m_builders.last();
+    if (builder.array)
+        builder.list.append(value);
+    else
+        builder.map.insert(m_stack.last().key, value);
+}
+
+void JsonEntryDecoder::endItem() {
+    if (m_table.finish) m_table.finish(m_entry, m_extras);
+
+    m_batch.append(m_entry);
+    ++m_count;
+    m_itemDepth = -1;
+
+    if (m_batch.size() >= m_batchSize) flush();
+}
+
+void JsonEntryDecoder::flush() {
+    if (m_batch.isEmpty()) return;
+    if (m_handler) m_handler(m_batch);
+    m_batch.clear();
+}
+
+void JsonEntryDecoder::insertAt(QVariant &node, const QVariantList &path,
+                                int pos, const QVariant &value) {
+    if (pos == path.size()) {
+        node = value;
+        return;
+    }
+
+    const auto &seg = path.at(pos);
+    if (seg.type() == QVariant::Int) {
+        int index = seg.toInt();
+        auto list = node.toList();
+        while (list.size() <= index) list.append(QVariantMap{});
+        insertAt(list[index], path, pos + 1, value);
+        node = list;
+    } else {
+        auto map = node.toMap();
+        insertAt(map[seg.toString()], path, pos + 1, value);
+        node = map;
+    }
+}
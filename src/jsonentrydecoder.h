@@ -0,0 +1,129 @@
+/* Copyright (C) 2022 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef JSONENTRYDECODER_H
+#define JSONENTRYDECODER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+#include <QVariantHash>
+#include <QVariantList>
+#include <QVariantMap>
+#include <QVector>
+#include <functional>
+
+#include "databasemanager.h"
+
+// Incremental JSON decoder fed chunk by chunk with network data. Objects
+// found in items array are turned directly into Entry structs according to
+// field table of an aggregator, other values are skipped without decoding.
+// Only values listed in captures are kept and returned as variant tree.
+class JsonEntryDecoder {
+   public:
+    using Setter = void (*)(DatabaseManager::Entry &entry,
+                            const QVariant &value);
+
+    struct Table {
+        // Path of items array, "*" matches any array index
+        QStringList itemsPath;
+        // Paths relative to item, array indexes are replaced by "*". Start
+        // of object or array is reported with null value. Values of paths
+        // with null setter are stored in item extras (first value wins).
+        QHash<QString, Setter> fields;
+        // Paths of values (outside items) kept in captured tree
+        QList<QStringList> captures;
+        void (*init)(DatabaseManager::Entry &entry) = nullptr;
+        void (*finish)(DatabaseManager::Entry &entry,
+                       const QVariantHash &extras) = nullptr;
+    };
+
+    using BatchHandler =
+        std::function<void(const QList<DatabaseManager::Entry> &batch)>;
+
+    static const int defaultBatchSize = 50;
+
+    explicit JsonEntryDecoder(const Table &table,
+                              int batchSize = defaultBatchSize);
+
+    void setBatchHandler(BatchHandler handler);
+    bool feed(const QByteArray &chunk);
+    bool finish();
+
+    inline bool hasError() const { return !m_error.isEmpty(); }
+    inline QString errorString() const { return m_error; }
+    inline int count() const { return m_count; }
+    inline QVariantMap captured() const { return m_captured.toMap(); }
+
+   private:
+    enum class Expect { Value, ValueOrEnd, Key, KeyOrEnd, Colon, CommaOrEnd,
+                        Done };
+
+    struct Frame {
+        bool array = false;
+        int index = 0;
+        QString key;
+    };
+
+    struct Builder {
+        bool array = false;
+        QVariantList list;
+        QVariantMap map;
+    };
+
+    const Table &m_table;
+    const int m_batchSize;
+    BatchHandler m_handler;
+
+    QByteArray m_buf;
+    int m_pos = 0;
+    qint64 m_consumed = 0;
+    int m_scan = 0;
+    bool m_scanEscapes = false;
+    bool m_final = false;
+    Expect m_expect = Expect::Value;
+    QString m_error;
+    QVector<Frame> m_stack;
+
+    int m_itemDepth = -1;
+    DatabaseManager::Entry m_entry;
+    QVariantHash m_extras;
+    QList<DatabaseManager::Entry> m_batch;
+    int m_count = 0;
+
+    int m_captureDepth = -1;
+    QVariantList m_capturePath;
+    QVector<Builder> m_builders;
+    QVariant m_captured;
+
+    void process();
+    bool scanString(int *end);
+    QString decodeString(int begin, int end) const;
+    bool scanNumber(QVariant *value);
+    bool scanLiteral(QVariant *value);
+
+    void beginContainer(bool array);
+    void endContainer();
+    void scalar(int strBegin, int strEnd, const QVariant &value);
+    void afterValue();
+
+    bool matches(const QStringList &pattern, int depth) const;
+    QString itemPath() const;
+    void assign(const QString &path, const QVariant &value);
+    void addCaptured(const QVariant &value);
+    void endItem();
+    void flush();
+    void setError(const char *msg);
+
+    static void insertAt(QVariant &node, const QVariantList &path, int pos,
+                         const QVariant &value);
+};
+
+#endif  // JSONENTRYDECODER_H
@@ -24,9 +24,15 @@
 #include "info.h"
 #include "networkaccessmanagerfactory.h"
 #include "nviconprovider.h"
+#include "querystats.h"
 #include "settings.h"
+#include "syncstats.h"
 #include "utils.h"
 
+#ifdef KAKTUS_BENCHMARK
+#include "syncbenchmark.h"
+#endif
+
 static void makeAppDirs() {
     auto root = QDir::root();
     root.mkpath(
@@ -73,6 +79,16 @@ Q_DECL_EXPORT int main(int argc, char **argv) {
 
     registerTypes();
 
+#ifdef KAKTUS_BENCHMARK
+    // Headless sync against local replay server, no UI is created
+    if (SyncBenchmark::requested(QGuiApplication::arguments())) {
+        SyncBenchmark::prepare();
+        SyncBenchmark benchmark;
+        if (!benchmark.start(QGuiApplication::arguments())) return 1;
+        return QGuiApplication::exec();
+    }
+#endif
+
     auto *view = SailfishApp::createView();
     auto *context = view->rootContext();
 
@@ -111,6 +127,10 @@ Q_DECL_EXPORT int main(int argc, char **argv) {
 
     context->setContextProperty(QStringLiteral("db"),
                                 DatabaseManager::instance());
+    context->setContextProperty(QStringLiteral("dbstats"),
+                                QueryStats::instance());
+    context->setContextProperty(QStringLiteral("syncstats"),
+                                SyncStats::instance());
     context->setContextProperty(QStringLiteral("utils"), &utils);
     context->setContextProperty(QStringLiteral("dm"),
                                 DownloadManager::instance());
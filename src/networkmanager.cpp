@@ -0,0 +1,109 @@
+/* Copyright (C) 2022 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "networkmanager.h"
+
+#include <QDebug>
+#include <QMutexLocker>
+#include <QSsl>
+
+#include "syncstats.h"
+
+QUrl NetworkManager::replayUrl;
+QMutex NetworkManager::sessionsMutex;
+QHash<QString, QByteArray> NetworkManager::sessions;
+
+NetworkManager::NetworkManager(QObject *parent)
+    : QNetworkAccessManager{parent} {}
+
+void NetworkManager::setReplayUrl(const QUrl &url) { replayUrl = url; }
+
+// Path and query are kept, so replay server can tell aggregator and call
+QUrl NetworkManager::replayed(QUrl url) {
+    if (replayUrl.isValid()) {
+        url.setScheme(replayUrl.scheme());
+        url.setHost(replayUrl.host());
+        url.setPort(replayUrl.port());
+    }
+    return url;
+}
+
+QString NetworkManager::sessionKey(const QUrl &url) {
+    return url.host().toLower() + ":" + QString::number(url.port(443));
+}
+
+QSslConfiguration NetworkManager::sslConfiguration(const QUrl &url,
+                                                   QSslConfiguration config) {
+    // Session ticket is only exposed when persistence is enabled
+    config.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+
+    QMutexLocker locker{&sessionsMutex};
+    auto it = sessions.constFind(sessionKey(url));
+    if (it != sessions.constEnd()) config.setSessionTicket(it.value());
+
+    return config;
+}
+
+void NetworkManager::configure(QNetworkRequest &request) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 8, 0)
+    request.setAttribute(QNetworkRequest::HTTP2AllowedAttribute, true);
+#endif
+    if (request.url().scheme() == "https")
+        request.setSslConfiguration(
+            sslConfiguration(request.url(), request.sslConfiguration()));
+}
+
+void NetworkManager::keepSession(QNetworkReply *reply) {
+    if (reply->url().scheme() != "https") return;
+
+    auto ticket = reply->sslConfiguration().sessionTicket();
+    if (ticket.isEmpty()) return;
+
+    QMutexLocker locker{&sessionsMutex};
+    sessions.insert(sessionKey(reply->url()), ticket);
+}
+
+void NetworkManager::useCookieJar(QNetworkRequest &request) {
+    request.setAttribute(cookieJarAttribute, true);
+}
+
+void NetworkManager::prewarm(const QUrl &url) {
+    auto target = replayed(url);
+    if (target.host().isEmpty()) return;
+
+    qDebug() << "Pre-warming connection to" << target.host();
+
+    if (target.scheme() == "https")
+        connectToHostEncrypted(
+            target.host(), target.port(443),
+            sslConfiguration(target, QSslConfiguration::defaultConfiguration()));
+    else
+        connectToHost(target.host(), target.port(80));
+}
+
+QNetworkReply *NetworkManager::createRequest(Operation operation,
+                                             const QNetworkRequest &request,
+                                             QIODevice *outgoingData) {
+    auto urlClass = SyncStats::urlClass(operation, request, outgoingData);
+
+    QNetworkRequest newRequest{request};
+    newRequest.setUrl(replayed(request.url()));
+    configure(newRequest);
+    if (!request.attribute(cookieJarAttribute).toBool()) {
+        newRequest.setAttribute(QNetworkRequest::CookieLoadControlAttribute,
+                                QNetworkRequest::Manual);
+        newRequest.setAttribute(QNetworkRequest::CookieSaveControlAttribute,
+                                QNetworkRequest::Manual);
+    }
+
+    auto *reply =
+        QNetworkAccessManager::createRequest(operation, newRequest, outgoingData);
+    SyncStats::instance()->track(reply, urlClass);
+    connect(reply, &QNetworkReply::finished, this,
+            [reply] { keepSession(reply); });
+    return reply;
+}
@@ -0,0 +1,68 @@
+/* Copyright (C) 2022 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef NETWORKMANAGER_H
+#define NETWORKMANAGER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QIODevice>
+#include <QMutex>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QSslConfiguration>
+#include <QString>
+#include <QUrl>
+
+#include "singleton.h"
+
+// Main thread manager shared by fetchers and DownloadManager, so all of
+// them use one connection pool. HTTP/2 is allowed when Qt supports it and
+// TLS session tickets are kept per host, so reconnects resume sessions.
+// Every reply is tracked by SyncStats. When replay URL is set, requests go
+// to local ReplayServer instead of aggregator. Fetchers put cookies into
+// request headers, so cookie jar is used only by requests marked with
+// useCookieJar.
+class NetworkManager : public QNetworkAccessManager,
+                       public Singleton<NetworkManager> {
+    Q_OBJECT
+
+   public:
+    explicit NetworkManager(QObject *parent = nullptr);
+
+    static void setReplayUrl(const QUrl &url);
+    // Allows HTTP/2 and sets session ticket of the host, used also by QML
+    // managers which live in other threads
+    static void configure(QNetworkRequest &request);
+    static void keepSession(QNetworkReply *reply);
+    // Cookies of replies are stored and sent with next requests
+    static void useCookieJar(QNetworkRequest &request);
+
+    // Opens connection to host of url in advance, so the first request
+    // skips DNS lookup, TCP and TLS handshakes
+    void prewarm(const QUrl &url);
+
+   protected:
+    QNetworkReply *createRequest(Operation operation,
+                                 const QNetworkRequest &request,
+                                 QIODevice *outgoingData) override;
+
+   private:
+    static const QNetworkRequest::Attribute cookieJarAttribute =
+        static_cast<QNetworkRequest::Attribute>(QNetworkRequest::User + 1);
+    static QUrl replayUrl;
+    static QMutex sessionsMutex;
+    static QHash<QString, QByteArray> sessions;
+
+    static QUrl replayed(QUrl url);
+    static QString sessionKey(const QUrl &url);
+    static QSslConfiguration sslConfiguration(const QUrl &url,
+                                              QSslConfiguration config);
+};
+
+#endif  // NETWORKMANAGER_H
@@ -18,7 +18,11 @@
 */
 
 #include <QRegExp>
+#include <QSet>
 #include <QtCore/qmath.h>
+#include <QMetaEnum>
+#include <QMutexLocker>
+#include <QTimer>
 
 #include "nvfetcher.h"
 #include "settings.h"
@@ -31,6 +35,11 @@ NvFetcher::NvFetcher(QObject *parent) :
 {
 }
 
+QUrl NvFetcher::serviceUrl() const
+{
+    return QUrl("https://www.netvibes.com");
+}
+
 void NvFetcher::signIn()
 {
     data.clear();
@@ -109,6 +118,11 @@ void NvFetcher::startFetching()
 {
     auto db = DatabaseManager::instance();
 
+    if (busyType == Fetcher::Refreshing) {
+        startRefresh();
+        return;
+    }
+
     storedStreamList = db->readStreamModuleTabListWithoutDate();
 
     //Backup
@@ -119,9 +133,8 @@ void NvFetcher::startFetching()
         return;
     }
 
-    db->cleanDashboards();
-    db->cleanTabs();
-    db->cleanModules();
+    // Fetched structure is compared with stored one when all tabs are fetched
+    structure = DatabaseManager::Structure();
 
     // Create Cache structure
     if(busyType == Fetcher::Initiating) {
@@ -131,6 +144,27 @@ void NvFetcher::startFetching()
     fetchDashboards();
 }
 
+// Only due streams are updated, dashboards and tabs are kept
+void NvFetcher::startRefresh()
+{
+    auto db = DatabaseManager::instance();
+
+    streamUpdateList.clear();
+    for (const auto &smt : db->readStreamModuleTabList()) {
+        if (refreshStreams.contains(smt.streamId))
+            streamUpdateList.append(smt);
+    }
+
+    if (streamUpdateList.isEmpty()) {
+        taskEnd();
+        return;
+    }
+
+    proggressTotal = qCeil(streamUpdateList.count()/feedsUpdateAtOnce)+1;
+    emit progress(1,proggressTotal);
+    fetchFeedsUpdate();
+}
+
 /*void NvFetcher::fetchDashboards()
 {
     data.clear();
@@ -201,54 +235,283 @@ void NvFetcher::fetchTabs()
     connect(currentReply, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(networkError(QNetworkReply::NetworkError)));
 }
 
+static const JsonEntryDecoder::Table &feedsTable()
+{
+    static const JsonEntryDecoder::Table table = [] {
+        JsonEntryDecoder::Table t;
+        t.itemsPath = QStringList{"results", "*", "items"};
+        t.captures = {QStringList{"success"}, QStringList{"error"},
+                      QStringList{"results", "*", "streams"}};
+        t.fields = {
+            {"id", [](DatabaseManager::Entry &e, const QVariant &v) { e.id = v.toString(); }},
+            {"stream/id", [](DatabaseManager::Entry &e, const QVariant &v) { e.streamId = v.toString(); }},
+            {"title", [](DatabaseManager::Entry &e, const QVariant &v) { e.title = v.toString(); }},
+            {"link", [](DatabaseManager::Entry &e, const QVariant &v) { e.link = v.toString(); }},
+            {"content", [](DatabaseManager::Entry &e, const QVariant &v) { e.content = v.toString(); }},
+            {"publishedAt", [](DatabaseManager::Entry &e, const QVariant &v) { e.publishedAt = v.toDouble(); }},
+            {"createdAt", [](DatabaseManager::Entry &e, const QVariant &v) { e.createdAt = v.toDouble(); }},
+            // Flags object without "read" means unknown read state
+            {"flags", [](DatabaseManager::Entry &e, const QVariant &) { e.read = 2; }},
+            {"flags/read", [](DatabaseManager::Entry &e, const QVariant &v) { e.read = v.toBool() ? 1 : 0; }},
+            {"flags/saved", [](DatabaseManager::Entry &e, const QVariant &v) { e.saved = v.toBool() ? 1 : 0; }},
+            {"enclosures/*/link", nullptr},
+            {"enclosures/*/type", nullptr},
+            {"authors/*/name", nullptr}
+        };
+        t.init = [](DatabaseManager::Entry &e) {
+            e.read = 1;
+        };
+        t.finish = [](DatabaseManager::Entry &e, const QVariantHash &extras) {
+            QString type = extras.value("enclosures/*/type").toString();
+            if (type == "image" || type == "html")
+                e.image = extras.value("enclosures/*/link").toString();
+            e.author = extras.value("authors/*/name").toString();
+            e.cached = 0;
+            e.fresh = 1;
+            e.broadcast = 0;
+        };
+        return t;
+    }();
+
+    return table;
+}
+
 void NvFetcher::fetchFeeds()
 {
-    data.clear();
+    startFeeds(false);
+}
 
-    Settings *s = Settings::instance();
+void NvFetcher::fetchFeedsUpdate()
+{
+    startFeeds(true);
+}
 
-    QUrl url("https://www.netvibes.com/api/streams?pageId="+s->getDashboardInUse());
-    QNetworkRequest request(url);
+// Streams are sent in batches, several at once. Batch size starts from
+// configured value and is adapted to replies by feedsTuner.
+void NvFetcher::startFeeds(bool update)
+{
+    feedsUpdate = update;
+    feedsFanOut = true;
+    feedsRetries = 0;
+    feedsTuner.reset(update ? feedsUpdateAtOnce : Settings::instance()->getFeedsAtOnce(), 2);
 
-    if (currentReply != NULL) {
-        currentReply->disconnect();
-        currentReply->deleteLater();
-        currentReply = NULL;
+    dispatchFeeds();
+
+    if (feedsReplies.isEmpty()) {
+        if (update)
+            finishedFeedsUpdate2();
+        else
+            finishedFeeds2();
     }
+}
 
-    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json; charset=UTF-8");
-    setCookie(request, s->getCookie().toLatin1());
+QList<DatabaseManager::StreamModuleTab> &NvFetcher::pendingFeeds()
+{
+    return feedsUpdate ? streamUpdateList : streamList;
+}
 
-    int feedsAtOnce = s->getFeedsAtOnce();
+QString NvFetcher::feedsContent(const QList<DatabaseManager::StreamModuleTab> &streams)
+{
+    Settings *s = Settings::instance();
 
-    int ii = 0;
     QString content = "[";
-    QList<DatabaseManager::StreamModuleTab>::iterator i = streamList.begin();
-    while (i != streamList.end()) {
-        if (ii > feedsAtOnce)
-            break;
-
-        if (ii != 0)
+    QList<DatabaseManager::StreamModuleTab>::const_iterator i = streams.constBegin();
+    while (i != streams.constEnd()) {
+        if (i != streams.constBegin())
             content += ",";
 
-        content += "{\"options\":{";
-        if (!s->getSyncRead())
-            content += "\"filter\":\"unread\",";
-        content += QString("\"limit\":%1},\"streams\":[{\"id\":\"%2\",\"moduleId\":\"%3\"}]}")
-                .arg(limitFeeds)
-                .arg((*i).streamId, (*i).moduleId);
-
-        //qDebug() << "streamId:" << (*i).streamId << "moduleId:" << (*i).moduleId;
+        if (feedsUpdate) {
+            content += QString("{\"options\":{\"limit\":%1},\"crawledAfterDate\":%2,"
+                               "\"streams\":[{\"id\":\"%3\",\"moduleId\":\"%4\"}]}")
+                    .arg(limitFeedsUpdate)
+                    .arg((*i).date)
+                    .arg((*i).streamId, (*i).moduleId);
+        } else {
+            content += "{\"options\":{";
+            if (!s->getSyncRead())
+                content += "\"filter\":\"unread\",";
+            content += QString("\"limit\":%1},\"streams\":[{\"id\":\"%2\",\"moduleId\":\"%3\"}]}")
+                    .arg(limitFeeds)
+                    .arg((*i).streamId, (*i).moduleId);
+        }
 
-        i = streamList.erase(i);
-        ++ii;
+        ++i;
     }
     content += "]";
 
-    currentReply = nam.post(request, content.toUtf8());
-    connect(currentReply, SIGNAL(finished()), this, SLOT(finishedFeeds()));
-    connect(currentReply, SIGNAL(readyRead()), this, SLOT(readyRead()));
-    connect(currentReply, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(networkError(QNetworkReply::NetworkError)));
+    return content;
+}
+
+void NvFetcher::dispatchFeeds()
+{
+    Settings *s = Settings::instance();
+    auto &pending = pendingFeeds();
+
+    // Batches waiting for worker are also counted, so downloading
+    // stops when DB writes can't keep up
+    while (!pending.isEmpty() &&
+           feedsReplies.count() < feedsTuner.concurrency() &&
+           feedsReplies.count() + queuedFeedsBatches() < feedsTuner.concurrency() + maxQueuedPages) {
+        auto state = std::make_shared<FeedsReply>();
+        state->streams = pending.mid(0, feedsTuner.size());
+        pending.erase(pending.begin(), pending.begin() + state->streams.count());
+        state->decoder.reset(new JsonEntryDecoder(feedsTable()));
+        auto entries = &state->entries;
+        state->decoder->setBatchHandler([entries](const QList<DatabaseManager::Entry> &batch) {
+            entries->append(batch);
+        });
+
+        QUrl url("https://www.netvibes.com/api/streams?pageId="+s->getDashboardInUse());
+        QNetworkRequest request(url);
+        request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json; charset=UTF-8");
+        setCookie(request, s->getCookie().toLatin1());
+
+        state->timer.start();
+        QNetworkReply *reply = nam.post(request, feedsContent(state->streams).toUtf8());
+        feedsReplies.insert(reply, state);
+
+        connect(reply, &QNetworkReply::readyRead, this, [this, reply] {
+            int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            auto state = feedsReplies.value(reply);
+            if (state && statusCode >= 200 && statusCode < 300) {
+                QByteArray chunk = reply->readAll();
+                state->bytes += chunk.size();
+                feedDecoder(state->decoder.get(), chunk);
+            }
+        });
+        connect(reply, &QNetworkReply::finished, this, [this, reply] {
+            finishedFeedsBatch(reply);
+        });
+#ifndef QT_NO_SSL
+        connect(reply, &QNetworkReply::sslErrors, this, &Fetcher::sslErrors);
+#endif
+        QTimer::singleShot(feedsTimeout, reply, [this, reply] {
+            auto state = feedsReplies.value(reply);
+            if (state) {
+                state->timedOut = true;
+                reply->abort();
+            }
+        });
+    }
+}
+
+void NvFetcher::finishedFeedsBatch(QNetworkReply *reply)
+{
+    auto state = feedsReplies.take(reply);
+    reply->deleteLater();
+
+    if (!busy || !state)
+        return;
+
+    auto e = reply->error();
+    if (e != QNetworkReply::NoError && (state->timedOut || isTransientError(reply)) &&
+        feedsRetries < maxRetries) {
+        feedsTuner.failed();
+
+        int delay = retryDelay << feedsRetries++;
+        qWarning() << "Transient network error:" << e << "timeout:" << state->timedOut
+                   << "retry" << feedsRetries << "in" << delay << "ms";
+
+        // Streams go back to the front, so they are sent again in
+        // smaller batches
+        auto streams = state->streams;
+        ++feedsRetrying;
+        int generation = feedsGeneration;
+        QTimer::singleShot(delay, this, [this, streams, generation] {
+            if (!busy || generation != feedsGeneration)
+                return;
+            --feedsRetrying;
+            auto &pending = pendingFeeds();
+            for (int i = streams.count() - 1; i >= 0; --i)
+                pending.prepend(streams.at(i));
+            dispatchFeeds();
+        });
+        return;
+    }
+
+    int code = 0;
+    if (e != QNetworkReply::NoError) {
+        qWarning() << "Request error:" << e;
+        code = e == QNetworkReply::SslHandshakeFailedError ? 700 : 500;
+    } else if (!state->decoder->finish()) {
+        qWarning() << "Error parsing Json:" << state->decoder->errorString();
+        code = 600;
+    }
+
+    if (code != 0) {
+        abortFeeds();
+
+        // Restoring backup, refresh doesn't make it
+        auto db = DatabaseManager::instance();
+        if (busyType != Fetcher::Refreshing && !db->restoreBackup()) {
+            qWarning() << "Unable to restore DB backup";
+        }
+
+        emit error(code);
+        setBusy(false);
+        return;
+    }
+
+    feedsRetries = 0;
+    feedsTuner.succeeded(state->streams.count(), state->timer.elapsed(), state->bytes);
+
+    FeedsBatch batch;
+    batch.captured = state->decoder->captured();
+    batch.entries.swap(state->entries);
+    {
+        QMutexLocker locker(&feedsMutex);
+        feedsBatches.append(batch);
+    }
+
+    if (currentJob == Idle)
+        startJob(feedsUpdate ? StoreFeedsUpdate : StoreFeeds);
+
+    dispatchFeeds();
+}
+
+void NvFetcher::abortFeeds()
+{
+    feedsFanOut = false;
+    feedsRetrying = 0;
+    ++feedsGeneration;
+
+    {
+        QMutexLocker locker(&feedsMutex);
+        feedsBatches.clear();
+    }
+
+    auto replies = feedsReplies.keys();
+    feedsReplies.clear();
+    for (auto reply : replies) {
+        reply->disconnect(this);
+        reply->abort();
+        reply->deleteLater();
+    }
+}
+
+bool NvFetcher::abortRequests()
+{
+    if (!feedsFanOut)
+        return Fetcher::abortRequests();
+
+    abortFeeds();
+    emit canceled();
+    return false;
+}
+
+int NvFetcher::queuedFeedsBatches()
+{
+    QMutexLocker locker(&feedsMutex);
+    return feedsBatches.count();
+}
+
+bool NvFetcher::takeFeedsBatch(FeedsBatch *batch)
+{
+    QMutexLocker locker(&feedsMutex);
+    if (feedsBatches.isEmpty())
+        return false;
+    *batch = feedsBatches.takeFirst();
+    return true;
 }
 
 void NvFetcher::fetchFeedsReadlater()
@@ -284,12 +547,16 @@ void NvFetcher::fetchFeedsReadlater()
     //qDebug() << content;
 
     currentReply = nam.post(request, content.toUtf8());
+    startDecoding(feedsTable());
     connect(currentReply, SIGNAL(finished()), this, SLOT(finishedFeedsReadlater()));
     connect(currentReply, SIGNAL(readyRead()), this, SLOT(readyRead()));
     connect(currentReply, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(networkError(QNetworkReply::NetworkError)));
 }
 
-void NvFetcher::fetchFeedsUpdate()
+// Newest item of every stream is requested in one call, so streams
+// are stored again and their newestItemAddedAt can be compared with
+// values stored before update
+void NvFetcher::probeFeeds()
 {
     data.clear();
 
@@ -307,41 +574,37 @@ void NvFetcher::fetchFeedsUpdate()
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json; charset=UTF-8");
     setCookie(request, s->getCookie().toLatin1());
 
-    int ii = 0;
     QString content = "[";
     QList<DatabaseManager::StreamModuleTab>::iterator i = streamUpdateList.begin();
     while (i != streamUpdateList.end()) {
-        if (ii >= feedsUpdateAtOnce)
-            break;
-
-        if (ii != 0)
+        if (i != streamUpdateList.begin())
             content += ",";
 
-        content += QString("{\"options\":{\"limit\":%1},\"crawledAfterDate\":%2,"
-                           "\"streams\":[{\"id\":\"%3\",\"moduleId\":\"%4\"}]}")
-                .arg(limitFeedsUpdate)
-                .arg((*i).date)
+        content += QString("{\"options\":{\"limit\":1},"
+                           "\"streams\":[{\"id\":\"%1\",\"moduleId\":\"%2\"}]}")
                 .arg((*i).streamId, (*i).moduleId);
 
-        i = streamUpdateList.erase(i);
-        ++ii;
+        ++i;
     }
     content += "]";
 
     currentReply = nam.post(request, content.toUtf8());
-
-    connect(currentReply, SIGNAL(finished()), this, SLOT(finishedFeedsUpdate()));
+    startDecoding(feedsTable());
+    connect(currentReply, SIGNAL(finished()), this, SLOT(finishedFeedsProbe()));
     connect(currentReply, SIGNAL(readyRead()), this, SLOT(readyRead()));
     connect(currentReply, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(networkError(QNetworkReply::NetworkError)));
 }
 
-void NvFetcher::setAction()
+int NvFetcher::actionsAtOnce() const
 {
-    data.clear();
+    return itemActionsAtOnce;
+}
 
+QNetworkReply *NvFetcher::sendActions(const ActionGroup &group)
+{
     auto s = Settings::instance();
     auto db = DatabaseManager::instance();
-    DatabaseManager::Action action = actionsList.first();
+    const DatabaseManager::Action &action = group.actions.first();
 
     QUrl url;
 
@@ -373,18 +636,11 @@ void NvFetcher::setAction()
     default:
         // Unknown action -> skiping
         qWarning("Unknown action!");
-        finishedSetAction();
-        return;
+        return NULL;
     }
 
     QNetworkRequest request(url);
 
-    if (currentReply != NULL) {
-        currentReply->disconnect();
-        currentReply->deleteLater();
-        currentReply = NULL;
-    }
-
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json; charset=UTF-8");
     request.setRawHeader("Content-Encoding", "gzip");
     setCookie(request, s->getCookie().toLatin1());
@@ -398,8 +654,7 @@ void NvFetcher::setAction()
 
         if (list.empty()) {
             qWarning() << "Action is broken";
-            removeAction();
-            return;
+            return NULL;
         }
 
         int lastPublishedAt = db->readLastPublishedAtByTab(action.id1)+1;
@@ -426,8 +681,7 @@ void NvFetcher::setAction()
 
         if (list.empty()) {
             qWarning() << "Action is broken";
-            removeAction();
-            return;
+            return NULL;
         }
 
         int lastPublishedAt = db->readLastPublishedAtByDashboard(s->getDashboardInUse())+1;
@@ -454,8 +708,7 @@ void NvFetcher::setAction()
 
         if (list.empty()) {
             qWarning() << "Action is broken";
-            removeAction();
-            return;
+            return NULL;
         }
 
         int lastPublishedAt = db->readLastPublishedAtSlowByDashboard(s->getDashboardInUse())+1;
@@ -490,13 +743,32 @@ void NvFetcher::setAction()
             action.type == DatabaseManager::SetSaved ||
             action.type == DatabaseManager::UnSetSaved ) {
 
-        if (action.date1==0) {
-            qWarning() << "PublishedAt date is 0";
+        // Items of one stream are sent together
+        QStringList streamIds;
+        QHash<QString, QStringList> items;
+        for (const auto &a : group.actions) {
+            if (a.date1==0) {
+                qWarning() << "PublishedAt date is 0";
+            }
+
+            if (!items.contains(a.id2))
+                streamIds.append(a.id2);
+            items[a.id2].append(QString("{\"id\":\"%1\",\"publishedAt\":%2}")
+                                .arg(a.id1).arg(a.date1));
         }
 
-        actions += QString("{\"streams\":[{\"id\":\"%1\",\"items\":[{"
-                           "\"id\":\"%2\",\"publishedAt\":%3}]}]}")
-                .arg(action.id2, action.id1).arg(action.date1);
+        actions += "{\"streams\":[";
+        QStringList::iterator i = streamIds.begin();
+        while (i != streamIds.end()) {
+            if (i != streamIds.begin())
+                actions += ",";
+
+            actions += QString("{\"id\":\"%1\",\"items\":[%2]}")
+                    .arg(*i, items.value(*i).join(","));
+
+            ++i;
+        }
+        actions += "]}";
 
         //qDebug() << actions;
     }
@@ -527,11 +799,33 @@ void NvFetcher::setAction()
     //QString content = "actions="+QUrl::toPercentEncoding(actions)+"&pageId="+s->getDashboardInUse();
     //QString content = "actions="+QUrl::toPercentEncoding(actions)+"&pageId="+s->getDashboardInUse();
 
-    currentReply = nam.post(request, actions.toUtf8());
+    return nam.post(request, actions.toUtf8());
+}
 
-    connect(currentReply, SIGNAL(finished()), this, SLOT(finishedSetAction()));
-    connect(currentReply, SIGNAL(readyRead()), this, SLOT(readyRead()));
-    connect(currentReply, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(networkError(QNetworkReply::NetworkError)));
+int NvFetcher::checkActionsReply(QNetworkReply *reply, const ActionGroup &group)
+{
+    Q_UNUSED(group)
+
+    if (reply->error()) {
+        if (reply->error() == QNetworkReply::OperationCanceledError ||
+            reply->error() == QNetworkReply::TimeoutError ) {
+            return -1;
+        }
+
+        qWarning() << "Unknown error in setAction reply";
+        return 0;
+    }
+
+    data = reply->readAll();
+
+    if (!parse()) {
+        qWarning() << "Error parsing Json";
+        return 600;
+    }
+
+    checkError();
+
+    return 0;
 }
 
 
@@ -880,6 +1174,13 @@ void NvFetcher::finishedTabs2()
         if (tabList.isEmpty()) {
             qWarning() << "No Tabs";
         }
+
+        // Only changed part of structure is written, entries of removed
+        // streams are deleted with them
+        auto diff = db->writeStructure(structure);
+        structure = DatabaseManager::Structure();
+        structureChanged = !diff.isEmpty();
+
         if (streamList.isEmpty()) {
             qWarning() << "No Streams";
             taskEnd();
@@ -889,17 +1190,15 @@ void NvFetcher::finishedTabs2()
                 db->updateEntriesFreshFlag(0);
 
                 streamUpdateList = db->readStreamModuleTabList();
+                probeWatermarks = db->readStreamWatermarks();
 
-                cleanRemovedFeeds();
                 cleanNewFeeds();
 
-                db->cleanStreams();
-
                 if (streamList.isEmpty()) {
                     qDebug() << "No new Feeds";
-                    proggressTotal = qCeil(streamUpdateList.count()/feedsUpdateAtOnce)+3;
+                    proggressTotal = qCeil(streamUpdateList.count()/feedsUpdateAtOnce)+4;
                     emit progress(3,proggressTotal);
-                    fetchFeedsUpdate();
+                    probeFeeds();
                 } else {
                     proggressTotal = qCeil(streamUpdateList.count()/feedsUpdateAtOnce)+qCeil(streamList.count()/feedsAtOnce)+3;
                     emit progress(3,proggressTotal);
@@ -920,45 +1219,38 @@ void NvFetcher::finishedTabs2()
     }
 }
 
-void NvFetcher::finishedFeeds()
+void NvFetcher::finishedFeeds2()
 {
-    //qDebug() << data;
-    if (currentReply->error()) {
-
-        // Restoring backup
-        auto db = DatabaseManager::instance();
-        if (!db->restoreBackup()) {
-            qWarning() << "Unable to restore DB backup";
-        }
+    auto db = DatabaseManager::instance();
 
-        emit error(500);
-        setBusy(false);
+    if (!busy || !feedsFanOut)
         return;
-    }
 
-    startJob(StoreFeeds);
-}
+    emit progress(proggressTotal-((streamList.count()/feedsAtOnce)+(streamUpdateList.count()/feedsUpdateAtOnce)),proggressTotal);
 
-void NvFetcher::finishedFeeds2()
-{
-    auto db = DatabaseManager::instance();
+    dispatchFeeds();
 
-    emit progress(proggressTotal-((streamList.count()/feedsAtOnce)+(streamUpdateList.count()/feedsUpdateAtOnce)),proggressTotal);
+    // Batches queued after worker had finished
+    if (queuedFeedsBatches() > 0) {
+        if (currentJob == Idle)
+            startJob(StoreFeeds);
+        return;
+    }
 
-    if (streamList.isEmpty()) {
+    // Next reply will start worker when downloaded
+    if (!feedsReplies.isEmpty() || feedsRetrying > 0)
+        return;
 
-        if(busyType == Fetcher::Updating) {
-            streamUpdateList = db->readStreamModuleTabList();
-            fetchFeedsUpdate();
-        }
+    feedsFanOut = false;
 
-        if(busyType == Fetcher::Initiating) {
-            publishedBeforeDate = 0;
-            fetchFeedsReadlater();
-        }
+    if(busyType == Fetcher::Updating) {
+        streamUpdateList = db->readStreamModuleTabList();
+        probeFeeds();
+    }
 
-    } else {
-        fetchFeeds();
+    if(busyType == Fetcher::Initiating) {
+        publishedBeforeDate = 0;
+        fetchFeedsReadlater();
     }
 }
 
@@ -1002,7 +1294,7 @@ void NvFetcher::finishedFeedsReadlater2()
     }
 }
 
-void NvFetcher::finishedFeedsUpdate()
+void NvFetcher::finishedFeedsProbe()
 {
     //qDebug() << data;
     if (currentReply->error()) {
@@ -1018,73 +1310,103 @@ void NvFetcher::finishedFeedsUpdate()
         return;
     }
 
-    startJob(StoreFeedsUpdate);
+    startJob(StoreFeedsProbe);
 }
 
-void NvFetcher::finishedFeedsUpdate2()
+// Only streams with newer items are updated, streams added in this
+// sync were already fetched
+void NvFetcher::finishedFeedsProbe2()
 {
-    emit progress(proggressTotal-qCeil(streamUpdateList.count()/feedsUpdateAtOnce),proggressTotal);
+    auto db = DatabaseManager::instance();
+    auto watermarks = db->readStreamWatermarks();
 
-    if (streamUpdateList.isEmpty()) {
-        // Fetching Saved items
-        publishedBeforeDate = 0;
+    QList<DatabaseManager::StreamModuleTab> changed;
+    QList<DatabaseManager::StreamModuleTab>::iterator i = streamUpdateList.begin();
+    while (i != streamUpdateList.end()) {
+        if (probeWatermarks.contains((*i).streamId) &&
+                watermarks.value((*i).streamId).newestItemAddedAt >
+                probeWatermarks.value((*i).streamId).newestItemAddedAt)
+            changed.append(*i);
+        ++i;
+    }
 
-        auto s = Settings::instance();
-        auto db = DatabaseManager::instance();
+    reportProbe(changed.size(), streamUpdateList.size());
 
-        db->updateEntriesSavedFlagByFlagAndDashboard(s->getDashboardInUse(),1,9);
-        fetchFeedsReadlater();
-    } else {
-        fetchFeedsUpdate();
+    probeWatermarks.clear();
+    streamUpdateList = changed;
+
+    if (streamUpdateList.isEmpty()) {
+        dashboardList.clear();
+        tabList.clear();
+        streamList.clear();
+        storedStreamList.clear();
+
+        taskEnd();
+        return;
     }
+
+    proggressTotal = qCeil(streamUpdateList.count()/feedsUpdateAtOnce)+4;
+    emit progress(4,proggressTotal);
+    fetchFeedsUpdate();
 }
 
-void NvFetcher::finishedSetAction()
+void NvFetcher::finishedFeedsUpdate2()
 {
-    if (currentReply != NULL) {
-        //qDebug() << data;
-        if (currentReply->error()) {
-            if (currentReply->error() == QNetworkReply::OperationCanceledError ||
-                currentReply->error() == QNetworkReply::TimeoutError ) {
-                setBusy(false);
-                return;
-            }
+    if (!busy || !feedsFanOut)
+        return;
 
-            qWarning() << "Unknown error in setAction reply";
+    emit progress(proggressTotal-qCeil(streamUpdateList.count()/feedsUpdateAtOnce),proggressTotal);
 
-            //emit error(500);
-            //setBusy(false);
-            //return;
+    dispatchFeeds();
 
-        } else if (!parse()) {
-            qWarning() << "Error parsing Json";
-            emit error(600);
-            setBusy(false);
-            return;
-        }
-
-        checkError();
+    // Batches queued after worker had finished
+    if (queuedFeedsBatches() > 0) {
+        if (currentJob == Idle)
+            startJob(StoreFeedsUpdate);
+        return;
     }
 
-    auto db = DatabaseManager::instance();
-
-    // Deleting action
-    DatabaseManager::Action action = actionsList.takeFirst();
-    db->removeActionsByIdAndType(action.id1, action.type);
+    // Next reply will start worker when downloaded
+    if (!feedsReplies.isEmpty() || feedsRetrying > 0)
+        return;
 
-    // Updating upload proggres
-    emit uploadProgress(this->uploadProggressTotal - actionsList.size(), this->uploadProggressTotal);
+    feedsFanOut = false;
 
-    if (actionsList.isEmpty()) {
-        db->cleanDashboards();
-        startFetching();
-    } else {
-        uploadActions();
+    if (busyType == Fetcher::Refreshing) {
+        taskEnd();
+        return;
     }
+
+    // Fetching Saved items
+    publishedBeforeDate = 0;
+
+    auto s = Settings::instance();
+    auto db = DatabaseManager::instance();
+
+    db->updateEntriesSavedFlagByFlagAndDashboard(s->getDashboardInUse(),1,9);
+    fetchFeedsReadlater();
 }
 
 void NvFetcher::run()
 {
+    // Stream batches are decoded before they are queued
+    if (currentJob == StoreFeeds || currentJob == StoreFeedsUpdate) {
+        storeFeedsBatches();
+        return;
+    }
+
+    if (!parse()) {
+        qWarning() << "Error parsing Json";
+        jobError = 600;
+        return;
+    }
+
+    if (jsonObj.contains("success") && !jsonObj["success"].toBool()) {
+        qWarning() << "Netvibes API error!" << jsonObj;
+        jobError = 500;
+        return;
+    }
+
     int count = 0;
     switch (currentJob) {
     case StoreDashboards:
@@ -1093,8 +1415,7 @@ void NvFetcher::run()
     case StoreTabs:
         storeTabs();
         break;
-    case StoreFeeds:
-    case StoreFeedsUpdate:
+    case StoreFeedsProbe:
         storeFeeds();
         break;
     case StoreFeedsReadlater:
@@ -1115,83 +1436,92 @@ void NvFetcher::startJob(Job job)
         return;
     }
 
-    auto *s = Settings::instance();
-    auto db = DatabaseManager::instance();
-
     disconnect(this, SIGNAL(finished()), 0, 0);
     currentJob = job;
+    jobError = 0;
     //qDebug() << "Job:" << job;
 
-    if(parse()) {
-        if (jsonObj.contains("success") && !jsonObj["success"].toBool()) {
+    switch (job) {
+    case StoreDashboards:
+    case StoreTabs:
+    case StoreFeeds:
+    case StoreFeedsUpdate:
+    case StoreFeedsReadlater:
+    case StoreFeedsProbe:
+        connect(this, SIGNAL(finished()), this, SLOT(finishedJob()));
+        break;
+    default:
+        qWarning() << "Unknown Job";
+        emit error(502);
+        setBusy(false);
+        return;
+    }
 
-            // If credentials other than Netvibes, prompting for re-auth
-            if (s->getSigninType()>0) {
-                qWarning() << "Cookie expires";
-                s->setCookie("");
-                setBusy(false);
-                emit error(403);
-                return;
-            }
+    start(QThread::LowPriority);
+}
 
-            qWarning() << "Netvibes API error!" << jsonObj;
+void NvFetcher::finishedJob()
+{
+    // Worker is idle from now, even if finished() arrives after
+    // the next reply
+    Job job = currentJob;
+    currentJob = Idle;
+    recordJob(QMetaEnum::fromType<Job>().valueToKey(job));
 
-            // Restoring backup
-            if (!db->restoreBackup()) {
-                qWarning() << "Unable to restore DB backup";
-            }
+    auto *s = Settings::instance();
+    auto db = DatabaseManager::instance();
 
-            setBusy(false);
-            emit error(500);
-            //update();
-            return;
-        }
-    } else {
-        qWarning() << "Error parsing Json";
+    if (jobError != 0)
+        abortFeeds();
 
-        // Restoring backup
-        if (!db->restoreBackup()) {
+    if (jobError == 500 && s->getSigninType()>0) {
+        // If credentials other than Netvibes, prompting for re-auth
+        qWarning() << "Cookie expires";
+        s->setCookie("");
+        setBusy(false);
+        emit error(403);
+        return;
+    }
+
+    if (jobError != 0) {
+        // Restoring backup, refresh doesn't make it
+        if (busyType != Fetcher::Refreshing && !db->restoreBackup()) {
             qWarning() << "Unable to restore DB backup";
         }
 
-        emit error(600);
+        emit error(jobError);
         setBusy(false);
         return;
     }
 
     switch (job) {
     case StoreDashboards:
-        connect(this, SIGNAL(finished()), this, SLOT(finishedDashboards2()));
+        finishedDashboards2();
         break;
     case StoreTabs:
-        connect(this, SIGNAL(finished()), this, SLOT(finishedTabs2()));
+        finishedTabs2();
         break;
     case StoreFeeds:
-        connect(this, SIGNAL(finished()), this, SLOT(finishedFeeds2()));
-        break;
-    case StoreFeedsInfo:
-        connect(this, SIGNAL(finished()), this, SLOT(finishedFeedsInfo2()));
+        finishedFeeds2();
         break;
     case StoreFeedsUpdate:
-        connect(this, SIGNAL(finished()), this, SLOT(finishedFeedsUpdate2()));
+        finishedFeedsUpdate2();
         break;
     case StoreFeedsReadlater:
-        connect(this, SIGNAL(finished()), this, SLOT(finishedFeedsReadlater2()));
+        finishedFeedsReadlater2();
+        break;
+    case StoreFeedsProbe:
+        finishedFeedsProbe2();
         break;
     default:
         qWarning() << "Unknown Job";
-        emit error(502);
-        setBusy(false);
-        return;
+        break;
     }
-
-    start(QThread::LowPriority);
 }
 
 void NvFetcher::storeDashboardsByParsingHtml()
 {
     auto s = Settings::instance();
-    auto db = DatabaseManager::instance();
 
     QRegExp rx1("<div id=\"page-([^\"]*)\" class=\"[^\"]*private-page[^\"]*\" title=\"([^\"]*)\">");
     int pos = 0;
@@ -1203,7 +1533,7 @@ void NvFetcher::storeDashboardsByParsingHtml()
         d.name = rx1.cap(1);
         d.title = rx1.cap(2);
         d.description = rx1.cap(2);
-        db->writeDashboard(d);
+        structure.dashboards.append(d);
         dashboardList.append(d.id);
     }
 
@@ -1228,7 +1558,6 @@ void NvFetcher::storeDashboards()
     }
 
     auto s = Settings::instance();
-    auto db = DatabaseManager::instance();
 
 #if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
     if (jsonObj["dashboards"].isObject()) {
@@ -1259,7 +1588,7 @@ void NvFetcher::storeDashboards()
                 d.name = obj["name"].toString();
                 d.title = obj["title"].toString();
                 d.description = obj["description"].toString();
-                db->writeDashboard(d);
+                structure.dashboards.append(d);
                 dashboardList.append(d.id);
                 //qDebug() << "Writing dashboard: " << d.title;
 
@@ -1290,7 +1619,6 @@ void NvFetcher::storeTabs()
         return;
     }
 
-    auto db = DatabaseManager::instance();
     QString dashboardId = dashboardList.takeFirst();
 
 #if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
@@ -1331,7 +1659,7 @@ void NvFetcher::storeTabs()
             }
 #endif
 
-            db->writeTab(t);
+            structure.tabs.append(t);
             tabList.append(t.id);
 
             //qDebug() << "Writing tab: " << t.id << t.title;
@@ -1405,7 +1733,7 @@ void NvFetcher::storeTabs()
                     qWarning() << "Module"<<m.id<<"without streams";
                 }
 
-                db->writeModule(m);
+                structure.modules.append(m);
             }
         }
     }  else {
@@ -1419,9 +1747,7 @@ int NvFetcher::storeFeeds()
         return 0;
     }
 
-    auto s = Settings::instance();
     auto db = DatabaseManager::instance();
-    auto dm = DownloadManager::instance();
 
     int entriesCount = 0;
 
@@ -1505,154 +1831,46 @@ int NvFetcher::storeFeeds()
                 } else {
                     qWarning() << "No \"streams\" element found";
                 }
-#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
-                if (arr.at(i).toObject()["items"].isArray()) {
-                    QJsonArray aarr = arr.at(i).toObject()["items"].toArray();
-                    int aend = aarr.count();
-#else
-                if ((*i).toMap()["items"].type()==QVariant::List) {
-                    QVariantList::const_iterator ai = (*i).toMap()["items"].toList().constBegin();
-                    QVariantList::const_iterator aend = (*i).toMap()["items"].toList().constEnd();
-#endif
-                    for (int ai = 0; ai < aend; ++ai) {
-#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
-                        QJsonObject obj = aarr.at(ai).toObject();
-#else
-                        QVariantMap obj = (*ai).toMap();
-#endif
-                        int read = 1; int saved = 0;
-#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
-                        if (obj["flags"].isObject()) {
+            }
+        }
+    }  else {
+        qWarning() << "No \"relults\" element found";
+    }
 
-                            if (!obj["flags"].toObject().contains("read")) {
-                                read = 2;
-                            } else {
-                                read = obj["flags"].toObject()["read"].toBool() ? 1 : 0;
-                            }
+    // Entries were decoded from "items" while reply was downloaded
+    QList<DatabaseManager::Entry> entries;
+    entries.swap(decodedEntries);
 
-                            if (!obj["flags"].toObject().contains("saved")) {
-                                saved = 0;
-                            } else {
-                                saved = obj["flags"].toObject()["saved"].toBool() ? 1 : 0;
-                            }
-                        }
-#else
-                        if (obj["flags"].type()==QVariant::Map) {
+    for (const auto &e : entries) {
+        if (e.publishedAt>0)
+            publishedBeforeDate = e.publishedAt;
+    }
 
-                            if (!obj["flags"].toMap().contains("read")) {
-                                read = 2;
-                            } else {
-                                read = obj["flags"].toMap()["read"].toBool() ? 1 : 0;
-                            }
+    entriesCount = ingest.push(entries);
 
-                            if (!obj["flags"].toMap().contains("saved")) {
-                                saved = 0;
-                            } else {
-                                saved = obj["flags"].toMap()["saved"].toBool() ? 1 : 0;
-                            }
-                        }
-#endif
-                        QString image = "";
-#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
-                        if (obj["enclosures"].isArray()) {
-                            if (!obj["enclosures"].toArray().empty()) {
-                                QString link = obj["enclosures"].toArray()[0].toObject()["link"].toString();
-                                QString type = obj["enclosures"].toArray()[0].toObject()["type"].toString();
-#else
-                        if (obj["enclosures"].type()==QVariant::List) {
-                            if (!obj["enclosures"].toList().isEmpty()) {
-                                QString link = obj["enclosures"].toList()[0].toMap()["link"].toString();
-                                QString type = obj["enclosures"].toList()[0].toMap()["type"].toString();
-#endif
-                                if (type=="image"||type=="html")
-                                    image = link;
-                            }
-                        }
+    return entriesCount;
+}
 
-                        QString author = "";
-#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
-                        if (obj["authors"].isArray()) {
-                            if (!obj["authors"].toArray().empty())
-                                author = obj["authors"].toArray()[0].toObject()["name"].toString();
-                        }
-#else
-                        if (obj["authors"].type()==QVariant::List) {
-                            if (!obj["authors"].toList().isEmpty())
-                                author = obj["authors"].toList()[0].toMap()["name"].toString();
-                        }
-#endif
-                        DatabaseManager::Entry e;
-                        e.id = obj["id"].toString();
+// Worker takes batches until there are none left, batches downloaded
+// meanwhile are stored in the same job
+void NvFetcher::storeFeedsBatches()
+{
+    FeedsBatch batch;
+    while (takeFeedsBatch(&batch)) {
 #if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
-                        e.streamId = obj["stream"].toObject()["id"].toString();
+        jsonObj = QJsonObject::fromVariantMap(batch.captured);
 #else
-                        e.streamId = obj["stream"].toMap()["id"].toString();
+        jsonObj = batch.captured;
 #endif
-                        //e.title = obj["title"].toString().remove(QRegExp("<[^>]*>"));
-                        e.title = obj["title"].toString();
-                        e.author = author;
-                        e.link = obj["link"].toString();
-                        e.image = image;
-                        e.content = obj["content"].toString();
-                        e.read = read;
-                        e.saved = saved;
-                        e.cached = 0;
-                        e.publishedAt = obj["publishedAt"].toDouble();
-                        e.createdAt = obj["createdAt"].toDouble();
-                        e.fresh = 1;
-                        e.broadcast = 0;
-                        e.annotations = "";
-
-                        // Downloading image file
-                        if (s->getCachingMode() == 2 || (s->getCachingMode() == 1 && dm->isWLANConnected())) {
-                            if (image!="") {
-                                //qDebug() << "netvibes image:" << image;
-                                // Image provided by Netvibes API :-)
-                                if (!db->isCacheExistsByFinalUrl(Utils::hash(image))) {
-                                    DatabaseManager::CacheItem item;
-                                    item.origUrl = image;
-                                    item.finalUrl = image;
-                                    item.type = "entry-image";
-                                    emit addDownload(item);
-                                }
-                            } else {
-                                // Checking if content contains image
-                                QRegExp rx("<img\\s[^>]*src\\s*=\\s*(\"[^\"]*\"|'[^']*')", Qt::CaseInsensitive);
-                                if (rx.indexIn(e.content)!=-1) {
-                                    QString imgSrc = rx.cap(1); imgSrc = imgSrc.mid(1,imgSrc.length()-2);
-                                    if (!imgSrc.isEmpty()) {
-                                        imgSrc.replace("&amp;","&", Qt::CaseInsensitive);
-                                        if (!db->isCacheExistsByFinalUrl(Utils::hash(imgSrc))) {
-                                            DatabaseManager::CacheItem item;
-                                            item.origUrl = imgSrc;
-                                            item.finalUrl = imgSrc;
-                                            item.type = "entry-image";
-                                            emit addDownload(item);
-                                        }
-                                        e.image = imgSrc;
-                                        //qDebug() << "cap image:" << imgSrc;
-                                    }
-                                }
-                            }
-                        }
-
-                        db->writeEntry(e);
-                        ++entriesCount;
-                        //qDebug() << "entriesCount:" << entriesCount;
-
-                        if (e.publishedAt>0)
-                            publishedBeforeDate = e.publishedAt;
-                    }
-                } else {
-                    qWarning() << "No \"items\" element found";
-                }
-            }
+        if (jsonObj.contains("success") && !jsonObj["success"].toBool()) {
+            qWarning() << "Netvibes API error!" << jsonObj;
+            jobError = 500;
+            return;
         }
-    }  else {
-        qWarning() << "No \"relults\" element found";
-    }
 
-    return entriesCount;
+        decodedEntries.swap(batch.entries);
+        storeFeeds();
+    }
 }
 
 bool NvFetcher::checkError()
@@ -1715,92 +1933,32 @@ void NvFetcher::uploadActions()
     if (!actionsList.isEmpty()) {
         emit uploading();
         //qDebug() << "Uploading actions...";
-        setAction();
+        planActions();
+        dispatchActions();
     }
 }
 
 void NvFetcher::cleanNewFeeds()
 {
-    QList<DatabaseManager::StreamModuleTab> tmp_storedStreamList = QList<DatabaseManager::StreamModuleTab>(storedStreamList);
-    QList<DatabaseManager::StreamModuleTab>::iterator i = streamList.begin();
-    while (i != streamList.end()) {
-        //qDebug() << "streamList| streamId:" << (*i).streamId << "tabId:" << (*i).tabId;
-        QList<DatabaseManager::StreamModuleTab>::iterator ci = tmp_storedStreamList.begin();
-        bool newStream = true;
-        while (ci != tmp_storedStreamList.end()) {
-            //qDebug() << "tmp_storedStreamList| streamId:" << (*ci).streamId << "tabId:" << (*ci).tabId;
-            if ((*i).streamId==(*ci).streamId && (*i).tabId==(*ci).tabId) {
-                i = streamList.erase(i);
-                tmp_storedStreamList.erase(ci);
-                newStream = false;
-                break;
-            }
-
-            if ((*i).streamId==(*ci).streamId) {
-                qDebug() << "Old stream" << (*i).streamId << "in new tab" << (*i).tabId;
-            }
-            ++ci;
-        }
-        if (newStream) {
-            qDebug() << "New stream" << (*i).streamId << "in tab" << (*i).tabId;
-            ++i;
-        }
+    QSet<QString> storedKeys;
+    QSet<QString> storedStreams;
+    for (const auto &smt : storedStreamList) {
+        storedKeys.insert(smt.streamId + '/' + smt.tabId);
+        storedStreams.insert(smt.streamId);
     }
-}
-
-void NvFetcher::cleanRemovedFeeds()
-{
-    auto db = DatabaseManager::instance();
-    QList<DatabaseManager::StreamModuleTab>::iterator i = storedStreamList.begin();
-
-    while (i != storedStreamList.end()) {
-        bool removedStream = true;
-        QList<DatabaseManager::StreamModuleTab>::iterator ci = streamList.begin();
-        while (ci != streamList.end()) {
-            if ((*i).streamId == (*ci).streamId) {
-                removedStream = false;
-                if ((*i).tabId == (*ci).tabId) {
-                    //qDebug() << "Existing stream" << (*i).streamId << "in tab" << (*i).tabId;
-                } else {
-                    qDebug() << "Old stream" << (*i).streamId << "in new tab" << (*ci).tabId;
-                }
-                break;
-            }
 
-            ++ci;
+    QList<DatabaseManager::StreamModuleTab>::iterator i = streamList.begin();
+    while (i != streamList.end()) {
+        if (storedKeys.contains((*i).streamId + '/' + (*i).tabId)) {
+            i = streamList.erase(i);
+            continue;
         }
 
-        if (removedStream) {
-            qDebug() << "Removing stream" << (*i).streamId << "in tab" << (*i).tabId;
-            db->removeStreamsByStream((*i).streamId);
-
-            // Removing stream from streamUpdateList
-            QList<DatabaseManager::StreamModuleTab>::iterator sui = streamUpdateList.begin();
-            while (sui != streamUpdateList.end()) {
-                if ((*sui).streamId==(*i).streamId && (*sui).tabId==(*i).tabId) {
-                    //qDebug() << "Removing stream form streamUpdateList" << (*sui).streamId;
-                    streamUpdateList.erase(sui);
-                    break;
-                }
-                ++sui;
-            }
+        if (storedStreams.contains((*i).streamId)) {
+            qDebug() << "Old stream" << (*i).streamId << "in new tab" << (*i).tabId;
+        } else {
+            qDebug() << "New stream" << (*i).streamId << "in tab" << (*i).tabId;
         }
-
         ++i;
     }
 }
-
-void NvFetcher::removeAction()
-{
-    DatabaseManager::Action action = actionsList.takeFirst();
-    auto db = DatabaseManager::instance();
-
-    db->removeActionsById(action.id1);
-
-    if (actionsList.isEmpty()) {
-        db->cleanDashboards();
-        startFetching();
-    } else {
-        uploadActions();
-    }
-}
@@ -24,8 +24,13 @@
 #include <QString>
 #include <QStringList>
 #include <QList>
+#include <QMap>
 #include <QVariantMap>
 #include <QNetworkRequest>
+#include <QHash>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <memory>
 #if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
 #include <QJsonArray>
 #else
@@ -34,6 +39,7 @@
 
 #include "fetcher.h"
 #include "databasemanager.h"
+#include "batchtuner.h"
 
 class NvFetcher : public Fetcher
 {
@@ -46,6 +52,7 @@ public:
 
 protected:
     void run();
+    bool abortRequests();
 
 private Q_SLOTS:
     void finishedGetAuthUrl();
@@ -55,24 +62,32 @@ private Q_SLOTS:
     void finishedDashboards2();
     void finishedTabs();
     void finishedTabs2();
-    void finishedFeeds();
+    void finishedFeedsBatch(QNetworkReply *reply);
     void finishedFeeds2();
-    void finishedFeedsUpdate();
     void finishedFeedsUpdate2();
+    void finishedFeedsProbe();
+    void finishedFeedsProbe2();
     void finishedFeedsReadlater();
     void finishedFeedsReadlater2();
-    void finishedSetAction();
+    void finishedJob();
 
 private:
     enum Job { Idle, StoreDashboards, StoreTabs, StoreFeeds,
-               StoreFeedsInfo, StoreFeedsUpdate, StoreFeedsReadlater
+               StoreFeedsInfo, StoreFeedsUpdate, StoreFeedsReadlater,
+               StoreFeedsProbe
              };
+    Q_ENUM(Job)
+
+    QUrl serviceUrl() const;
 
     static const int feedsAtOnce = 5;
     static const int limitFeeds = 25;
     static const int limitFeedsUpdate = 25;
     static const int limitFeedsReadlater = 25;
     static const int feedsUpdateAtOnce = 10;
+    // Stream batch requests not finished in that time are retried (ms)
+    static const int feedsTimeout = 30000;
+    static const int itemActionsAtOnce = 100;
 
     Job currentJob;
     QStringList dashboardList;
@@ -80,17 +95,59 @@ private:
     QList<DatabaseManager::StreamModuleTab> streamList;
     QList<DatabaseManager::StreamModuleTab> streamUpdateList;
     QList<DatabaseManager::StreamModuleTab> storedStreamList;
+    DatabaseManager::Structure structure;
     int publishedBeforeDate = 0;
+    // Stored streams state before update, compared with probe results
+    QMap<QString,DatabaseManager::Watermark> probeWatermarks;
+
+    // Streams of one batch request, several are in flight at once
+    struct FeedsReply {
+        QList<DatabaseManager::StreamModuleTab> streams;
+        std::unique_ptr<JsonEntryDecoder> decoder;
+        QList<DatabaseManager::Entry> entries;
+        QElapsedTimer timer;
+        qint64 bytes = 0;
+        bool timedOut = false;
+    };
+
+    // Downloaded batch waiting for worker thread
+    struct FeedsBatch {
+        QVariantMap captured;
+        QList<DatabaseManager::Entry> entries;
+    };
+
+    // Batch size and concurrency follow response time and size
+    BatchTuner feedsTuner;
+    bool feedsFanOut = false;
+    bool feedsUpdate = false;
+    QHash<QNetworkReply*, std::shared_ptr<FeedsReply>> feedsReplies;
+    // Batches waiting for retry, generation is changed on abort
+    int feedsRetrying = 0;
+    int feedsRetries = 0;
+    int feedsGeneration = 0;
+    QMutex feedsMutex;
+    QList<FeedsBatch> feedsBatches;
 
     void signIn();
     void startFetching();
+    void startRefresh();
     void uploadActions();
     void fetchDashboards(const QString &url = "http://www.netvibes.com/privatepage/0");
     void fetchTabs();
     void fetchFeeds();
     void fetchFeedsUpdate();
+    void startFeeds(bool update);
+    void dispatchFeeds();
+    void abortFeeds();
+    QList<DatabaseManager::StreamModuleTab> &pendingFeeds();
+    QString feedsContent(const QList<DatabaseManager::StreamModuleTab> &streams);
+    int queuedFeedsBatches();
+    bool takeFeedsBatch(FeedsBatch *batch);
+    void probeFeeds();
     void fetchFeedsReadlater();
-    void setAction();
+    int actionsAtOnce() const;
+    QNetworkReply *sendActions(const ActionGroup &group);
+    int checkActionsReply(QNetworkReply *reply, const ActionGroup &group);
 
     void startJob(Job job);
 
@@ -98,13 +155,12 @@ private:
     void storeDashboardsByParsingHtml();
     void storeTabs();
     int storeFeeds();
+    void storeFeedsBatches();
 
     void setCookie(QNetworkRequest &request, const QString &cookie);
     bool checkCookie(const QString &cookie);
     bool checkError();
     void cleanNewFeeds();
-    void cleanRemovedFeeds();
-    void removeAction();
 };
 
 #endif // NVFETCHER_H
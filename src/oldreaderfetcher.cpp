@@ -24,8 +24,10 @@
 #include <QJsonValue>
 #include <QJsonArray>
 #include <QList>
+#include <QSet>
 #include <QStringList>
 #include <QDateTime>
+#include <QMetaEnum>
 #include <math.h>
 #else
 #include "parser.h"
@@ -42,6 +44,11 @@ OldReaderFetcher::OldReaderFetcher(QObject *parent) :
 {
 }
 
+QUrl OldReaderFetcher::serviceUrl() const
+{
+    return QUrl("https://theoldreader.com");
+}
+
 void OldReaderFetcher::signIn()
 {
     data.clear();
@@ -120,39 +127,42 @@ QString OldReaderFetcher::getIdsFromActionString(const QString &actionString)
     return ids;
 }
 
-void OldReaderFetcher::setAction()
+int OldReaderFetcher::actionsAtOnce() const
 {
-    data.clear();
+    return editTagAtOnce;
+}
 
-    DatabaseManager::Action action = actionsList.first();
+// Item actions of the group are sent in one edit-tag request with many "i"
+QNetworkReply *OldReaderFetcher::sendActions(const ActionGroup &group)
+{
+    const DatabaseManager::Action &action = group.actions.first();
 
     auto s = Settings::instance();
     auto db = DatabaseManager::instance();
 
-    if (currentReply != NULL) {
-        currentReply->disconnect();
-        currentReply->deleteLater();
-        currentReply = NULL;
-    }
+    QStringList ids;
+    for (const auto &a : group.actions)
+        ids.append(QString("i=%1").arg(a.id1));
+    QString items = ids.join("&");
 
     QUrl url;
     QString body;
     switch (action.type) {
     case DatabaseManager::SetRead:
         url.setUrl("https://theoldreader.com/reader/api/0/edit-tag");
-        body = QString("a=user/-/state/com.google/read&i=%1").arg(action.id1);
+        body = QString("a=user/-/state/com.google/read&%1").arg(items);
         break;
     case DatabaseManager::UnSetRead:
         url.setUrl("https://theoldreader.com/reader/api/0/edit-tag");
-        body = QString("r=user/-/state/com.google/read&i=%1").arg(action.id1);
+        body = QString("r=user/-/state/com.google/read&%1").arg(items);
         break;
     case DatabaseManager::SetLiked:
         url.setUrl("https://theoldreader.com/reader/api/0/edit-tag");
-        body = QString("a=user/-/state/com.google/like&i=%1").arg(action.id1);
+        body = QString("a=user/-/state/com.google/like&%1").arg(items);
         break;
     case DatabaseManager::UnSetLiked:
         url.setUrl("https://theoldreader.com/reader/api/0/edit-tag");
-        body = QString("r=user/-/state/com.google/like&i=%1").arg(action.id1);
+        body = QString("r=user/-/state/com.google/like&%1").arg(items);
         break;
     case DatabaseManager::SetListRead:
         url.setUrl("https://theoldreader.com/reader/api/0/edit-tag");
@@ -160,11 +170,11 @@ void OldReaderFetcher::setAction()
         break;
     case DatabaseManager::SetSaved:
         url.setUrl("https://theoldreader.com/reader/api/0/edit-tag");
-        body = QString("a=user/-/state/com.google/starred&i=%1").arg(action.id1);
+        body = QString("a=user/-/state/com.google/starred&%1").arg(items);
         break;
     case DatabaseManager::UnSetSaved:
         url.setUrl("https://theoldreader.com/reader/api/0/edit-tag");
-        body = QString("r=user/-/state/com.google/starred&i=%1").arg(action.id1);
+        body = QString("r=user/-/state/com.google/starred&%1").arg(items);
         break;
     case DatabaseManager::SetStreamReadAll:
         url.setUrl("https://theoldreader.com/reader/api/0/mark-all-as-read");
@@ -172,21 +182,9 @@ void OldReaderFetcher::setAction()
                     QString::number(db->readLastLastUpdateByStream(action.id1))+"000000");
         break;
     case DatabaseManager::SetTabReadAll:
-        if (action.id1 == "subscriptions") {
-            // Adding SetStreamReadAll action for every stream in substriptions folder
-            QStringList list = db->readStreamIdsByTab("subscriptions");
-            QStringList::iterator it = list.begin();
-            while (it != list.end()) {
-                DatabaseManager::Action action;
-                action.type = DatabaseManager::SetStreamReadAll;
-                action.id1 = *it;
-                actionsList.insert(1,action);
-                ++it;
-            }
-
-            finishedSetAction();
-            return;
-        }
+        // Subscriptions folder was expanded into SetStreamReadAll actions
+        if (action.id1 == "subscriptions")
+            return NULL;
 
         url.setUrl("https://theoldreader.com/reader/api/0/mark-all-as-read");
         body = QString("s=%1&ts=%2").arg(action.id1,
@@ -200,19 +198,18 @@ void OldReaderFetcher::setAction()
     case DatabaseManager::SetBroadcast:
         url.setUrl("https://theoldreader.com/reader/api/0/edit-tag");
         if (action.text == "")
-            body = QString("a=user/-/state/com.google/broadcast&i=%1").arg(action.id1);
+            body = QString("a=user/-/state/com.google/broadcast&%1").arg(items);
         else
             body = QString("a=user/-/state/com.google/broadcast&i=%1&annotation=%2").arg(action.id1, action.text);
         break;
     case DatabaseManager::UnSetBroadcast:
         url.setUrl("https://theoldreader.com/reader/api/0/edit-tag");
-        body = QString("r=user/-/state/com.google/broadcast&i=%1").arg(action.id1);
+        body = QString("r=user/-/state/com.google/broadcast&%1").arg(items);
         break;
     default:
         // Unknown action -> skiping
         qWarning("Unknown action!");
-        finishedSetAction();
-        return;
+        return NULL;
     }
 
     QNetworkRequest request(url);
@@ -222,14 +219,29 @@ void OldReaderFetcher::setAction()
     request.setRawHeader("Authorization",QString("GoogleLogin auth=%1").arg(s->getCookie()).toLatin1());
     request.setRawHeader("Content-Encoding", "gzip");
 
-    currentReply = nam.post(request,body.toUtf8());
+    return nam.post(request, body.toUtf8());
+}
 
-    connect(currentReply, SIGNAL(finished()), this, SLOT(finishedSetAction()));
-    connect(currentReply, SIGNAL(readyRead()), this, SLOT(readyRead()));
-    connect(currentReply, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(networkError(QNetworkReply::NetworkError)));
+int OldReaderFetcher::checkActionsReply(QNetworkReply *reply, const ActionGroup &group)
+{
+    if (reply->error()) {
+        int code = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (code == 404 && group.actions.size() > 1) {
+            // Missing item is found by sending items one by one
+            qWarning() << "Action request returns 404, splitting group";
+            return splitActions;
+        } else if (code == 404) {
+            // Probably item already deleted -> skiping
+            qWarning() << "Action request returns 404";
+        } else {
+            return 500;
+        }
+    }
+
+    return 0;
 }
 
-void OldReaderFetcher::fetchFriends()
+void OldReaderFetcher::fetchFriends(bool conditional)
 {
     data.clear();
 
@@ -245,6 +257,8 @@ void OldReaderFetcher::fetchFriends()
     QNetworkRequest request(url);
 
     request.setRawHeader("Authorization",QString("GoogleLogin auth=%1").arg(s->getCookie()).toLatin1());
+    if (conditional)
+        setConditional(request);
 
     currentReply = nam.get(request);
 
@@ -271,6 +285,7 @@ void OldReaderFetcher::fetchTabs()
     QNetworkRequest request(url);
 
     request.setRawHeader("Authorization",QString("GoogleLogin auth=%1").arg(s->getCookie()).toLatin1());
+    setConditional(request);
 
     currentReply = nam.get(request);
 
@@ -279,7 +294,7 @@ void OldReaderFetcher::fetchTabs()
     connect(currentReply, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(networkError(QNetworkReply::NetworkError)));
 }
 
-void OldReaderFetcher::fetchFeeds()
+void OldReaderFetcher::fetchFeeds(bool conditional)
 {
     //qDebug() << "fetchFeeds";
     data.clear();
@@ -296,6 +311,8 @@ void OldReaderFetcher::fetchFeeds()
     QNetworkRequest request(url);
 
     request.setRawHeader("Authorization",QString("GoogleLogin auth=%1").arg(s->getCookie()).toLatin1());
+    if (conditional)
+        setConditional(request);
 
     currentReply = nam.get(request);
 
@@ -304,6 +321,62 @@ void OldReaderFetcher::fetchFeeds()
     connect(currentReply, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(networkError(QNetworkReply::NetworkError)));
 }
 
+static void setCategory(DatabaseManager::Entry &e, const QVariant &v)
+{
+    const QString category = v.toString();
+    if (category == "user/-/state/com.google/read")
+        e.read = 1;
+    else if (category == "user/-/state/com.google/starred")
+        e.saved = 1;
+    else if (category == "user/-/state/com.google/like")
+        e.liked = 1;
+    else if (category == "user/-/state/com.google/fresh")
+        e.freshOR = 1;
+    else if (category == "user/-/state/com.google/broadcast")
+        e.broadcast = 1;
+}
+
+static const JsonEntryDecoder::Table &streamTable()
+{
+    static const JsonEntryDecoder::Table table = [] {
+        JsonEntryDecoder::Table t;
+        t.itemsPath = QStringList{"items"};
+        t.captures = {QStringList{"updated"}, QStringList{"continuation"}};
+        t.fields = {
+            {"id", [](DatabaseManager::Entry &e, const QVariant &v) { e.id = v.toString(); }},
+            {"origin/streamId", [](DatabaseManager::Entry &e, const QVariant &v) { e.streamId = v.toString(); }},
+            {"title", [](DatabaseManager::Entry &e, const QVariant &v) { e.title = v.toString(); }},
+            {"author", [](DatabaseManager::Entry &e, const QVariant &v) { e.author = v.toString(); }},
+            {"summary/content", [](DatabaseManager::Entry &e, const QVariant &v) { e.content = v.toString(); }},
+            {"canonical/*/href", nullptr},
+            {"annotations/*", nullptr},
+            {"categories/*", setCategory},
+            {"published", [](DatabaseManager::Entry &e, const QVariant &v) { e.publishedAt = v.toDouble(); }},
+            {"updated", [](DatabaseManager::Entry &e, const QVariant &v) { e.createdAt = v.toDouble(); }},
+            {"crawlTimeMsec", [](DatabaseManager::Entry &e, const QVariant &v) {
+                 QString crawlTime = v.toString();
+                 crawlTime.chop(3); // converting Msec to sec
+                 e.crawlTime = crawlTime.toDouble();
+             }},
+            {"timestampUsec", [](DatabaseManager::Entry &e, const QVariant &v) {
+                 QString timestamp = v.toString();
+                 timestamp.chop(6); // converting Usec to sec
+                 e.timestamp = timestamp.toDouble();
+             }}
+        };
+        t.finish = [](DatabaseManager::Entry &e, const QVariantHash &extras) {
+            // Only first link and annotation are used
+            e.link = extras.value("canonical/*/href").toString();
+            e.annotations = extras.value("annotations/*").toString();
+            e.cached = 0;
+            e.fresh = 1;
+        };
+        return t;
+    }();
+
+    return table;
+}
+
 void OldReaderFetcher::fetchStream()
 {
     data.clear();
@@ -359,6 +432,7 @@ void OldReaderFetcher::fetchStream()
     //qDebug() << surl;
 
     currentReply = nam.get(request);
+    startDecoding(streamTable());
 
     connect(currentReply, SIGNAL(finished()), this, SLOT(finishedStream()));
     connect(currentReply, SIGNAL(readyRead()), this, SLOT(readyRead()));
@@ -394,6 +468,7 @@ void OldReaderFetcher::fetchStarredStream()
     request.setRawHeader("Authorization",QString("GoogleLogin auth=%1").arg(s->getCookie()).toLatin1());
 
     currentReply = nam.get(request);
+    startDecoding(streamTable());
 
     connect(currentReply, SIGNAL(finished()), this, SLOT(finishedStarredStream()));
     connect(currentReply, SIGNAL(readyRead()), this, SLOT(readyRead()));
@@ -429,6 +504,7 @@ void OldReaderFetcher::fetchLikedStream()
     request.setRawHeader("Authorization",QString("GoogleLogin auth=%1").arg(s->getCookie()).toLatin1());
 
     currentReply = nam.get(request);
+    startDecoding(streamTable());
 
     connect(currentReply, SIGNAL(finished()), this, SLOT(finishedLikedStream()));
     connect(currentReply, SIGNAL(readyRead()), this, SLOT(readyRead()));
@@ -464,6 +540,7 @@ void OldReaderFetcher::fetchBroadcastStream()
     request.setRawHeader("Authorization",QString("GoogleLogin auth=%1").arg(s->getCookie()).toLatin1());
 
     currentReply = nam.get(request);
+    startDecoding(streamTable());
 
     connect(currentReply, SIGNAL(finished()), this, SLOT(finishedBroadcastStream()));
     connect(currentReply, SIGNAL(readyRead()), this, SLOT(readyRead()));
@@ -502,12 +579,412 @@ void OldReaderFetcher::fetchUnreadStream()
     request.setRawHeader("Authorization",QString("GoogleLogin auth=%1").arg(s->getCookie()).toLatin1());
 
     currentReply = nam.get(request);
+    startDecoding(streamTable());
 
     connect(currentReply, SIGNAL(finished()), this, SLOT(finishedUnreadStream()));
     connect(currentReply, SIGNAL(readyRead()), this, SLOT(readyRead()));
     connect(currentReply, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(networkError(QNetworkReply::NetworkError)));
 }
 
+// Item refs have short ids, entries are stored with long ones
+static const JsonEntryDecoder::Table &idsTable()
+{
+    static const JsonEntryDecoder::Table table = [] {
+        JsonEntryDecoder::Table t;
+        t.itemsPath = QStringList{"itemRefs"};
+        t.captures = {QStringList{"continuation"}};
+        t.fields = {
+            {"id", [](DatabaseManager::Entry &e, const QVariant &v) {
+                 QString id = v.toString();
+                 e.id = id.startsWith("tag:") ? id : "tag:google.com,2005:reader/item/" + id;
+             }}
+        };
+        return t;
+    }();
+
+    return table;
+}
+
+void OldReaderFetcher::startDelta()
+{
+    Settings *s = Settings::instance();
+
+    deltaStreams.clear();
+    deltaStreams.append("user/-/state/com.google/reading-list");
+    if (s->getSyncRead())
+        deltaStreams.append("user/-/state/com.google/read");
+    deltaStreams.append("user/-/state/com.google/starred");
+    deltaStreams.append("user/-/state/com.google/like");
+    deltaStreams.append("user/-/state/com.google/broadcast");
+
+    deltaStream = 0;
+    deltaIds.clear();
+    deltaTruncated.clear();
+    pendingItemIds.clear();
+    lastContinuation.clear();
+    continuationCount = 0;
+
+    proggressTotal = deltaStreams.size() + 2;
+    proggress = 1;
+    emit progress(proggress, proggressTotal);
+
+    fetchIds();
+}
+
+// Ids of unread items of given feeds are listed, contents are downloaded
+// only for unknown ones. State streams are listed when state of items
+// outside of these feeds has to be updated as well.
+void OldReaderFetcher::startPartialDelta(const QStringList &feeds, bool states)
+{
+    deltaStreams = feeds;
+    if (states) {
+        deltaStreams.append("user/-/state/com.google/starred");
+        deltaStreams.append("user/-/state/com.google/like");
+        deltaStreams.append("user/-/state/com.google/broadcast");
+    }
+
+    deltaStream = 0;
+    deltaIds.clear();
+    deltaTruncated.clear();
+    pendingItemIds.clear();
+    lastContinuation.clear();
+    continuationCount = 0;
+
+    proggressTotal = deltaStreams.size() + 2;
+    proggress = 1;
+    emit progress(proggress, proggressTotal);
+
+    fetchIds();
+}
+
+void OldReaderFetcher::fetchUnreadCount()
+{
+    data.clear();
+
+    Settings *s = Settings::instance();
+
+    if (currentReply != NULL) {
+        currentReply->disconnect();
+        currentReply->deleteLater();
+        currentReply = NULL;
+    }
+
+    QUrl url("https://theoldreader.com/reader/api/0/unread-count?output=json");
+    QNetworkRequest request(url);
+
+    request.setRawHeader("Authorization",QString("GoogleLogin auth=%1").arg(s->getCookie()).toLatin1());
+
+    currentReply = nam.get(request);
+
+    connect(currentReply, SIGNAL(finished()), this, SLOT(finishedUnreadCount()));
+    connect(currentReply, SIGNAL(readyRead()), this, SLOT(readyRead()));
+    connect(currentReply, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(networkError(QNetworkReply::NetworkError)));
+}
+
+// Feed has changed when it has newer item than the newest stored one or
+// when it has fewer unread items (read on other device). More unread items
+// than stored is normal, items older than retention are not synced.
+void OldReaderFetcher::finishedUnreadCount()
+{
+    if (currentReply->error() || !parse()) {
+        qWarning() << "Unable to get unread count";
+        reportProbe(-1, 0);
+        startDelta();
+        return;
+    }
+
+    auto db = DatabaseManager::instance();
+    auto watermarks = db->readStreamWatermarks();
+
+    QHash<QString, QPair<int,int>> counts;
+    bool unknownFeed = false;
+
+#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
+    QJsonArray arr = jsonObj["unreadcounts"].toArray();
+    for (int i = 0; i < arr.count(); ++i) {
+        QJsonObject obj = arr.at(i).toObject();
+#else
+    QVariantList arr = jsonObj["unreadcounts"].toList();
+    for (int i = 0; i < arr.count(); ++i) {
+        QVariantMap obj = arr.at(i).toMap();
+#endif
+        QString id = obj["id"].toString();
+        if (!id.startsWith("feed/"))
+            continue;
+
+        if (!watermarks.contains(id))
+            unknownFeed = true;
+
+        QString newest = obj["newestItemTimestampUsec"].toString();
+        newest.chop(6); // converting Usec to sec
+        counts.insert(id, qMakePair(obj["count"].toInt(), newest.toInt()));
+    }
+
+    if (unknownFeed) {
+        reportProbe(-1, watermarks.size());
+        startDelta();
+        return;
+    }
+
+    QStringList changed;
+    for (auto it = watermarks.constBegin(); it != watermarks.constEnd(); ++it) {
+        auto count = counts.value(it.key());
+        if (count.second > it.value().newestTimestamp ||
+                count.first < it.value().unread)
+            changed.append(it.key());
+    }
+
+    reportProbe(changed.size(), watermarks.size());
+
+    if (changed.isEmpty()) {
+        taskEnd();
+        return;
+    }
+
+    startPartialDelta(changed, true);
+}
+
+void OldReaderFetcher::fetchIds()
+{
+    data.clear();
+
+    Settings *s = Settings::instance();
+
+    if (currentReply != NULL) {
+        currentReply->disconnect();
+        currentReply->deleteLater();
+        currentReply = NULL;
+    }
+
+    const QString stream = deltaStreams.at(deltaStream);
+    QString surl = QString("https://theoldreader.com/reader/api/0/stream/items/ids?output=json&n=%1&s=%2")
+            .arg(idsAtOnce).arg(QString(QUrl::toPercentEncoding(stream)));
+    if (lastContinuation != "")
+        surl += QString("&c=%1").arg(lastContinuation);
+
+    // Same window as in full sync, state streams are not limited
+    bool feed = stream.startsWith("feed/");
+    if (stream.endsWith("/reading-list") || stream.endsWith("/read") || feed) {
+        int epoch = s->getRetentionDays() > 0 ?
+                    QDateTime::currentDateTimeUtc().addDays(0-s->getRetentionDays()).toTime_t() :
+                    0;
+        if (epoch > 0)
+            surl += QString("&ot=%1").arg(epoch);
+    }
+    if ((stream.endsWith("/reading-list") && !s->getSyncRead()) || feed)
+        surl += QString("&xt=%1").arg(QString(QUrl::toPercentEncoding("user/-/state/com.google/read")));
+
+    QUrl url(surl);
+    QNetworkRequest request(url);
+
+    request.setRawHeader("Authorization",QString("GoogleLogin auth=%1").arg(s->getCookie()).toLatin1());
+
+    currentReply = nam.get(request);
+    startDecoding(idsTable());
+
+    connect(currentReply, SIGNAL(finished()), this, SLOT(finishedIds()));
+    connect(currentReply, SIGNAL(readyRead()), this, SLOT(readyRead()));
+    connect(currentReply, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(networkError(QNetworkReply::NetworkError)));
+}
+
+void OldReaderFetcher::finishedIds()
+{
+    if (currentReply->error()) {
+        if (retryTransient(currentReply, [this] { fetchIds(); }))
+            return;
+        emit error(500);
+        setBusy(false);
+        return;
+    }
+
+    if (!parse()) {
+        qWarning() << "Error parsing Json";
+        emit error(600);
+        setBusy(false);
+        return;
+    }
+
+    auto &ids = deltaIds[deltaStreams.at(deltaStream)];
+    for (const auto &e : decodedEntries)
+        ids.append(e.id);
+    decodedEntries.clear();
+
+    lastContinuation = jsonObj["continuation"].toString();
+    ++continuationCount;
+
+    if (!lastContinuation.isEmpty() && continuationCount <= continuationLimit) {
+        fetchIds();
+        return;
+    }
+
+    if (!lastContinuation.isEmpty()) {
+        qWarning() << "Ids of" << deltaStreams.at(deltaStream) << "are truncated";
+        deltaTruncated.insert(deltaStreams.at(deltaStream));
+    }
+
+    lastContinuation.clear();
+    continuationCount = 0;
+
+    ++proggress;
+    emit progress(proggress, proggressTotal);
+
+    if (++deltaStream < deltaStreams.size()) {
+        fetchIds();
+        return;
+    }
+
+    diffIds();
+}
+
+void OldReaderFetcher::diffIds()
+{
+    auto db = DatabaseManager::instance();
+
+    QList<QString> ids;
+    for (const auto &stream : deltaStreams) {
+        if (!stream.endsWith("/read"))
+            ids.append(deltaIds.value(stream));
+    }
+    ids = ids.toSet().toList();
+
+    // Contents are downloaded only for unknown items
+    pendingItemIds = db->readMissingEntryIds(ids);
+
+    qDebug() << "Delta sync, items:" << ids.size() << "unknown:" << pendingItemIds.size();
+
+    if (pendingItemIds.isEmpty()) {
+        applyDelta();
+        return;
+    }
+
+    fetchItems();
+}
+
+void OldReaderFetcher::fetchItems()
+{
+    data.clear();
+
+    Settings *s = Settings::instance();
+
+    if (currentReply != NULL) {
+        currentReply->disconnect();
+        currentReply->deleteLater();
+        currentReply = NULL;
+    }
+
+    requestedItemIds = pendingItemIds.mid(0, itemsAtOnce);
+    pendingItemIds = pendingItemIds.mid(itemsAtOnce);
+
+    QStringList params;
+    for (const auto &id : requestedItemIds)
+        params.append("i=" + QString(QUrl::toPercentEncoding(id)));
+
+    QUrl url("https://theoldreader.com/reader/api/0/stream/items/contents?output=json");
+    QNetworkRequest request(url);
+
+    request.setRawHeader("Authorization",QString("GoogleLogin auth=%1").arg(s->getCookie()).toLatin1());
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
+
+    currentReply = nam.post(request, params.join("&").toUtf8());
+    startDecoding(streamTable());
+
+    connect(currentReply, SIGNAL(finished()), this, SLOT(finishedItems()));
+    connect(currentReply, SIGNAL(readyRead()), this, SLOT(readyRead()));
+    connect(currentReply, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(networkError(QNetworkReply::NetworkError)));
+}
+
+void OldReaderFetcher::finishedItems()
+{
+    if (currentReply->error()) {
+        if (retryTransient(currentReply, [this] {
+            pendingItemIds = requestedItemIds + pendingItemIds;
+            fetchItems();
+        }))
+            return;
+        emit error(500);
+        setBusy(false);
+        return;
+    }
+
+    pageFinished(StoreItems);
+}
+
+void OldReaderFetcher::finishedItems2()
+{
+    applyDelta();
+}
+
+void OldReaderFetcher::applyDelta()
+{
+    auto db = DatabaseManager::instance();
+
+    // Items missing in truncated list may still be listed on server, so
+    // nothing is cleared by such list
+    auto complete = [this](const QString &stream) {
+        return deltaIds.contains(stream) && !deltaTruncated.contains(stream);
+    };
+
+    // Partial delta, feeds not listed are not touched
+    if (!deltaStreams.contains("user/-/state/com.google/reading-list")) {
+        for (const auto &stream : deltaStreams) {
+            if (stream.startsWith("feed/") && complete(stream))
+                db->updateEntriesReadFlagByStreamAndIds(stream, deltaIds.value(stream));
+        }
+
+        if (complete("user/-/state/com.google/starred"))
+            db->updateEntriesSavedFlagByIds(deltaIds.value("user/-/state/com.google/starred"));
+        if (complete("user/-/state/com.google/like"))
+            db->updateEntriesLikedFlagByIds(deltaIds.value("user/-/state/com.google/like"));
+        if (complete("user/-/state/com.google/broadcast"))
+            db->updateEntriesBroadcastFlagByIds(deltaIds.value("user/-/state/com.google/broadcast"));
+
+        deltaIds.clear();
+
+        taskEnd();
+        return;
+    }
+
+    QList<QString> keep;
+    for (const auto &stream : deltaStreams) {
+        if (!stream.endsWith("/read"))
+            keep.append(deltaIds.value(stream));
+    }
+
+    // Items that were not listed would not be fetched by full sync
+    if (deltaTruncated.isEmpty())
+        db->removeEntriesNotInIds(keep);
+
+    // Unread items are derived only when both lists are complete, item
+    // missing in truncated read list may be read as well
+    if (complete("user/-/state/com.google/reading-list") &&
+        (complete("user/-/state/com.google/read") ||
+         !deltaIds.contains("user/-/state/com.google/read"))) {
+        QList<QString> unread = deltaIds.value("user/-/state/com.google/reading-list");
+        if (deltaIds.contains("user/-/state/com.google/read")) {
+            QSet<QString> read = deltaIds.value("user/-/state/com.google/read").toSet();
+            QList<QString> ids;
+            for (const auto &id : unread) {
+                if (!read.contains(id))
+                    ids.append(id);
+            }
+            unread = ids;
+        }
+        db->updateEntriesReadFlagByIds(unread);
+    } else if (deltaIds.contains("user/-/state/com.google/read")) {
+        db->markEntriesReadByIds(deltaIds.value("user/-/state/com.google/read"));
+    }
+    if (complete("user/-/state/com.google/starred"))
+        db->updateEntriesSavedFlagByIds(deltaIds.value("user/-/state/com.google/starred"));
+    if (complete("user/-/state/com.google/like"))
+        db->updateEntriesLikedFlagByIds(deltaIds.value("user/-/state/com.google/like"));
+    if (complete("user/-/state/com.google/broadcast"))
+        db->updateEntriesBroadcastFlagByIds(deltaIds.value("user/-/state/com.google/broadcast"));
+
+    deltaIds.clear();
+
+    taskEnd();
+}
+
 void OldReaderFetcher::finishedSignInOnlyCheck()
 {
     //qDebug() << data;
@@ -622,6 +1099,14 @@ void OldReaderFetcher::finishedTabs()
     }
 
     auto db = DatabaseManager::instance();
+
+    // Tabs are the same as stored in last sync
+    if (isNotModified(currentReply)) {
+        tabList = db->readTabIdsByDashboard("oldreader");
+        finishedTabs2();
+        return;
+    }
+
     db->cleanTabs();
     startJob(StoreTabs);
 }
@@ -662,6 +1147,12 @@ void OldReaderFetcher::finishedFriends()
         return;
     }
 
+    friendsNotModified = isNotModified(currentReply);
+    if (friendsNotModified) {
+        fetchFeeds();
+        return;
+    }
+
     auto db = DatabaseManager::instance();
     db->cleanStreams();
     db->cleanModules();
@@ -670,7 +1161,16 @@ void OldReaderFetcher::finishedFriends()
 
 void OldReaderFetcher::finishedFriends2()
 {
-    fetchFeeds();
+    // Feeds were downloaded before friends had to be refreshed
+    if (!pendingFeedsData.isEmpty()) {
+        data.clear();
+        data.swap(pendingFeedsData);
+        startJob(StoreFeeds);
+        return;
+    }
+
+    // Streams were cleaned, so feeds are needed even if not modified
+    fetchFeeds(false);
 }
 
 void OldReaderFetcher::finishedFeeds()
@@ -682,6 +1182,20 @@ void OldReaderFetcher::finishedFeeds()
         return;
     }
 
+    if (isNotModified(currentReply)) {
+        // Only possible when friends are not modified as well
+        finishedFeeds2();
+        return;
+    }
+
+    if (friendsNotModified) {
+        // Streams have to be cleaned, friends are downloaded again
+        friendsNotModified = false;
+        pendingFeedsData = data;
+        fetchFriends(false);
+        return;
+    }
+
     startJob(StoreFeeds);
 }
 
@@ -699,6 +1213,38 @@ void OldReaderFetcher::finishedFeeds2()
         removeDeletedFeeds();*/
 
     auto db = DatabaseManager::instance();
+
+    // Interrupted full sync is completed first, entries stored before
+    // interruption are already unflagged
+    if (busyType == Fetcher::Updating) {
+        auto checkpoints = resumeCheckpoints("oldreader/");
+        if (!checkpoints.isEmpty()) {
+            const auto &checkpoint = checkpoints.first();
+            qDebug() << "Resuming stream after page" << checkpoint.pages;
+            lastContinuation = checkpoint.continuation;
+            continuationCount = checkpoint.pages;
+            lastDate = checkpoint.lastDate;
+            if (checkpoint.done)
+                finishedStream2();
+            else
+                fetchStream();
+            return;
+        }
+    }
+
+    // On update only ids are listed and contents of new items downloaded.
+    // When feeds have not changed, unread counts tell which feeds have
+    // new or read items.
+    if (busyType == Fetcher::Updating && db->countEntries() > 0) {
+        if (friendsNotModified) {
+            fetchUnreadCount();
+        } else {
+            reportProbe(-1, 0);
+            startDelta();
+        }
+        return;
+    }
+
     db->updateEntriesFlag(1); // Marking as old
 
     fetchStream();
@@ -708,182 +1254,251 @@ void OldReaderFetcher::finishedStream()
 {
     //qDebug() << data;
     if (currentReply->error()) {
+        if (retryTransient(currentReply, [this] { fetchPage(StoreStream); }))
+            return;
         emit error(500);
         setBusy(false);
         return;
     }
 
-    startJob(StoreStream);
+    pageFinished(StoreStream);
 }
 
 void OldReaderFetcher::finishedStream2()
 {
     Settings *s = Settings::instance();
-    if (s->getRetentionDays() > 0) {
-        if (lastDate > s->getRetentionDays())
-            lastDate = s->getRetentionDays();
-        //qDebug() << "finishedStream2" << "proggress" << proggress << "log(lastDate)" << log(lastDate) << "proggressTotal" << proggressTotal;
-        emit progress(proggress + log(lastDate), proggressTotal);
-    }
-
-    if (lastContinuation.isEmpty() ||
-        continuationCount > continuationLimit) {
 
-        proggress += s->getRetentionDays() > 0 ? log(lastDate) : 1;
-        //qDebug() << "finishedStream2" << "proggress" << proggress;
+    proggress += s->getRetentionDays() > 0 ? log(lastDate) : 1;
+    //qDebug() << "finishedStream2" << "proggress" << proggress;
 
+    lastContinuation.clear();
+    continuationCount = 0;
+    lastDate = 0;
 
-        lastContinuation.clear();
-        continuationCount = 0;
-        lastDate = 0;
-
-        fetchStarredStream();
-        return;
-    }
-
-    fetchStream();
+    fetchStarredStream();
 }
 
 void OldReaderFetcher::finishedStarredStream()
 {
     //qDebug() << data;
     if (currentReply->error()) {
+        if (retryTransient(currentReply, [this] { fetchPage(StoreStarredStream); }))
+            return;
         emit error(500);
         setBusy(false);
         return;
     }
 
-    startJob(StoreStarredStream);
+    pageFinished(StoreStarredStream);
 }
 
 void OldReaderFetcher::finishedStarredStream2()
 {
-    if (lastContinuation.isEmpty() ||
-        continuationCount > continuationLimit) {
+    ++proggress;
+    //qDebug() << "finishedStarredStream2" << "proggress" << proggress;
+    emit progress(proggress, proggressTotal);
 
-        ++proggress;
-        //qDebug() << "finishedStarredStream2" << "proggress" << proggress;
-        emit progress(proggress, proggressTotal);
-
-        fetchLikedStream();
-        return;
-    }
-
-    fetchStarredStream();
+    fetchLikedStream();
 }
 
 void OldReaderFetcher::finishedLikedStream()
 {
     //qDebug() << data;
     if (currentReply->error()) {
+        if (retryTransient(currentReply, [this] { fetchPage(StoreLikedStream); }))
+            return;
         emit error(500);
         setBusy(false);
         return;
     }
 
-    startJob(StoreLikedStream);
+    pageFinished(StoreLikedStream);
 }
 
 void OldReaderFetcher::finishedLikedStream2()
 {
-    if (lastContinuation.isEmpty() ||
-        continuationCount > continuationLimit) {
+    ++proggress;
+    //qDebug() << "finishedLikedStream2" << "proggress" << proggress;
+    emit progress(proggress, proggressTotal);
 
-        ++proggress;
-        //qDebug() << "finishedLikedStream2" << "proggress" << proggress;
-        emit progress(proggress, proggressTotal);
-
-        fetchBroadcastStream();
-        return;
-    }
-
-    fetchLikedStream();
+    fetchBroadcastStream();
 }
 
 void OldReaderFetcher::finishedBroadcastStream()
 {
     //qDebug() << data;
     if (currentReply->error()) {
+        if (retryTransient(currentReply, [this] { fetchPage(StoreBroadcastStream); }))
+            return;
         emit error(500);
         setBusy(false);
         return;
     }
 
-    startJob(StoreBroadcastStream);
+    pageFinished(StoreBroadcastStream);
 }
 
 void OldReaderFetcher::finishedBroadcastStream2()
 {
-    if (lastContinuation.isEmpty() ||
-        continuationCount > continuationLimit) {
-
-        ++proggress;
-        //qDebug() << "finishedBroadcastStream2" << "proggress" << proggress;
-        emit progress(proggress, proggressTotal);
-
-        //startJob(MarkSlow);
-        finishedMarkSlow();
-        return;
-    }
+    ++proggress;
+    //qDebug() << "finishedBroadcastStream2" << "proggress" << proggress;
+    emit progress(proggress, proggressTotal);
 
-    fetchBroadcastStream();
+    //startJob(MarkSlow);
+    finishedMarkSlow();
 }
 
 void OldReaderFetcher::finishedUnreadStream()
 {
     //qDebug() << data;
     if (currentReply->error()) {
+        if (retryTransient(currentReply, [this] { fetchPage(StoreUnreadStream); }))
+            return;
         emit error(500);
         setBusy(false);
         return;
     }
 
-    startJob(StoreUnreadStream);
+    pageFinished(StoreUnreadStream);
 }
 
 void OldReaderFetcher::finishedUnreadStream2()
 {
-    if (lastContinuation.isEmpty() ||
-        continuationCount > continuationLimit) {
-        taskEnd();
-        return;
-    }
+    taskEnd();
+}
 
-    fetchUnreadStream();
+void OldReaderFetcher::fetchPage(Job job)
+{
+    switch (job) {
+    case StoreStream:
+        fetchStream();
+        break;
+    case StoreUnreadStream:
+        fetchUnreadStream();
+        break;
+    case StoreStarredStream:
+        fetchStarredStream();
+        break;
+    case StoreLikedStream:
+        fetchLikedStream();
+        break;
+    case StoreBroadcastStream:
+        fetchBroadcastStream();
+        break;
+    case StoreItems:
+        fetchItems();
+        break;
+    default:
+        qWarning() << "Unknown Job";
+        break;
+    }
 }
 
-void OldReaderFetcher::finishedSetAction()
+void OldReaderFetcher::pageFinished(Job job)
 {
-    //qDebug() << data;
+    // Reply was decoded while downloading, only remaining data is parsed
+    if (!parse()) {
+        qWarning() << "Error parsing Json";
+        emit error(600);
+        setBusy(false);
+        return;
+    }
 
-    if (currentReply != NULL && currentReply->error()) {
-        int code = currentReply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-        if (code == 404) {
-            // Probably item already deleted -> skiping
-            qWarning() << "Action request returns 404";
-        } else {
-            emit error(500);
-            setBusy(false);
-            return;
+    QList<DatabaseManager::Entry> entries;
+    entries.swap(decodedEntries);
+
+    lastContinuation = jsonObj["continuation"].toString();
+    ++continuationCount;
+
+    // Progress, only for StoreStream
+    int retentionDays = Settings::instance()->getRetentionDays();
+    if (job == StoreStream && retentionDays > 0) {
+        for (int i = 0; i < entries.size(); ++i) {
+            int newLastDate = QDateTime::fromTime_t(entries.at(i).crawlTime).daysTo(QDateTime::currentDateTimeUtc());
+            //qDebug() << "newLastDate" << newLastDate;
+            if (newLastDate > retentionDays) {
+                lastDate = retentionDays;
+                lastContinuation.clear();
+                entries = entries.mid(0, i + 1);
+                break;
+            }
+            lastDate = newLastDate;
         }
+        //qDebug() << "pageFinished" << "proggress" << proggress << "log(lastDate)" << log(lastDate) << "proggressTotal" << proggressTotal;
+        emit progress(proggress + log(lastDate), proggressTotal);
     }
 
-    auto db = DatabaseManager::instance();
+    pagingMore = !lastContinuation.isEmpty() &&
+                 continuationCount <= continuationLimit;
+    if (job == StoreItems)
+        pagingMore = !pendingItemIds.isEmpty();
+
+    // Reading list is the longest download, it is resumed after the last
+    // stored page if sync is interrupted
+    DatabaseManager::Checkpoint checkpoint;
+    if (job == StoreStream) {
+        checkpoint.job = "oldreader/stream";
+        checkpoint.continuation = lastContinuation;
+        checkpoint.pages = continuationCount;
+        checkpoint.lastDate = lastDate;
+        checkpoint.done = !pagingMore;
+    }
+
+    queuePage(entries, checkpoint);
+
+    // Next page is downloaded while this one is being stored
+    if (pagingMore && queuedPagesCount() < maxQueuedPages)
+        fetchPage(job);
 
-    // Deleting action
-    DatabaseManager::Action action = actionsList.takeFirst();
-    db->removeActionsByIdAndType(action.id1, action.type);
+    // Worker is idle only when finishedJob has handled previous job
+    if (currentJob == Idle)
+        startJob(job);
+}
+
+void OldReaderFetcher::pageStored(Job job)
+{
+    if (!busy)
+        return;
 
-    // Updating upload proggres
-    emit uploadProgress(this->uploadProggressTotal - actionsList.size(), this->uploadProggressTotal);
+    bool downloading = isDownloading();
+    if (pagingMore && !downloading && queuedPagesCount() < maxQueuedPages) {
+        fetchPage(job);
+        downloading = true;
+    }
 
-    if (actionsList.isEmpty()) {
-        db->cleanDashboards();
-        startFetching();
+    // Pages queued after worker had finished
+    if (queuedPagesCount() > 0) {
+        startJob(job);
         return;
     }
 
-    setAction();
+    // Next page will start worker when downloaded
+    if (downloading)
+        return;
+
+    switch (job) {
+    case StoreStream:
+        finishedStream2();
+        break;
+    case StoreUnreadStream:
+        finishedUnreadStream2();
+        break;
+    case StoreStarredStream:
+        finishedStarredStream2();
+        break;
+    case StoreLikedStream:
+        finishedLikedStream2();
+        break;
+    case StoreBroadcastStream:
+        finishedBroadcastStream2();
+        break;
+    case StoreItems:
+        finishedItems2();
+        break;
+    default:
+        qWarning() << "Unknown Job";
+        break;
+    }
 }
 
 void OldReaderFetcher::finishedMarkSlow()
@@ -918,6 +1533,11 @@ void OldReaderFetcher::startFetching()
     auto s = Settings::instance();
     auto db = DatabaseManager::instance();
 
+    if (busyType == Fetcher::Refreshing) {
+        startPartialDelta(refreshStreams, false);
+        return;
+    }
+
     // Create DB structure
     db->cleanDashboards();
     if(busyType == Fetcher::Initiating) {
@@ -939,80 +1559,106 @@ void OldReaderFetcher::startFetching()
     db->writeDashboard(d);
     s->setDashboardInUse(d.id);
 
+    friendsNotModified = false;
+    pendingFeedsData.clear();
+
     fetchTabs();
 }
 
 void OldReaderFetcher::startJob(Job job)
 {
-    if (isRunning()) {
+    // finished() of previous job can still be queued when thread is
+    // not running anymore
+    if (currentJob != Idle || isRunning()) {
         qWarning() << "Job is running";
         return;
     }
 
     disconnect(this, SIGNAL(finished()), 0, 0);
     currentJob = job;
+    jobError = 0;
 
-    if (parse()) {
-        /*qWarning() << "Cookie expires";
-        Settings *s = Settings::instance();
-        s->setCookie("");
+    switch (job) {
+    case StoreTabs:
+    case StoreFriends:
+    case StoreFeeds:
+    case StoreStream:
+    case StoreUnreadStream:
+    case StoreStarredStream:
+    case StoreLikedStream:
+    case StoreBroadcastStream:
+    case StoreItems:
+    case MarkSlow:
+        connect(this, SIGNAL(finished()), this, SLOT(finishedJob()));
+        break;
+    default:
+        qWarning() << "Unknown Job";
+        currentJob = Idle;
+        emit error(502);
         setBusy(false);
+        return;
+    }
 
-        // If credentials other than OldReader, prompting for re-auth
-        if (s->getSigninType()>10) {
-            emit error(403);
-            return;
-        }
+    start(QThread::LowPriority);
+}
 
-        update();
-        return;*/
-    } else {
-        qWarning() << "Error parsing Json";
-        emit error(600);
+void OldReaderFetcher::finishedJob()
+{
+    // Worker is idle from now, even if finished() arrives after
+    // the next reply
+    Job job = currentJob;
+    currentJob = Idle;
+    recordJob(QMetaEnum::fromType<Job>().valueToKey(job));
+
+    if (jobError != 0) {
+        emit error(jobError);
         setBusy(false);
         return;
     }
 
     switch (job) {
     case StoreTabs:
-        connect(this, SIGNAL(finished()), this, SLOT(finishedTabs2()));
+        finishedTabs2();
         break;
     case StoreFriends:
-        connect(this, SIGNAL(finished()), this, SLOT(finishedFriends2()));
+        finishedFriends2();
         break;
     case StoreFeeds:
-        connect(this, SIGNAL(finished()), this, SLOT(finishedFeeds2()));
+        finishedFeeds2();
         break;
     case StoreStream:
-        connect(this, SIGNAL(finished()), this, SLOT(finishedStream2()));
-        break;
     case StoreUnreadStream:
-        connect(this, SIGNAL(finished()), this, SLOT(finishedUnreadStream2()));
-        break;
     case StoreStarredStream:
-        connect(this, SIGNAL(finished()), this, SLOT(finishedStarredStream2()));
-        break;
     case StoreLikedStream:
-        connect(this, SIGNAL(finished()), this, SLOT(finishedLikedStream2()));
-        break;
     case StoreBroadcastStream:
-        connect(this, SIGNAL(finished()), this, SLOT(finishedBroadcastStream2()));
+    case StoreItems:
+        pageStored(job);
         break;
     case MarkSlow:
-        connect(this, SIGNAL(finished()), this, SLOT(finishedMarkSlow()));
+        finishedMarkSlow();
         break;
     default:
         qWarning() << "Unknown Job";
-        emit error(502);
-        setBusy(false);
-        return;
+        break;
     }
-
-    start(QThread::LowPriority);
 }
 
 void OldReaderFetcher::run()
 {
+    // Stream pages are parsed before they are queued
+    if (currentJob == StoreStream || currentJob == StoreUnreadStream ||
+        currentJob == StoreStarredStream || currentJob == StoreLikedStream ||
+        currentJob == StoreBroadcastStream || currentJob == StoreItems) {
+        storeStream();
+        return;
+    }
+
+    if (!parse()) {
+        qWarning() << "Error parsing Json";
+        jobError = 600;
+        return;
+    }
+
     switch (currentJob) {
     case StoreTabs:
         storeTabs();
@@ -1028,6 +1674,7 @@ void OldReaderFetcher::run()
     case StoreStarredStream:
     case StoreLikedStream:
     case StoreBroadcastStream:
+    case StoreItems:
         storeStream();
         break;
     case MarkSlow:
@@ -1121,65 +1768,6 @@ void OldReaderFetcher::getFolderFromCategories(const QVariantList &categories, Q
     tabName.clear();
 }
 
-#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
-void OldReaderFetcher::getFromCategories(const QJsonArray &categories, QVariantMap &result)
-{
-    QJsonArray::const_iterator i = categories.constBegin();
-    QJsonArray::const_iterator end = categories.constEnd();
-#else
-void OldReaderFetcher::getFromCategories(const QVariantList &categories, QVariantMap &result)
-{
-    QVariantList::const_iterator i = categories.constBegin();
-    QVariantList::const_iterator end = categories.constEnd();
-#endif
-    bool read = false;
-    bool starred = false;
-    bool fresh = false;
-    bool liked = false;
-    bool broadcast = false;
-    while (i != end) {
-        QStringList id = (*i).toString().split('/');
-        //qDebug() << (*i).toString();
-        if (id.at(2)=="label") {
-            result.insert("tabId",QVariant((*i).toString()));
-            result.insert("tabName",QVariant(id.at(3)));
-        } else if ((*i).toString() == "user/-/state/com.google/read") {
-            read = true;
-        } else if ((*i).toString() == "user/-/state/com.google/starred") {
-            starred = true;
-        } else if ((*i).toString() == "user/-/state/com.google/like") {
-            liked = true;
-        } else if ((*i).toString() == "user/-/state/com.google/fresh") {
-            fresh = true;
-        } else if ((*i).toString() == "user/-/state/com.google/broadcast") {
-            broadcast = true;
-        }
-
-        ++i;
-    }
-
-    if (read)
-        result.insert("read",QVariant(1));
-    else
-        result.insert("read",QVariant(0));
-    if (starred)
-        result.insert("starred",QVariant(1));
-    else
-        result.insert("starred",QVariant(0));
-    if (liked)
-        result.insert("liked",QVariant(1));
-    else
-        result.insert("liked",QVariant(0));
-    if (fresh)
-        result.insert("fresh",QVariant(1));
-    else
-        result.insert("fresh",QVariant(0));
-    if (broadcast)
-        result.insert("broadcast",QVariant(1));
-    else
-        result.insert("broadcast",QVariant(0));
-}
-
 void OldReaderFetcher::storeFriends()
 {
     tabList.clear();
@@ -1353,152 +1941,11 @@ void OldReaderFetcher::storeFeeds()
 
 void OldReaderFetcher::storeStream()
 {
-    auto s = Settings::instance();
-    auto db = DatabaseManager::instance();
-    auto dm = DownloadManager::instance();
-
-    double updated = 0;
-    int retentionDays = s->getRetentionDays();
-
-    //qDebug() << "getRetentionDays" << retentionDays;
-    //qint64 date1 = QDateTime::currentMSecsSinceEpoch();
-    //int items = 0;
-
-#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
-    if (jsonObj["updated"].isDouble()) {
-        updated = jsonObj["updated"].toDouble();
-    } else {
-        qWarning() << "No updated param in stream";
-    }
-    if (jsonObj["items"].isArray()) {
-        QJsonArray arr = jsonObj["items"].toArray();
-        int end = arr.count();
-#else
-    //qDebug() << jsonObj["updated"].type();
-    if (jsonObj["updated"].type()==QVariant::ULongLong) {
-        updated = jsonObj["updated"].toDouble();
-    } else {
-        qWarning() << "No updated param in stream";
-    }
-    if (jsonObj["items"].type()==QVariant::List) {
-        QVariantList::const_iterator i = jsonObj["items"].toList().constBegin();
-        QVariantList::const_iterator end = jsonObj["items"].toList().constEnd();
-#endif
-        //qDebug() << "Updated:" << updated;
-        for (int i = 0; i < end; ++i) {
-            QString feedId;
-#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
-            QJsonObject obj = arr.at(i).toObject();
-            if (obj["origin"].isObject()) {
-                feedId = obj["origin"].toObject()["streamId"].toString();
-            }
-#else
-            QVariantMap obj = (*i).toMap();
-            if (obj["origin"].type() == QVariant::Map) {
-                feedId = obj["origin"].toMap()["streamId"].toString();
-            }
-#endif
-            DatabaseManager::Entry e;
-            e.id = obj["id"].toString();
-            e.streamId = feedId;
-            e.title = obj["title"].toString();
-            e.author = obj["author"].toString();
-            QVariantMap categories;
-
-            //qDebug() << e.id << e.title;
-
-#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
-            if (obj["summary"].isObject())
-                e.content = obj["summary"].toObject()["content"].toString();
-            if (obj["canonical"].isArray() && !obj["canonical"].toArray().isEmpty() && obj["canonical"].toArray()[0].isObject())
-                e.link = obj["canonical"].toArray()[0].toObject()["href"].toString();
-            if (obj["categories"].isArray())
-                getFromCategories(obj["categories"].toArray(), categories);
-            if (obj["annotations"].isArray() && !obj["annotations"].toArray().isEmpty())
-                e.annotations = obj["annotations"].toArray()[0].toString();
-#else
-            if (obj["summary"].type() == QVariant::Map)
-                e.content = obj["summary"].toMap()["content"].toString();
-            if (obj["canonical"].type() == QVariant::List && !obj["canonical"].toList().isEmpty() && obj["canonical"].toList()[0].type() == QVariant::Map)
-                e.link = obj["canonical"].toList()[0].toMap()["href"].toString();
-            if (obj["categories"].type() == QVariant::List)
-                getFromCategories(obj["categories"].toList(), categories);
-            if (obj["annotations"].type() == QVariant::List && !obj["annotations"].toList().isEmpty()) {
-                e.annotations = obj["annotations"].toList()[0].toString();
-            }
-#endif
-            e.read = categories.value("read").toInt();
-            e.saved = categories.value("starred").toInt();
-            e.liked = categories.value("liked").toInt();
-            e.freshOR = categories.value("fresh").toInt();
-            e.cached = 0;
-            e.broadcast = categories.value("broadcast").toInt();
-            e.publishedAt = obj["published"].toDouble();
-            e.createdAt = obj["updated"].toDouble();
-            e.fresh = 1;
-
-            QString crawlTime = obj["crawlTimeMsec"].toString();
-            crawlTime.chop(3); // converting Msec to sec
-            e.crawlTime = crawlTime.toDouble();
-            QString timestamp = obj["timestampUsec"].toString();
-            timestamp.chop(6); // converting Usec to sec
-            e.timestamp = timestamp.toDouble();
-
-            /*qDebug() << ">>>>>>>>>>>>>>>";
-            qDebug() << e.title << e.streamId;
-            qDebug() << "crawlTime" << e.crawlTime;
-            qDebug() << "timestampUsec" << e.timestamp;
-            qDebug() << "publishedAt"<< e.publishedAt;
-            qDebug() << "createdAt" << e.createdAt;
-            qDebug() << "<<<<<<<<<<<<<<<";*/
-
-            // Downloading image file
-            // Checking if content contains image
-            QRegExp rx("<img\\s[^>]*src\\s*=\\s*(\"[^\"]*\"|'[^']*')", Qt::CaseInsensitive);
-            if (rx.indexIn(e.content)!=-1) {
-                QString imgSrc = rx.cap(1); imgSrc = imgSrc.mid(1,imgSrc.length()-2);
-                if (!imgSrc.isEmpty()) {
-                    imgSrc.replace("&amp;","&", Qt::CaseInsensitive);
-                    if (s->getCachingMode() == 2 || (s->getCachingMode() == 1 && dm->isWLANConnected())) {
-                        if (!db->isCacheExistsByFinalUrl(Utils::hash(imgSrc))) {
-                            DatabaseManager::CacheItem item;
-                            item.origUrl = imgSrc;
-                            item.finalUrl = imgSrc;
-                            item.type = "entry-image";
-                            emit addDownload(item);
-                        }
-                    }
-                    e.image = imgSrc;
-                }
-            }
-
-            db->writeEntry(e);
-
-            // Progress, only for StoreStream
-            //++items;
-            if (currentJob == StoreStream && retentionDays > 0) {
-                int newLastDate = QDateTime::fromTime_t(e.crawlTime).daysTo(QDateTime::currentDateTimeUtc());
-                //qDebug() << "newLastDate" << newLastDate;
-                if (newLastDate > retentionDays) {
-                    //qDebug() << "newLastDate > retentionDays";
-                    lastDate = retentionDays;
-                    lastContinuation = "";
-                    ++continuationCount;
-
-                    //qDebug() << "db write time:" << (QDateTime::currentMSecsSinceEpoch() - date1) << "items:" << items;
-                    return;
-                } else {
-                    lastDate = newLastDate;
-                }
-            }
-        }
-    }
-
-    //qDebug() << "db write time:" << (QDateTime::currentMSecsSinceEpoch() - date1) << "items:" << items;
-
-    QString continuation = jsonObj["continuation"].toString();
-    lastContinuation = continuation;
-    ++continuationCount;
+    // Pages can be queued while previous ones are stored
+    QList<DatabaseManager::Entry> entries;
+    DatabaseManager::Checkpoint checkpoint;
+    while (takePage(&entries, &checkpoint))
+        ingest.push(entries, checkpoint);
 }
 
 /*void OldReaderFetcher::removeDeletedFeeds()
@@ -1532,7 +1979,27 @@ void OldReaderFetcher::uploadActions()
     if (!actionsList.isEmpty()) {
         emit uploading();
         //qDebug() << "Uploading actions...";
-        setAction();
+
+        // Marking subscriptions folder as read is done for every stream
+        // in it, original action is removed after all of them
+        auto db = DatabaseManager::instance();
+        for (int i = 0; i < actionsList.size(); ++i) {
+            const DatabaseManager::Action action = actionsList.at(i);
+            if (action.type == DatabaseManager::SetTabReadAll &&
+                    action.id1 == "subscriptions") {
+                const QStringList list = db->readStreamIdsByTab("subscriptions");
+                for (const auto &streamId : list) {
+                    DatabaseManager::Action streamAction;
+                    streamAction.type = DatabaseManager::SetStreamReadAll;
+                    streamAction.id1 = streamId;
+                    actionsList.insert(i++, streamAction);
+                }
+            }
+        }
+
+        this->uploadProggressTotal = actionsList.size();
+        planActions();
+        dispatchActions();
     }
 }
 
@@ -22,6 +22,8 @@
 
 #include <QObject>
 #include <QStringList>
+#include <QHash>
+#include <QSet>
 #include <QVariantMap>
 #if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
 #include <QJsonArray>
@@ -62,16 +64,27 @@ private Q_SLOTS:
     void finishedBroadcastStream2();
     void finishedUnreadStream();
     void finishedUnreadStream2();
-    void finishedSetAction();
+    void finishedUnreadCount();
+    void finishedIds();
+    void finishedItems();
+    void finishedItems2();
     void finishedMarkSlow();
+    void finishedJob();
 
 private:
     enum Job { Idle, StoreTabs, StoreFriends, StoreFeeds, StoreStream,
                StoreUnreadStream, StoreStarredStream, StoreLikedStream,
-               StoreBroadcastStream, MarkSlow };
+               StoreBroadcastStream, StoreItems, MarkSlow };
+    Q_ENUM(Job)
+
+    QUrl serviceUrl() const;
 
     static const int limitAtOnce = 400;
     static const int continuationLimit = 100;
+    static const int idsAtOnce = 1000;
+    static const int itemsAtOnce = 100;
+    // Item ids in one edit-tag request
+    static const int editTagAtOnce = 100;
 
     Job currentJob;
     QStringList tabList;
@@ -81,6 +94,22 @@ private:
     QString lastContinuation;
     int continuationCount = 0;
     int lastDate = 0;
+    bool pagingMore = false;
+
+    // Friends and feeds are both stored in streams, so store is
+    // skipped only when both lists are not modified
+    bool friendsNotModified = false;
+    QByteArray pendingFeedsData;
+
+    // Delta sync, only ids of items are fetched for these streams
+    QStringList deltaStreams;
+    int deltaStream = 0;
+    QHash<QString, QList<QString>> deltaIds;
+    // Streams which ids were cut by continuationLimit
+    QSet<QString> deltaTruncated;
+    QList<QString> pendingItemIds;
+    // Ids of current items request, pending again when request is retried
+    QList<QString> requestedItemIds;
 
     void signIn();
     void startFetching();
@@ -90,16 +119,28 @@ private:
     //void removeDeletedFeeds();
 
     void fetchTabs();
-    void fetchFriends();
-    void fetchFeeds();
+    void fetchFriends(bool conditional = true);
+    void fetchFeeds(bool conditional = true);
     void fetchStream();
     void fetchUnreadStream();
     void fetchStarredStream();
     void fetchLikedStream();
     void fetchBroadcastStream();
-    void setAction();
+    void startDelta();
+    void startPartialDelta(const QStringList &feeds, bool states);
+    void fetchUnreadCount();
+    void fetchIds();
+    void diffIds();
+    void fetchItems();
+    void applyDelta();
+    int actionsAtOnce() const;
+    QNetworkReply *sendActions(const ActionGroup &group);
+    int checkActionsReply(QNetworkReply *reply, const ActionGroup &group);
 
     void startJob(Job job);
+    void fetchPage(Job job);
+    void pageFinished(Job job);
+    void pageStored(Job job);
 
     void storeTabs();
     void storeFriends();
@@ -109,10 +150,8 @@ private:
 
 #if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
     void getFolderFromCategories(const QJsonArray &categories, QString &tabId, QString &tabName);
-    void getFromCategories(const QJsonArray &categories, QVariantMap &result);
 #else
     void getFolderFromCategories(const QVariantList &categories, QString &tabId, QString &tabName);
-    void getFromCategories(const QVariantList &categories, QVariantMap &result);
 #endif
 
     QString getIdsFromActionString(const QString &actionString);
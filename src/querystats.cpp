@@ -0,0 +1,232 @@
+/* Copyright (C) 2022 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "querystats.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <algorithm>
+
+#include "settings.h"
+
+std::atomic_bool QueryStats::m_enabled{false};
+
+QueryStats::QueryStats(QObject *parent) : QObject{parent} {}
+
+bool QueryStats::isAvailable() const {
+#ifdef KAKTUS_DB_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool QueryStats::isEnabled() const { return m_enabled.load(); }
+
+void QueryStats::setEnabled(bool value) {
+#ifndef KAKTUS_DB_STATS
+    value = false;
+#endif
+    if (m_enabled.exchange(value) != value) emit enabledChanged();
+}
+
+int QueryStats::getSlowThreshold() const {
+    return static_cast<int>(m_slowThresholdNs / 1000000);
+}
+
+void QueryStats::setSlowThreshold(int value) {
+    if (getSlowThreshold() != value) {
+        m_slowThresholdNs = static_cast<qint64>(value) * 1000000;
+        emit slowThresholdChanged();
+    }
+}
+
+void QueryStats::record(const char *method, qint64 ns, int rows) {
+    QMutexLocker locker{&m_mutex};
+
+    auto &r = m_records[QString::fromLatin1(method)];
+    r.calls++;
+    r.totalNs += ns;
+    r.rows += rows;
+    if (r.samples.size() < maxSamples) {
+        r.samples.push_back(ns);
+    } else {
+        r.samples[r.nextSample] = ns;
+        r.nextSample = (r.nextSample + 1) % maxSamples;
+    }
+}
+
+void QueryStats::recordSlow(const char *method, qint64 ns,
+                            const QString &query, const QString &plan) {
+    qWarning() << "slow query:" << method << ns / 1000000 << "ms" << query;
+
+    QMutexLocker locker{&m_mutex};
+
+    SlowQuery item;
+    item.method = QString::fromLatin1(method);
+    item.query = query;
+    item.plan = plan;
+    item.ns = ns;
+
+    m_slowQueries.append(item);
+    if (m_slowQueries.size() > maxSlowQueries) m_slowQueries.removeFirst();
+}
+
+static inline QString toMs(qint64 ns) {
+    return QString::number(static_cast<double>(ns) / 1000000, 'f', 2);
+}
+
+QString QueryStats::report() const {
+    QMutexLocker locker{&m_mutex};
+
+    QString text;
+    QTextStream out{&text};
+
+    QList<QString> methods = m_records.keys();
+    std::sort(methods.begin(), methods.end(),
+              [this](const QString &a, const QString &b) {
+                  return m_records.constFind(a)->totalNs >
+                         m_records.constFind(b)->totalNs;
+              });
+
+    out << "method calls total_ms p50_ms p99_ms rows\n";
+    for (const auto &method : methods) {
+        const auto &r = *m_records.constFind(method);
+        auto samples = r.samples;
+        std::sort(samples.begin(), samples.end());
+        qint64 p50 = samples.isEmpty() ? 0 : samples.at(samples.size() / 2);
+        qint64 p99 =
+            samples.isEmpty()
+                ? 0
+                : samples.at(std::min(samples.size() - 1,
+                                      samples.size() * 99 / 100));
+        out << method << " " << r.calls << " " << toMs(r.totalNs) << " "
+            << toMs(p50) << " " << toMs(p99) << " " << r.rows << "\n";
+    }
+
+    if (!m_slowQueries.isEmpty()) {
+        out << "\nslow queries (>" << getSlowThreshold() << " ms):\n";
+        for (const auto &item : m_slowQueries) {
+            out << item.method << " " << toMs(item.ns) << " ms\n"
+                << "  " << item.query << "\n";
+            if (!item.plan.isEmpty()) out << item.plan;
+        }
+    }
+
+    out.flush();
+    return text;
+}
+
+QString QueryStats::dump() const {
+    auto path = QDir{Settings::instance()->getSettingsDir()}.absoluteFilePath(
+        QString{"dbstats-%1.txt"}.arg(
+            QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss")));
+
+    QFile file{path};
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        qWarning() << "cannot open file:" << path;
+        return {};
+    }
+
+    file.write(report().toUtf8());
+    file.close();
+
+    qDebug() << "db stats saved to:" << path;
+    return path;
+}
+
+void QueryStats::reset() {
+    QMutexLocker locker{&m_mutex};
+    m_records.clear();
+    m_slowQueries.clear();
+}
+
+#ifdef KAKTUS_DB_STATS
+TimedQuery::TimedQuery(const QSqlDatabase &db, const char *method)
+    : QSqlQuery{db}, m_method{method}, m_db{db} {}
+
+TimedQuery::~TimedQuery() {
+    if (!m_executed) return;
+    finishStatement();
+    QueryStats::instance()->record(m_method, m_totalNs, m_rows);
+}
+
+void TimedQuery::finishStatement() {
+    if (m_statementNs == 0) return;
+
+    auto *stats = QueryStats::instance();
+    if (m_statementNs > stats->slowThresholdNs())
+        stats->recordSlow(m_method, m_statementNs, lastQuery(), explain());
+
+    m_totalNs += m_statementNs;
+    m_statementNs = 0;
+}
+
+QString TimedQuery::explain() const {
+    QSqlQuery query{m_db};
+
+    query.prepare("EXPLAIN QUERY PLAN " + lastQuery());
+    auto count = boundValues().size();
+    for (int i = 0; i < count; ++i) query.addBindValue(boundValue(i));
+
+    QString plan;
+    if (query.exec()) {
+        // columns: id, parent, notused, detail
+        while (query.next())
+            plan.append("  > " + query.value(3).toString() + "\n");
+    }
+    return plan;
+}
+
+bool TimedQuery::exec(const QString &query) {
+    if (!QueryStats::enabled()) return QSqlQuery::exec(query);
+
+    finishStatement();
+    m_executed = true;
+    m_timer.start();
+    bool ret = QSqlQuery::exec(query);
+    m_statementNs += m_timer.nsecsElapsed();
+    if (ret && !isSelect()) m_rows += std::max(0, numRowsAffected());
+    return ret;
+}
+
+bool TimedQuery::exec() {
+    if (!QueryStats::enabled()) return QSqlQuery::exec();
+
+    finishStatement();
+    m_executed = true;
+    m_timer.start();
+    bool ret = QSqlQuery::exec();
+    m_statementNs += m_timer.nsecsElapsed();
+    if (ret && !isSelect()) m_rows += std::max(0, numRowsAffected());
+    return ret;
+}
+
+bool TimedQuery::next() {
+    if (!m_executed) return QSqlQuery::next();
+
+    m_timer.start();
+    bool ret = QSqlQuery::next();
+    m_statementNs += m_timer.nsecsElapsed();
+    if (ret) m_rows++;
+    return ret;
+}
+
+bool TimedQuery::first() {
+    if (!m_executed) return QSqlQuery::first();
+
+    m_timer.start();
+    bool ret = QSqlQuery::first();
+    m_statementNs += m_timer.nsecsElapsed();
+    if (ret) m_rows++;
+    return ret;
+}
+#endif
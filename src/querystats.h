@@ -0,0 +1,114 @@
+/* Copyright (C) 2022 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef QUERYSTATS_H
+#define QUERYSTATS_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QString>
+#include <QVector>
+#include <atomic>
+
+#include "singleton.h"
+
+class QueryStats : public QObject, public Singleton<QueryStats> {
+    Q_OBJECT
+    Q_PROPERTY(bool available READ isAvailable CONSTANT)
+    Q_PROPERTY(bool enabled READ isEnabled WRITE setEnabled NOTIFY
+                   enabledChanged)
+    Q_PROPERTY(int slowThreshold READ getSlowThreshold WRITE
+                   setSlowThreshold NOTIFY slowThresholdChanged)
+
+   public:
+    struct SlowQuery {
+        QString method;
+        QString query;
+        QString plan;
+        qint64 ns = 0;
+    };
+
+    explicit QueryStats(QObject *parent = nullptr);
+
+    static inline bool enabled() { return m_enabled.load(); }
+    bool isAvailable() const;
+    bool isEnabled() const;
+    void setEnabled(bool value);
+    int getSlowThreshold() const;
+    void setSlowThreshold(int value);
+    inline qint64 slowThresholdNs() const { return m_slowThresholdNs; }
+
+    void record(const char *method, qint64 ns, int rows);
+    void recordSlow(const char *method, qint64 ns, const QString &query,
+                    const QString &plan);
+
+    Q_INVOKABLE QString report() const;
+    Q_INVOKABLE QString dump() const;
+    Q_INVOKABLE void reset();
+
+   signals:
+    void enabledChanged();
+    void slowThresholdChanged();
+
+   private:
+    static const int maxSamples = 256;
+    static const int maxSlowQueries = 50;
+
+    struct Record {
+        int calls = 0;
+        qint64 totalNs = 0;
+        qint64 rows = 0;
+        QVector<qint64> samples;
+        int nextSample = 0;
+    };
+
+    static std::atomic_bool m_enabled;
+    std::atomic<qint64> m_slowThresholdNs{50000000};
+    mutable QMutex m_mutex;
+    QHash<QString, Record> m_records;
+    QList<SlowQuery> m_slowQueries;
+};
+
+// Drop-in QSqlQuery that reports execution time and fetched rows of
+// every statement to QueryStats under the name of the calling method
+#ifdef KAKTUS_DB_STATS
+class TimedQuery : public QSqlQuery {
+   public:
+    TimedQuery(const QSqlDatabase &db, const char *method);
+    ~TimedQuery();
+
+    bool exec(const QString &query);
+    bool exec();
+    bool next();
+    bool first();
+
+   private:
+    const char *m_method;
+    QSqlDatabase m_db;
+    QElapsedTimer m_timer;
+    qint64 m_statementNs = 0;
+    qint64 m_totalNs = 0;
+    int m_rows = 0;
+    bool m_executed = false;
+
+    void finishStatement();
+    QString explain() const;
+};
+#else
+class TimedQuery : public QSqlQuery {
+   public:
+    inline TimedQuery(const QSqlDatabase &db, const char *)
+        : QSqlQuery{db} {}
+};
+#endif
+
+#endif  // QUERYSTATS_H
@@ -0,0 +1,572 @@
+/* Copyright (C) 2022 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "replayserver.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QHostAddress>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QRegExp>
+#include <QTimer>
+#include <algorithm>
+
+ReplayServer::ReplayServer(const Profile &profile, QObject *parent)
+    : QObject{parent}, m_server{new QHttpServer{this}}, m_profile{profile} {
+    m_profile.feeds = qMax(1, m_profile.feeds);
+    m_profile.categories = qBound(1, m_profile.categories, m_profile.feeds);
+    m_profile.items = qMax(1, m_profile.items);
+    m_profile.changedFeeds = qBound(0, m_profile.changedFeeds, m_profile.feeds);
+
+    // Every item has unique timestamp, so paging by date doesn't skip
+    // items, the newest ones are a few seconds old
+    m_base = QDateTime::currentDateTimeUtc().toTime_t() -
+             static_cast<uint>((m_profile.items + 1) * m_profile.feeds);
+
+    static const QString lorem{
+        "Lorem ipsum dolor sit amet, consectetur adipiscing elit. "};
+    while (m_filler.size() < m_profile.bodySize) m_filler.append(lorem);
+    m_filler.truncate(qMax(0, m_profile.bodySize));
+
+    connect(m_server, &QHttpServer::newRequest, this, &ReplayServer::handle);
+}
+
+bool ReplayServer::listen() {
+    if (!m_server->listen(QHostAddress::LocalHost, port)) {
+        qWarning() << "Replay server failed to start on" << port << "port";
+        return false;
+    }
+
+    return true;
+}
+
+QUrl ReplayServer::url() const {
+    return QUrl{QString("http://127.0.0.1:%1").arg(port)};
+}
+
+void ReplayServer::setRecordingsDir(const QString &dir) {
+    m_recordingsDir = dir;
+    m_recordingCounts.clear();
+}
+
+void ReplayServer::nextGeneration() { ++m_generation; }
+
+void ReplayServer::resetCounters() { m_counters = Counters{}; }
+
+// Body of POST arrives after newRequest, reply is made when whole request
+// is received and sent after configured latency
+void ReplayServer::handle(QHttpRequest *req, QHttpResponse *resp) {
+    req->storeBody();
+    connect(req, &QHttpRequest::end, this,
+            [this, req, resp] { respond(req, resp); });
+}
+
+void ReplayServer::respond(QHttpRequest *req, QHttpResponse *resp) {
+    auto path = req->path();
+    QUrlQuery query{req->url()};
+    auto body = req->body();
+
+    // TT-RSS API has one URL, operation is in JSON body
+    QString op;
+    if (path == "/api" || path == "/api/")
+        op = QJsonDocument::fromJson(body).object().value("op").toString();
+
+    QString method = req->methodString();
+    method.remove("HTTP_");
+    auto key = QString{method + path + (op.isEmpty() ? "" : "/" + op)}.replace(
+        QRegExp{"[^A-Za-z0-9]"}, "_");
+
+    ++m_counters.requests;
+
+    Reply reply;
+    if (readRecording(key, &reply)) {
+        ++m_counters.replayed;
+    } else {
+        reply = synthesize(path, query, body);
+        if (!reply.known) {
+            ++m_counters.unknown;
+            qWarning() << "Replay server: unknown request:" << method
+                       << req->url().toString();
+        }
+    }
+
+    m_counters.bytes += reply.body.size();
+
+    QTimer::singleShot(qMax(0, m_profile.latency), resp, [resp, reply] {
+        resp->setHeader("Content-Type", reply.contentType);
+        resp->setHeader("Content-Length", QString::number(reply.body.size()));
+        if (!reply.cookie.isEmpty()) resp->setHeader("Set-Cookie", reply.cookie);
+        resp->writeHead(200);
+        resp->end(reply.body);
+    });
+}
+
+bool ReplayServer::readRecording(const QString &key, Reply *reply) {
+    if (m_recordingsDir.isEmpty()) return false;
+
+    int n = ++m_recordingCounts[key];
+    QFile file{
+        QDir{m_recordingsDir}.absoluteFilePath(QString("%1.%2").arg(key).arg(n))};
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    reply->body = file.readAll();
+    if (reply->body.trimmed().startsWith('<')) reply->contentType = "text/html";
+
+    // Sign in cookie is not part of recorded body
+    if (key.contains("auth_signin"))
+        reply->cookie = "activeSessionID=replay; path=/";
+
+    return true;
+}
+
+ReplayServer::Reply ReplayServer::synthesize(const QString &path,
+                                             const QUrlQuery &query,
+                                             const QByteArray &body) {
+    if (path == "/api" || path == "/api/") return ttrss(body);
+    if (path.startsWith("/accounts/") || path.startsWith("/reader/"))
+        return oldReader(path, query, body);
+    if (path.startsWith("/api/") || path.startsWith("/privatepage"))
+        return netvibes(path, body);
+
+    Reply reply;
+    reply.known = false;
+    reply.body = "{}";
+    return reply;
+}
+
+ReplayServer::Reply ReplayServer::ttrss(const QByteArray &body) {
+    auto params = QJsonDocument::fromJson(body).object();
+    auto op = params.value("op").toString();
+
+    Reply reply;
+    QJsonValue content;
+
+    if (op == "login") {
+        content = QJsonObject{{"session_id", "replay"}, {"api_level", 14}};
+    } else if (op == "getConfig") {
+        content = QJsonObject{{"icons_url", "feed-icons"},
+                              {"daemon_is_running", true},
+                              {"num_feeds", m_profile.feeds}};
+    } else if (op == "getCategories") {
+        QJsonArray arr;
+        for (int c = 0; c < m_profile.categories; ++c)
+            arr.append(QJsonObject{{"id", c + 1},
+                                   {"title", QString("Category %1").arg(c + 1)}});
+        content = arr;
+    } else if (op == "getFeeds") {
+        QJsonArray arr;
+        for (int f = 0; f < m_profile.feeds; ++f)
+            arr.append(QJsonObject{
+                {"id", f + 1},
+                {"title", QString("Feed %1").arg(f + 1)},
+                {"feed_url", QString("http://feed.example/%1").arg(f + 1)},
+                {"cat_id", category(f) + 1},
+                {"unread", unread(f)},
+                {"has_icon", false},
+                {"last_updated",
+                 static_cast<qint64>(timestamp(Item{f, count(f) - 1}))}});
+        content = arr;
+    } else if (op == "getCounters") {
+        QJsonArray arr;
+        arr.append(
+            QJsonObject{{"id", "subscribed-feeds"}, {"counter", m_profile.feeds}});
+        for (int f = 0; f < m_profile.feeds; ++f)
+            arr.append(QJsonObject{{"id", f + 1}, {"counter", unread(f)}});
+        content = arr;
+    } else if (op == "getHeadlines") {
+        int feedId = params.value("feed_id").toInt();
+        bool isCat = params.value("is_cat").toBool();
+        bool unreadOnly = params.value("view_mode").toString() == "unread";
+        bool withContent = params.value("show_content").toBool();
+        int skip = params.value("skip").toInt();
+        int limit = params.value("limit").toInt(200);
+        qint64 sinceId = params.value("since_id").toVariant().toLongLong();
+
+        auto list = items([&](const Item &item) {
+            if (unreadOnly && isRead(item)) return false;
+            if (itemId(item) <= sinceId) return false;
+            switch (feedId) {
+                case -4:
+                    return true;
+                case -1:
+                    return isSaved(item);
+                case -2:
+                    return isBroadcast(item);
+                default:
+                    return isCat ? category(item.feed) + 1 == feedId
+                                 : item.feed + 1 == feedId;
+            }
+        });
+
+        QJsonArray arr;
+        for (const auto &item : list.mid(skip, limit))
+            arr.append(ttrssHeadline(item, withContent));
+        content = arr;
+    } else if (op == "getArticle") {
+        QJsonArray arr;
+        for (const auto &id : params.value("article_id").toString().split(',')) {
+            Item item;
+            if (itemFromId(id.toLongLong(), &item))
+                arr.append(ttrssHeadline(item, true));
+        }
+        content = arr;
+    } else if (op == "updateArticle" || op == "catchupFeed" || op == "logout") {
+        content = QJsonObject{{"status", "OK"}};
+    } else {
+        reply.known = false;
+        content = QJsonObject{};
+    }
+
+    reply.body = QJsonDocument{QJsonObject{
+                                   {"seq", 0}, {"status", 0}, {"content", content}}}
+                     .toJson(QJsonDocument::Compact);
+    return reply;
+}
+
+ReplayServer::Reply ReplayServer::oldReader(const QString &path,
+                                            const QUrlQuery &query,
+                                            const QByteArray &body) {
+    static const QString state{"user/-/state/com.google/"};
+
+    Reply reply;
+    QJsonObject obj;
+
+    if (path == "/accounts/ClientLogin") {
+        obj.insert("Auth", "replay");
+    } else if (path.endsWith("/friend/list")) {
+        obj.insert("friends", QJsonArray{});
+    } else if (path.endsWith("/tag/list")) {
+        QJsonArray arr;
+        arr.append(QJsonObject{{"id", state + "starred"}});
+        for (int c = 0; c < m_profile.categories; ++c)
+            arr.append(QJsonObject{
+                {"id", QString("user/-/label/Category %1").arg(c + 1)}});
+        obj.insert("tags", arr);
+    } else if (path.endsWith("/subscription/list")) {
+        QJsonArray arr;
+        for (int f = 0; f < m_profile.feeds; ++f) {
+            auto label = QString("Category %1").arg(category(f) + 1);
+            arr.append(QJsonObject{
+                {"id", QString("feed/%1").arg(f + 1)},
+                {"title", QString("Feed %1").arg(f + 1)},
+                {"categories",
+                 QJsonArray{QJsonObject{{"id", "user/-/label/" + label},
+                                        {"label", label}}}},
+                {"url", QString("http://feed.example/%1").arg(f + 1)},
+                {"htmlUrl", QString("http://feed.example/%1/").arg(f + 1)},
+                {"iconUrl", ""},
+                {"firstitemmsec",
+                 QString::number(timestamp(Item{f, 0})) + "000"}});
+        }
+        obj.insert("subscriptions", arr);
+    } else if (path.endsWith("/unread-count")) {
+        QJsonArray arr;
+        for (int f = 0; f < m_profile.feeds; ++f)
+            arr.append(QJsonObject{
+                {"id", QString("feed/%1").arg(f + 1)},
+                {"count", unread(f)},
+                {"newestItemTimestampUsec",
+                 QString::number(timestamp(Item{f, count(f) - 1})) +
+                     "000000"}});
+        obj.insert("max", 1000);
+        obj.insert("unreadcounts", arr);
+    } else if (path.endsWith("/stream/contents") ||
+               path.endsWith("/stream/items/ids")) {
+        auto stream = query.queryItemValue("s", QUrl::FullyDecoded);
+        bool excludeRead =
+            query.queryItemValue("xt", QUrl::FullyDecoded) == state + "read";
+        uint oldest = query.queryItemValue("ot").toUInt();
+        int n = qMax(1, query.queryItemValue("n").toInt());
+        int offset = query.queryItemValue("c").toInt();
+
+        auto list = items([&](const Item &item) {
+            if (excludeRead && isRead(item)) return false;
+            if (timestamp(item) < oldest) return false;
+            if (stream == state + "reading-list") return true;
+            if (stream == state + "read") return isRead(item);
+            if (stream == state + "starred") return isSaved(item);
+            if (stream == state + "like") return isLiked(item);
+            if (stream == state + "broadcast") return isBroadcast(item);
+            return stream == QString("feed/%1").arg(item.feed + 1);
+        });
+
+        bool ids = path.endsWith("/ids");
+        QJsonArray arr;
+        for (const auto &item : list.mid(offset, n)) {
+            if (ids)
+                arr.append(QJsonObject{
+                    {"id", oldReaderId(item).section('/', -1)},
+                    {"timestampUsec",
+                     QString::number(timestamp(item)) + "000000"}});
+            else
+                arr.append(oldReaderItem(item));
+        }
+
+        obj.insert(ids ? "itemRefs" : "items", arr);
+        obj.insert("updated",
+                   static_cast<qint64>(QDateTime::currentDateTimeUtc().toTime_t()));
+        if (offset + n < list.size())
+            obj.insert("continuation", QString::number(offset + n));
+    } else if (path.endsWith("/stream/items/contents")) {
+        QUrlQuery params{QString::fromUtf8(body)};
+        QJsonArray arr;
+        for (const auto &id : params.allQueryItemValues("i", QUrl::FullyDecoded)) {
+            bool ok = false;
+            Item item;
+            if (itemFromId(id.section('/', -1).toLongLong(&ok, 16), &item) && ok)
+                arr.append(oldReaderItem(item));
+        }
+        obj.insert("items", arr);
+    } else if (path.endsWith("/edit-tag") || path.endsWith("/mark-all-as-read")) {
+        reply.contentType = "text/plain";
+        reply.body = "OK";
+        return reply;
+    } else {
+        reply.known = false;
+    }
+
+    reply.body = QJsonDocument{obj}.toJson(QJsonDocument::Compact);
+    return reply;
+}
+
+ReplayServer::Reply ReplayServer::netvibes(const QString &path,
+                                           const QByteArray &body) {
+    Reply reply;
+    QJsonObject obj;
+
+    if (path == "/api/auth/signin") {
+        reply.cookie = "activeSessionID=replay; path=/";
+        obj.insert("success", true);
+    } else if (path.startsWith("/privatepage")) {
+        reply.contentType = "text/html";
+        reply.body =
+            "<html><body><div id=\"page-1\" class=\"private-page active\" "
+            "title=\"Replay\"></div></body></html>";
+        return reply;
+    } else if (path == "/api/my/dashboards/data") {
+        QJsonArray tabs;
+        for (int c = 0; c < m_profile.categories; ++c)
+            tabs.append(QJsonObject{{"id", QString::number(c + 1)},
+                                    {"title", QString("Category %1").arg(c + 1)}});
+
+        QJsonArray modules;
+        for (int f = 0; f < m_profile.feeds; ++f)
+            modules.append(QJsonObject{
+                {"id", QString::number(f + 1)},
+                {"name", "RssReader"},
+                {"title", QString("Feed %1").arg(f + 1)},
+                {"status", "normal"},
+                {"widgetId", ""},
+                {"pageId", "1"},
+                {"tab", QString::number(category(f) + 1)},
+                {"streams",
+                 QJsonArray{QJsonObject{{"id", QString::number(f + 1)}}}}});
+
+        obj.insert("userData",
+                   QJsonObject{{"tabs", tabs}, {"modules", modules}});
+    } else if (path == "/api/streams" || path == "/api/streams/saved") {
+        bool saved = path.endsWith("/saved");
+
+        QJsonArray results;
+        for (const auto &value : QJsonDocument::fromJson(body).array()) {
+            auto request = value.toObject();
+            auto options = request.value("options").toObject();
+            int limit = options.value("limit").toInt(25);
+            bool unreadOnly = options.value("filter").toString() == "unread";
+            auto before = options.value("publishedBeforeDate").toVariant().toUInt();
+            auto after = request.value("crawledAfterDate").toVariant().toUInt();
+
+            QList<int> feeds;
+            for (const auto &stream : request.value("streams").toArray()) {
+                int f = stream.toObject().value("id").toString().toInt() - 1;
+                if (f >= 0 && f < m_profile.feeds) feeds.append(f);
+            }
+
+            auto list = items([&](const Item &item) {
+                if (saved)
+                    return isSaved(item) &&
+                           (before == 0 || timestamp(item) < before);
+                if (unreadOnly && isRead(item)) return false;
+                if (timestamp(item) <= after) return false;
+                return feeds.contains(item.feed);
+            });
+
+            QJsonArray streams;
+            for (int f : feeds) streams.append(netvibesStream(f));
+
+            QJsonArray arr;
+            for (const auto &item : list.mid(0, limit))
+                arr.append(netvibesItem(item));
+
+            results.append(QJsonObject{{"streams", streams}, {"items", arr}});
+        }
+
+        obj.insert("success", true);
+        obj.insert("results", results);
+    } else if (path.startsWith("/api/streams/")) {
+        obj.insert("success", true);
+    } else {
+        reply.known = false;
+    }
+
+    reply.body = QJsonDocument{obj}.toJson(QJsonDocument::Compact);
+    return reply;
+}
+
+int ReplayServer::count(int feed) const {
+    return m_profile.items +
+           (feed < m_profile.changedFeeds ? m_generation * m_profile.newItems : 0);
+}
+
+int ReplayServer::unread(int feed) const {
+    int n = 0;
+    for (int i = 0; i < count(feed); ++i)
+        if (!isRead(Item{feed, i})) ++n;
+    return n;
+}
+
+int ReplayServer::category(int feed) const {
+    return feed % m_profile.categories;
+}
+
+qint64 ReplayServer::itemId(const Item &item) const {
+    return (item.feed + 1) * 1000000LL + item.index;
+}
+
+bool ReplayServer::itemFromId(qint64 id, Item *item) const {
+    item->feed = static_cast<int>(id / 1000000) - 1;
+    item->index = static_cast<int>(id % 1000000);
+    return item->feed >= 0 && item->feed < m_profile.feeds && item->index >= 0 &&
+           item->index < count(item->feed);
+}
+
+uint ReplayServer::timestamp(const Item &item) const {
+    return m_base + static_cast<uint>(item.index * m_profile.feeds + item.feed);
+}
+
+// Items of later generations are unread
+bool ReplayServer::isRead(const Item &item) const {
+    return item.index < m_profile.items && item.index % 3 == 0;
+}
+
+bool ReplayServer::isSaved(const Item &item) const {
+    return item.index % 20 == 1;
+}
+
+bool ReplayServer::isLiked(const Item &item) const {
+    return item.index % 30 == 3;
+}
+
+bool ReplayServer::isBroadcast(const Item &item) const {
+    return item.index % 25 == 2;
+}
+
+QString ReplayServer::title(const Item &item) const {
+    return QString("Item %1 of feed %2").arg(item.index + 1).arg(item.feed + 1);
+}
+
+QString ReplayServer::link(const Item &item) const {
+    return QString("http://feed.example/%1/%2").arg(item.feed + 1).arg(item.index + 1);
+}
+
+QString ReplayServer::content(const Item &item) const {
+    return QString("<p>%1</p><p>%2</p>").arg(title(item), m_filler);
+}
+
+QList<ReplayServer::Item> ReplayServer::items(const Filter &filter) const {
+    QList<Item> list;
+    for (int f = 0; f < m_profile.feeds; ++f) {
+        for (int i = count(f) - 1; i >= 0; --i) {
+            Item item{f, i};
+            if (filter(item)) list.append(item);
+        }
+    }
+
+    std::stable_sort(list.begin(), list.end(),
+                     [this](const Item &a, const Item &b) {
+                         return timestamp(a) > timestamp(b);
+                     });
+
+    return list;
+}
+
+QJsonObject ReplayServer::ttrssHeadline(const Item &item, bool withContent) const {
+    QJsonObject obj{{"id", itemId(item)},
+                    {"feed_id", QString::number(item.feed + 1)},
+                    {"title", title(item)},
+                    {"author", "Replay"},
+                    {"link", link(item)},
+                    {"unread", !isRead(item)},
+                    {"marked", isSaved(item)},
+                    {"published", isBroadcast(item)},
+                    {"updated", static_cast<qint64>(timestamp(item))}};
+    if (withContent) obj.insert("content", content(item));
+    return obj;
+}
+
+QString ReplayServer::oldReaderId(const Item &item) const {
+    return "tag:google.com,2005:reader/item/" +
+           QString::number(itemId(item), 16).rightJustified(16, '0');
+}
+
+QJsonObject ReplayServer::oldReaderItem(const Item &item) const {
+    static const QString state{"user/-/state/com.google/"};
+
+    QJsonArray categories{state + "reading-list", state + "fresh"};
+    if (isRead(item)) categories.append(state + "read");
+    if (isSaved(item)) categories.append(state + "starred");
+    if (isLiked(item)) categories.append(state + "like");
+    if (isBroadcast(item)) categories.append(state + "broadcast");
+
+    auto ts = QString::number(timestamp(item));
+    return QJsonObject{
+        {"id", oldReaderId(item)},
+        {"crawlTimeMsec", ts + "000"},
+        {"timestampUsec", ts + "000000"},
+        {"published", static_cast<qint64>(timestamp(item))},
+        {"updated", static_cast<qint64>(timestamp(item))},
+        {"title", title(item)},
+        {"author", "Replay"},
+        {"canonical", QJsonArray{QJsonObject{{"href", link(item)}}}},
+        {"summary", QJsonObject{{"direction", "ltr"}, {"content", content(item)}}},
+        {"categories", categories},
+        {"annotations", QJsonArray{}},
+        {"origin",
+         QJsonObject{{"streamId", QString("feed/%1").arg(item.feed + 1)},
+                     {"title", QString("Feed %1").arg(item.feed + 1)}}}};
+}
+
+// Empty link, so no icon is downloaded from outside
+QJsonObject ReplayServer::netvibesStream(int feed) const {
+    auto newest = static_cast<qint64>(timestamp(Item{feed, count(feed) - 1}));
+    return QJsonObject{
+        {"id", QString::number(feed + 1)},
+        {"title", QString("Feed %1").arg(feed + 1)},
+        {"link", ""},
+        {"query", QString("http://feed.example/%1").arg(feed + 1)},
+        {"content", ""},
+        {"type", "feeds"},
+        {"newestItemAddedAt", newest},
+        {"updateAt", newest}};
+}
+
+QJsonObject ReplayServer::netvibesItem(const Item &item) const {
+    return QJsonObject{
+        {"id", QString::number(itemId(item))},
+        {"stream", QJsonObject{{"id", QString::number(item.feed + 1)}}},
+        {"title", title(item)},
+        {"link", link(item)},
+        {"content", content(item)},
+        {"publishedAt", static_cast<qint64>(timestamp(item))},
+        {"createdAt", static_cast<qint64>(timestamp(item))},
+        {"flags", QJsonObject{{"read", isRead(item)}, {"saved", isSaved(item)}}},
+        {"authors", QJsonArray{QJsonObject{{"name", "Replay"}}}},
+        {"enclosures", QJsonArray{}}};
+}
@@ -0,0 +1,132 @@
+/* Copyright (C) 2022 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef REPLAYSERVER_H
+#define REPLAYSERVER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QJsonObject>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QUrl>
+#include <QUrlQuery>
+#include <functional>
+
+#include "qhttpserver/qhttprequest.h"
+#include "qhttpserver/qhttpresponse.h"
+#include "qhttpserver/qhttpserver.h"
+
+// Local stand-in for Netvibes, Old Reader and TT-RSS APIs. Fetcher requests
+// are redirected to it (see NetworkManager::setReplayUrl), so
+// sync can be measured without live accounts.
+//
+// Responses are generated from synthetic profile: feeds split into
+// categories, each with given number of items of given body size. Every
+// generation adds new items to first changedFeeds feeds, so incremental
+// sync has something to download.
+//
+// When recordings dir is set, file "<key>.<n>" is replayed instead of
+// generated response, where key is method, path and TT-RSS operation with
+// non-alphanumeric chars replaced by "_" (e.g. "POST_api__getHeadlines")
+// and n is number of request with that key (1, 2, ...).
+class ReplayServer : public QObject {
+    Q_OBJECT
+
+   public:
+    static const quint16 port = 9998;
+
+    struct Profile {
+        int feeds = 50;
+        int categories = 5;
+        int items = 100;
+        int bodySize = 2000;
+        // Delay of every response (ms)
+        int latency = 50;
+        int changedFeeds = 10;
+        int newItems = 5;
+    };
+
+    struct Counters {
+        int requests = 0;
+        int replayed = 0;
+        int unknown = 0;
+        qint64 bytes = 0;
+    };
+
+    explicit ReplayServer(const Profile &profile, QObject *parent = nullptr);
+
+    bool listen();
+    QUrl url() const;
+    void setRecordingsDir(const QString &dir);
+    void nextGeneration();
+    void resetCounters();
+    inline const Counters &counters() const { return m_counters; }
+    inline const Profile &profile() const { return m_profile; }
+
+   private slots:
+    void handle(QHttpRequest *req, QHttpResponse *resp);
+
+   private:
+    struct Item {
+        int feed = 0;
+        int index = 0;
+    };
+
+    struct Reply {
+        QByteArray body;
+        QString contentType = "application/json";
+        QString cookie;
+        bool known = true;
+    };
+
+    using Filter = std::function<bool(const Item &item)>;
+
+    QHttpServer *m_server = nullptr;
+    Profile m_profile;
+    QString m_recordingsDir;
+    QHash<QString, int> m_recordingCounts;
+    Counters m_counters;
+    int m_generation = 0;
+    uint m_base = 0;
+    QString m_filler;
+
+    void respond(QHttpRequest *req, QHttpResponse *resp);
+    bool readRecording(const QString &key, Reply *reply);
+    Reply synthesize(const QString &path, const QUrlQuery &query,
+                     const QByteArray &body);
+    Reply ttrss(const QByteArray &body);
+    Reply oldReader(const QString &path, const QUrlQuery &query,
+                    const QByteArray &body);
+    Reply netvibes(const QString &path, const QByteArray &body);
+
+    // Synthetic items, index 0 is the oldest item of feed
+    int count(int feed) const;
+    int unread(int feed) const;
+    int category(int feed) const;
+    qint64 itemId(const Item &item) const;
+    bool itemFromId(qint64 id, Item *item) const;
+    uint timestamp(const Item &item) const;
+    bool isRead(const Item &item) const;
+    bool isSaved(const Item &item) const;
+    bool isLiked(const Item &item) const;
+    bool isBroadcast(const Item &item) const;
+    QString title(const Item &item) const;
+    QString link(const Item &item) const;
+    QString content(const Item &item) const;
+    // Newest first
+    QList<Item> items(const Filter &filter) const;
+
+    QJsonObject ttrssHeadline(const Item &item, bool withContent) const;
+    QString oldReaderId(const Item &item) const;
+    QJsonObject oldReaderItem(const Item &item) const;
+    QJsonObject netvibesStream(int feed) const;
+    QJsonObject netvibesItem(const Item &item) const;
+};
+
+#endif  // REPLAYSERVER_H
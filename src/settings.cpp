@@ -100,6 +100,17 @@ bool Settings::getShowOldestFirst() const {
     return value("showoldestfirst", false).toBool();
 }
 
+void Settings::setCollapseDuplicates(bool value) {
+    if (getCollapseDuplicates() != value) {
+        setValue("collapseduplicates", value);
+        emit collapseDuplicatesChanged();
+    }
+}
+
+bool Settings::getCollapseDuplicates() const {
+    return value("collapseduplicates", false).toBool();
+}
+
 void Settings::setShowBroadcast(bool value) {
     if (getShowBroadcast() != value) {
         setValue("showbroadcast", value);
@@ -243,6 +254,17 @@ void Settings::setSyncRead(bool value) {
 
 bool Settings::getSyncRead() const { return value("syncread", false).toBool(); }
 
+void Settings::setBackgroundSync(bool value) {
+    if (getBackgroundSync() != value) {
+        setValue("backgroundsync", value);
+        emit backgroundSyncChanged();
+    }
+}
+
+bool Settings::getBackgroundSync() const {
+    return value("backgroundsync", true).toBool();
+}
+
 void Settings::setClickBehavior(int value) {
     if (getClickBehavior() != value) {
         setValue("clickbehavior", value);
@@ -631,6 +653,12 @@ int Settings::getRetentionDays() const {
 
 void Settings::setRetentionDays(int value) { setValue("retentiondays", value); }
 
+int Settings::getArchiveDays() const {
+    return value("archivedays", 30).toInt();
+}
+
+void Settings::setArchiveDays(int value) { setValue("archivedays", value); }
+
 int Settings::getTheme() const { return value("apptheme", 2).toInt(); }
 
 void Settings::setTheme(int value) {
@@ -652,6 +680,22 @@ int Settings::getFeedsUpdateAtOnce() const {
     return value("feedsupdateatonce", 10).toInt();
 }
 
+void Settings::setTtrssConcurrency(int value) {
+    setValue("ttrssconcurrency", value);
+}
+
+int Settings::getTtrssConcurrency() const {
+    return value("ttrssconcurrency", 4).toInt();
+}
+
+void Settings::setHttpValidators(const QVariantMap &value) {
+    setValue("httpvalidators", value);
+}
+
+QVariantMap Settings::getHttpValidators() const {
+    return value("httpvalidators").toMap();
+}
+
 /*
 View modes:
 0 - Tabs->Feeds->Entries
@@ -68,8 +68,12 @@ class Settings : public QSettings, public Singleton<Settings> {
                    NOTIFY showBroadcastChanged)
     Q_PROPERTY(bool showOldestFirst READ getShowOldestFirst WRITE
                    setShowOldestFirst NOTIFY showOldestFirstChanged)
+    Q_PROPERTY(bool collapseDuplicates READ getCollapseDuplicates WRITE
+                   setCollapseDuplicates NOTIFY collapseDuplicatesChanged)
     Q_PROPERTY(
         bool syncRead READ getSyncRead WRITE setSyncRead NOTIFY syncReadChanged)
+    Q_PROPERTY(bool backgroundSync READ getBackgroundSync WRITE
+                   setBackgroundSync NOTIFY backgroundSyncChanged)
     Q_PROPERTY(bool doublePane READ getDoublePane WRITE setDoublePane NOTIFY
                    doublePaneChanged)
     Q_PROPERTY(int clickBehavior READ getClickBehavior WRITE setClickBehavior
@@ -211,6 +215,10 @@ class Settings : public QSettings, public Singleton<Settings> {
     void setSyncRead(bool value);
     bool getSyncRead() const;
 
+    // Due feeds are refreshed in background according to their schedule
+    void setBackgroundSync(bool value);
+    bool getBackgroundSync() const;
+
     void setDoublePane(bool value);
     bool getDoublePane() const;
 
@@ -269,12 +277,22 @@ class Settings : public QSettings, public Singleton<Settings> {
     Q_INVOKABLE void setRetentionDays(int value);
     Q_INVOKABLE int getRetentionDays() const;
 
+    // Age in days after which read saved/liked entries are moved
+    // to the archive DB, 0 - archiving disabled
+    Q_INVOKABLE void setArchiveDays(int value);
+    Q_INVOKABLE int getArchiveDays() const;
+
     int getFilter() const;
     void setFilter(int value);
 
     bool getShowOldestFirst() const;
     void setShowOldestFirst(bool value);
 
+    // Copies of the same article from other feeds are hidden in views
+    // spanning whole dashboard
+    bool getCollapseDuplicates() const;
+    void setCollapseDuplicates(bool value);
+
     void setDmConnections(int value);
     int getDmConnections() const;
 
@@ -290,6 +308,12 @@ class Settings : public QSettings, public Singleton<Settings> {
     void setFeedsUpdateAtOnce(int value);
     int getFeedsUpdateAtOnce() const;
 
+    void setTtrssConcurrency(int value);
+    int getTtrssConcurrency() const;
+
+    void setHttpValidators(const QVariantMap &value);
+    QVariantMap getHttpValidators() const;
+
     void setIgnoreSslErrors(bool value);
     bool getIgnoreSslErrors() const;
 
@@ -326,7 +350,9 @@ class Settings : public QSettings, public Singleton<Settings> {
     void signinTypeChanged();
     void showBroadcastChanged();
     void showOldestFirstChanged();
+    void collapseDuplicatesChanged();
     void syncReadChanged();
+    void backgroundSyncChanged();
     void doublePaneChanged();
     void clickBehaviorChanged();
     void expandedModeChanged();
@@ -0,0 +1,238 @@
+/* Copyright (C) 2022 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "syncbenchmark.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QStandardPaths>
+#include <QTextStream>
+#include <QTimer>
+#include <cstdio>
+
+#include "databasemanager.h"
+#include "fetcher.h"
+#include "htmlscanner.h"
+#include "nvfetcher.h"
+#include "oldreaderfetcher.h"
+#include "settings.h"
+#include "ttrssfetcher.h"
+
+static const QString benchmarkOption{"benchmark-sync"};
+
+bool SyncBenchmark::requested(const QStringList &arguments) {
+    for (const auto &arg : arguments)
+        if (arg == "--" + benchmarkOption ||
+            arg.startsWith("--" + benchmarkOption + "="))
+            return true;
+    return false;
+}
+
+// Every run starts from empty settings, DB and cache
+void SyncBenchmark::prepare() {
+    QStandardPaths::setTestModeEnabled(true);
+
+    QDir{QStandardPaths::writableLocation(QStandardPaths::ConfigLocation) +
+         "/" + QCoreApplication::organizationName() + "/" +
+         QCoreApplication::applicationName()}
+        .removeRecursively();
+    QDir{QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)}
+        .removeRecursively();
+    QDir{QStandardPaths::writableLocation(QStandardPaths::CacheLocation)}
+        .removeRecursively();
+}
+
+SyncBenchmark::SyncBenchmark(QObject *parent) : QObject{parent} {}
+
+bool SyncBenchmark::start(const QStringList &arguments) {
+    ReplayServer::Profile profile;
+
+    QCommandLineParser parser;
+    parser.addOptions({
+        {benchmarkOption,
+         "Aggregators to sync: netvibes, oldreader, ttrss or all.", "types"},
+        {"feeds", "Number of feeds.", "n", QString::number(profile.feeds)},
+        {"categories", "Number of categories.", "n",
+         QString::number(profile.categories)},
+        {"items", "Items per feed.", "n", QString::number(profile.items)},
+        {"body-size", "Item content size in bytes.", "n",
+         QString::number(profile.bodySize)},
+        {"latency", "Delay of every response in ms.", "n",
+         QString::number(profile.latency)},
+        {"changed-feeds", "Feeds with new items on incremental sync.", "n",
+         QString::number(profile.changedFeeds)},
+        {"new-items", "New items per changed feed.", "n",
+         QString::number(profile.newItems)},
+        {"replay-dir", "Dir with recorded responses.", "dir"},
+    });
+
+    if (!parser.parse(arguments)) {
+        print(parser.errorText());
+        return false;
+    }
+
+    m_types = parser.value(benchmarkOption).split(',', QString::SkipEmptyParts);
+    if (m_types.isEmpty() || m_types.contains("all"))
+        m_types = QStringList{"netvibes", "oldreader", "ttrss"};
+    for (const auto &type : m_types) {
+        if (type != "netvibes" && type != "oldreader" && type != "ttrss") {
+            print("Unknown aggregator: " + type);
+            return false;
+        }
+    }
+
+    profile.feeds = parser.value("feeds").toInt();
+    profile.categories = parser.value("categories").toInt();
+    profile.items = parser.value("items").toInt();
+    profile.bodySize = parser.value("body-size").toInt();
+    profile.latency = parser.value("latency").toInt();
+    profile.changedFeeds = parser.value("changed-feeds").toInt();
+    profile.newItems = parser.value("new-items").toInt();
+
+    m_server = new ReplayServer{profile, this};
+    if (parser.isSet("replay-dir"))
+        m_server->setRecordingsDir(parser.value("replay-dir"));
+    if (!m_server->listen()) return false;
+
+    NetworkManager::setReplayUrl(m_server->url());
+
+    const auto &p = m_server->profile();
+    print(QString("profile: %1 feeds, %2 categories, %3 items per feed, "
+                  "%4 B body, %5 ms latency, %6 x %7 new items")
+              .arg(p.feeds)
+              .arg(p.categories)
+              .arg(p.items)
+              .arg(p.bodySize)
+              .arg(p.latency)
+              .arg(p.changedFeeds)
+              .arg(p.newItems));
+    print("aggregator  sync         wall ms  requests        kB  written  "
+          "duplicates  write ms  entries");
+
+    QTimer::singleShot(0, this, &SyncBenchmark::nextType);
+    return true;
+}
+
+void SyncBenchmark::nextType() {
+    auto s = Settings::instance();
+    auto db = DatabaseManager::instance();
+
+    if (++m_current >= m_types.size()) {
+        QCoreApplication::exit(0);
+        return;
+    }
+
+    const auto &type = m_types.at(m_current);
+
+    // Previous aggregator is signed out and its data removed
+    s->setSignedIn(false);
+    s->reset();
+    s->setBackgroundSync(false);
+    s->setUsername("replay");
+    s->setPassword("replay");
+    s->setUrl(m_server->url().toString());
+
+    db->cleanDashboards();
+    db->cleanTabs();
+    db->cleanModules();
+    db->cleanStreams();
+    db->cleanEntries();
+    db->cleanCache();
+
+    auto fetcher = makeFetcher(type);
+    s->fetcher = fetcher;
+    if (m_fetcher) m_fetcher->deleteLater();
+    m_fetcher = fetcher;
+
+    connect(m_fetcher, &Fetcher::ready, this, [this] {
+        // Fetcher is still busy when ready is emitted
+        QTimer::singleShot(0, this, &SyncBenchmark::finishPhase);
+    });
+    connect(m_fetcher, &Fetcher::error, this, &SyncBenchmark::fail);
+
+    m_phase = Phase::Full;
+    startPhase();
+}
+
+void SyncBenchmark::startPhase() {
+    m_server->resetCounters();
+    m_timer.start();
+
+    bool started = m_phase == Phase::Full ? m_fetcher->init()
+                                          : m_fetcher->update();
+    if (!started) fail(200);
+}
+
+void SyncBenchmark::finishPhase() {
+    auto wall = m_timer.elapsed();
+    const auto &server = m_server->counters();
+    const auto ingest = m_fetcher->ingestCounters();
+
+    print(QString("%1  %2  %3  %4  %5  %6  %7  %8  %9")
+              .arg(m_types.at(m_current), -10)
+              .arg(m_phase == Phase::Full ? "full" : "incremental", -11)
+              .arg(wall, 7)
+              .arg(server.requests, 8)
+              .arg(server.bytes / 1024, 8)
+              .arg(ingest.written, 7)
+              .arg(ingest.duplicates, 10)
+              .arg(ingest.writeNs / 1000000, 8)
+              .arg(DatabaseManager::instance()->countEntries(), 7));
+
+    if (server.unknown > 0)
+        print(QString("warning: %1 unknown requests").arg(server.unknown));
+
+    if (m_phase == Phase::Full) {
+        m_server->nextGeneration();
+        m_phase = Phase::Incremental;
+        startPhase();
+        return;
+    }
+
+    // HTML scanner is compared with the regex used before on synced content
+    const auto entries = DatabaseManager::instance()->readEntriesByDashboard(
+        Settings::instance()->getDashboardInUse(), 0, 500);
+    QList<QString> contents;
+    for (const auto &entry : entries) contents.append(entry.content);
+    print(HtmlScanner::benchmark(contents, 10));
+
+    nextType();
+}
+
+void SyncBenchmark::fail(int code) {
+    print(QString("%1 %2 sync failed, error %3")
+              .arg(m_types.value(m_current),
+                   m_phase == Phase::Full ? "full" : "incremental")
+              .arg(code));
+    QCoreApplication::exit(1);
+}
+
+Fetcher *SyncBenchmark::makeFetcher(const QString &type) {
+    auto s = Settings::instance();
+
+    if (type == "netvibes") {
+        s->setSigninType(0);
+        return new NvFetcher{this};
+    }
+
+    if (type == "oldreader") {
+        s->setSigninType(10);
+        return new OldReaderFetcher{this};
+    }
+
+    s->setSigninType(30);
+    return new TTRssFetcher{this};
+}
+
+// Report goes to stdout, so it is not mixed with debug log
+void SyncBenchmark::print(const QString &line) {
+    QTextStream out{stdout};
+    out << line << "\n";
+    out.flush();
+}
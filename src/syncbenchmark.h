@@ -0,0 +1,54 @@
+/* Copyright (C) 2022 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef SYNCBENCHMARK_H
+#define SYNCBENCHMARK_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+#include "replayserver.h"
+
+class Fetcher;
+
+// Headless full and incremental sync of every requested aggregator against
+// local ReplayServer, started with "--benchmark-sync <types>" (see
+// "make benchmark"). For each sync wall time, requests, bytes and DB writes
+// are printed to stdout. Settings, DB and cache are kept in Qt test mode
+// dirs, so user data is not touched.
+class SyncBenchmark : public QObject {
+    Q_OBJECT
+
+   public:
+    static bool requested(const QStringList &arguments);
+    // Must be called before Settings and DB are created
+    static void prepare();
+
+    explicit SyncBenchmark(QObject *parent = nullptr);
+    bool start(const QStringList &arguments);
+
+   private:
+    enum class Phase { Full, Incremental };
+
+    ReplayServer *m_server = nullptr;
+    Fetcher *m_fetcher = nullptr;
+    QStringList m_types;
+    int m_current = -1;
+    Phase m_phase = Phase::Full;
+    QElapsedTimer m_timer;
+
+    void nextType();
+    void startPhase();
+    void finishPhase();
+    void fail(int code);
+    Fetcher *makeFetcher(const QString &type);
+    static void print(const QString &line);
+};
+
+#endif  // SYNCBENCHMARK_H
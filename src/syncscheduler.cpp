@@ -0,0 +1,125 @@
+/* Copyright (C) 2022 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "syncscheduler.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QSet>
+#include <algorithm>
+
+static int now() { return QDateTime::currentDateTimeUtc().toTime_t(); }
+
+SyncScheduler::SyncScheduler(QObject *parent) : QObject{parent} {
+    m_timer.setSingleShot(true);
+    connect(&m_timer, &QTimer::timeout, this, &SyncScheduler::due);
+    m_prewarmTimer.setSingleShot(true);
+    connect(&m_prewarmTimer, &QTimer::timeout, this, &SyncScheduler::dueSoon);
+}
+
+void SyncScheduler::setEnabled(bool enabled) {
+    m_enabled = enabled;
+    if (enabled) {
+        arm();
+    } else {
+        m_timer.stop();
+        m_prewarmTimer.stop();
+    }
+}
+
+// Average distance between recent entries, streams without recent entries
+// are polled once a day
+int SyncScheduler::interval(const DatabaseManager::Schedule &schedule) {
+    int base = schedule.posts > 0 ? historyDays * 24 * 60 * 60 / schedule.posts
+                                  : maxInterval;
+    if (schedule.slow) base = std::max(base, slowInterval);
+    base = qBound(minInterval, base, maxInterval);
+
+    int backoff = std::min(std::max(schedule.idle, schedule.errors), maxBackoff);
+
+    return std::min(base << backoff, maxInterval);
+}
+
+QStringList SyncScheduler::dueStreams() const {
+    auto schedules = DatabaseManager::instance()->readSchedules(
+        now() - historyDays * 24 * 60 * 60);
+
+    std::sort(schedules.begin(), schedules.end(),
+              [](const DatabaseManager::Schedule &a,
+                 const DatabaseManager::Schedule &b) {
+                  return a.nextPoll < b.nextPoll;
+              });
+
+    QStringList ids;
+    auto time = now();
+    for (const auto &schedule : schedules) {
+        if (schedule.nextPoll > time || ids.size() >= maxStreams) break;
+        ids.append(schedule.streamId);
+    }
+
+    return ids;
+}
+
+void SyncScheduler::polled(const QStringList &streamIds, bool error) {
+    auto db = DatabaseManager::instance();
+    auto time = now();
+    auto schedules = db->readSchedules(time - historyDays * 24 * 60 * 60);
+    auto ids = streamIds.toSet();
+
+    QList<DatabaseManager::Schedule> changed;
+    for (auto &schedule : schedules) {
+        if (!ids.isEmpty() && !ids.contains(schedule.streamId)) continue;
+
+        if (error) {
+            ++schedule.errors;
+        } else {
+            schedule.errors = 0;
+            if (schedule.newestPublishedAt > schedule.lastPublishedAt)
+                schedule.idle = 0;
+            else
+                ++schedule.idle;
+            schedule.lastPublishedAt = schedule.newestPublishedAt;
+        }
+
+        schedule.nextPoll = time + interval(schedule);
+        changed.append(schedule);
+    }
+
+    db->writeSchedules(changed);
+
+    qDebug() << "Schedule updated:" << changed.size() << "streams"
+             << (error ? "(error)" : "");
+
+    arm();
+}
+
+void SyncScheduler::arm() {
+    if (!m_enabled) return;
+
+    const auto schedules = DatabaseManager::instance()->readSchedules(
+        now() - historyDays * 24 * 60 * 60);
+    if (schedules.isEmpty()) {
+        m_timer.stop();
+        m_prewarmTimer.stop();
+        return;
+    }
+
+    int next = schedules.first().nextPoll;
+    for (const auto &schedule : schedules)
+        next = std::min(next, schedule.nextPoll);
+
+    armIn(next - now());
+}
+
+void SyncScheduler::retry() { armIn(retryDelay); }
+
+void SyncScheduler::armIn(int secs) {
+    if (!m_enabled) return;
+    secs = qBound(60, secs, maxInterval);
+    m_timer.start(secs * 1000);
+    m_prewarmTimer.start((secs - prewarmLead) * 1000);
+}
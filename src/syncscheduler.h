@@ -0,0 +1,60 @@
+/* Copyright (C) 2022 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef SYNCSCHEDULER_H
+#define SYNCSCHEDULER_H
+
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+
+#include "databasemanager.h"
+
+// Keeps next poll time of every stream. Interval follows posting history
+// of a stream and is never shorter than slowInterval for slow streams. It
+// doubles after each poll that brought nothing new or failed and is reset
+// when new entries arrive. Timer is armed to the nearest next poll and
+// due() is emitted when some streams should be refreshed.
+class SyncScheduler : public QObject {
+    Q_OBJECT
+   public:
+    static const int historyDays = 14;
+    static const int minInterval = 15 * 60;
+    static const int slowInterval = 6 * 60 * 60;
+    static const int maxInterval = 24 * 60 * 60;
+    static const int maxBackoff = 4;
+    static const int retryDelay = 5 * 60;
+    // Streams refreshed at once
+    static const int maxStreams = 20;
+    // dueSoon() is emitted that many secs before due()
+    static const int prewarmLead = 30;
+
+    explicit SyncScheduler(QObject *parent = nullptr);
+
+    void setEnabled(bool enabled);
+    // Most overdue streams first
+    QStringList dueStreams() const;
+    // Empty list means all streams (full sync)
+    void polled(const QStringList &streamIds, bool error);
+    void arm();
+    void retry();
+
+    static int interval(const DatabaseManager::Schedule &schedule);
+
+   signals:
+    void due();
+    void dueSoon();
+
+   private:
+    QTimer m_timer;
+    QTimer m_prewarmTimer;
+    bool m_enabled = false;
+
+    void armIn(int secs);
+};
+
+#endif  // SYNCSCHEDULER_H
@@ -0,0 +1,303 @@
+/* Copyright (C) 2022 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "syncstats.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QMutexLocker>
+#include <QRegExp>
+#include <QTextStream>
+#include <memory>
+
+#include "settings.h"
+
+SyncStats::SyncStats(QObject *parent) : QObject{parent} { load(); }
+
+void SyncStats::begin(const QString &type) {
+    QMutexLocker locker{&m_mutex};
+
+    m_active = true;
+    m_timer.start();
+    m_started = QDateTime::currentDateTime();
+    m_type = type;
+    m_result = "ok";
+    m_notes.clear();
+    m_requests.clear();
+    m_jobs.clear();
+    m_parse = Span{};
+    m_upload = Span{};
+    m_ingest.clear();
+}
+
+void SyncStats::end() {
+    QString text;
+
+    {
+        QMutexLocker locker{&m_mutex};
+        if (!m_active) return;
+        m_active = false;
+
+        text = summary();
+        m_summaries.append(text);
+        while (m_summaries.size() > maxSummaries) m_summaries.removeFirst();
+    }
+
+    qDebug().noquote() << "Sync summary:\n" << text;
+    save();
+    emit updated();
+}
+
+void SyncStats::setResult(const QString &result) {
+    QMutexLocker locker{&m_mutex};
+    if (m_active) m_result = result;
+}
+
+void SyncStats::note(const QString &text) {
+    QMutexLocker locker{&m_mutex};
+    if (m_active) m_notes.append(text);
+}
+
+void SyncStats::track(QNetworkReply *reply, const QString &urlClass) {
+    {
+        QMutexLocker locker{&m_mutex};
+        if (!m_active) return;
+    }
+
+    struct Pending {
+        QElapsedTimer timer;
+        qint64 ttfbNs = -1;
+        qint64 bytes = 0;
+    };
+
+    auto pending = std::make_shared<Pending>();
+    pending->timer.start();
+
+    // Headers of final reply, time to first byte includes DNS, connect
+    // and TLS handshake of new connection
+    connect(reply, &QNetworkReply::metaDataChanged, this, [pending] {
+        if (pending->ttfbNs < 0) pending->ttfbNs = pending->timer.nsecsElapsed();
+    });
+    connect(reply, &QNetworkReply::uploadProgress, this,
+            [pending](qint64 sent, qint64) { pending->bytes = sent; });
+    connect(reply, &QNetworkReply::downloadProgress, this,
+            [pending](qint64 received, qint64) {
+                if (received > 0) pending->bytes = received;
+            });
+    connect(reply, &QNetworkReply::finished, this, [this, reply, pending,
+                                                    urlClass] {
+        auto error = reply->error() != QNetworkReply::NoError &&
+                     reply->error() != QNetworkReply::OperationCanceledError;
+        addRequest(urlClass, pending->bytes, qMax<qint64>(0, pending->ttfbNs),
+                   pending->timer.nsecsElapsed(), error);
+    });
+}
+
+void SyncStats::addRequest(const QString &urlClass, qint64 bytes,
+                           qint64 ttfbNs, qint64 ns, bool error) {
+    QMutexLocker locker{&m_mutex};
+    if (!m_active) return;
+
+    auto &span = m_requests[urlClass];
+    span.count++;
+    if (error) span.errors++;
+    span.bytes += bytes;
+    span.ns += ns;
+    span.maxNs = qMax(span.maxNs, ns);
+    span.ttfbNs += ttfbNs;
+    span.maxTtfbNs = qMax(span.maxTtfbNs, ttfbNs);
+}
+
+void SyncStats::addParse(qint64 bytes, qint64 ns) {
+    QMutexLocker locker{&m_mutex};
+    if (!m_active) return;
+
+    m_parse.count++;
+    m_parse.bytes += bytes;
+    m_parse.ns += ns;
+    m_parse.maxNs = qMax(m_parse.maxNs, ns);
+}
+
+void SyncStats::addJob(const QString &name, qint64 ns, int rows) {
+    QMutexLocker locker{&m_mutex};
+    if (!m_active) return;
+
+    auto &span = m_jobs[name];
+    span.count++;
+    span.rows += rows;
+    span.ns += ns;
+    span.maxNs = qMax(span.maxNs, ns);
+}
+
+void SyncStats::addUpload(int actions, int requests, qint64 ns) {
+    QMutexLocker locker{&m_mutex};
+    if (!m_active) return;
+
+    m_upload.count += requests;
+    m_upload.rows += actions;
+    m_upload.ns += ns;
+}
+
+void SyncStats::setIngest(const QString &report) {
+    QMutexLocker locker{&m_mutex};
+    if (m_active) m_ingest = report;
+}
+
+QString SyncStats::urlClass(QNetworkAccessManager::Operation operation,
+                            const QNetworkRequest &request,
+                            QIODevice *outgoingData) {
+    QString method;
+    switch (operation) {
+        case QNetworkAccessManager::HeadOperation:
+            method = "HEAD";
+            break;
+        case QNetworkAccessManager::GetOperation:
+            method = "GET";
+            break;
+        case QNetworkAccessManager::PutOperation:
+            method = "PUT";
+            break;
+        case QNetworkAccessManager::PostOperation:
+            method = "POST";
+            break;
+        case QNetworkAccessManager::DeleteOperation:
+            method = "DELETE";
+            break;
+        default:
+            method = "CUSTOM";
+    }
+
+    // Ids in path are long or contain digits
+    auto segments = request.url().path().split('/', QString::SkipEmptyParts);
+    for (auto &segment : segments) {
+        if (segment.size() > 24 ||
+            (segment.size() > 4 && segment.contains(QRegExp{"\\d"})))
+            segment = "*";
+    }
+
+    auto name = method + " /" + segments.join('/');
+
+    // TT-RSS API has one URL, operation is in JSON body
+    if (outgoingData) {
+        QRegExp rx{"\"op\"\\s*:\\s*\"(\\w+)\""};
+        if (rx.indexIn(QString::fromUtf8(outgoingData->peek(1024))) != -1)
+            name += " " + rx.cap(1);
+    }
+
+    return name;
+}
+
+static inline QString toMs(qint64 ns) {
+    return QString::number(static_cast<double>(ns) / 1000000, 'f', 1);
+}
+
+static inline QString toKb(qint64 bytes) {
+    return QString::number(static_cast<double>(bytes) / 1024, 'f', 1);
+}
+
+QString SyncStats::summary() const {
+    QString text;
+    QTextStream out{&text};
+
+    out << m_started.toString("yyyy-MM-dd hh:mm:ss") << " " << m_type << " "
+        << m_result << " " << toMs(m_timer.nsecsElapsed()) << " ms\n";
+
+    for (const auto &note : m_notes) out << note << "\n";
+
+    int count = 0, errors = 0;
+    qint64 bytes = 0;
+    for (const auto &span : m_requests) {
+        count += span.count;
+        errors += span.errors;
+        bytes += span.bytes;
+    }
+    out << "requests: " << count << ", " << toKb(bytes) << " kB, errors "
+        << errors << "\n";
+    for (auto it = m_requests.cbegin(); it != m_requests.cend(); ++it) {
+        const auto &span = it.value();
+        out << "  " << it.key() << ": " << span.count << "x " << toKb(span.bytes)
+            << " kB, ttfb " << toMs(span.ttfbNs / span.count) << "/"
+            << toMs(span.maxTtfbNs) << " ms, total "
+            << toMs(span.ns / span.count) << "/" << toMs(span.maxNs)
+            << " ms (avg/max)";
+        if (span.errors > 0) out << ", errors " << span.errors;
+        out << "\n";
+    }
+
+    out << "parse: " << m_parse.count << "x " << toKb(m_parse.bytes)
+        << " kB, " << toMs(m_parse.ns) << " ms, max " << toMs(m_parse.maxNs)
+        << " ms\n";
+
+    out << "jobs:\n";
+    for (auto it = m_jobs.cbegin(); it != m_jobs.cend(); ++it) {
+        const auto &span = it.value();
+        out << "  " << it.key() << ": " << span.count << "x " << toMs(span.ns)
+            << " ms, max " << toMs(span.maxNs) << " ms, rows " << span.rows
+            << "\n";
+    }
+
+    if (m_upload.rows > 0)
+        out << "upload: " << m_upload.rows << " actions, " << m_upload.count
+            << " requests, " << toMs(m_upload.ns) << " ms\n";
+
+    if (!m_ingest.isEmpty()) out << "ingest: " << m_ingest << "\n";
+
+    out.flush();
+    return text;
+}
+
+// Newest first
+QString SyncStats::report() const {
+    QMutexLocker locker{&m_mutex};
+
+    QStringList summaries;
+    for (auto it = m_summaries.crbegin(); it != m_summaries.crend(); ++it)
+        summaries.append(*it);
+    return summaries.join('\n');
+}
+
+void SyncStats::clear() {
+    {
+        QMutexLocker locker{&m_mutex};
+        m_summaries.clear();
+    }
+
+    QFile::remove(logPath());
+    emit updated();
+}
+
+QString SyncStats::logPath() const {
+    return QDir{Settings::instance()->getSettingsDir()}.absoluteFilePath(
+        "sync.log");
+}
+
+// Summaries are separated by line with "--"
+void SyncStats::load() {
+    QFile file{logPath()};
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) return;
+
+    auto summaries = QString::fromUtf8(file.readAll())
+                         .split("--\n", QString::SkipEmptyParts);
+    m_summaries = summaries.mid(qMax(0, summaries.size() - maxSummaries));
+}
+
+void SyncStats::save() const {
+    QStringList summaries;
+    {
+        QMutexLocker locker{&m_mutex};
+        summaries = m_summaries;
+    }
+
+    QFile file{logPath()};
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        qWarning() << "cannot open file:" << file.fileName();
+        return;
+    }
+
+    file.write(summaries.join("--\n").toUtf8());
+}
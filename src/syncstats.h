@@ -0,0 +1,93 @@
+/* Copyright (C) 2022 Michal Kosciesza <michal@mkiol.net>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef SYNCSTATS_H
+#define SYNCSTATS_H
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QIODevice>
+#include <QMap>
+#include <QMutex>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+#include "singleton.h"
+
+// Timing and byte counters of one sync split into phases: requests grouped
+// by URL class, JSON parsing, store jobs and action upload. When sync ends,
+// summary is appended to rolling log kept in settings dir. Requests are
+// tracked in main thread, parse and jobs are reported from worker thread.
+class SyncStats : public QObject, public Singleton<SyncStats> {
+    Q_OBJECT
+
+   public:
+    explicit SyncStats(QObject *parent = nullptr);
+
+    void begin(const QString &type);
+    void end();
+    void setResult(const QString &result);
+    void note(const QString &text);
+    // Reply must be tracked before any other slot is connected to it
+    void track(QNetworkReply *reply, const QString &urlClass);
+    void addParse(qint64 bytes, qint64 ns);
+    void addJob(const QString &name, qint64 ns, int rows);
+    void addUpload(int actions, int requests, qint64 ns);
+    void setIngest(const QString &report);
+
+    // Method, path with ids replaced by "*" and TT-RSS API operation
+    static QString urlClass(QNetworkAccessManager::Operation operation,
+                            const QNetworkRequest &request,
+                            QIODevice *outgoingData);
+
+    Q_INVOKABLE QString report() const;
+    Q_INVOKABLE void clear();
+
+   signals:
+    void updated();
+
+   private:
+    static const int maxSummaries = 20;
+
+    struct Span {
+        int count = 0;
+        int errors = 0;
+        qint64 bytes = 0;
+        qint64 rows = 0;
+        qint64 ns = 0;
+        qint64 maxNs = 0;
+        qint64 ttfbNs = 0;
+        qint64 maxTtfbNs = 0;
+    };
+
+    mutable QMutex m_mutex;
+    bool m_active = false;
+    QElapsedTimer m_timer;
+    QDateTime m_started;
+    QString m_type;
+    QString m_result;
+    QStringList m_notes;
+    QMap<QString, Span> m_requests;
+    QMap<QString, Span> m_jobs;
+    Span m_parse;
+    Span m_upload;
+    QString m_ingest;
+    QStringList m_summaries;
+
+    void addRequest(const QString &urlClass, qint64 bytes, qint64 ttfbNs,
+                    qint64 ns, bool error);
+    QString summary() const;
+    QString logPath() const;
+    void load();
+    void save() const;
+};
+
+#endif  // SYNCSTATS_H
@@ -18,9 +18,9 @@
   along with Kaktus.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <QRegExp>
 #include <QSslError>
 #include <QtCore/qmath.h>
+#include <QMetaEnum>
 
 #if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
 #include <QJsonDocument>
@@ -37,6 +37,44 @@
 #define FETCHER_SLOT(callback) SLOT(callback)
 #endif
 
+static const JsonEntryDecoder::Table &headlinesTable()
+{
+    static const JsonEntryDecoder::Table table = [] {
+        JsonEntryDecoder::Table t;
+        t.itemsPath = QStringList{"content"};
+        t.captures = {QStringList{"status"}, QStringList{"content"}};
+        t.fields = {
+            {"id", [](DatabaseManager::Entry &e, const QVariant &v) { e.id = v.toString(); }},
+            {"feed_id", [](DatabaseManager::Entry &e, const QVariant &v) { e.streamId = v.toString(); }},
+            {"title", [](DatabaseManager::Entry &e, const QVariant &v) { e.title = v.toString(); }},
+            {"author", [](DatabaseManager::Entry &e, const QVariant &v) { e.author = v.toString(); }},
+            {"content", [](DatabaseManager::Entry &e, const QVariant &v) {
+                 if (v.type() == QVariant::String)
+                     e.content = v.toString();
+             }},
+            {"link", [](DatabaseManager::Entry &e, const QVariant &v) { e.link = v.toString(); }},
+            {"unread", [](DatabaseManager::Entry &e, const QVariant &v) { e.read = v.toBool() ? 0 : 1; }},
+            {"marked", [](DatabaseManager::Entry &e, const QVariant &v) { e.saved = v.toBool() ? 1 : 0; }},
+            {"published", [](DatabaseManager::Entry &e, const QVariant &v) { e.broadcast = v.toBool() ? 1 : 0; }},
+            {"updated", [](DatabaseManager::Entry &e, const QVariant &v) {
+                 e.publishedAt = v.toInt();
+                 e.createdAt = e.publishedAt;
+                 e.timestamp = e.publishedAt;
+             }}
+        };
+        t.init = [](DatabaseManager::Entry &e) {
+            e.read = 1;
+        };
+        t.finish = [](DatabaseManager::Entry &e, const QVariantHash &) {
+            e.cached = 0;
+            e.fresh = 1;
+        };
+        return t;
+    }();
+
+    return table;
+}
+
 TTRssFetcher::TTRssFetcher(QObject *parent) :
   Fetcher(parent),
   currentCommand(NULL),
@@ -48,6 +86,11 @@ TTRssFetcher::~TTRssFetcher()
 {
 }
 
+QUrl TTRssFetcher::serviceUrl() const
+{
+    return QUrl(Settings::instance()->getUrl());
+}
+
 void TTRssFetcher::signIn()
 {
     Settings *s = Settings::instance();
@@ -140,6 +183,12 @@ void TTRssFetcher::startFetching()
     auto s = Settings::instance();
     auto db = DatabaseManager::instance();
 
+    if (busyType == Fetcher::Refreshing) {
+        abortHeadlines();
+        startRefresh();
+        return;
+    }
+
     if (!db->makeBackup ()) {
         qWarning() << "Unable to make DB backup";
         emit error(506);
@@ -147,20 +196,40 @@ void TTRssFetcher::startFetching()
         return;
     }
 
-    db->cleanDashboards();
+    abortHeadlines();
+
+    // Structure is kept on update and only changes are fetched. Interrupted
+    // full sync is completed first.
+    QList<DatabaseManager::Checkpoint> checkpoints;
+    if (busyType == Fetcher::Updating && db->countStreams() > 0)
+        checkpoints = resumeCheckpoints("ttrss/");
+
+    if (!checkpoints.isEmpty()) {
+        startResumedSync(checkpoints);
+    } else if (busyType == Fetcher::Updating && db->countStreams() > 0) {
+        startIncrementalSync();
+    } else {
+        startFullSync();
+    }
+}
+
+void TTRssFetcher::startFullSync()
+{
+    auto s = Settings::instance();
+    auto db = DatabaseManager::instance();
+
+    // Categories and feeds are collected and compared with stored
+    // structure when feeds are fetched
+    structure = DatabaseManager::Structure();
 
     DatabaseManager::Dashboard d;
     d.id = "ttrss";
     d.name = "Default";
     d.title = "Default";
     d.description = "Tiny Tiny Rss default dashboard";
-    db->writeDashboard(d);
+    structure.dashboards.append(d);
     s->setDashboardInUse(d.id);
 
-    db->cleanTabs();
-    db->cleanStreams();
-    db->cleanModules();
-
     if(busyType == Fetcher::Initiating) {
         db->cleanCache();
         db->cleanEntries();
@@ -169,7 +238,10 @@ void TTRssFetcher::startFetching()
     commandList.clear();
     commandList.append(&TTRssFetcher::fetchCategories);
     commandList.append(&TTRssFetcher::fetchFeeds);
-    commandList.append(&TTRssFetcher::fetchStream);
+    if (s->getTtrssConcurrency() > 1)
+        commandList.append(&TTRssFetcher::fetchStreamConcurrent);
+    else
+        commandList.append(&TTRssFetcher::fetchStream);
     commandList.append(&TTRssFetcher::fetchStarredStream);
     commandList.append(&TTRssFetcher::fetchPublishedStream);
     commandList.append(&TTRssFetcher::pruneOld);
@@ -182,6 +254,305 @@ void TTRssFetcher::startFetching()
     callNextCmd();
 }
 
+void TTRssFetcher::startIncrementalSync()
+{
+    structureChanged = false;
+
+    commandList.clear();
+    commandList.append(&TTRssFetcher::fetchCounters);
+    commandList.append(&TTRssFetcher::fetchChanges);
+    commandList.append(&TTRssFetcher::reconcileState);
+    commandList.append(&TTRssFetcher::fetchMissingArticles);
+    commandList.append(&TTRssFetcher::pruneRetention);
+
+    proggressTotal = commandList.size() + Settings::instance()->getRetentionDays();
+    proggress = 0;
+    lastDate = 0;
+    offset = 0;
+
+    callNextCmd();
+}
+
+// Headlines of due feeds only, counters are not fetched so unread
+// counts are taken from lists of unread ids
+// Structure was stored before interruption, stream is continued after
+// the last stored page
+void TTRssFetcher::startResumedSync(const QList<DatabaseManager::Checkpoint> &checkpoints)
+{
+    bool sequential = false;
+    bool streamDone = false;
+    offset = 0;
+    lastDate = 0;
+    resumeCategories.clear();
+
+    for (const auto &checkpoint : checkpoints) {
+        if (checkpoint.job == "ttrss/stream") {
+            sequential = true;
+            streamDone = checkpoint.done;
+            offset = checkpoint.offset;
+            lastDate = checkpoint.lastDate;
+        } else {
+            resumeCategories.insert(checkpoint.job.section('/', 2).toInt(), checkpoint);
+        }
+    }
+
+    qDebug() << "Resuming full sync, checkpoints:" << checkpoints.size();
+
+    commandList.clear();
+    if (!sequential)
+        commandList.append(&TTRssFetcher::fetchStreamConcurrent);
+    else if (!streamDone)
+        commandList.append(&TTRssFetcher::fetchStream);
+    commandList.append(&TTRssFetcher::fetchStarredStream);
+    commandList.append(&TTRssFetcher::fetchPublishedStream);
+    commandList.append(&TTRssFetcher::pruneOld);
+
+    proggressTotal = commandList.size() + Settings::instance()->getRetentionDays();
+    proggress = 0;
+
+    callNextCmd();
+}
+
+void TTRssFetcher::startRefresh()
+{
+    counters.clear();
+    changedFeeds = refreshStreams;
+
+    commandList.clear();
+    commandList.append(&TTRssFetcher::fetchChanges);
+    commandList.append(&TTRssFetcher::reconcileState);
+    commandList.append(&TTRssFetcher::fetchMissingArticles);
+
+    proggressTotal = commandList.size() + Settings::instance()->getRetentionDays();
+    proggress = 0;
+    lastDate = 0;
+    offset = 0;
+
+    callNextCmd();
+}
+
+void TTRssFetcher::fetchCounters()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
+    QJsonObject params;
+    params["output_mode"] = "f";
+#else
+    QString params = "\"output_mode\":\"f\"";
+#endif
+
+    sendApiCall("getCounters", params, FETCHER_SLOT(finishedCounters));
+}
+
+void TTRssFetcher::finishedCounters()
+{
+    if (!processResponse()) {
+        return;
+    }
+
+    auto db = DatabaseManager::instance();
+
+    QHash<QString, int> localUnread;
+    QHash<QString, int> localUpdates;
+    for (const auto &st : db->readStreamsByDashboard("ttrss")) {
+        localUnread.insert(st.id, st.unread);
+        localUpdates.insert(st.id, st.updateAt);
+    }
+
+    counters.clear();
+    feedUpdates.clear();
+    changedFeeds.clear();
+    bool feedsChanged = false;
+
+#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
+    QJsonArray arr = jsonObj["content"].toArray();
+    for (int i = 0; i < arr.count(); ++i) {
+        QJsonObject obj = arr.at(i).toObject();
+        // Global counters have string ids
+        if (!obj["id"].isDouble()) {
+            if (obj["id"].toString() == "subscribed-feeds" &&
+                obj["counter"].toInt() != localUnread.count())
+                feedsChanged = true;
+            continue;
+        }
+#else
+    QVariantList arr = jsonObj["content"].toList();
+    for (int i = 0; i < arr.count(); ++i) {
+        QVariantMap obj = arr.at(i).toMap();
+        if (obj["id"].type() == QVariant::String) {
+            if (obj["id"].toString() == "subscribed-feeds" &&
+                obj["counter"].toInt() != localUnread.count())
+                feedsChanged = true;
+            continue;
+        }
+#endif
+        // Categories, special feeds and labels are skipped
+        int id = obj["id"].toInt();
+        if (id <= 0 || obj.contains("kind"))
+            continue;
+
+        QString feedId = QString::number(id);
+        if (!localUnread.contains(feedId))
+            feedsChanged = true;
+        counters.insert(feedId, obj["counter"].toInt());
+        // Older servers don't send update time
+        if (obj.contains("ts"))
+            feedUpdates.insert(feedId, obj["ts"].toInt());
+    }
+
+    if (feedsChanged) {
+        qDebug() << "Feeds have changed, doing full sync";
+        reportProbe(-1, localUnread.count());
+        startFullSync();
+        return;
+    }
+
+    // Counter alone misses new articles already read on other client or
+    // arrivals offset by reads, so feed updated on server since the last
+    // sync is fetched as well
+    for (auto it = localUnread.constBegin(); it != localUnread.constEnd(); ++it) {
+        if (counters.value(it.key()) != it.value() ||
+            feedUpdates.value(it.key()) > localUpdates.value(it.key()))
+            changedFeeds.append(it.key());
+    }
+
+    reportProbe(changedFeeds.count(), localUnread.count());
+
+    // Counters are equal, there is nothing new to fetch
+    if (changedFeeds.isEmpty()) {
+        commandList.clear();
+        taskEnd();
+        return;
+    }
+
+    callNextCmd();
+}
+
+void TTRssFetcher::fetchChanges()
+{
+    auto s = Settings::instance();
+    auto db = DatabaseManager::instance();
+
+    auto maxIds = db->readMaxEntryIdsByStream();
+
+    pendingHeadlines.clear();
+    headlinesIds.clear();
+
+    // New articles are requested after last known id and state of
+    // existing ones is reconciled with list of unread ids
+    for (const auto &feedId : changedFeeds) {
+        HeadlinesRequest request;
+        request.feedId = feedId.toInt();
+        request.unreadOnly = !s->getSyncRead();
+        request.sinceId = maxIds.value(feedId);
+        pendingHeadlines.append(request);
+
+        HeadlinesRequest ids;
+        ids.feedId = request.feedId;
+        ids.unreadOnly = true;
+        ids.idsOnly = true;
+        pendingHeadlines.append(ids);
+    }
+
+    // Starred and published state can change without affecting counters
+    HeadlinesRequest starred;
+    starred.feedId = Starred;
+    starred.idsOnly = true;
+    pendingHeadlines.append(starred);
+
+    HeadlinesRequest published;
+    published.feedId = Published;
+    published.idsOnly = true;
+    pendingHeadlines.append(published);
+
+    headlinesFanOut = true;
+    headlinesUnits = pendingHeadlines.count();
+    headlinesDone = 0;
+
+    dispatchHeadlines();
+}
+
+void TTRssFetcher::reconcileState()
+{
+    auto db = DatabaseManager::instance();
+
+    for (const auto &feedId : changedFeeds) {
+        db->updateEntriesReadFlagByStreamAndIds(feedId, headlinesIds.value(feedId.toInt()));
+        db->updateStreamUnreadById(feedId, counters.contains(feedId) ?
+                                       counters.value(feedId) :
+                                       headlinesIds.value(feedId.toInt()).size());
+        if (feedUpdates.contains(feedId))
+            db->updateStreamUpdateAtById(feedId, feedUpdates.value(feedId));
+    }
+
+    QList<QString> starred = headlinesIds.value(Starred);
+    QList<QString> published = headlinesIds.value(Published);
+    db->updateEntriesSavedFlagByIds(starred);
+    db->updateEntriesBroadcastFlagByIds(published);
+
+    // Old articles starred or published since last sync
+    missingIds = db->readMissingEntryIds(starred + published);
+    missingIds.removeDuplicates();
+
+    headlinesIds.clear();
+
+    callNextCmd();
+}
+
+void TTRssFetcher::fetchMissingArticles()
+{
+    if (missingIds.isEmpty()) {
+        callNextCmd();
+        return;
+    }
+
+    QStringList ids = missingIds.mid(0, streamLimit);
+    missingIds = missingIds.mid(streamLimit);
+
+#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
+    QJsonObject params;
+    params["article_id"] = ids.join(",");
+#else
+    QString params = "\"article_id\":\"" + ids.join(",") + "\"";
+#endif
+
+    sendApiCall("getArticle", params, FETCHER_SLOT(finishedArticles));
+    startDecoding(headlinesTable());
+}
+
+void TTRssFetcher::finishedArticles()
+{
+    if (!checkReply()) {
+        return;
+    }
+
+    int code = parseResponse();
+    if (code != 0) {
+        responseError(code);
+        return;
+    }
+
+    QList<DatabaseManager::Entry> entries;
+    entries.swap(decodedEntries);
+    queuePage(entries);
+
+    pagingMore = false;
+    if (!missingIds.isEmpty())
+        commandList.prepend(&TTRssFetcher::fetchMissingArticles);
+
+    startJob(StoreStream);
+}
+
+void TTRssFetcher::pruneRetention()
+{
+    int days = Settings::instance()->getRetentionDays();
+    if (days > 0) {
+        int date = QDateTime::currentDateTimeUtc().addDays(0-days).toTime_t();
+        DatabaseManager::instance()->removeEntriesOlderThanByTimestamp(date);
+    }
+
+    callNextCmd();
+}
+
 void TTRssFetcher::fetchCategories()
 {
     sendApiCall("getCategories", FETCHER_SLOT(finishedCategories));
@@ -189,7 +560,7 @@ void TTRssFetcher::fetchCategories()
 
 void TTRssFetcher::finishedCategories()
 {
-    if (!processResponse()) {
+    if (!checkReply()) {
         return;
     }
 
@@ -210,7 +581,7 @@ void TTRssFetcher::fetchFeeds()
 
 void TTRssFetcher::finishedFeeds()
 {
-    if (!processResponse()) {
+    if (!checkReply()) {
         return;
     }
 
@@ -231,28 +602,335 @@ void TTRssFetcher::fetchStream()
 
 void TTRssFetcher::finishedStream()
 {
-    if (!processResponse()) {
+    if (retryTransient(currentReply, [this] { (this->*currentCommand)(); }))
+        return;
+
+    if (!checkReply()) {
         return;
     }
 
-    startJob(StoreStream);
-}
+    // Reply was decoded while downloading, only remaining data is parsed
+    int code = parseResponse();
+    if (code != 0) {
+        responseError(code);
+        return;
+    }
 
-void TTRssFetcher::finishedStream2()
-{
     Settings *s = Settings::instance();
+
+    QList<DatabaseManager::Entry> entries;
+    entries.swap(decodedEntries);
+
+    for (const auto &e : entries) {
+        if (!e.saved && !e.broadcast && s->getRetentionDays() > 0) {
+            int date = QDateTime::fromTime_t(e.timestamp).daysTo(QDateTime::currentDateTimeUtc());
+            if (date > lastDate)
+                lastDate = date;
+        }
+    }
+    lastCount = entries.count();
+
     if ((s->getRetentionDays() > 0 && lastDate > s->getRetentionDays()) ||
         lastCount < streamLimit) {
-        offset = 0;
-        lastDate = s->getRetentionDays();
+        pagingMore = false;
     } else {
+        pagingMore = true;
         offset += lastCount;
+    }
+
+    // Only all articles stream is resumed, starred and published are short
+    DatabaseManager::Checkpoint checkpoint;
+    if (currentCommand == &TTRssFetcher::fetchStream) {
+        checkpoint.job = "ttrss/stream";
+        checkpoint.offset = offset;
+        checkpoint.lastDate = lastDate;
+        checkpoint.done = !pagingMore;
+    }
+
+    queuePage(entries, checkpoint);
+
+    // Next page is downloaded while this one is being stored
+    if (pagingMore && queuedPagesCount() < maxQueuedPages) {
         commandList.prepend(currentCommand);
+        callNextCmd();
+    }
+
+    // Worker is idle only when finishedJob has handled previous job
+    if (currentJob == Idle)
+        startJob(StoreStream);
+}
+
+void TTRssFetcher::finishedStream2()
+{
+    if (!busy)
+        return;
+
+    bool downloading = isDownloading();
+    if (pagingMore && !downloading && queuedPagesCount() < maxQueuedPages) {
+        commandList.prepend(currentCommand);
+        callNextCmd();
+        downloading = true;
+    }
+
+    // Pages queued after worker had finished
+    if (queuedPagesCount() > 0) {
+        startJob(StoreStream);
+        return;
     }
 
+    // Next page will start worker when downloaded
+    if (downloading)
+        return;
+
+    offset = 0;
+    lastDate = Settings::instance()->getRetentionDays();
+
     callNextCmd();
 }
 
+void TTRssFetcher::fetchStreamConcurrent()
+{
+    auto db = DatabaseManager::instance();
+    auto tabs = db->readTabsByDashboard("ttrss");
+
+    // Without categories all articles are fetched as one stream
+    if (tabs.isEmpty()) {
+        currentCommand = &TTRssFetcher::fetchStream;
+        fetchStream();
+        return;
+    }
+
+    // Categories completed before interruption are skipped, others
+    // continue after the last stored page
+    bool resuming = !resumeCategories.isEmpty();
+
+    pendingHeadlines.clear();
+    for (const auto &tab : tabs) {
+        HeadlinesRequest request;
+        request.feedId = tab.id.toInt();
+        request.isCat = true;
+        request.unreadOnly = !Settings::instance()->getSyncRead();
+        request.checkpoint = true;
+
+        auto checkpoint = resumeCategories.value(request.feedId);
+        if (checkpoint.done)
+            continue;
+        request.offset = checkpoint.offset;
+
+        pendingHeadlines.append(request);
+    }
+    resumeCategories.clear();
+
+    if (!resuming)
+        db->updateEntriesFlag(1);
+
+    headlinesFanOut = true;
+    headlinesUnits = pendingHeadlines.count();
+    headlinesDone = 0;
+
+    dispatchHeadlines();
+
+    if (headlinesReplies.isEmpty())
+        finishedHeadlines2();
+}
+
+void TTRssFetcher::dispatchHeadlines()
+{
+    auto s = Settings::instance();
+    int concurrency = qMax(1, s->getTtrssConcurrency());
+
+    // Pages waiting for worker are also counted, so downloading
+    // stops when DB writes can't keep up
+    while (!pendingHeadlines.isEmpty() &&
+           headlinesReplies.count() < concurrency &&
+           headlinesReplies.count() + queuedPagesCount() < concurrency + maxQueuedPages) {
+        auto state = std::make_shared<HeadlinesReply>();
+        state->request = pendingHeadlines.takeFirst();
+        state->decoder.reset(new JsonEntryDecoder(headlinesTable()));
+        auto entries = &state->entries;
+        state->decoder->setBatchHandler([entries](const QList<DatabaseManager::Entry> &batch) {
+            entries->append(batch);
+        });
+
+        const auto &request = state->request;
+        QNetworkReply *reply = postApiCall("getHeadlines",
+            headlinesParams(request.feedId, request.isCat, !request.idsOnly, request.unreadOnly,
+                            request.offset, request.sinceId));
+        headlinesReplies.insert(reply, state);
+
+        connect(reply, &QNetworkReply::readyRead, this, [this, reply] {
+            int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            auto state = headlinesReplies.value(reply);
+            if (state && statusCode >= 200 && statusCode < 300)
+                feedDecoder(state->decoder.get(), reply->readAll());
+        });
+        connect(reply, &QNetworkReply::finished, this, [this, reply] {
+            finishedHeadlines(reply);
+        });
+#ifndef QT_NO_SSL
+        connect(reply, &QNetworkReply::sslErrors, this, &Fetcher::sslErrors);
+#endif
+    }
+}
+
+void TTRssFetcher::finishedHeadlines(QNetworkReply *reply)
+{
+    auto state = headlinesReplies.take(reply);
+    reply->deleteLater();
+
+    if (!busy || !state)
+        return;
+
+    auto e = reply->error();
+    if (e != QNetworkReply::NoError && isTransientError(reply) &&
+        state->request.attempts < maxRetries) {
+        HeadlinesRequest request = state->request;
+        int delay = retryDelay << request.attempts++;
+        qWarning() << "Transient network error:" << e
+                   << "retry" << request.attempts << "in" << delay << "ms";
+
+        ++headlinesRetrying;
+        int generation = headlinesGeneration;
+        QTimer::singleShot(delay, this, [this, request, generation] {
+            if (!busy || generation != headlinesGeneration)
+                return;
+            --headlinesRetrying;
+            pendingHeadlines.prepend(request);
+            dispatchHeadlines();
+        });
+        return;
+    }
+
+    if (e != QNetworkReply::NoError) {
+        qDebug() << "Request error:" << e;
+        abortHeadlines();
+        if (e == QNetworkReply::SslHandshakeFailedError) {
+            emit error(700);
+        } else {
+            emit error(500);
+        }
+        setBusy(false);
+        return;
+    }
+
+    int code = 0;
+    if (!state->decoder->finish()) {
+        qWarning() << "Error parsing Json:" << state->decoder->errorString();
+        code = 600;
+    } else {
+#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
+        code = checkStatus(QJsonObject::fromVariantMap(state->decoder->captured()));
+#else
+        code = checkStatus(state->decoder->captured());
+#endif
+    }
+
+    if (code != 0) {
+        abortHeadlines();
+        responseError(code);
+        return;
+    }
+
+    Settings *s = Settings::instance();
+
+    int pageDate = 0;
+    for (const auto &entry : state->entries) {
+        if (!entry.saved && !entry.broadcast && s->getRetentionDays() > 0) {
+            int date = QDateTime::fromTime_t(entry.timestamp).daysTo(QDateTime::currentDateTimeUtc());
+            if (date > pageDate)
+                pageDate = date;
+        }
+    }
+
+    bool last = (s->getRetentionDays() > 0 && pageDate > s->getRetentionDays()) ||
+            state->entries.count() < streamLimit;
+    if (last) {
+        ++headlinesDone;
+        emit progress(proggress + double(s->getRetentionDays() * headlinesDone) / headlinesUnits,
+                      proggressTotal);
+    } else {
+        // Next page of the same category goes first, so pages of
+        // one category are stored in order
+        HeadlinesRequest next = state->request;
+        next.offset += state->entries.count();
+        next.attempts = 0;
+        pendingHeadlines.prepend(next);
+    }
+
+    if (state->request.idsOnly) {
+        auto &ids = headlinesIds[state->request.feedId];
+        for (const auto &entry : state->entries)
+            ids.append(entry.id);
+    } else {
+        DatabaseManager::Checkpoint checkpoint;
+        if (state->request.checkpoint) {
+            checkpoint.job = QString("ttrss/category/%1").arg(state->request.feedId);
+            checkpoint.offset = state->request.offset + state->entries.count();
+            checkpoint.done = last;
+        }
+
+        queuePage(state->entries, checkpoint);
+        if (currentJob == Idle)
+            startJob(StoreStream);
+    }
+
+    // Stage can end here when there is nothing to store
+    if (currentJob == Idle)
+        finishedHeadlines2();
+    else
+        dispatchHeadlines();
+}
+
+void TTRssFetcher::finishedHeadlines2()
+{
+    if (!busy || !headlinesFanOut)
+        return;
+
+    dispatchHeadlines();
+
+    // Pages queued after worker had finished
+    if (queuedPagesCount() > 0) {
+        if (currentJob == Idle)
+            startJob(StoreStream);
+        return;
+    }
+
+    // Next reply will start worker when downloaded
+    if (!headlinesReplies.isEmpty() || headlinesRetrying > 0)
+        return;
+
+    headlinesFanOut = false;
+    lastDate = Settings::instance()->getRetentionDays();
+
+    callNextCmd();
+}
+
+void TTRssFetcher::abortHeadlines()
+{
+    pendingHeadlines.clear();
+    headlinesFanOut = false;
+    headlinesRetrying = 0;
+    ++headlinesGeneration;
+
+    auto replies = headlinesReplies.keys();
+    headlinesReplies.clear();
+    for (auto reply : replies) {
+        reply->disconnect(this);
+        reply->abort();
+        reply->deleteLater();
+    }
+}
+
+bool TTRssFetcher::abortRequests()
+{
+    if (!headlinesFanOut)
+        return Fetcher::abortRequests();
+
+    abortHeadlines();
+    emit canceled();
+    return false;
+}
+
 void TTRssFetcher::fetchStarredStream()
 {
     getHeadlines(Starred, true, false, offset, FETCHER_SLOT(finishedStream));
@@ -271,24 +949,26 @@ void TTRssFetcher::pruneOld()
 
 void TTRssFetcher::startJob(Job job)
 {
-    if (isRunning()) {
+    // finished() of previous job can still be queued when thread is
+    // not running anymore
+    if (currentJob != Idle || isRunning()) {
         qWarning() << "Job is running";
         return;
     }
 
     disconnect(this, SIGNAL(finished()), 0, 0);
     currentJob = job;
+    jobError = 0;
 
     switch (job) {
     case StoreCategories:
     case StoreFeeds:
-        connect(this, SIGNAL(finished()), this, SLOT(callNextCmd()));
-        break;
     case StoreStream:
-        connect(this, SIGNAL(finished()), this, SLOT(finishedStream2()));
+        connect(this, SIGNAL(finished()), this, SLOT(finishedJob()));
         break;
     default:
         qWarning() << "Unknown Job";
+        currentJob = Idle;
         emit error(502);
         setBusy(false);
         return;
@@ -297,8 +977,42 @@ void TTRssFetcher::startJob(Job job)
     start(QThread::LowPriority);
 }
 
+void TTRssFetcher::finishedJob()
+{
+    // Worker is idle from now, even if finished() arrives after
+    // the next reply
+    Job job = currentJob;
+    currentJob = Idle;
+    recordJob(QMetaEnum::fromType<Job>().valueToKey(job));
+
+    if (jobError != 0) {
+        abortHeadlines();
+        responseError(jobError);
+        return;
+    }
+
+    if (job == StoreStream && headlinesFanOut) {
+        finishedHeadlines2();
+    } else if (job == StoreStream) {
+        finishedStream2();
+    } else {
+        callNextCmd();
+    }
+}
+
 void TTRssFetcher::run()
 {
+    // Stream pages are parsed before they are queued
+    if (currentJob == StoreStream) {
+        storeStream();
+        return;
+    }
+
+    jobError = parseResponse();
+    if (jobError != 0) {
+        return;
+    }
+
     switch (currentJob) {
     case StoreCategories:
         storeCategories();
@@ -317,7 +1031,6 @@ void TTRssFetcher::run()
 
 void TTRssFetcher::storeCategories()
 {
-    auto db = DatabaseManager::instance();
     QString dashboardId = "ttrss";
 
 #if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
@@ -340,7 +1053,7 @@ void TTRssFetcher::storeCategories()
                 t.id = obj["id"].isString() ? obj["id"].toString() : QString::number(obj["id"].toInt());
                 t.dashboardId = dashboardId;
                 t.title = obj["title"].toString();
-                db->writeTab(t);
+                structure.tabs.append(t);
             }
         }
     } else {
@@ -375,7 +1088,7 @@ void TTRssFetcher::storeFeeds()
             st.query = st.link;
             st.content = "";
             st.type = "";
-            st.unread = 0;
+            st.unread = obj["unread"].toInt();
             st.saved = 0;
             st.read = 0;
             st.slow = 0;
@@ -391,7 +1104,7 @@ void TTRssFetcher::storeFeeds()
                 emit addDownload(item);
             }
 
-            db->writeStream(st);
+            structure.streams.append(st);
 
             DatabaseManager::Module m;
             m.id = st.id;
@@ -402,93 +1115,34 @@ void TTRssFetcher::storeFeeds()
             m.pageId = "";
             m.tabId = obj["id"].isString() ? obj["cat_id"].toString() : QString::number(obj["cat_id"].toInt());
             m.streamList.append(st.id);
-            db->writeModule(m);
+            structure.modules.append(m);
         }
+
+        // Only changed part of structure is written, entries of
+        // unsubscribed feeds are deleted with them
+        auto diff = db->writeStructure(structure);
+        structureChanged = !diff.isEmpty();
     } else {
         qWarning() << "No feeds found";
     }
+
+    structure = DatabaseManager::Structure();
 }
 
 void TTRssFetcher::storeStream()
 {
-    auto s = Settings::instance();
-    auto db = DatabaseManager::instance();
-    auto dm = DownloadManager::instance();
-
-    int count = 0;
-
-#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
-    if (jsonObj["content"].isArray()) {
-        QJsonArray arr = jsonObj["content"].toArray();
-        int end = arr.count();
-        count = end;
-#else
-    if (jsonObj["content"].type()==QVariant::List) {
-        QVariantList::const_iterator i = jsonObj["content"].toList().constBegin();
-        QVariantList::const_iterator end = jsonObj["content"].toList().constEnd();
-#endif
-
-        for (int i = 0; i < arr.count(); ++i) {
-#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
-            QJsonObject obj = arr.at(i).toObject();
-#else
-            QVariantMap obj = (*i).toMap();
-            ++count;
-#endif
-
-            DatabaseManager::Entry e;
-            e.id = obj["id"].isString() ? obj["id"].toString() : QString::number(obj["id"].toInt());
-            e.streamId = obj["feed_id"].isString() ? obj["feed_id"].toString() : QString::number(obj["feed_id"].toInt());
-            e.title = obj["title"].toString();
-            e.author = obj["author"].toString();
-
-            if (obj["content"].isString())
-                e.content = obj["content"].toString();
-
-            e.link = obj["link"].toString();
-            e.read = obj["unread"].toBool() ? 0 : 1;
-            e.saved = obj["marked"].toBool() ? 1 : 0;
-            e.publishedAt = obj["updated"].toInt();
-            e.createdAt = obj["updated"].toInt();
-            e.cached = 0;
-            e.fresh = 1;
-            e.broadcast = obj["published"].toBool() ? 1 : 0;
-            e.timestamp = obj["updated"].toInt();
-
-            QRegExp rx("<img\\s[^>]*src\\s*=\\s*(\"[^\"]*\"|'[^']*')", Qt::CaseInsensitive);
-            if (rx.indexIn(e.content)!=-1) {
-                QString imgSrc = rx.cap(1); imgSrc = imgSrc.mid(1,imgSrc.length()-2);
-                if (!imgSrc.isEmpty()) {
-                    imgSrc.replace("&amp;","&", Qt::CaseInsensitive);
-                    if (s->getCachingMode() == 2 || (s->getCachingMode() == 1 && dm->isWLANConnected())) {
-                        if (!db->isCacheExistsByFinalUrl(Utils::hash(imgSrc))) {
-                            DatabaseManager::CacheItem item;
-                            item.origUrl = imgSrc;
-                            item.finalUrl = imgSrc;
-                            item.type = "entry-image";
-                            emit addDownload(item);
-                        }
-                    }
-                    e.image = imgSrc;
-                }
-            }
-
-            db->writeEntry(e);
-            if (!e.saved && !e.broadcast && s->getRetentionDays() > 0) {
-                int date = QDateTime::fromTime_t(e.timestamp).daysTo(QDateTime::currentDateTimeUtc());
-                if (date > lastDate)
-                    lastDate = date;
-            }
-        }
-
-        lastCount = count;
-    }
+    // Pages can be queued while previous ones are stored
+    QList<DatabaseManager::Entry> entries;
+    DatabaseManager::Checkpoint checkpoint;
+    while (takePage(&entries, &checkpoint))
+        ingest.push(entries, checkpoint);
 }
 
 void TTRssFetcher::uploadActions()
 {
     if (!actionsList.isEmpty()) {
         emit uploading();
+        actionIdsAfter.clear();
         setAction();
     }
 }
@@ -499,6 +1153,7 @@ void TTRssFetcher::setAction()
     DatabaseManager::Action action = actionsList.first();
 
     QString ids;
+    QStringList streamIds;
     int mode, field;
 
     switch (action.type)
@@ -528,47 +1183,36 @@ void TTRssFetcher::setAction()
         break;
     }
     case DatabaseManager::SetStreamReadAll:
+        catchupFeed(action.id1, false);
+        return;
+    case DatabaseManager::SetTabReadAll:
+        catchupFeed(action.id1, true);
+        return;
+    case DatabaseManager::SetAllRead:
+        // All articles virtual feed
+        catchupFeed("-4", false);
+        return;
     case DatabaseManager::UnSetStreamReadAll:
     {
-        ids = mergeEntryIds(db->readEntriesByStream(action.id1, 0, db->countEntriesByStream(action.id1)),
-                            action.type == DatabaseManager::SetStreamReadAll);
-        mode = action.type == DatabaseManager::SetStreamReadAll ? 0 : 1;
+        streamIds.append(action.id1);
+        mode = 1;
         field = 2;
         break;
     }
-    case DatabaseManager::SetTabReadAll:
     case DatabaseManager::UnSetTabReadAll:
     {
-        QList<QString> streams = db->readStreamIdsByTab(action.id1);
-        for (int i = 0; i < streams.count(); ++i) {
-            QString streamIds = mergeEntryIds(db->readEntriesByStream(streams[i], 0, db->countEntriesByStream(streams[i])),
-                                              action.type == DatabaseManager::SetTabReadAll);
-            if (!streamIds.isEmpty()) {
-                if (!ids.isEmpty())
-                    ids += ",";
-                ids += streamIds;
-            }
-        }
-
-        mode = action.type == DatabaseManager::SetTabReadAll ? 0 : 1;
+        streamIds = db->readStreamIdsByTab(action.id1);
+        mode = 1;
         field = 2;
         break;
     }
-    case DatabaseManager::SetAllRead:
     case DatabaseManager::UnSetAllRead:
     {
         QList<DatabaseManager::Stream> streams = db->readStreamsByDashboard(action.id1);
-        for (int i = 0; i < streams.count(); ++i) {
-            QString streamIds = mergeEntryIds(db->readEntriesByStream(streams[i].id, 0, db->countEntriesByStream(streams[i].id)),
-                                              action.type == DatabaseManager::SetAllRead);
-            if (!streamIds.isEmpty()) {
-                if (!ids.isEmpty())
-                    ids += ",";
-                ids += streamIds;
-            }
-        }
+        for (int i = 0; i < streams.count(); ++i)
+            streamIds.append(streams[i].id);
 
-        mode = action.type == DatabaseManager::SetAllRead ? 0 : 1;
+        mode = 1;
         field = 2;
         break;
     }
@@ -594,6 +1238,20 @@ void TTRssFetcher::setAction()
         return;
     }
 
+    // Unread entries of streams are sent in chunks, so memory and request
+    // size don't grow with dashboard
+    if (!streamIds.isEmpty()) {
+        QStringList chunk = db->readEntryIdsByStreams(streamIds, false, actionIdsAfter, idsAtOnce);
+        ids = chunk.join(",");
+        actionIdsAfter = chunk.size() < idsAtOnce ? QString() : chunk.last();
+    }
+
+    // Nothing to mark on server
+    if (ids.isEmpty()) {
+        nextAction();
+        return;
+    }
+
 #if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
     QJsonObject params;
     params["article_ids"] = ids;
@@ -604,15 +1262,43 @@ void TTRssFetcher::setAction()
         ",\"field\":" + QString::number(field);
 #endif
 
+    uploadRequests++;
     sendApiCall("updateArticle", params, FETCHER_SLOT(finishedSetAction));
 }
 
+// Server marks whole feed or category, entry ids are not needed
+void TTRssFetcher::catchupFeed(const QString &feedId, bool isCat)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
+    QJsonObject params;
+    params["feed_id"] = feedId.toInt();
+    params["is_cat"] = isCat;
+#else
+    QString params = "\"feed_id\":" + QString::number(feedId.toInt()) +
+        ",\"is_cat\":" + (isCat ? "true" : "false");
+#endif
+
+    uploadRequests++;
+    sendApiCall("catchupFeed", params, FETCHER_SLOT(finishedSetAction));
+}
+
 void TTRssFetcher::finishedSetAction()
 {
     if (!processResponse()) {
         return;
     }
 
+    // Same action continues with next chunk of ids
+    if (!actionIdsAfter.isEmpty()) {
+        setAction();
+        return;
+    }
+
+    nextAction();
+}
+
+void TTRssFetcher::nextAction()
+{
     auto db = DatabaseManager::instance();
 
     DatabaseManager::Action action = actionsList.takeFirst();
@@ -621,6 +1307,7 @@ void TTRssFetcher::finishedSetAction()
     emit uploadProgress(uploadProggressTotal - actionsList.size(), uploadProggressTotal);
 
     if (actionsList.isEmpty()) {
+        recordUpload(uploadRequests);
         startFetching();
     } else {
         setAction();
@@ -639,34 +1326,33 @@ void TTRssFetcher::callNextCmd()
     }
 }
 
-QString TTRssFetcher::mergeEntryIds(const QList<DatabaseManager::Entry>& entries, bool read)
+void TTRssFetcher::getHeadlines(int feedId, bool getContent, bool unreadOnly, int offset, ReplyCallback callback)
 {
-    QString ids;
-
-    for (int i = 0; i < entries.count(); ++i) {
-        if (entries[i].read == read) {
-            if (!ids.isEmpty())
-                ids += ",";
-            ids += entries[i].id;
-        }
-    }
-
-    return ids;
+    sendApiCall("getHeadlines", headlinesParams(feedId, false, getContent, unreadOnly, offset), callback);
+    startDecoding(headlinesTable());
 }
 
-void TTRssFetcher::getHeadlines(int feedId, bool getContent, bool unreadOnly, int offset, ReplyCallback callback)
+#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
+QJsonObject TTRssFetcher::headlinesParams(int feedId, bool isCat, bool getContent, bool unreadOnly, int offset, int sinceId)
+#else
+QString TTRssFetcher::headlinesParams(int feedId, bool isCat, bool getContent, bool unreadOnly, int offset, int sinceId)
+#endif
 {
 #if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
     QJsonObject params;
     params["feed_id"] = feedId;
+    params["is_cat"] = isCat;
     params["show_content"] = getContent;
     params["view_mode"] = unreadOnly ? "unread" : "all_articles";
     params["include_attachments"] = getContent;
     params["order_by"] = "feed_dates";
     params["skip"] = offset;
     params["limit"] = streamLimit;
+    if (sinceId > 0)
+        params["since_id"] = sinceId;
 #else
     QString params = "\"feed_id\":" + QString::number(feedId) + "," +
+        "\"is_cat\":" + (isCat ? "true," : "false,") +
         "\"show_content\":" + (getContent ? "true," : "false,") +
         "\"show_excerpt\":false," +
         "\"view_mode\":" + (unreadOnly ? "\"unread\"," : "\"all_articles\",") +
@@ -674,9 +1360,11 @@ void TTRssFetcher::getHeadlines(int feedId, bool getContent, bool unreadOnly, in
         "\"order_by\":\"feed_dates\"," +
         "\"skip\":" + QString::number(offset) + "," +
         "\"limit\":" + QString::number(streamLimit);
+    if (sinceId > 0)
+        params += ",\"since_id\":" + QString::number(sinceId);
 #endif
 
-    sendApiCall("getHeadlines", params, callback);
+    return params;
 }
 
 void TTRssFetcher::sendApiCall(const QString& op, ReplyCallback callback)
@@ -703,6 +1391,21 @@ void TTRssFetcher::sendApiCall(const QString& op, const QString& params, ReplyCa
         currentReply = NULL;
     }
 
+    currentReply = postApiCall(op, params);
+    connect(currentReply, &QNetworkReply::finished, this, callback);
+    connect(currentReply, SIGNAL(readyRead()), this, SLOT(readyRead()));
+    connect(currentReply, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(networkError(QNetworkReply::NetworkError)));
+#ifndef QT_NO_SSL
+    connect(currentReply, &QNetworkReply::sslErrors, this, &Fetcher::sslErrors);
+#endif
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
+QNetworkReply* TTRssFetcher::postApiCall(const QString& op, const QJsonObject& params)
+#else
+QNetworkReply* TTRssFetcher::postApiCall(const QString& op, const QString& params)
+#endif
+{
     QNetworkRequest request(QUrl(Settings::instance()->getUrl() + "/api/"));
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json; charset=UTF-8");
 
@@ -718,16 +1421,25 @@ void TTRssFetcher::sendApiCall(const QString& op, const QString& params, ReplyCa
     QString body = "{\"op\":\"" + op + "\"" + (!params.isEmpty() ? params : "") + "}";
 #endif
 
-    currentReply = nam.post(request, body.toUtf8());
-    connect(currentReply, &QNetworkReply::finished, this, callback);
-    connect(currentReply, SIGNAL(readyRead()), this, SLOT(readyRead()));
-    connect(currentReply, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(networkError(QNetworkReply::NetworkError)));
-#ifndef QT_NO_SSL
-    connect(currentReply, &QNetworkReply::sslErrors, this, &Fetcher::sslErrors);
-#endif
+    return nam.post(request, body.toUtf8());
 }
 
 bool TTRssFetcher::processResponse()
+{
+    if (!checkReply()) {
+        return false;
+    }
+
+    int code = parseResponse();
+    if (code != 0) {
+        responseError(code);
+        return false;
+    }
+
+    return true;
+}
+
+bool TTRssFetcher::checkReply()
 {
     auto e = currentReply->error();
     if (e != QNetworkReply::NoError &&
@@ -742,35 +1454,53 @@ bool TTRssFetcher::processResponse()
         return false;
     }
 
+    return true;
+}
+
+// Called also from worker thread, so only returns error code
+int TTRssFetcher::parseResponse()
+{
     if (!parse()) {
         qWarning() << "Error parsing Json";
-        emit error(600);
-        setBusy(false);
-        return false;
-    } else if (jsonObj["status"].toInt() != 0) {
+        return 600;
+    }
+
+    return checkStatus(jsonObj);
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
+int TTRssFetcher::checkStatus(const QJsonObject& obj)
+#else
+int TTRssFetcher::checkStatus(const QVariantMap& obj)
+#endif
+{
+    if (obj["status"].toInt() != 0) {
         QString err;
 #if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
-        err = jsonObj["content"].toObject()["error"].toString();
+        err = obj["content"].toObject()["error"].toString();
 #else
-        err = jsonObj["content"].toMap()["error"].toString();
+        err = obj["content"].toMap()["error"].toString();
 #endif
         qWarning() << "Error: " << err;
         if (err == "LOGIN_ERROR") {
-            if (busyType == Fetcher::CheckingCredentials) {
-                emit errorCheckingCredentials(501);
-            } else {
-                emit error(402);
-            }
+            return 402;
         } else if (err == "NOT_LOGGED_IN") {
-            emit error(401);
+            return 401;
         } else if (err == "API_DISABLED") {
-            emit error(404);
-        } else {
-            emit error(601);
+            return 404;
         }
-        setBusy(false);
-        return false;
+        return 601;
     }
 
-    return true;
+    return 0;
+}
+
+void TTRssFetcher::responseError(int code)
+{
+    if (code == 402 && busyType == Fetcher::CheckingCredentials) {
+        emit errorCheckingCredentials(501);
+    } else {
+        emit error(code);
+    }
+    setBusy(false);
 }
@@ -27,6 +27,8 @@
 #include <QList>
 #include <QVariantMap>
 #include <QNetworkRequest>
+#include <QHash>
+#include <memory>
 #if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
 #include <QJsonArray>
 #else
@@ -54,6 +56,7 @@ class TTRssFetcher : public Fetcher
         StoreFeeds,
         StoreStream
     };
+    Q_ENUM(Job)
 
     enum SpecialFeed {
         AllArticles = -4,
@@ -62,6 +65,26 @@ class TTRssFetcher : public Fetcher
         Starred = -1
     };
 
+    // Headlines of one feed or category fetched concurrently with other ones
+    struct HeadlinesRequest {
+        int feedId = 0;
+        bool isCat = false;
+        bool unreadOnly = false;
+        // Only ids are collected, entries are not stored
+        bool idsOnly = false;
+        int sinceId = 0;
+        int offset = 0;
+        // Position is stored with pages, so full sync can be resumed
+        bool checkpoint = false;
+        int attempts = 0;
+    };
+
+    struct HeadlinesReply {
+        HeadlinesRequest request;
+        std::unique_ptr<JsonEntryDecoder> decoder;
+        QList<DatabaseManager::Entry> entries;
+    };
+
 public:
     explicit TTRssFetcher(QObject *parent = 0);
     virtual ~TTRssFetcher();
@@ -71,6 +94,7 @@ public:
 
 protected:
     void run();
+    bool abortRequests();
 
 private Q_SLOTS:
     void finishedSignIn();
@@ -79,7 +103,12 @@ private Q_SLOTS:
     void finishedFeeds();
     void finishedStream();
     void finishedStream2();
+    void finishedCounters();
+    void finishedArticles();
+    void finishedHeadlines(QNetworkReply *reply);
+    void finishedHeadlines2();
     void finishedSetAction();
+    void finishedJob();
 
     void callNextCmd();
 
@@ -87,14 +116,30 @@ private:
     virtual void signIn();
     virtual void startFetching();
     virtual void uploadActions();
+    virtual QUrl serviceUrl() const;
+
+    void startFullSync();
+    void startIncrementalSync();
+    void startResumedSync(const QList<DatabaseManager::Checkpoint> &checkpoints);
+    void startRefresh();
 
     void fetchCategories();
     void fetchFeeds();
     void fetchStream();
+    void fetchStreamConcurrent();
+    void dispatchHeadlines();
+    void abortHeadlines();
     void fetchStarredStream();
     void fetchPublishedStream();
     void pruneOld();
+    void fetchCounters();
+    void fetchChanges();
+    void reconcileState();
+    void fetchMissingArticles();
+    void pruneRetention();
     void setAction();
+    void nextAction();
+    void catchupFeed(const QString &feedId, bool isCat);
 
     void startJob(Job job);
 
@@ -102,18 +147,28 @@ private:
     void storeFeeds();
     void storeStream();
 
-    QString mergeEntryIds(const QList<DatabaseManager::Entry>& entries, bool read);
-
     void getHeadlines(int feedId, bool getContent, bool unreadOnly, int offset, ReplyCallback callback);
 
     void sendApiCall(const QString& op, ReplyCallback callback);
 #if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
+    QJsonObject headlinesParams(int feedId, bool isCat, bool getContent, bool unreadOnly, int offset, int sinceId = 0);
     void sendApiCall(const QString& op, const QJsonObject& params, ReplyCallback callback);
+    QNetworkReply* postApiCall(const QString& op, const QJsonObject& params);
 #else
+    QString headlinesParams(int feedId, bool isCat, bool getContent, bool unreadOnly, int offset, int sinceId = 0);
     void sendApiCall(const QString& op, const QString& params, ReplyCallback callback);
+    QNetworkReply* postApiCall(const QString& op, const QString& params);
 #endif
 
     bool processResponse();
+    bool checkReply();
+    int parseResponse();
+#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
+    int checkStatus(const QJsonObject& obj);
+#else
+    int checkStatus(const QVariantMap& obj);
+#endif
+    void responseError(int code);
 
 private:
     static const int streamLimit = 100;
@@ -123,12 +178,38 @@ private:
     QString iconsUrl;
 
     QList<int> processedActionList;
+    // Ids of entries marked unread by stream are sent in chunks, next
+    // chunk starts after this id
+    static const int idsAtOnce = 200;
+    QString actionIdsAfter;
     QList<ChainCommand> commandList;
     ChainCommand currentCommand;
     Job currentJob;
     int lastDate;
     int lastCount;
     int offset;
+    bool pagingMore = false;
+
+    QList<HeadlinesRequest> pendingHeadlines;
+    QHash<QNetworkReply*, std::shared_ptr<HeadlinesReply>> headlinesReplies;
+    bool headlinesFanOut = false;
+    int headlinesUnits = 0;
+    int headlinesDone = 0;
+    QHash<int, QList<QString>> headlinesIds;
+    // Requests waiting for retry, generation is changed on abort
+    int headlinesRetrying = 0;
+    int headlinesGeneration = 0;
+    // Structure of full sync, written when feeds are stored
+    DatabaseManager::Structure structure;
+    // Categories of interrupted full sync by id
+    QHash<int, DatabaseManager::Checkpoint> resumeCategories;
+
+    // Incremental sync state
+    QHash<QString, int> counters;
+    // Time of last update of feed on server
+    QHash<QString, int> feedUpdates;
+    QList<QString> changedFeeds;
+    QList<QString> missingIds;
 };
 
 #endif // TTRSSFETCHER_H